@@ -43,7 +43,9 @@ string(FIND ${CMAKE_BINARY_DIR} "_arm" ARM_POS)
 math(EXPR IS_LINK "${STR_LENGTH} - ${LINK_POS}")
 math(EXPR IS_ARM "${STR_LENGTH} - ${ARM_POS}")
 
-if( ${IS_LINK} STREQUAL 5 )
+if( SOS_BUILD_CONFIG STREQUAL link OR SOS_BUILD_CONFIG STREQUAL arm )
+	message( STATUS "Build config is ${SOS_BUILD_CONFIG}" )
+elseif( ${IS_LINK} STREQUAL 5 )
 	set(SOS_BUILD_CONFIG link CACHE INTERNAL "sos build config is link")
 	message( STATUS "Set build config to link" )
 elseif( ${IS_ARM} STREQUAL 4 )
@@ -71,6 +71,14 @@ u64 task_root_gettime(int tid) MCU_ROOT_CODE;
 void task_root_delete(int id /*! The task to delete */) MCU_ROOT_CODE;
 
 void task_root_switch_context() MCU_ROOT_CODE;
+void task_root_set_deadline(int id /*! The task ID */,
+									 u32 deadline /*! The absolute deadline in microseconds (modulo 2^32) */,
+									 u32 budget /*! Clock cycles the task may execute (zero to schedule the task round robin) */) MCU_ROOT_CODE;
+
+//implemented by the scheduler -- called when a deadline task uses its budget
+void task_budget_event_handler(int id) MCU_ROOT_CODE;
+//implemented by the scheduler -- the microsecond clock that times a task running without the SysTick
+u64 task_root_get_usecond_clock() MCU_ROOT_CODE;
 void task_root_resetstack(int id) MCU_ROOT_CODE;
 
 
@@ -91,6 +99,7 @@ u32 task_interrupt_stacksize();
 s8 task_get_current_priority();
 void task_root_set_current_priority(s8 value);
 void task_root_elevate_current_priority(s8 value);
+s8 task_root_get_highest_ready_priority();
 
 u32 task_reverse_memory_lookup(u32 input);
 
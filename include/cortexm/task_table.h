@@ -31,7 +31,7 @@ extern "C" {
 
 //flags 0 to 7 are unused
 #define TASK_FLAGS_USED (1<<0) //task is currently being used
-#define TASK_FLAGS_EXEC (1<<1) //set if task is part of current tasks being executed (highest priority of active tasks)
+#define TASK_FLAGS_EXEC (1<<1) //set for task 0 (other tasks execute when they are in the ready list of the current priority)
 #define TASK_FLAGS_ACTIVE (1<<2) //Task is currently active (it is not blocked or sleeping)
 #define TASK_FLAGS_THREAD (1<<3) //Task is a thread task rather than a process (first thread)
 #define TASK_FLAGS_FIFO (1<<4) //Task is executed in FIFO rather than Round Robin mode
@@ -39,8 +39,15 @@ extern "C" {
 #define TASK_FLAGS_ROOT (1<<6) //Task has root privileges
 #define TASK_FLAGS_YIELD (1<<7) //current task wants to yield the processor -- also used internally by context switcher to track SVCALL
 
+//one ready list per priority (SCHED_LOWEST_PRIORITY to SCHED_HIGHEST_PRIORITY) -- higher priorities share the top list
+#define TASK_PRIORITY_TOTAL 32
+
 extern volatile task_t sos_task_table[];
 
+//moves the task in/out of the ready lists after its flags or priority change
+void task_root_update_ready(int id);
+int task_exec_asserted(int id);
+
 static inline int task_enabled_active_not_stopped(int id){
     return (sos_task_table[id].flags & (TASK_FLAGS_USED | TASK_FLAGS_ACTIVE | TASK_FLAGS_STOPPED)) == (TASK_FLAGS_ACTIVE | TASK_FLAGS_USED );
 }
@@ -60,17 +67,13 @@ static inline void task_set_reent(int id, struct _reent * reent, struct _reent *
     sos_task_table[id].global_reent = global_reent;
 }
 
-static inline void task_assert_used(int id){ task_assert_flag(id, TASK_FLAGS_USED); }
-static inline void task_deassert_used(int id){ task_deassert_flag(id, TASK_FLAGS_USED); }
+static inline void task_assert_used(int id){ task_assert_flag(id, TASK_FLAGS_USED); task_root_update_ready(id); }
+static inline void task_deassert_used(int id){ task_deassert_flag(id, TASK_FLAGS_USED); task_root_update_ready(id); }
 static inline int task_used_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_USED); }
 static inline int task_enabled(int id){ return task_flag_asserted(id, TASK_FLAGS_USED); }
 
-static inline void task_assert_exec(int id){ task_assert_flag(id, TASK_FLAGS_EXEC); }
-static inline void task_deassert_exec(int id){ task_deassert_flag(id, TASK_FLAGS_EXEC); }
-static inline int task_exec_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_EXEC); }
-
-static inline void task_assert_active(int id){ task_assert_flag(id, TASK_FLAGS_ACTIVE); }
-static inline void task_deassert_active(int id){ task_deassert_flag(id, TASK_FLAGS_ACTIVE); }
+static inline void task_assert_active(int id){ task_assert_flag(id, TASK_FLAGS_ACTIVE); task_root_update_ready(id); }
+static inline void task_deassert_active(int id){ task_deassert_flag(id, TASK_FLAGS_ACTIVE); task_root_update_ready(id); }
 static inline int task_active_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_ACTIVE); }
 
 static inline void task_assert_thread(int id){ task_assert_flag(id, TASK_FLAGS_THREAD); }
@@ -81,8 +84,8 @@ static inline void task_assert_fifo(int id){ task_assert_flag(id, TASK_FLAGS_FIF
 static inline void task_deassert_fifo(int id){ task_deassert_flag(id, TASK_FLAGS_FIFO); }
 static inline int task_fifo_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_FIFO); }
 
-static inline void task_assert_stopped(int id){ task_assert_flag(id, TASK_FLAGS_STOPPED); }
-static inline void task_deassert_stopped(int id){ task_deassert_flag(id, TASK_FLAGS_STOPPED); }
+static inline void task_assert_stopped(int id){ task_assert_flag(id, TASK_FLAGS_STOPPED); task_root_update_ready(id); }
+static inline void task_deassert_stopped(int id){ task_deassert_flag(id, TASK_FLAGS_STOPPED); task_root_update_ready(id); }
 static inline int task_stopped_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_STOPPED); }
 
 static inline void task_assert_root(int id){ task_assert_flag(id, TASK_FLAGS_ROOT); }
@@ -93,9 +96,11 @@ static inline void task_assert_yield(int id){ task_assert_flag(id, TASK_FLAGS_YI
 static inline void task_deassert_yield(int id){ task_deassert_flag(id, TASK_FLAGS_YIELD); }
 static inline int task_yield_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_YIELD); }
 
+static inline int task_deadline_asserted(int id){ return sos_task_table[id].is_deadline != 0; }
+
 static inline void task_set_parent(int id, int parent){ sos_task_table[id].parent = parent; }
 static inline int task_get_parent(int id){ return sos_task_table[id].parent; }
-static inline void task_set_priority(int id, int priority){ sos_task_table[id].priority = priority; }
+static inline void task_set_priority(int id, int priority){ sos_task_table[id].priority = priority; task_root_update_ready(id); }
 static inline s8 task_get_priority(int id){ return sos_task_table[id].priority; }
 
 extern volatile int m_task_current;
@@ -108,6 +113,8 @@ int task_get_pid(int id){
 
 u8 task_get_total();
 
+static inline u32 task_get_wake_count(int id){ return sos_task_table[id].wake_count; }
+
 static inline void task_get_timer(u32 * dest, int id){
     dest[1] = sos_task_table[id].timer.t_atomic[1];
     dest[0] = sos_task_table[id].timer.t_atomic[0];
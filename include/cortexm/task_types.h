@@ -75,6 +75,16 @@ typedef struct MCU_PACK {
 	void * global_reent /*! Points to process re-entrancy data */;
 	void * reent /*! Points to thread re-entrancy data */;
 	int rr_time /*! The amount of time the task used in the round robin */;
+	volatile u8 ready_next /*! Next task in the ready list (zero if the task is not ready) */;
+	volatile u8 ready_prev /*! Previous task in the ready list */;
+	volatile u8 ready_list /*! The ready list (priority) that holds the task */;
+	volatile u8 is_deadline /*! Non-zero if the task is ordered by deadline (see task_root_set_deadline()) */;
+	u32 wake_count /*! The number of times the task has been switched in */;
+	u32 voluntary_switch_count /*! The number of times the task was switched out after it blocked or yielded */;
+	u32 involuntary_switch_count /*! The number of times the task was switched out while it was ready */;
+	u64 root_time /*! Clock cycles the task has spent executing kernel calls (SVCall) */;
+	volatile u32 deadline /*! Absolute deadline in microseconds (modulo 2^32) of a deadline task */;
+	volatile u32 budget /*! Clock cycles a deadline task may execute before its next deadline */;
 #if __FPU_USED == 1
 	u32 fp[32];
 	u32 fpscr;
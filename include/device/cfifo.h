@@ -24,9 +24,12 @@
 #include "fifo.h"
 #include "sos/dev/cfifo.h"
 
-typedef struct MCU_PACK {
+//not packed so the driver can pass &transfer_handler to devfs (same layout on the target)
+typedef struct {
 	u32 * owner_array;
 	fifo_state_t * fifo_state_array;
+	volatile u32 o_ready; //bitmask of channels with data -- updated as data is written and read
+	devfs_transfer_handler_t transfer_handler; //read is used to wait on CFIFO_LOC_READY
 } cfifo_state_t;
 
 /*! \brief MCFIFO Configuration
@@ -27,13 +27,17 @@
 #include "sos/fs/devfs.h"
 
 
-/*! \details This is the state for a framed FIFO (ffifo)
+/*! \details This is the state for a framed FIFO (ffifo).
+ * It isn't packed so that the driver can pass \a transfer_handler
+ * to devfs (the layout is the same on the target).
  *
  */
-typedef struct MCU_PACK {
+typedef struct {
     volatile fifo_atomic_position_t atomic_position;
     devfs_transfer_handler_t transfer_handler;
     volatile u32 o_flags;
+    ffifo_watermark_t watermark;
+    volatile u32 overflow_count;
 } ffifo_state_t;
 
 /*! \details This is the configuration for a framed FIFO (ffifo)
@@ -64,7 +68,13 @@ void * ffifo_get_tail(const ffifo_config_t * config, ffifo_state_t * state);
 int ffifo_read_buffer(const ffifo_config_t * config, ffifo_state_t * state, char * buf, int len);
 int ffifo_write_buffer(const ffifo_config_t * config, ffifo_state_t * state, const char * buf, int len);
 
+int ffifo_acquire_read(const ffifo_config_t * config, ffifo_state_t * state, ffifo_lend_t * lend);
+int ffifo_release_read(const ffifo_config_t * config, ffifo_state_t * state, const ffifo_lend_t * lend);
+int ffifo_acquire_write(const ffifo_config_t * config, ffifo_state_t * state, ffifo_lend_t * lend);
+int ffifo_release_write(const ffifo_config_t * config, ffifo_state_t * state, const ffifo_lend_t * lend);
+
 char * ffifo_get_frame(const ffifo_config_t * config, u16 frame);
+u16 ffifo_get_frame_count_ready(const ffifo_config_t * config, ffifo_state_t * state);
 
 //helper functions for implementing FIFOs
 void ffifo_flush(ffifo_state_t * state);
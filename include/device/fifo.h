@@ -34,10 +34,12 @@ typedef union {
     u32 atomic_access; //read head and tail in one operation
 } fifo_atomic_position_t;
 
-typedef struct MCU_PACK {
+//not packed so the drivers can pass &transfer_handler to devfs (same layout on the target)
+typedef struct {
     volatile fifo_atomic_position_t atomic_position; //4 bytes
     devfs_transfer_handler_t transfer_handler; //8 bytes
     volatile u32 o_flags; //4 bytes
+    mcu_event_handler_t data_received; //8 bytes -- called by fifo_data_received() for the group the fifo is in (cfifo)
 } fifo_state_t;
 
 /*! \brief FIFO Configuration
@@ -82,6 +84,9 @@ void fifo_set_notify_write(fifo_state_t * state, int value);
 int fifo_is_overflow(fifo_state_t * state);
 void fifo_set_overflow(fifo_state_t * state, int value);
 
+u32 fifo_get_ready_events(u32 atomic_access, u16 full_tail, int writeblock);
+int fifo_poll_read(const fifo_config_t * cfgp, fifo_state_t * state, devfs_poll_t * request);
+
 int fifo_read_buffer(const fifo_config_t * cfgp, fifo_state_t * state, char * buf, int nbyte);
 int fifo_write_buffer(const fifo_config_t * cfgp, fifo_state_t * state, const char * buf, int nbyte, int non_blocking);
 
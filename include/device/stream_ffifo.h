@@ -31,6 +31,7 @@ typedef struct {
     devfs_async_t async;
     u32 access_count;
     s32 error;
+    u32 overflow_access_count;
 } stream_ffifo_channel_state_t;
 
 typedef struct {
@@ -29,7 +29,7 @@ typedef struct {
     u32 bytes_transferred;
 } switchboard_state_terminal_t;
 
-typedef struct {
+typedef struct switchboard_state {
     u32 o_flags;
     switchboard_state_terminal_t input;
     switchboard_state_terminal_t output;
@@ -39,6 +39,13 @@ typedef struct {
     u16 transaction_limit;
     u16 packet_size;
     mcu_event_handler_t event_handler;
+    struct switchboard_state * source; //connection that reads the input (points to itself unless the connection fans out from another one)
+    struct switchboard_state * fan_out; //next output that shares the source's buffers
+    u16 buffer_size;
+    u8 reference_count[2]; //number of outputs that still need to write each buffer (used by the source)
+    u8 pending; //bitmask of buffers this output still needs to write
+    u8 resd[3];
+    switchboard_transform_t transform;
 } switchboard_state_t;
 
 typedef struct {
@@ -36,6 +36,14 @@
 #define PTHREAD_DEFAULT_STACK_SIZE 1536
 #define MALLOC_CHUNK_SIZE 64
 #define MALLOC_SBRK_JUMP_SIZE 128
+#if !defined MALLOC_USE_FREE_LIST_BINS
+//set to 1 for O(1) malloc()/free() using segregated free lists
+#define MALLOC_USE_FREE_LIST_BINS 0
+#endif
+#if !defined MALLOC_USE_PROFILER
+//set to 1 to record the caller of each allocation (adds 4 bytes to each chunk header)
+#define MALLOC_USE_PROFILER 0
+#endif
 #define SCHED_FIRST_THREAD_STACK_SIZE 2048
 #define SCHED_DEFAULT_STACKGUARD_SIZE 128
 
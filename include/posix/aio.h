@@ -35,6 +35,7 @@
 extern "C" {
 #endif
 
+struct aio_queue;
 
 /*! \brief AIO Data Structure
  * \details This is the data structure used
@@ -50,10 +51,29 @@ struct aiocb {
 	struct sigevent aio_sigevent /*! \brief The AIO sigevent */;
 	int aio_lio_opcode /*! \brief The AIO list opcode */;
     devfs_async_t async;
-	//list
-	//items in list
+	struct aio_queue * aio_queue /*! \brief The completion queue (assigned when the operation is started) */;
+	void * volatile suspend /*! \brief The aio_suspend() call waiting on this operation (used by the kernel) */;
 };
 
+/*! \brief AIO Completion Queue
+ * \details Operations started with aio_queue_submit() are added
+ * to the queue when they finish so a thread can collect them
+ * with aio_queue_get() rather than checking each one.
+ *
+ * The queue holds at most \a size - 1 operations. If a finished operation
+ * doesn't fit, \a overflow_count is incremented and the operation is only
+ * visible through aio_error() and aio_return().
+ *
+ */
+typedef struct aio_queue {
+	struct aiocb ** entry /*! \brief Ring of finished operations (\a size entries) */;
+	u16 size /*! \brief Number of entries in the ring */;
+	volatile u16 head /*! \brief Next entry written by the kernel */;
+	volatile u16 tail /*! \brief Next entry read by aio_queue_get() */;
+	volatile u16 overflow_count /*! \brief Number of finished operations that didn't fit */;
+	volatile int tid /*! \brief Thread waiting in aio_queue_get() (-1 if none) */;
+} aio_queue_t;
+
 #define AIO_ALLDONE 1
 #define AIO_CANCELED 2
 #define AIO_NOTCANCELED 3
@@ -63,6 +83,10 @@ struct aiocb {
 #define LIO_WAIT 7
 #define LIO_WRITE 8
 
+#ifndef AIO_LISTIO_MAX
+#define AIO_LISTIO_MAX 16
+#endif
+
 int aio_cancel(int fildes, struct aiocb * aiocbp);
 int aio_error(const struct aiocb * aiocbp);
 int aio_fsync(int, struct aiocb * aiocbp);
@@ -72,6 +96,10 @@ int aio_suspend(struct aiocb *const list[], int nent, const struct timespec * ti
 int aio_write(struct aiocb * aiocbp);
 int lio_listio(int mode, struct aiocb * const list[], int nent, struct sigevent * sig);
 
+int aio_queue_init(aio_queue_t * queue, struct aiocb ** entry, u16 size);
+int aio_queue_submit(aio_queue_t * queue, struct aiocb * const list[], int nent);
+struct aiocb * aio_queue_get(aio_queue_t * queue, const struct timespec * timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -48,11 +48,12 @@ struct mq_attr {
 	long mq_curmsgs /*! number of messages currently queued */;
 };
 
-/*! \details This defines the maximum
- * priority that can be assigned to a message.
+/*! \details This defines the number of message
+ * priorities. The priority assigned to a message
+ * must be less than this value.
  * \hideinitializer
  */
-#define MQ_PRIO_MAX INT_MAX
+#define MQ_PRIO_MAX 32
 
 
 int mq_getattr(mqd_t mqdes, struct mq_attr *mqstat);
@@ -78,6 +79,14 @@ void mq_flush(mqd_t mqdes);
 ssize_t mq_tryreceive(mqd_t mqdes, char * msg_ptr, size_t msg_len, unsigned * msg_prio);
 int mq_trysend(mqd_t mqdes, const char * msg_ptr, size_t msg_len, unsigned msg_prio);
 
+//non standard zero-copy access -- the message is written or read in place
+void * mq_reserve(mqd_t mqdes);
+void * mq_timedreserve(mqd_t mqdes, const struct timespec * abs_timeout);
+int mq_commit(mqd_t mqdes, void * msg_ptr, size_t msg_len, unsigned msg_prio);
+void * mq_borrow(mqd_t mqdes, size_t * msg_len, unsigned * msg_prio);
+void * mq_timedborrow(mqd_t mqdes, size_t * msg_len, unsigned * msg_prio, const struct timespec * abs_timeout);
+int mq_release(mqd_t mqdes, void * msg_ptr);
+
 
 #ifdef __cplusplus
 }
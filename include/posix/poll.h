@@ -0,0 +1,58 @@
+/* Copyright 2011-2018 Tyler Gilbert; 
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * 
+ */
+
+#ifndef POLL_H_
+#define POLL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \details This is the type used for the number of
+ * file descriptors passed to poll().
+ */
+typedef unsigned int nfds_t;
+
+/*! \details This structure holds a file descriptor
+ * and the events to poll() for.
+ */
+struct pollfd {
+	int fd /*! The file descriptor to poll (negative values are ignored) */;
+	short events /*! The events to check for */;
+	short revents /*! The events that occurred (written by poll()) */;
+};
+
+#define POLLIN 0x0001 /*! Data other than high-priority data may be read without blocking */
+#define POLLRDNORM 0x0002 /*! Normal data may be read without blocking */
+#define POLLRDBAND 0x0004 /*! Priority data may be read without blocking */
+#define POLLPRI 0x0008 /*! High priority data may be read without blocking */
+#define POLLOUT 0x0010 /*! Normal data may be written without blocking */
+#define POLLWRNORM POLLOUT /*! Same as POLLOUT */
+#define POLLWRBAND 0x0020 /*! Priority data may be written */
+#define POLLERR 0x0040 /*! An error has occurred (only in revents) */
+#define POLLHUP 0x0080 /*! The device has been disconnected (only in revents) */
+#define POLLNVAL 0x0100 /*! The file descriptor is invalid (only in revents) */
+
+int poll(struct pollfd fds[], nfds_t nfds, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POLL_H_ */
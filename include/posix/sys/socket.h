@@ -40,6 +40,7 @@ struct iovec;
 #endif //SOS_BOOTSTRAP_SOCKETS
 
 #include "arpa/inet.h"
+#include "sys/uio.h"
 
 #if defined __cplusplus
 extern "C" {
@@ -65,8 +66,7 @@ int sendto(int s, const void *dataptr, size_t size, int flags,
 			  const struct sockaddr *to, socklen_t tolen);
 int socket(int domain, int type, int protocol);
 
-//these functions are currently only for sockets but should be supported on non-sockets as well
-int writev(int s, const struct iovec *iov, int iovcnt);
+//works with files and devices (see poll()) -- sets that have sockets go to the socket API
 int select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset, struct timeval *timeout);
 
 //these are supported on both sockets and non-sockets
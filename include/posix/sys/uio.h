@@ -0,0 +1,49 @@
+/* Copyright 2011-2018 Tyler Gilbert; 
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * 
+ */
+
+#ifndef SYS_UIO_H_
+#define SYS_UIO_H_
+
+#include <sys/types.h>
+
+#if !defined SOS_BOOTSTRAP_SOCKETS
+//lwIP defines struct iovec for its socket API
+#include <lwip/sockets.h>
+#else
+/*! \details This structure describes one segment
+ * of a vectored transfer (see readv() and writev()).
+ */
+struct iovec {
+	void * iov_base /*! The base address of the segment */;
+	size_t iov_len /*! The number of bytes in the segment */;
+};
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ssize_t readv(int fildes, const struct iovec * iov, int iovcnt);
+ssize_t writev(int fildes, const struct iovec * iov, int iovcnt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYS_UIO_H_ */
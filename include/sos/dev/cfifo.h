@@ -38,13 +38,39 @@
 #include "fifo.h"
 #include "mcu/types.h"
 
-#define CFIFO_VERSION (0x030000)
+#define CFIFO_VERSION (0x030100)
 #define CFIFO_IOC_CHAR 'M'
 
 enum {
 	CFIFO_FLAG_NONE = 0,
 };
 
+/*! \details Reading this location (rather than a channel) waits for
+ * any of the selected channels to have data. The read must be
+ * sizeof(u32) bytes. Before the read, the buffer holds the bitmask
+ * of channels to wait for (zero to wait for any channel). When the read
+ * completes, the buffer holds the bitmask of selected channels that
+ * are ready.
+ *
+ * \code
+ * u32 o_ready = (1<<3) | (1<<7);
+ * lseek(fd, CFIFO_LOC_READY, SEEK_SET);
+ * read(fd, &o_ready, sizeof(o_ready)); //blocks until channel 3 or 7 has data
+ * \endcode
+ *
+ * With O_NONBLOCK, the read returns less than zero with errno
+ * set to EAGAIN if none of the selected channels are ready.
+ *
+ */
+#define CFIFO_LOC_READY (0x10000)
+
+/*! \details Use this channel with I_MCU_SETACTION and a null
+ * callback to cancel a read that is waiting on CFIFO_LOC_READY
+ * (mcu_action_t::channel is too small to hold CFIFO_LOC_READY).
+ *
+ */
+#define CFIFO_CHANNEL_READY (0xff)
+
 typedef struct MCU_PACK {
 	u32 o_flags /*! Fifo flags */;
 	u16 count /*! Total number of channels in the fifo */;
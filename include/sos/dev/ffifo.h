@@ -54,7 +54,8 @@ typedef struct MCU_PACK {
 	u16 frame_size /*! Frame size of the fifo */;
 	u16 frame_count_ready /*! Number of frames being used */;
 	u16 resd_align;
-	u32 resd[8];
+	u32 overflow_count /*! Total number of frames that were overwritten before they were read (or zero-filled by a stream before they were written) */;
+	u32 resd[7];
 } ffifo_info_t;
 
 
@@ -67,6 +68,31 @@ typedef struct MCU_PACK {
 	u32 resd[8];
 } ffifo_attr_t;
 
+/*! \brief FFIFO Frame Lending
+ * \details This structure is used to borrow frames
+ * in the FFIFO buffer so they can be processed in place
+ * rather than copied with read() or write().
+ *
+ * With an acquire request, \a frame_count is the maximum
+ * number of frames to borrow (zero for no limit). The driver
+ * writes the location of the first frame to \a frame and the
+ * number of contiguous frames that are lent to \a frame_count
+ * and the size of each frame to \a frame_size.
+ *
+ * With a release request, \a frame must be the value provided by
+ * the acquire request and \a frame_count is the number of frames
+ * that were consumed (read) or filled (written).
+ *
+ * The frames are in the driver's buffer so the buffer
+ * must be in memory the application can access.
+ *
+ */
+typedef struct MCU_PACK {
+	void * frame /*! Location of the first lent frame */;
+	u16 frame_count /*! Number of frames */;
+	u16 frame_size /*! Bytes in each frame (set by acquire requests) */;
+} ffifo_lend_t;
+
 #define I_FFIFO_GETVERSION _IOCTL(FFIFO_IOC_IDENT_CHAR, I_MCU_GETVERSION)
 #define I_FFIFO_GETINFO _IOCTLR(FIFO_IOC_CHAR, 0, ffifo_info_t)
 #define I_FFIFO_SETATTR _IOCTLW(FIFO_IOC_CHAR, 1, ffifo_attr_t)
@@ -75,6 +101,126 @@ typedef struct MCU_PACK {
 #define I_FFIFO_INIT I_FIFO_INIT
 #define I_FFIFO_EXIT I_FIFO_EXIT
 
+/*! \brief See below for details.
+ * \details Borrows the oldest frames in the FFIFO so they
+ * can be read in place. Returns the number of frames that
+ * are lent or less than zero with errno set to EAGAIN if
+ * the FFIFO is empty.
+ *
+ * \code
+ * ffifo_lend_t lend;
+ * lend.frame_count = 0;
+ * if( ioctl(fd, I_FFIFO_ACQUIRE_READ, &lend) > 0 ){
+ * 	process(lend.frame, lend.frame_count);
+ * 	ioctl(fd, I_FFIFO_RELEASE_READ, &lend);
+ * }
+ * \endcode
+ *
+ */
+#define I_FFIFO_ACQUIRE_READ _IOCTLRW(FIFO_IOC_CHAR, I_FIFO_TOTAL, ffifo_lend_t)
+
+/*! \brief See below for details.
+ * \details Returns frames borrowed with I_FFIFO_ACQUIRE_READ. The
+ * consumed frames are removed from the FFIFO. If the frames were
+ * overwritten while they were lent, the request returns less than
+ * zero with errno set to EIO.
+ *
+ */
+#define I_FFIFO_RELEASE_READ _IOCTLW(FIFO_IOC_CHAR, I_FIFO_TOTAL+1, ffifo_lend_t)
+
+/*! \brief See below for details.
+ * \details Borrows the next free frames in the FFIFO so they
+ * can be written in place. Returns the number of frames that
+ * are lent or less than zero with errno set to EAGAIN if the
+ * FFIFO is full.
+ *
+ */
+#define I_FFIFO_ACQUIRE_WRITE _IOCTLRW(FIFO_IOC_CHAR, I_FIFO_TOTAL+2, ffifo_lend_t)
+
+/*! \brief See below for details.
+ * \details Returns frames borrowed with I_FFIFO_ACQUIRE_WRITE. The
+ * filled frames are added to the FFIFO. If the driver had to
+ * write the frames while they were lent (for example, to
+ * zero-fill a stream that underflowed), the frames are not added and
+ * the request returns less than zero with errno set to EIO.
+ *
+ */
+#define I_FFIFO_RELEASE_WRITE _IOCTLW(FIFO_IOC_CHAR, I_FIFO_TOTAL+3, ffifo_lend_t)
+
+/*! \brief See below for details.
+ * \details Returns frames borrowed with I_FFIFO_ACQUIRE_READ (like
+ * I_FFIFO_RELEASE_READ) and borrows the next frames that are ready
+ * (like I_FFIFO_ACQUIRE_READ with \a frame_count set to zero) in one request.
+ * Returns the number of frames that are lent. If the release fails,
+ * nothing is lent and the error is returned. If the release
+ * succeeds but the FFIFO is empty, the request returns less than
+ * zero with errno set to EAGAIN.
+ *
+ * \code
+ * ffifo_lend_t lend;
+ * lend.frame_count = 0;
+ * int result = ioctl(fd, I_FFIFO_ACQUIRE_READ, &lend);
+ * while( result > 0 ){
+ * 	process(lend.frame, lend.frame_count);
+ * 	result = ioctl(fd, I_FFIFO_EXCHANGE_READ, &lend);
+ * }
+ * \endcode
+ *
+ */
+#define I_FFIFO_EXCHANGE_READ _IOCTLRW(FIFO_IOC_CHAR, I_FIFO_TOTAL+5, ffifo_lend_t)
+
+/*! \brief See below for details.
+ * \details Returns frames borrowed with I_FFIFO_ACQUIRE_WRITE (like
+ * I_FFIFO_RELEASE_WRITE) and borrows the next free frames
+ * (like I_FFIFO_ACQUIRE_WRITE with \a frame_count set to zero) in one request.
+ * The errors are the same as I_FFIFO_EXCHANGE_READ.
+ *
+ */
+#define I_FFIFO_EXCHANGE_WRITE _IOCTLRW(FIFO_IOC_CHAR, I_FIFO_TOTAL+6, ffifo_lend_t)
+
+/*! \brief FFIFO Watermark
+ * \details This structure is used with I_FFIFO_SETWATERMARK to call
+ * \a handler when the FFIFO reaches a fill level.
+ *
+ * If \a o_events is MCU_EVENT_FLAG_DATA_READY, the handler is called each time
+ * frames are added while at least \a frame_count frames are ready to read. If
+ * \a o_events is MCU_EVENT_FLAG_WRITE_COMPLETE, the handler is called each time
+ * frames are removed while at least \a frame_count frames are free to write.
+ *
+ * The handler is executed in privileged mode from the interrupt that
+ * moves the frames, so unless the caller is a root task, it must be
+ * devfs_signal_callback() or devfs_semaphore_callback() with a context in
+ * the caller's memory (otherwise the request fails with EPERM). The event
+ * data is the number of frames ready (or free). If the handler returns zero,
+ * it is removed.
+ *
+ */
+typedef struct MCU_PACK {
+	u32 o_events /*! MCU_EVENT_FLAG_DATA_READY or MCU_EVENT_FLAG_WRITE_COMPLETE */;
+	u16 frame_count /*! Fill level (in frames) that triggers the handler */;
+	u16 resd_align;
+	mcu_event_handler_t handler /*! Handler to call (a null callback removes the watermark) */;
+} ffifo_watermark_t;
+
+/*! \brief See below for details.
+ * \details Sets the watermark handler for the FFIFO (see ffifo_watermark_t).
+ * For a stream FFIFO, MCU_EVENT_FLAG_DATA_READY applies to the RX FFIFO and
+ * MCU_EVENT_FLAG_WRITE_COMPLETE applies to the TX FFIFO.
+ *
+ * \code
+ * sem_t frames_ready;
+ * ffifo_watermark_t watermark;
+ * sem_init(&frames_ready, 0, 0);
+ * watermark.o_events = MCU_EVENT_FLAG_DATA_READY;
+ * watermark.frame_count = 1;
+ * watermark.handler.callback = devfs_semaphore_callback;
+ * watermark.handler.context = &frames_ready;
+ * ioctl(fd, I_FFIFO_SETWATERMARK, &watermark);
+ * \endcode
+ *
+ */
+#define I_FFIFO_SETWATERMARK _IOCTLW(FIFO_IOC_CHAR, I_FIFO_TOTAL+4, ffifo_watermark_t)
+
 
 
 
@@ -64,8 +64,9 @@ typedef struct MCU_PACK {
 
 typedef struct MCU_PACK {
 	ffifo_info_t ffifo;
-	u32 access_count;
+	u32 access_count /*! Number of frames the device has transferred */;
 	s32 error;
+	u32 overflow_access_count /*! Value of \a access_count when frames were last overwritten (rx) or zero-filled (tx) */;
 } stream_ffifo_channel_info_t;
 
 typedef struct MCU_PACK {
@@ -94,6 +94,17 @@
  *
  * Using this scheme all USB channels are executed at the same priority level.
  *
+ * One input can be written to several outputs by connecting each additional
+ * output with SWITCHBOARD_FLAG_IS_FAN_OUT. The outputs share the packets that are
+ * read from the input, and a packet buffer is not read again until every output has
+ * written it, so the slowest output sets the pace of the connection.
+ *
+ * - I2S (ASYNC) -> DAC (ASYNC)
+ * - I2S (fan out) -> FIFO (SYNC NON-BLOCKING)
+ *
+ * Packets can be processed in place (gain, format conversion, decimation) before they
+ * are written to the outputs using I_SWITCHBOARD_SETTRANSFORM.
+ *
  *
  *
  *
@@ -114,7 +125,7 @@
 extern "C" {
 #endif
 
-#define SWITCHBOARD_VERSION (0x030600)
+#define SWITCHBOARD_VERSION (0x030700)
 #define SWITCHBOARD_IOC_IDENT_CHAR 'W'
 
 /*! \details Switchboard flags used with
@@ -139,7 +150,8 @@ typedef enum {
 	SWITCHBOARD_FLAG_IS_FILL_LAST_32 /*! If no data is available on a non-blocking input, a packet is filled with the last 32-bit word of the previous packet */ = (1<<14),
 	SWITCHBOARD_FLAG_IS_FILL_LAST_64 /*! If no data is available on a non-blocking input, a packet is filled with the last 64-bit word of the previous packet */ = (1<<15),
 	SWITCHBOARD_FLAG_CLEAN /*! Cleanup connectections that have stopped on an error */ = (1<<16),
-	SWITCHBOARD_FLAG_IS_CANCELED /*! Set if a connection operation was cancelled */ = (1<<17)
+	SWITCHBOARD_FLAG_IS_CANCELED /*! Set if a connection operation was cancelled */ = (1<<17),
+	SWITCHBOARD_FLAG_IS_FAN_OUT /*! Use with SWITCHBOARD_FLAG_CONNECT to add an output to the active connection that reads the same input terminal */ = (1<<18)
 } switchboard_flag_t;
 
 
@@ -207,6 +219,26 @@ typedef switchboard_connection_t switchboard_status_t;
  */
 typedef switchboard_connection_t switchboard_attr_t;
 
+/*! \brief Switchboard Transform
+ * \details A switchboard transform processes each packet
+ * of a connection in place after it is read from the input
+ * and before it is written to the output(s). It is used
+ * with I_SWITCHBOARD_SETTRANSFORM.
+ *
+ * The callback is executed in the context of the input's
+ * interrupt. It is passed the packet, the number of bytes in the packet and
+ * the size of the buffer (switchboard_info_t.connection_buffer_size). It returns the number
+ * of bytes to write to the output(s) (zero to drop the packet) or less than zero
+ * to stop the connection.
+ *
+ */
+typedef struct MCU_PACK {
+	u16 id /*! The connection id */;
+	u16 resd;
+	int (*callback)(void * context, void * buf, int nbyte, int size) /*! Transform callback (null to remove the transform) */;
+	void * context /*! Argument passed to the callback */;
+} switchboard_transform_t;
+
 
 
 #define I_SWITCHBOARD_GETVERSION _IOCTL(SWITCHBOARD_IOC_IDENT_CHAR, I_MCU_GETVERSION)
@@ -246,6 +278,46 @@ typedef switchboard_connection_t switchboard_attr_t;
 #define I_SWITCHBOARD_SETATTR _IOCTLW(SWITCHBOARD_IOC_IDENT_CHAR, I_MCU_SETATTR, switchboard_attr_t)
 #define I_SWITCHBOARD_SETACTION _IOCTLW(SWITCHBOARD_IOC_IDENT_CHAR, I_MCU_SETACTION, mcu_action_t)
 
+/*! \brief See details below.
+ * \hideinitializer
+ *
+ * \details Sets the transform that is applied to each packet
+ * of a connection. The transform is kept until the connection
+ * is disconnected so it can be set before the connection
+ * is made. A transform can't be set on a connection that
+ * fans out from another connection (the packets are transformed
+ * once for all outputs).
+ *
+ * \code
+ * static int apply_gain(void * context, void * buf, int nbyte, int size){
+ * 	s16 * samples = buf;
+ * 	for(int i=0; i < nbyte/2; i++){ samples[i] >>= 1; }
+ * 	return nbyte;
+ * }
+ *
+ * switchboard_transform_t transform;
+ * transform.id = 0;
+ * transform.callback = apply_gain;
+ * transform.context = 0;
+ * ioctl(fd, I_SWITCHBOARD_SETTRANSFORM, &transform);
+ *
+ * //i2s0 -> dac0 with i2s0 -> fifo0 sharing the same packets
+ * switchboard_attr_t attr;
+ * attr.id = 0;
+ * strcpy(attr.input.name, "i2s0");
+ * strcpy(attr.output.name, "dac0");
+ * attr.o_flags = SWITCHBOARD_FLAG_CONNECT | SWITCHBOARD_FLAG_IS_PERSISTENT;
+ * ioctl(fd, I_SWITCHBOARD_SETATTR, &attr);
+ *
+ * attr.id = 1;
+ * strcpy(attr.output.name, "fifo0");
+ * attr.o_flags = SWITCHBOARD_FLAG_CONNECT | SWITCHBOARD_FLAG_IS_FAN_OUT;
+ * ioctl(fd, I_SWITCHBOARD_SETATTR, &attr);
+ * \endcode
+ *
+ */
+#define I_SWITCHBOARD_SETTRANSFORM _IOCTLW(SWITCHBOARD_IOC_IDENT_CHAR, I_MCU_TOTAL, switchboard_transform_t)
+
 
 #define I_SWITCHBOARD_TOTAL 1
 
@@ -63,7 +63,8 @@ enum sys_board_config_flags {
 	SYS_FLAG_IS_ACTIVE_ON_IDLE /*! Don't stop the CPU when the system is idle (board config flag) */ = (1<<7),
 	SYS_FLAG_IS_KEYED /*! Binary has a 256-bit secret key appended to the end (before HASH if present).*/ = (1<<8),
 	SYS_FLAG_IS_HASHED /*! Binary has a 256-bit SHA256 hash appended to the end (after secret key if present) */ = (1<<9),
-	SYS_FLAG_IS_FIRST_THREAD_ROOT /*! First thread is started as a root enabled thread */ = (1<<10)
+	SYS_FLAG_IS_FIRST_THREAD_ROOT /*! First thread is started as a root enabled thread */ = (1<<10),
+	SYS_FLAG_IS_TASK_STATS /*! Times kernel calls and blocked tasks for I_SYS_GETTASKSTATS (board config flag) */ = (1<<11)
 };
 
 enum sys_memory_flags {
@@ -188,6 +189,104 @@ typedef struct MCU_PACK {
 	s32 pthread_id /*! \brief Thread ID of primary thread in process (written by driver; -1 if process is not running) */;
 } sys_process_t;
 
+#define SYS_HEAP_HISTOGRAM_COUNT 12
+#define SYS_HEAP_CALLER_COUNT 8
+
+/*! \brief Live heap memory attributed to a single call site
+ * \details Callers are only tracked when the kernel is built with MALLOC_USE_PROFILER.
+ */
+typedef struct MCU_PACK {
+	u32 address /*! \brief Return address of the call to malloc() (entry is unused if count is zero) */;
+	u32 count /*! \brief Number of live allocations made from address */;
+	u32 live_bytes /*! \brief Bytes requested by the live allocations */;
+} sys_heap_caller_t;
+
+/*! \brief Heap Profile
+ * \details This structure is used with I_SYS_GETHEAPINFO to
+ * take a snapshot of the heap of the process that owns the
+ * task \a tid.
+ *
+ * The fragmentation is the portion of free memory that cannot
+ * be used for a single allocation in parts per thousand
+ * (1000 - 1000 * largest_free_size / free_size).
+ *
+ */
+typedef struct MCU_PACK {
+	u32 tid /*! \brief Any task in the process to inspect (written by caller) */;
+	u32 size /*! \brief Total bytes in the heap */;
+	u32 used_size /*! \brief Bytes requested by live allocations */;
+	u32 used_count /*! \brief Number of live allocations */;
+	u32 free_size /*! \brief Bytes in free chunks */;
+	u32 free_count /*! \brief Number of free chunks */;
+	u32 largest_free_size /*! \brief Bytes in the largest free chunk */;
+	u16 fragmentation /*! \brief Parts per thousand of free memory not in the largest free chunk */;
+	u16 o_flags /*! \brief SYS_HEAP_FLAG_IS_PROFILER if callers are tracked */;
+	u32 histogram[SYS_HEAP_HISTOGRAM_COUNT] /*! \brief Live allocations of 2^(n+3) to 2^(n+4)-1 bytes (first and last entries are open ended) */;
+	sys_heap_caller_t caller[SYS_HEAP_CALLER_COUNT] /*! \brief Call sites with live allocations */;
+	u32 other_caller_live_bytes /*! \brief Live bytes from call sites that didn't fit in \a caller */;
+} sys_heapinfo_t;
+
+#define SYS_HEAP_FLAG_IS_PROFILER (1<<0)
+
+/*! \details Groups the time a task spends blocked
+ * by what woke the task. A wait that times out
+ * is counted as SYS_TASK_BLOCK_SLEEP.
+ *
+ */
+enum sys_task_block_type {
+	SYS_TASK_BLOCK_MUTEX /*! Mutexes and read/write locks */,
+	SYS_TASK_BLOCK_SEMAPHORE /*! Semaphores and futexes */,
+	SYS_TASK_BLOCK_COND /*! Condition variables */,
+	SYS_TASK_BLOCK_SLEEP /*! Sleeping and timeouts */,
+	SYS_TASK_BLOCK_IO /*! Device transfers, poll() and asynchronous IO */,
+	SYS_TASK_BLOCK_MQ /*! Message queues */,
+	SYS_TASK_BLOCK_OTHER /*! Signals, wait() and pthread_join() */,
+	SYS_TASK_BLOCK_TOTAL
+};
+
+/*! \brief Task Statistics
+ * \details This structure holds the scheduling statistics
+ * of a single task. I_SYS_GETTASKSTATS and reading the
+ * system device return an array with one entry per task
+ * (the index of the entry is the task ID).
+ *
+ * The counters wrap. Tools should use the difference between
+ * two snapshots. \a timer and \a root_timer are in CPU clock cycles
+ * (see \a cpu_freq in sys_info_t).
+ *
+ * Timing kernel calls and blocked tasks costs time on every kernel call, block
+ * and wake, so \a root_timer and \a block_time stay zero unless the board
+ * config sets SYS_FLAG_IS_TASK_STATS. Each entry is a consistent snapshot of
+ * one task (the entries aren't taken at the same instant).
+ *
+ */
+typedef struct MCU_PACK {
+	u32 pid /*! \brief PID for the task */;
+	u32 tid /*! \brief Task ID */;
+	u64 timer /*! \brief Clock cycles the task has executed */;
+	u64 root_timer /*! \brief Clock cycles the task has spent executing kernel calls */;
+	u32 wake_count /*! \brief Number of times the task was switched in */;
+	u32 voluntary_switch_count /*! \brief Number of times the task was switched out after blocking, sleeping or yielding */;
+	u32 involuntary_switch_count /*! \brief Number of times the task was preempted or used all its round robin time */;
+	u32 block_time[SYS_TASK_BLOCK_TOTAL] /*! \brief Microseconds the task has been blocked (see \ref sys_task_block_type) */;
+	u32 deadline_miss_count /*! \brief Number of deadlines missed by a SCHED_DEADLINE thread */;
+	u32 deadline_overrun_count /*! \brief Number of times a SCHED_DEADLINE thread used its runtime before its job was done */;
+	s8 prio /*! \brief Task Priority */;
+	u8 is_active /*! \brief Bit 0 is set for an active task and bit 1 for a stopped task */;
+	u8 is_thread /*! \brief Non-zero if not main process thread */;
+	u8 is_enabled /*! \brief Non-zero if associated with running process (the other values are zero if not set) */;
+} sys_taskstats_t;
+
+/*! \brief Structure for I_SYS_GETTASKSTATS
+ * \details This structure is used with I_SYS_GETTASKSTATS. The link
+ * protocol can't pass \a stats so host tools read the system device instead.
+ */
+typedef struct MCU_PACK {
+	u32 count /*! \brief Entries in \a stats (written by caller); entries written (written by driver) */;
+	u32 total /*! \brief Number of tasks the system supports (written by driver) */;
+	sys_taskstats_t * stats /*! \brief Array of entries to write starting with task 0 */;
+} sys_taskstats_list_t;
+
 
 
 #define I_SYS_GETVERSION _IOCTL(SYS_IOC_IDENT_CHAR, I_MCU_GETVERSION)
@@ -272,8 +371,45 @@ typedef struct MCU_PACK {
  */
 #define I_SYS_ISROOT _IOCTL(SYS_IOC_CHAR, I_MCU_TOTAL+8)
 
+/*! \brief See below for details.
+ * \details Takes a snapshot of the heap used by the process
+ * that owns a task.
+ *
+ * \code
+ * sys_heapinfo_t info;
+ * info.tid = pthread_self();
+ * ioctl(fd, I_SYS_GETHEAPINFO, &info);
+ * \endcode
+ *
+ */
+#define I_SYS_GETHEAPINFO _IOCTLRW(SYS_IOC_CHAR, I_MCU_TOTAL+9, sys_heapinfo_t)
+
+/*! \brief See below for details.
+ * \details Takes a snapshot of the scheduling statistics of
+ * all the tasks with a single request.
+ *
+ * \code
+ * sys_taskstats_t stats[16];
+ * sys_taskstats_list_t list;
+ * list.count = 16;
+ * list.stats = stats;
+ * ioctl(fd, I_SYS_GETTASKSTATS, &list);
+ * \endcode
+ *
+ * Reading the system device returns the same entries (the
+ * location is the task ID times sizeof(sys_taskstats_t)) which
+ * is how host tools get the snapshot over the link protocol.
+ *
+ * \code
+ * lseek(fd, 0, SEEK_SET);
+ * read(fd, stats, sizeof(stats));
+ * \endcode
+ *
+ */
+#define I_SYS_GETTASKSTATS _IOCTLRW(SYS_IOC_CHAR, I_MCU_TOTAL+10, sys_taskstats_list_t)
+
 
-#define I_SYS_TOTAL 7
+#define I_SYS_TOTAL 11
 
 
 
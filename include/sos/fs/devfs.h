@@ -78,6 +78,26 @@ typedef struct {
  */
 int devfs_signal_callback(void * context, const mcu_event_t * data);
 
+/*! \details This function can be set as the callback for mcu_action_t
+ * or ffifo_watermark_t. The context points to an initialized sem_t.
+ * Each time the event happens, the semaphore is posted and the
+ * highest priority thread waiting on it (if any) is woken.
+ *
+ * The callback always returns non-zero so it stays installed.
+ *
+ * \code
+ * sem_t sem; //this must be valid when the interrupt happens
+ * sem_init(&sem, 0, 0);
+ * ...
+ * watermark.handler.callback = devfs_semaphore_callback;
+ * watermark.handler.context = &sem;
+ * ioctl(fd, I_FFIFO_SETWATERMARK, &watermark);
+ * sem_wait(&sem);
+ * \endcode
+ *
+ */
+int devfs_semaphore_callback(void * context, const mcu_event_t * data);
+
 extern const devfs_device_t devfs_list[];
 
 const devfs_handle_t * devfs_lookup_handle(const devfs_device_t * list, const char * name);
@@ -186,6 +206,8 @@ bool devfs_is_terminator(const devfs_device_t * dev){
 }
 
 int devfs_execute_event_handler(mcu_event_handler_t * handler, u32 o_events, void * data);
+//checks a handler from the caller before a driver runs it from an interrupt (0 if it can be installed)
+int devfs_validate_event_handler(const mcu_event_handler_t * handler);
 //executes the read handler (if it exists) and nulls the read async object so it can be assigned again
 int devfs_execute_read_handler(devfs_transfer_handler_t * transfer_handler, void * data, int nbyte, u32 o_flags);
 //executes the write handler (if it exists) and nulls the write async object so it can be assigned again
@@ -194,11 +216,23 @@ int devfs_execute_write_handler(devfs_transfer_handler_t * transfer_handler, voi
 //executes read and write handlers (if they exist) with MCU_EVENT_FLAG_CANCELED set
 void devfs_execute_cancel_handler(devfs_transfer_handler_t * transfer_handler, void * data, int nbyte, u32 o_flags);
 
+//handles I_DEVFS_POLL for drivers that use a transfer handler (o_ready_events are the events the driver has ready)
+int devfs_poll_transfer_handler(devfs_transfer_handler_t * transfer_handler, devfs_poll_t * request, u32 o_ready_events);
+
+static inline bool devfs_is_poll_async(const devfs_async_t * async);
+bool devfs_is_poll_async(const devfs_async_t * async){
+	//zero-byte reads and writes never occupy the transfer handler -- a zero-byte async is a poll request
+	return async->nbyte == 0;
+}
+
 int devfs_init(const void * cfg);
 int devfs_open(const void * cfg, void ** handle, const char * path, int flags, int mode);
 int devfs_read(const void * cfg, void * handle, int flags, int loc, void * buf, int nbyte);
 int devfs_write(const void * cfg, void * handle, int flags, int loc, const void * buf, int nbyte);
+int devfs_readv(const void * cfg, void * handle, int flags, int loc, const struct iovec * iov, int iovcnt);
+int devfs_writev(const void * cfg, void * handle, int flags, int loc, const struct iovec * iov, int iovcnt);
 int devfs_aio(const void * cfg, void * handle, struct aiocb * aio);
+int devfs_aio_list(const devfs_device_t * const device_list[], struct aiocb * const list[], int nent);
 int devfs_ioctl(const void * cfg, void * handle, int request, void * ctl);
 int devfs_close(const void * cfg, void ** handle);
 int devfs_fstat(const void * cfg, void * handle, struct stat * st);
@@ -224,6 +258,8 @@ int devfs_closedir(const void * cfg, void ** handle);
 	.fsync = SYSFS_NOTSUP, \
 	.read = devfs_read, \
 	.write = devfs_write, \
+	.readv = devfs_readv, \
+	.writev = devfs_writev, \
 	.close = devfs_close, \
 	.rename = SYSFS_NOTSUP, \
 	.unlink = SYSFS_NOTSUP, \
@@ -88,6 +88,26 @@
  * in such a way that a power failure at any time cannot corrupt the
  * filesystem.
  *
+ * ## Append-only Log Files
+ *
+ * A file created with the SFFS_MODE_LOG bit set in the open() mode
+ * is an append-only log. Writes to a log file always go to the end
+ * of the file regardless of the file offset. Each append programs only
+ * the new bytes into the erased part of the tail segment's block so
+ * partial appends do not rewrite segments or strike entries in the
+ * file list.
+ *
+ * After the data is programmed, a trailer record holding the size of
+ * the file and the first live segment (the head) is written to the
+ * file header. An append is durable once write() returns: if power is
+ * lost before the file is closed, the file is rolled forward to the
+ * last trailer when the drive is mounted. When the header runs out
+ * of trailer records, the file is closed and reopened internally.
+ *
+ * If sffs_config_t::log_max_size is non-zero, whole segments are dropped
+ * from the head of the file once the log grows beyond that size (ring-log
+ * semantics). Reads and fstat() only see the data following the head.
+ *
  * ## Ways to improve performance
  *
  * ### Cache file list location and block
@@ -145,8 +165,14 @@ typedef struct {
 
 typedef struct {
 	sysfs_shared_config_t drive;
+	u32 log_max_size /*! Max bytes kept in a log file (SFFS_MODE_LOG) before head segments are dropped (0 for no limit) */;
 } sffs_config_t;
 
+/*! \details Mode bit passed to open() when creating a file
+ * to make the file an append-only log.
+ */
+#define SFFS_MODE_LOG S_ISVTX
+
 
 int sffs_init(const void * cfg); //initialize the filesystem
 int sffs_mkfs(const void * cfg);
@@ -29,6 +29,7 @@
 #include <sys/stat.h>
 
 struct dirent;
+struct iovec;
 
 #if !defined __link
 #include <sys/lock.h>
@@ -78,6 +79,8 @@ typedef struct {
 	int (*ioctl)(const void*, void*, int, void*);
 	int (*read)(const void*, void*, int, int, void*, int);
 	int (*write)(const void*, void*, int, int, const void*, int);
+	int (*readv)(const void*, void*, int, int, const struct iovec*, int) /*! null to use read() for each segment */;
+	int (*writev)(const void*, void*, int, int, const struct iovec*, int) /*! null to use write() for each segment */;
 	int (*fsync)(const void*, void*);
 	int (*close)(const void*, void**);
 	int (*fstat)(const void*, void*, struct stat*);
@@ -183,6 +186,8 @@ int sysfs_file_ioctl(sysfs_file_t * file, int request, void * ctl);
 int sysfs_file_fsync(sysfs_file_t * file);
 int sysfs_file_read(sysfs_file_t * file, void * buf, int nbyte);
 int sysfs_file_write(sysfs_file_t * file, const void * buf, int nbyte);
+int sysfs_file_readv(sysfs_file_t * file, const struct iovec * iov, int iovcnt);
+int sysfs_file_writev(sysfs_file_t * file, const struct iovec * iov, int iovcnt);
 int sysfs_file_aio(sysfs_file_t * file, void * aio);
 int sysfs_file_close(sysfs_file_t * file);
 
@@ -229,6 +234,8 @@ typedef struct {
 	struct aiocb * const * list;
 	int nent;
 	bool block_on_all;
+	int pending; //operations in list that haven't completed
+	int tid; //thread that is waiting
 	struct mcu_timeval abs_timeout;
 	int result;
 	struct sigevent * event;
@@ -88,6 +88,26 @@ typedef char devfs_get_name_t[NAME_MAX];
 
 #define I_DEVFS_GETNAME _IOCTLW(DEVFS_IOC_IDENT_CHAR, I_MCU_TOTAL, devfs_get_name_t)
 
+/*! \brief Device Poll Request
+ * \details This is used by poll() to check a device for readiness
+ * using I_DEVFS_POLL. It is only sent to drivers from the kernel.
+ *
+ * If \a async is not null, it is first removed from the driver (if a previous
+ * request left it there). If none of the requested events are ready,
+ * \a async is then registered with the driver and its handler is executed once (with
+ * nbyte set to zero) when one of the events becomes ready. Setting \a o_events to zero
+ * just removes \a async.
+ *
+ */
+typedef struct {
+	u32 o_events /*! Events to check (MCU_EVENT_FLAG_DATA_READY and/or MCU_EVENT_FLAG_WRITE_COMPLETE); on return, the events that are ready */;
+	u32 resd;
+	devfs_async_t * async /*! Handler to execute when an event becomes ready (null to only check) */;
+} devfs_poll_t;
+
+//mcu_ioctl() doesn't check the ident so the number is beyond the range of the MCU driver request tables
+#define I_DEVFS_POLL _IOCTLRW(DEVFS_IOC_IDENT_CHAR, 0xFF, devfs_poll_t)
+
 
 
 #endif /* SOS_FS_TYPES_H_ */
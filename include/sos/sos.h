@@ -354,6 +354,7 @@
 #include "sys/socket.h"
 #endif
 #include "sos/fs/devfs.h"
+#include "sos/dev/sys.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -525,6 +526,182 @@ void sos_trace_stack(u32 count);
 void sos_trace_event_addr_tid(link_trace_event_id_t event_id, const void * data_ptr, size_t data_len, u32 addr, int tid);
 void sos_trace_root_trace_event(link_trace_event_id_t event_id, const void * data_ptr, size_t data_len);
 
+/*! \brief Fixed-size Object Pool
+ * \details A pool hands out objects of one size in constant time. Free objects
+ * are kept on a singly linked list that is updated using exclusive load/store
+ * instructions so sos_pool_alloc() and sos_pool_free() can be called from
+ * threads, the kernel and interrupt handlers without a lock.
+ *
+ */
+typedef struct {
+	void * volatile free /*! First free object (null if the pool is empty) */;
+	u16 object_size /*! Bytes used by each object (word aligned) */;
+	u16 resd;
+	void * memory /*! Memory allocated by sos_pool_create() (null if the memory was provided with sos_pool_init()) */;
+} sos_pool_t;
+
+#define SOS_POOL_OBJECT_SIZE(object_size) ((((object_size) < sizeof(void*) ? sizeof(void*) : (object_size)) + 3) & ~3)
+#define SOS_POOL_SIZE(object_size, count) (SOS_POOL_OBJECT_SIZE(object_size)*(count))
+#define SOS_POOL_INITIALIZER(object_size) { 0, SOS_POOL_OBJECT_SIZE(object_size), 0, 0 }
+
+int sos_pool_init(sos_pool_t * pool, void * memory, u32 size, u16 object_size);
+int sos_pool_create(sos_pool_t * pool, u16 object_size, u16 count);
+void sos_pool_destroy(sos_pool_t * pool);
+int sos_pool_extend(sos_pool_t * pool, void * memory, u32 size);
+void * sos_pool_alloc(sos_pool_t * pool);
+void sos_pool_free(sos_pool_t * pool, void * object);
+//kernel pools use the global heap (the objects aren't accessible to applications)
+int sos_pool_create_kernel(sos_pool_t * pool, u16 object_size, u16 count);
+void sos_pool_destroy_kernel(sos_pool_t * pool);
+void * sos_pool_alloc_kernel(sos_pool_t * pool, u16 count);
+
+/*! \brief Device/File Splice
+ * \details A splice copies data from one file descriptor to another
+ * using a worker thread in the calling process so the application
+ * doesn't have to read and write each chunk itself.
+ *
+ * When the input (SOS_SPLICE_FLAG_IS_INPUT_FFIFO) or the output
+ * (SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO) is an ffifo or stream_ffifo device,
+ * the frames are borrowed from the device buffer (see I_FFIFO_ACQUIRE_READ)
+ * and passed directly to the other descriptor. Otherwise, the data
+ * goes through a buffer that is allocated by the worker.
+ *
+ * Both descriptors must stay open until sos_splice_stop() returns.
+ *
+ */
+typedef struct {
+	pthread_t thread /*! Worker thread */;
+	int fd_in /*! Input file descriptor */;
+	int fd_out /*! Output file descriptor */;
+	u32 nbyte /*! Bytes to transfer (zero to transfer until the end of the input or until stopped) */;
+	volatile u32 bytes_transferred /*! Bytes written to \a fd_out */;
+	volatile u32 overflow_count /*! Number of times the device overwrote (input) or zero-filled (output) frames while they were lent */;
+	volatile int error /*! errno value if the transfer failed */;
+	volatile u32 o_flags /*! Splice flags */;
+} sos_splice_t;
+
+#define SOS_SPLICE_FLAG_IS_INPUT_FFIFO (1<<0)
+#define SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO (1<<1)
+#define SOS_SPLICE_FLAG_IS_STOP (1<<2)
+#define SOS_SPLICE_FLAG_IS_DONE (1<<3)
+
+int sos_splice_start(sos_splice_t * splice, int fd_in, int fd_out, u32 nbyte, u32 o_flags);
+int sos_splice_stop(sos_splice_t * splice);
+
+/*! \details Blocks the calling thread while the value at \a addr
+ * is equal to \a value. The comparison and the block are done in one
+ * kernel call, so a sos_futex_wake() that happens after the caller
+ * changed its mind can't be lost.
+ *
+ * \param addr The address to wait on (any word that all threads can access)
+ * \param value The value the caller expects \a addr to hold
+ * \param abs_timeout Absolute CLOCK_REALTIME timeout (null to wait forever)
+ *
+ * \return Zero if the thread was woken (or \a addr no longer held \a value)
+ * or -1 with errno (see \ref errno) set to:
+ * - ETIMEDOUT: \a abs_timeout expired
+ * - EINTR: a signal was received
+ *
+ */
+int sos_futex_wait(volatile u32 * addr, u32 value, const struct timespec * abs_timeout);
+
+/*! \details Wakes all threads that are blocked in sos_futex_wait() on \a addr.
+ *
+ */
+void sos_futex_wake(volatile u32 * addr);
+
+#if defined __v7em_f5ss || defined __v7em_f5sh || defined __v7em_f5ds || defined __v7em_f5dh
+#define SOS_RING_CACHE_LINE_SIZE 32
+#else
+#define SOS_RING_CACHE_LINE_SIZE 4
+#endif
+
+/*! \brief Lock-free Ring
+ * \details A ring passes fixed-size items from one or more producer threads
+ * (SOS_RING_FLAG_IS_MULTI_PRODUCER) to a single consumer thread. Items are
+ * copied in and out of the ring memory without a kernel call. The kernel is
+ * only entered (with sos_futex_wait() and sos_futex_wake()) when a thread
+ * has to block because the ring is empty or full.
+ *
+ * Each slot has a sequence number that is published after the item is copied,
+ * so the consumer never sees a partial item. Producers reserve slots with
+ * exclusive load/store instructions (see sos_pool_t for why this is safe on
+ * a single core). The producer and consumer indices are on different cache
+ * lines on cores with a data cache.
+ *
+ * The ring and its memory can be shared between processes as long as all
+ * of them can access it. Interrupts can't use the ring because writing
+ * may need to wake the reader.
+ *
+ */
+typedef struct {
+	volatile u32 head MCU_ALIGN(SOS_RING_CACHE_LINE_SIZE) /*! Sequence number of the next slot to write */;
+	volatile u32 write_waiters /*! Number of producers waiting for a free slot */;
+	volatile u32 tail MCU_ALIGN(SOS_RING_CACHE_LINE_SIZE) /*! Sequence number of the next slot to read */;
+	volatile u32 read_waiters /*! Non-zero if the consumer is waiting for an item */;
+	void * buffer MCU_ALIGN(SOS_RING_CACHE_LINE_SIZE) /*! Slot memory */;
+	u16 item_size /*! Bytes in each item */;
+	u16 count /*! Number of slots (a power of 2) */;
+	u32 o_flags /*! Ring flags */;
+} sos_ring_t;
+
+#define SOS_RING_FLAG_IS_MULTI_PRODUCER (1<<0)
+
+#define SOS_RING_SLOT_SIZE(item_size) (sizeof(u32) + (((item_size) + 3) & ~3))
+#define SOS_RING_SIZE(item_size, count) (SOS_RING_SLOT_SIZE(item_size)*(count))
+
+int sos_ring_init(sos_ring_t * ring, void * buffer, u32 size, u16 item_size, u32 o_flags);
+int sos_ring_write(sos_ring_t * ring, const void * item, const struct timespec * abs_timeout);
+int sos_ring_trywrite(sos_ring_t * ring, const void * item);
+int sos_ring_read(sos_ring_t * ring, void * item, const struct timespec * abs_timeout);
+int sos_ring_tryread(sos_ring_t * ring, void * item);
+
+/*! \details Scheduling policy for periodic threads that are
+ * executed earliest deadline first (see sos_sched_deadline_t).
+ */
+#define SCHED_DEADLINE 6
+
+/*! \brief Deadline Scheduling Parameters
+ * \details These are the parameters that are passed to pthread_setschedparam()
+ * with SCHED_DEADLINE.
+ *
+ * \code
+ * sos_sched_deadline_t attr;
+ * attr.param.sched_priority = 10;
+ * attr.runtime = 2000;
+ * attr.period = 10000;
+ * attr.deadline = 0;
+ * pthread_setschedparam(pthread_self(), SCHED_DEADLINE, &attr.param);
+ * \endcode
+ *
+ * The thread is released (its job starts) every \a period
+ * microseconds. Deadline threads with the same priority are executed
+ * earliest deadline first and ahead of the round robin threads with that
+ * priority. The thread calls sched_yield() when its job is done
+ * for the period. It then sleeps until its next release.
+ *
+ * The thread may execute for \a runtime microseconds each period.
+ * If it uses all of that time, it is held until its next release (an overrun).
+ *
+ * A thread is only accepted if the total of runtime/min(deadline, period) for
+ * all deadline threads stays below SOS_SCHED_DEADLINE_DENSITY_MAX. Otherwise,
+ * pthread_setschedparam() fails with EBUSY.
+ *
+ * Missed deadlines and overruns are counted in sys_taskstats_t.
+ *
+ */
+typedef struct {
+	struct sched_param param /*! Priority of the thread (must be the first member) */;
+	u32 runtime /*! Microseconds the thread may execute each period */;
+	u32 period /*! Microseconds between releases */;
+	u32 deadline /*! Microseconds after the release that the job must be done by (zero to use \a period) */;
+} sos_sched_deadline_t;
+
+/*! \details Parts per million of the processor that deadline threads can
+ * reserve. The rest is left for the other threads.
+ */
+#define SOS_SCHED_DEADLINE_DENSITY_MAX 900000
+
 #define SOS_SCHEDULER_TIMEVAL_SECONDS 2048
 #define STFY_SCHEDULER_TIMEVAL_SECONDS SOS_SCHEDULER_TIMEVAL_SECONDS
 #define SOS_USECOND_PERIOD (1000000UL * SOS_SCHEDULER_TIMEVAL_SECONDS)
@@ -538,6 +715,15 @@ typedef struct {
 	struct sigevent sigevent;
 } sos_process_timer_t;
 
+typedef struct {
+	u32 runtime /*! Microseconds the task may execute each period */;
+	u32 period /*! Microseconds between releases */;
+	u32 deadline /*! Microseconds between the release and the deadline */;
+	u32 miss_count /*! Number of deadlines the task has missed */;
+	u32 overrun_count /*! Number of times the task used its runtime before its job was done */;
+	struct mcu_timeval release /*! When the current job was released */;
+} sos_sched_deadline_state_t;
+
 typedef struct {
 	pthread_attr_t attr /*! This holds the task's pthread attributes */;
 	volatile void * block_object /*! The blocking object */;
@@ -549,6 +735,16 @@ typedef struct {
 	volatile struct mcu_timeval wake /*! When to wake the task */;
 	volatile u16 flags /*! This indicates whether the process is active or not */;
 	trace_id_t trace_id /*! Trace ID is PID is being traced (0 otherwise) */;
+	volatile u8 wait_queue /*! Wait queue (plus one) the task is blocked in (0 if not in a wait queue) */;
+	volatile u8 wait_next /*! Next task in the wait queue (0 for the end) */;
+	volatile u8 wait_prev /*! Previous task in the wait queue (0 for the head) */;
+	volatile u8 wake_next /*! Next task in the sleep queue (0 for the end) */;
+	volatile u8 wake_prev /*! Previous task in the sleep queue (0 for the head) */;
+	volatile u16 timer_next[SOS_PROCESS_TIMER_COUNT] /*! Next entry in the process timer queue (0 for the end) */;
+	volatile u16 timer_prev[SOS_PROCESS_TIMER_COUNT] /*! Previous entry in the process timer queue (0 for the head) */;
+	u32 block_start /*! When the task blocked in microseconds (0 if the task isn't blocked) */;
+	u32 block_time[SYS_TASK_BLOCK_TOTAL] /*! Microseconds the task has been blocked (see sys_task_block_type) */;
+	sos_sched_deadline_state_t deadline /*! Parameters and statistics for SCHED_DEADLINE */;
 	sos_process_timer_t timer[SOS_PROCESS_TIMER_COUNT];
 } sched_task_t;
 
@@ -560,7 +756,7 @@ typedef struct {
  */
 typedef struct MCU_PACK {
 	u8 clk_usecond_tmr /*! Hardware timer used for usecond counter */;
-	u8 task_total /*! Total number of supported tasks */;
+	u8 task_total /*! Total number of supported tasks (at most 255) */;
 	u16 start_stack_size /*! Stack size of the first thread (when in doubt use SOS_DEFAULT_START_STACK_SIZE) */;
 	const char * stdin_dev /*! Device used for standard input */;
 	const char * stdout_dev /*! Device used for standard output */;
@@ -588,7 +784,9 @@ extern volatile task_t sos_task_table[];
 extern const sos_board_config_t sos_board_config;
 
 
+//the wait and sleep queues link tasks with u8 ids (see sched_task_t)
 #define SOS_DECLARE_TASK_TABLE(task_count) \
+	typedef char sos_task_table_total_check_t[((task_count) <= 255) ? 1 : -1]; \
 	volatile sched_task_t sos_sched_table[task_count] MCU_SYS_MEM; \
 	volatile task_t sos_task_table[task_count] MCU_SYS_MEM
 
@@ -175,6 +175,8 @@ extern u32 __aeabi_unwind_cpp_pr1();
 #include "semaphore.h"
 #include "mqueue.h"
 #include "aio.h"
+#include "poll.h"
+#include "sys/uio.h"
 #include "sos/sos.h"
 #include "device/sys.h"
 #include "sos/dev/sys.h"
@@ -680,6 +680,34 @@ u32 const symbols_table[] = {
 	(u32)seteuid,
 	(u32)sos_trace_stack,
 	(u32)__assert_func,
+	(u32)sos_pool_init,
+	(u32)sos_pool_create,
+	(u32)sos_pool_destroy,
+	(u32)sos_pool_extend,
+	(u32)sos_pool_alloc,
+	(u32)sos_pool_free,
+	(u32)poll,
+	(u32)readv,
+	(u32)writev,
+	(u32)sos_splice_start,
+	(u32)sos_splice_stop,
+	(u32)aio_queue_init,
+	(u32)aio_queue_submit,
+	(u32)aio_queue_get,
+	(u32)devfs_semaphore_callback,
+	(u32)sos_futex_wait,
+	(u32)sos_futex_wake,
+	(u32)sos_ring_init,
+	(u32)sos_ring_write,
+	(u32)sos_ring_trywrite,
+	(u32)sos_ring_read,
+	(u32)sos_ring_tryread,
+	(u32)mq_reserve,
+	(u32)mq_timedreserve,
+	(u32)mq_commit,
+	(u32)mq_borrow,
+	(u32)mq_timedborrow,
+	(u32)mq_release,
 	1
 };
 
@@ -13,6 +13,13 @@ set(SOS_OPTION link)
 set(SOS_ARCH link)
 include(${SOS_TOOLCHAIN_CMAKE_PATH}/sos-lib.cmake)
 
+option(SOS_BUILD_HOST_TESTS "Build the kernel host tests" ON)
+
+if(SOS_BUILD_HOST_TESTS)
+	enable_testing()
+	add_subdirectory(test)
+endif()
+
 install(FILES include/mcu/types.h DESTINATION include/mcu)
 install(FILES include/mcu/mcu.h DESTINATION include/mcu)
 install(DIRECTORY include/sos DESTINATION include)
@@ -21,6 +21,9 @@
 #include "mcu/mcu.h"
 #include "mcu/core.h"
 #include "cortexm/mpu.h"
+#include "cortexm/task.h"
+#include "sos/sos.h"
+#include "sos/dev/sys.h"
 
 //this is used to ensure svcall's execute from start to finish
 cortexm_svcall_t cortexm_svcall_validation MCU_SYS_MEM;
@@ -162,7 +165,14 @@ void mcu_core_svcall_handler(){
 	//verify call is located secure kernel region ROOT_EXEC ONLY
 	if( ((u32)call >= (u32)&_text) && ((u32)call < (u32)&_etext) ){
 		//args must point to kernel RAM or kernel flash -- can't be SYS MEM or registers or anything like that
-		call(args);
+		if( sos_board_config.o_sys_flags & SYS_FLAG_IS_TASK_STATS ){
+			u32 start = DWT->CYCCNT;
+			call(args);
+			//interrupts that execute during the call are included
+			sos_task_table[task_get_current()].root_time += DWT->CYCCNT - start;
+		} else {
+			call(args);
+		}
 	} else {
 		//this needs to be a fault
 	}
@@ -22,17 +22,31 @@
 
 #include "task_local.h"
 #include "sos/sos.h"
+#include "sos/dev/sys.h"
 #include "cortexm/task.h"
 
-#define SYSTICK_MIN_CYCLES 10000
-
-volatile s8 m_task_current_priority MCU_SYS_MEM;
-static volatile u8 m_task_exec_count MCU_SYS_MEM;
-int m_task_rr_reload MCU_SYS_MEM;
+/*
+ * The ready lists and the order tasks execute in are in task_ready.c.
+ *
+ * The SysTick interrupt is only enabled while tasks compete for the processor.
+ * When nothing is ready, task 0 sleeps until an interrupt (such as the usecond
+ * timer output compare for the next sleeping task) wakes a task. The SysTick
+ * counter keeps running because cortexm_delay_us() uses it, but it wraps
+ * without being counted, so the time a task runs tickless is measured with the
+ * microsecond clock and charged when the tick resumes.
+ *
+ */
+static volatile u8 m_task_is_tickless MCU_SYS_MEM;
+static volatile u64 m_task_tickless_start MCU_SYS_MEM;
 volatile int m_task_current MCU_SYS_MEM;
-static void svcall_read_rr_timer(u32 * val);
+static void svcall_read_rr_timer(u64 * val);
 static int set_systick_interval(int interval) MCU_ROOT_CODE;
-static void switch_contexts();
+static void switch_contexts(int is_voluntary);
+static void load_systick();
+static void start_tickless();
+static void stop_tickless();
+static u64 get_tickless_cycles();
+static void check_switch_request();
 
 
 
@@ -42,19 +56,7 @@ void system_reset(){
 }
 
 
-u8 task_get_exec_count(){ return m_task_exec_count; }
 u8 task_get_total(){ return sos_board_config.task_total; }
-s8 task_get_current_priority(){ return m_task_current_priority; }
-void task_root_set_current_priority(s8 value){ m_task_current_priority = value; }
-
-void task_root_elevate_current_priority(s8 value){
-	cortexm_disable_interrupts();
-	if( value > m_task_current_priority ){
-		m_task_current_priority = value;
-	}
-	cortexm_enable_interrupts();
-}
-
 int task_init(int interval,
 				  void (*scheduler_function)(),
 				  void * system_memory,
@@ -73,6 +75,8 @@ int task_init(int interval,
 
 	sos_task_table[0].sp = system_stack - sizeof(hw_stack_frame_t);
 	sos_task_table[0].flags = TASK_FLAGS_EXEC | TASK_FLAGS_USED | TASK_FLAGS_ROOT;
+	sos_task_table[0].ready_next = 0;
+	sos_task_table[0].ready_prev = 0;
 	sos_task_table[0].parent = 0;
 	sos_task_table[0].priority = 0;
 	sos_task_table[0].pid = 0;
@@ -95,7 +99,20 @@ int task_init(int interval,
 	//enable use of PSP
 	cortexm_set_thread_stack_ptr( (void*)sos_task_table[0].sp );
 	m_task_current = 0;
-	m_task_current_priority = 0;
+	m_task_is_tickless = 0;
+	task_ready_init();
+	sos_task_table[0].wake_count = 0;
+	sos_task_table[0].voluntary_switch_count = 0;
+	sos_task_table[0].involuntary_switch_count = 0;
+	sos_task_table[0].root_time = 0;
+	sos_task_table[0].is_deadline = 0;
+
+	if( sos_board_config.o_sys_flags & SYS_FLAG_IS_TASK_STATS ){
+		//the cycle counter times kernel calls (see mcu_core_svcall_handler())
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
 
 	//Set the interrupt priorities
 	for(i=0; i <= mcu_config.irq_total; i++){
@@ -214,6 +231,13 @@ void task_svcall_new_task(new_task_t * task){
 			sos_task_table[i].reent = task->reent;
 			sos_task_table[i].global_reent = task->global_reent;
 			sos_task_table[i].timer.t = 0;
+			sos_task_table[i].wake_count = 0;
+			sos_task_table[i].voluntary_switch_count = 0;
+			sos_task_table[i].involuntary_switch_count = 0;
+			sos_task_table[i].root_time = 0;
+			sos_task_table[i].is_deadline = 0;
+			sos_task_table[i].deadline = 0;
+			sos_task_table[i].budget = 0;
 			sos_task_table[i].rr_time = m_task_rr_reload;
 			memcpy((void*)&(sos_task_table[i].mem), task->mem, sizeof(task_memories_t));
 #if __FPU_USED != 0
@@ -244,7 +268,6 @@ void task_svcall_new_task(new_task_t * task){
 void task_root_delete(int id){
 	if ( (id < task_get_total() ) && (id >= 1)){
 		task_deassert_used(id);
-		task_deassert_exec(id);
 	}
 }
 
@@ -303,16 +326,20 @@ int task_get_thread_zero(int pid){
 	return -1;
 }
 
-static void svcall_read_rr_timer(u32 * val){
+static void svcall_read_rr_timer(u64 * val){
 	CORTEXM_SVCALL_ENTER();
-	*val = m_task_rr_reload - SysTick->VAL;
+	if( m_task_is_tickless ){
+		*val = get_tickless_cycles();
+	} else {
+		*val = task_ready_get_slice(task_get_current()) - SysTick->VAL;
+	}
 }
 
 
 u64 task_root_gettime(int tid){
-	u32 val;
+	u64 val;
 	if ( tid != task_get_current() ){
-		return sos_task_table[tid].timer.t + (m_task_rr_reload - sos_task_table[tid].rr_time);
+		return sos_task_table[tid].timer.t + (task_ready_get_slice(tid) - sos_task_table[tid].rr_time);
 	} else {
 		svcall_read_rr_timer(&val);
 		return sos_task_table[tid].timer.t + val;
@@ -321,9 +348,9 @@ u64 task_root_gettime(int tid){
 
 
 u64 task_gettime(int tid){
-	u32 val;
+	u64 val;
 	if ( tid != task_get_current() ){
-		return sos_task_table[tid].timer.t + (m_task_rr_reload - sos_task_table[tid].rr_time);
+		return sos_task_table[tid].timer.t + (task_ready_get_slice(tid) - sos_task_table[tid].rr_time);
 	} else {
 		//security? args is written
 		cortexm_svcall((cortexm_svcall_t)svcall_read_rr_timer, &val);
@@ -331,7 +358,7 @@ u64 task_gettime(int tid){
 	}
 }
 
-void switch_contexts(){
+void switch_contexts(int is_voluntary){
 	//Save the PSP to the current task's stack pointer
 	asm volatile ("MRS %0, psp\n\t" : "=r" (sos_task_table[m_task_current].sp) );
 
@@ -363,44 +390,21 @@ void switch_contexts(){
 	}
 #endif
 
-	do {
-		m_task_current++;
-		if ( m_task_current == task_get_total() ){
-			//The scheduler only uses OS mem -- disable the process MPU regions
-			m_task_current = 0;
-			if( sos_task_table[0].rr_time < SYSTICK_MIN_CYCLES ){
-				sos_task_table[0].rr_time = m_task_rr_reload;
-				sos_task_table[0].timer.t += (m_task_rr_reload);
-			}
-
-			//see if all tasks have used up their RR time
-			int i;
-			for(i=1; i < task_get_total(); i++){
-				if ( task_exec_asserted(i) && (sos_task_table[i].rr_time >= SYSTICK_MIN_CYCLES) ){
-					break;
-				}
-			}
-
-			//if all executing tasks have used up their RR time -- reload the RR time for executing tasks
-			if ( i == task_get_total() ){
-				for(i=1; i < task_get_total(); i++){
-					if ( task_exec_asserted(i) ){
-						sos_task_table[i].timer.t += (m_task_rr_reload - sos_task_table[i].rr_time);
-						sos_task_table[i].rr_time = m_task_rr_reload;
-					}
-				}
-			}
-
-			break;
-		} else if ( task_exec_asserted(m_task_current) ){
-			if ( (sos_task_table[m_task_current].rr_time >= SYSTICK_MIN_CYCLES) || //is there time remaining on the RR
-				  task_fifo_asserted(m_task_current) ){ //is this a FIFO task
-				//check to see if task is low on memory -- kill if necessary?
-
-				break;
-			}
+	//Issue #130 -- the ready lists are also updated by interrupts that wake tasks
+	cortexm_disable_interrupts();
+	int previous = m_task_current;
+	stop_tickless();
+	m_task_current = task_ready_get_next();
+	if( m_task_current != previous ){
+		sos_task_table[m_task_current].wake_count++;
+		if( is_voluntary ){
+			sos_task_table[previous].voluntary_switch_count++;
+		} else {
+			sos_task_table[previous].involuntary_switch_count++;
 		}
-	} while(1);
+	}
+	start_tickless();
+	cortexm_enable_interrupts();
 
 	//Enable the MPU for the task stack guard
 #if MPU_PRESENT || __MPU_PRESENT
@@ -427,16 +431,7 @@ void switch_contexts(){
 	_impure_ptr = sos_task_table[m_task_current].reent;
 	_global_impure_ptr = sos_task_table[m_task_current].global_reent;
 
-	if ( task_fifo_asserted(m_task_current) ){
-		//disable the systick interrupt (because this is a fifo task)
-		cortexm_disable_systick_irq();
-	} else {
-		//init sys tick to the amount of time remaining
-		SysTick->LOAD = sos_task_table[m_task_current].rr_time;
-		SysTick->VAL = 0; //force a reload
-		//enable the systick interrupt
-		cortexm_enable_systick_irq();
-	}
+	load_systick();
 
 #if __FPU_USED == 1
 	//only do this if the task has used the FPU
@@ -459,8 +454,57 @@ void switch_contexts(){
 	asm volatile ("MSR psp, %0\n\t" : : "r" (sos_task_table[m_task_current].sp) );
 }
 
+void load_systick(){
+	if ( task_fifo_asserted(m_task_current) || m_task_is_tickless ){
+		//disable the systick interrupt (because this is a fifo task or there is no round robin competition)
+		cortexm_disable_systick_irq();
+	} else {
+		//init sys tick to the amount of time remaining
+		SysTick->LOAD = sos_task_table[m_task_current].rr_time;
+		SysTick->VAL = 0; //force a reload
+		//enable the systick interrupt
+		cortexm_enable_systick_irq();
+	}
+}
+
+void start_tickless(){
+	m_task_is_tickless = task_ready_is_tickless();
+	if( m_task_is_tickless ){
+		task_ready_start_tickless(m_task_current);
+		m_task_tickless_start = task_root_get_usecond_clock();
+	}
+}
+
+void stop_tickless(){
+	if( m_task_is_tickless ){
+		task_ready_stop_tickless(m_task_current, get_tickless_cycles());
+		m_task_is_tickless = 0;
+	}
+}
+
+u64 get_tickless_cycles(){
+	return (task_root_get_usecond_clock() - m_task_tickless_start) * (mcu_board_config.core_cpu_freq / 1000000UL);
+}
+
+void task_root_set_deadline(int id, u32 deadline, u32 budget){
+	//Issue #130 -- the ready lists are also updated by interrupts that wake tasks
+	cortexm_disable_interrupts();
+	if( id == m_task_current ){
+		stop_tickless();
+	}
+	task_ready_set_deadline(id, deadline, budget);
+	if( id == m_task_current ){
+		//the new budget (or round robin time) starts now
+		start_tickless();
+		load_systick();
+	}
+	cortexm_enable_interrupts();
+}
+
 void task_root_switch_context(){
-	sos_task_table[task_get_current()].rr_time = SysTick->VAL; //save the RR time from the SYSTICK
+	if( m_task_is_tickless == 0 ){
+		sos_task_table[task_get_current()].rr_time = SysTick->VAL; //save the RR time from the SYSTICK
+	}
 	SCB->ICSR |= (1<<28); //set the pend SV interrupt pending -- causes mcu_core_pendsv_handler() to execute when current interrupt exits
 }
 
@@ -468,7 +512,26 @@ void task_check_count_flag(){
 	if ( SysTick->CTRL & (1<<16) ){ //check the countflag
 
 		sos_task_table[m_task_current].rr_time = 0;
-		switch_contexts();
+		if( task_deadline_asserted(m_task_current) ){
+			//the scheduler holds the task until its next period (and sets a new budget)
+			task_budget_event_handler(m_task_current);
+		}
+		switch_contexts(0);
+	}
+}
+
+void check_switch_request(){
+	//blocking, sleeping, stopping and yielding are voluntary -- being preempted is not
+	int is_voluntary = (task_exec_asserted(task_get_current()) == 0) || //checks if current task is NOT running
+			task_yield_asserted(task_get_current()); //checks if current task requested a context switch
+
+	//switch contexts if current task is not executing or it wants to yield
+	if(  (task_get_current()) == 0 || //always switch away from task zero if requested
+		  is_voluntary ||
+		  task_ready_is_deadline_preempted() || //a task with an earlier deadline is ready
+		  (m_task_is_tickless && (task_ready_is_tickless() == 0)) ){ //another task needs round robin time
+		task_deassert_yield(task_get_current());
+		switch_contexts(is_voluntary);
 	}
 }
 
@@ -486,34 +549,7 @@ void mcu_core_systick_handler(){
 void mcu_core_pendsv_handler() MCU_NAKED MCU_WEAK;
 void mcu_core_pendsv_handler(){
 	task_save_context();
-
-	//disable interrupts -- Re-entrant scheduler issue #130
-	m_task_exec_count = 0;
-	cortexm_disable_interrupts();
-	int i;
-	for(i=1; i < task_get_total(); i++){
-
-		if( task_enabled_active_not_stopped(i) && //enabled, active, and not stopped
-			 ( task_get_priority(i) == task_get_current_priority() ) ){ //task is equal to the currently executing priority
-			//Enable process execution for highest active priority tasks
-			task_assert_exec(i);
-			m_task_exec_count++;
-		} else {
-			//Disable process execution for lower priority tasks
-			task_deassert_exec(i);
-		}
-	}
-
-	//enable interrupts -- Re-entrant scheduler issue
-	cortexm_enable_interrupts();
-
-	//switch contexts if current task is not executing or it wants to yield
-	if(  (task_get_current()) == 0 || //always switch away from task zero if requested
-		  (task_exec_asserted(task_get_current()) == 0) || //checks if current task is NOT running
-		  task_yield_asserted(task_get_current()) ){ //checks if current task requested a context switch
-		task_deassert_yield(task_get_current());
-		switch_contexts();
-	}
+	check_switch_request();
 
 	task_load_context();
 	task_return_context();
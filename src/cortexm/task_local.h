@@ -27,6 +27,7 @@
 #define SYSTICK_CTRL_ENABLE (1<<0)
 #define SYSTICK_CTRL_CLKSROUCE (1<<2)
 #define SYSTICK_CTRL_COUNTFLAG (1<<16)
+#define SYSTICK_MIN_CYCLES 10000
 
 typedef struct {
 	//u32 exc_return;
@@ -59,6 +60,7 @@ typedef struct MCU_PACK {
 extern int task_total MCU_SYS_MEM;
 extern task_t * task_table MCU_SYS_MEM;
 extern volatile int m_task_current MCU_SYS_MEM;
+extern int m_task_rr_reload MCU_SYS_MEM;
 
 typedef struct {
 	int tid;
@@ -80,6 +82,18 @@ typedef struct {
 
 void task_svcall_new_task(new_task_t * task);
 
+//ready lists (task_ready.c) -- called with interrupts disabled
+void task_ready_init();
+void task_ready_insert(int id);
+void task_ready_remove(int id);
+u32 task_ready_get_slice(int id);
+void task_ready_set_deadline(int id, u32 deadline, u32 budget);
+int task_ready_get_next();
+int task_ready_is_tickless();
+void task_ready_start_tickless(int id);
+void task_ready_stop_tickless(int id, u64 cycles);
+int task_ready_is_deadline_preempted();
+
 static inline void task_save_context() MCU_ALWAYS_INLINE;
 void task_save_context(){
 	asm volatile ("MRS r1, psp\n\t"
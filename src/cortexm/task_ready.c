@@ -0,0 +1,297 @@
+/* Copyright 2011-2018 Tyler Gilbert; 
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <string.h>
+#include "task_local.h"
+#include "sos/sos.h"
+#include "sos/dev/sys.h"
+#include "cortexm/task.h"
+
+/*
+ * Tasks that are enabled, active and not stopped are kept in a circular
+ * list for each priority (linked using ready_next/ready_prev in the task table).
+ * A bit in m_task_ready_bitmap is set for each non-empty list so the highest
+ * ready priority is a CLZ and the next task to execute is the head of that list.
+ *
+ * The head of the list is the next task to execute. A task that uses up its
+ * round robin time (or yields) moves to the tail. Task 0 executes once each
+ * time the tasks at the current priority have had a turn.
+ *
+ * Deadline tasks (see task_root_set_deadline()) are kept ahead of the other
+ * tasks in their list, earliest deadline first, and a task with an earlier
+ * deadline preempts the current task (task 0 waits for its turn until no
+ * deadline task is ready). Their round robin time is their budget
+ * so it isn't reloaded when they move. When the budget runs out,
+ * task_budget_event_handler() lets the scheduler hold the task until its
+ * next period.
+ *
+ * None of this touches the core peripherals (task.c programs the SysTick
+ * and switches the contexts) so it is also built by the host tests (test/cortexm).
+ *
+ */
+volatile s8 m_task_current_priority MCU_SYS_MEM;
+static volatile u32 m_task_ready_bitmap MCU_SYS_MEM;
+static volatile u8 m_task_ready_head[TASK_PRIORITY_TOTAL] MCU_SYS_MEM;
+static volatile u8 m_task_ready_count[TASK_PRIORITY_TOTAL] MCU_SYS_MEM;
+static volatile u8 m_task_round_count MCU_SYS_MEM;
+int m_task_rr_reload MCU_SYS_MEM;
+static int get_ready_list(s8 priority);
+static void reload_rr_time(int id);
+
+void task_ready_init(){
+	m_task_current_priority = 0;
+	m_task_ready_bitmap = 0;
+	m_task_round_count = 0;
+	memset((void*)m_task_ready_head, 0, TASK_PRIORITY_TOTAL);
+	memset((void*)m_task_ready_count, 0, TASK_PRIORITY_TOTAL);
+}
+
+u8 task_get_exec_count(){ return m_task_ready_count[ get_ready_list(m_task_current_priority) ]; }
+s8 task_get_current_priority(){ return m_task_current_priority; }
+void task_root_set_current_priority(s8 value){ m_task_current_priority = value; }
+
+void task_root_elevate_current_priority(s8 value){
+	cortexm_disable_interrupts();
+	if( value > m_task_current_priority ){
+		m_task_current_priority = value;
+	}
+	cortexm_enable_interrupts();
+}
+
+s8 task_root_get_highest_ready_priority(){
+	if( m_task_ready_bitmap == 0 ){
+		return 0;
+	}
+	return 31 - __builtin_clz(m_task_ready_bitmap);
+}
+
+int get_ready_list(s8 priority){
+	if( priority < 0 ){
+		return 0;
+	}
+	if( priority >= TASK_PRIORITY_TOTAL ){
+		return TASK_PRIORITY_TOTAL-1;
+	}
+	return priority;
+}
+
+int task_exec_asserted(int id){
+	if( id == 0 ){
+		return 1;
+	}
+	return (sos_task_table[id].ready_next != 0) &&
+			(sos_task_table[id].ready_list == get_ready_list(m_task_current_priority));
+}
+
+void task_ready_insert(int id){
+	int list = get_ready_list(task_get_priority(id));
+	int head = m_task_ready_head[list];
+	int next;
+	int prev;
+	int count;
+
+	if( head == 0 ){
+		sos_task_table[id].ready_next = id;
+		sos_task_table[id].ready_prev = id;
+		m_task_ready_head[list] = id;
+		m_task_ready_bitmap |= (1<<list);
+	} else {
+		//insert at the tail (just before the head)
+		next = head;
+		if( task_deadline_asserted(id) ){
+			//insert after the deadline tasks that are due first (or at the same time)
+			count = m_task_ready_count[list];
+			while( count &&
+					 task_deadline_asserted(next) &&
+					 ((s32)(sos_task_table[next].deadline - sos_task_table[id].deadline) <= 0) ){
+				next = sos_task_table[next].ready_next;
+				count--;
+			}
+			if( count == m_task_ready_count[list] ){
+				m_task_ready_head[list] = id;
+			}
+		}
+		prev = sos_task_table[next].ready_prev;
+		sos_task_table[id].ready_next = next;
+		sos_task_table[id].ready_prev = prev;
+		sos_task_table[prev].ready_next = id;
+		sos_task_table[next].ready_prev = id;
+	}
+	sos_task_table[id].ready_list = list;
+	m_task_ready_count[list]++;
+}
+
+void task_ready_remove(int id){
+	int list = sos_task_table[id].ready_list;
+	int next = sos_task_table[id].ready_next;
+	int prev = sos_task_table[id].ready_prev;
+
+	if( next == id ){
+		m_task_ready_head[list] = 0;
+		m_task_ready_bitmap &= ~(1<<list);
+	} else {
+		sos_task_table[prev].ready_next = next;
+		sos_task_table[next].ready_prev = prev;
+		if( m_task_ready_head[list] == id ){
+			m_task_ready_head[list] = next;
+		}
+	}
+	sos_task_table[id].ready_next = 0;
+	sos_task_table[id].ready_prev = 0;
+	m_task_ready_count[list]--;
+}
+
+void task_root_update_ready(int id){
+	int is_ready;
+
+	if( id == 0 ){
+		return; //task 0 is never in a ready list
+	}
+
+	is_ready = task_enabled_active_not_stopped(id);
+
+	//Issue #130 -- the lists are also updated by interrupts that wake tasks
+	cortexm_disable_interrupts();
+	if( sos_task_table[id].ready_next != 0 ){
+		if( (is_ready == 0) ||
+			 (sos_task_table[id].ready_list != get_ready_list(task_get_priority(id))) ){
+			task_ready_remove(id);
+		}
+	}
+
+	if( is_ready && (sos_task_table[id].ready_next == 0) ){
+		task_ready_insert(id);
+	}
+	cortexm_enable_interrupts();
+}
+
+void reload_rr_time(int id){
+	sos_task_table[id].timer.t += (m_task_rr_reload - sos_task_table[id].rr_time);
+	sos_task_table[id].rr_time = m_task_rr_reload;
+}
+
+u32 task_ready_get_slice(int id){
+	if( task_deadline_asserted(id) ){
+		return sos_task_table[id].budget;
+	}
+	return m_task_rr_reload;
+}
+
+/*
+ * The SysTick counter wraps freely while its interrupt is off, so rr_time
+ * (saved from SysTick->VAL) doesn't apply to a task that runs tickless. What
+ * it used of its slice is charged when the tick stops, and the time it ran
+ * tickless is charged when the tick resumes (with a fresh slice because no
+ * other task was competing).
+ *
+ */
+void task_ready_start_tickless(int id){
+	sos_task_table[id].timer.t += task_ready_get_slice(id) - sos_task_table[id].rr_time;
+	sos_task_table[id].rr_time = task_ready_get_slice(id);
+}
+
+void task_ready_stop_tickless(int id, u64 cycles){
+	sos_task_table[id].timer.t += cycles;
+	sos_task_table[id].rr_time = task_ready_get_slice(id);
+}
+
+void task_ready_set_deadline(int id, u32 deadline, u32 budget){
+	//charge the time used from the old slice or budget (task_root_switch_context() saves rr_time of the current task)
+	sos_task_table[id].timer.t += task_ready_get_slice(id) - sos_task_table[id].rr_time;
+	sos_task_table[id].is_deadline = (budget != 0);
+	sos_task_table[id].deadline = deadline;
+	sos_task_table[id].budget = budget;
+	sos_task_table[id].rr_time = task_ready_get_slice(id);
+	if( sos_task_table[id].ready_next != 0 ){
+		//move the task to its place in deadline order
+		task_ready_remove(id);
+		task_ready_insert(id);
+	}
+}
+
+int task_ready_get_next(){
+	int current = m_task_current;
+	int list = get_ready_list(m_task_current_priority);
+	int next;
+	int is_round_complete = 0;
+
+	if( current != 0 ){
+		if( sos_task_table[current].ready_next != 0 ){
+			if( sos_task_table[current].ready_list == list ){
+				//the current task goes to the back of the line with a fresh round robin time
+				task_ready_remove(current);
+				task_ready_insert(current);
+				if( task_deadline_asserted(current) == 0 ){
+					reload_rr_time(current);
+				}
+				m_task_round_count++;
+			}
+		}
+		//a task that blocked, slept or stopped is no longer counted in the list (so it isn't counted in the round)
+		is_round_complete = m_task_round_count >= m_task_ready_count[list];
+	}
+
+	next = m_task_ready_head[list];
+	if( (next == 0) || (is_round_complete && !task_deadline_asserted(next)) ){
+		//task 0 executes each time the ready tasks have had a turn (or when nothing else is ready) but not ahead of a deadline task
+		m_task_round_count = 0;
+		if( sos_task_table[0].rr_time < SYSTICK_MIN_CYCLES ){
+			sos_task_table[0].rr_time = m_task_rr_reload;
+			sos_task_table[0].timer.t += (m_task_rr_reload);
+		}
+		return 0;
+	}
+
+	if( (sos_task_table[next].rr_time < SYSTICK_MIN_CYCLES) && !task_fifo_asserted(next) && !task_deadline_asserted(next) ){
+		//the task used its time before it blocked
+		reload_rr_time(next);
+	}
+	return next;
+}
+
+int task_ready_is_tickless(){
+	//task 0 needs the SysTick (and its turns) to reset the watchdog
+	if( (sos_board_config.o_sys_flags & SYS_FLAG_IS_WDT_DISABLED) == 0 ){
+		return 0;
+	}
+
+	if( m_task_current == 0 ){
+		//task 0 sleeps when nothing is ready
+		return m_task_ready_bitmap == 0;
+	}
+
+	//the SysTick enforces the budget of a deadline task
+	if( task_deadline_asserted(m_task_current) ){
+		return 0;
+	}
+
+	return m_task_ready_count[ sos_task_table[m_task_current].ready_list ] == 1;
+}
+
+int task_ready_is_deadline_preempted(){
+	int current = m_task_current;
+	int head;
+	if( sos_task_table[current].ready_next == 0 ){
+		return 0;
+	}
+
+	//deadline tasks are inserted ahead of the current task only if they are due first
+	head = m_task_ready_head[ sos_task_table[current].ready_list ];
+	return (head != current) && task_deadline_asserted(head);
+}
@@ -21,11 +21,25 @@
 #include <errno.h>
 #include <stddef.h>
 #include "mcu/debug.h"
+#include "cortexm/cortexm.h"
 #include "device/cfifo.h"
 
-static u32 get_ready_channels(const cfifo_config_t * config, cfifo_state_t * state);
+static void update_ready_channel(cfifo_state_t * state, u32 channel);
+static int handle_data_received(void * context, const mcu_event_t * event);
+static int read_ready_channels(cfifo_state_t * state, devfs_async_t * async);
+static int execute_fifo_request(const cfifo_config_t * config, cfifo_state_t * state, u32 channel, int request, void * ctl);
 
 int cfifo_open(const devfs_handle_t * handle){
+	const cfifo_config_t * config = handle->config;
+	cfifo_state_t * state = handle->state;
+	u32 i;
+
+	//fifo_data_received() updates the ready channels no matter which driver writes the channel
+	for(i=0; i < config->count; i++){
+		state->fifo_state_array[i].data_received.context = state;
+		state->fifo_state_array[i].data_received.callback = handle_data_received;
+		update_ready_channel(state, i);
+	}
 	return 0;
 }
 
@@ -45,7 +59,7 @@ int cfifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 		memset(info, 0, sizeof(cfifo_info_t));
 		info->size = config->size;
 		info->count = config->count;
-		info->o_ready = get_ready_channels(config, state);
+		info->o_ready = state->o_ready;
 		return 0;
 
 	case I_CFIFO_SETATTR:
@@ -68,20 +82,11 @@ int cfifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 		}
 
 	case I_CFIFO_FIFOINIT:
-		return fifo_ioctl_local(config->fifo_config_array + fifo_request->channel,
-				state->fifo_state_array + fifo_request->channel,
-				I_FIFO_INIT,
-				0);
+		return execute_fifo_request(config, state, fifo_request->channel, I_FIFO_INIT, 0);
 	case I_CFIFO_FIFOFLUSH:
-		return fifo_ioctl_local(config->fifo_config_array + fifo_request->channel,
-				state->fifo_state_array + fifo_request->channel,
-				I_FIFO_FLUSH,
-				0);
+		return execute_fifo_request(config, state, fifo_request->channel, I_FIFO_FLUSH, 0);
 	case I_CFIFO_FIFOEXIT:
-		return fifo_ioctl_local(config->fifo_config_array + fifo_request->channel,
-				state->fifo_state_array + fifo_request->channel,
-				I_FIFO_EXIT,
-				0);
+		return execute_fifo_request(config, state, fifo_request->channel, I_FIFO_EXIT, 0);
 	case I_CFIFO_FIFOSETATTR:
 		return fifo_ioctl_local(config->fifo_config_array + fifo_attr->channel,
 				state->fifo_state_array + fifo_attr->channel,
@@ -95,6 +100,15 @@ int cfifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 
 
 	case I_MCU_SETACTION:
+		if( action->channel == CFIFO_CHANNEL_READY ){
+			if( action->handler.callback == 0 ){
+				//cancel waiting for a channel to be ready
+				devfs_execute_read_handler(&state->transfer_handler, 0, -1, MCU_EVENT_FLAG_CANCELED);
+				return 0;
+			}
+			return SYSFS_SET_RETURN(ENOTSUP);
+		}
+
 		//mcu action channel to figure out which fifo
 		if( action->channel < config->count ){
 
@@ -116,6 +130,11 @@ int cfifo_read(const devfs_handle_t * handle, devfs_async_t * async){
 	cfifo_state_t * state = handle->state;
 	if( loc < config->count ){
         ret = fifo_read_local(config->fifo_config_array + loc, state->fifo_state_array + loc, async, 1);
+		if( ret > 0 ){
+			update_ready_channel(state, loc);
+		}
+	} else if( loc == CFIFO_LOC_READY ){
+		ret = read_ready_channels(state, async);
 	} else {
         ret = SYSFS_SET_RETURN(EINVAL);
     }
@@ -140,21 +159,82 @@ int cfifo_close(const devfs_handle_t * handle){
 	return 0;
 }
 
-u32 get_ready_channels(const cfifo_config_t * config, cfifo_state_t * state){
-	u32 o_ready;
-	fifo_info_t info;
-	fifo_state_t * fifo_state;
-	const fifo_config_t * fifo_config;
-	int i;
+int handle_data_received(void * context, const mcu_event_t * event){
+	cfifo_state_t * state = context;
+	fifo_state_t * fifo_state = event->data;
+	u32 channel = fifo_state - state->fifo_state_array;
+	u32 * o_ready;
+	u32 o_select;
+
+	//a read that is blocked on the channel has already taken the data
+	update_ready_channel(state, channel);
+
+	if( (state->transfer_handler.read != 0) && (state->o_ready & (1<<channel)) ){
+		//the waiting read holds the channels it is waiting for
+		o_ready = state->transfer_handler.read->buf;
+		o_select = *o_ready;
+		if( o_select == 0 ){
+			o_select = 0xffffffff;
+		}
 
-	o_ready = 0;
-	for(i=0; i < config->count; i++){
-		fifo_config = config->fifo_config_array + i;
-		fifo_state = state->fifo_state_array + i;
-		fifo_getinfo(&info, fifo_config, fifo_state);
-        if( info.size_ready > 0 ){
-			o_ready |= (1<<i);
+		if( state->o_ready & o_select ){
+			*o_ready = state->o_ready & o_select;
+			devfs_execute_read_handler(&state->transfer_handler, 0, sizeof(u32), MCU_EVENT_FLAG_DATA_READY);
 		}
 	}
-	return o_ready;
+	return 0;
+}
+
+int execute_fifo_request(const cfifo_config_t * config, cfifo_state_t * state, u32 channel, int request, void * ctl){
+	int result;
+	if( channel >= config->count ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+	result = fifo_ioctl_local(config->fifo_config_array + channel, state->fifo_state_array + channel, request, ctl);
+	update_ready_channel(state, channel);
+	return result;
+}
+
+int read_ready_channels(cfifo_state_t * state, devfs_async_t * async){
+	u32 * o_ready = async->buf;
+	u32 o_select;
+
+	if( async->nbyte != sizeof(u32) ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	DEVFS_DRIVER_IS_BUSY(state->transfer_handler.read, async);
+
+	o_select = *o_ready;
+	if( o_select == 0 ){
+		o_select = 0xffffffff;
+	}
+
+	if( state->o_ready & o_select ){
+		*o_ready = state->o_ready & o_select;
+		state->transfer_handler.read = 0;
+		return sizeof(u32);
+	}
+
+	if( async->flags & O_NONBLOCK ){
+		state->transfer_handler.read = 0;
+		return SYSFS_SET_RETURN(EAGAIN);
+	}
+
+	//handle_data_received() completes the read when a selected channel has data
+	return 0;
+}
+
+void update_ready_channel(cfifo_state_t * state, u32 channel){
+	fifo_atomic_position_t atomic_position;
+
+	//the channel may be written by an interrupt while it is being read
+	cortexm_disable_interrupts();
+	atomic_position.atomic_access = state->fifo_state_array[channel].atomic_position.atomic_access;
+	if( atomic_position.access.head != atomic_position.access.tail ){
+		state->o_ready |= (1<<channel);
+	} else {
+		state->o_ready &= ~(1<<channel);
+	}
+	cortexm_enable_interrupts();
 }
@@ -64,6 +64,7 @@ int ffifo_is_write_ok(ffifo_state_t * state, u16 count, int writeblock){
 				state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
 			}
 			ffifo_set_overflow(state, 1);
+			state->overflow_count++;
 		}
 	}
 
@@ -135,7 +136,7 @@ int ffifo_read_buffer(const ffifo_config_t * config, ffifo_state_t * state, char
 			if( state->o_flags & FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY ){
 				read_was_clobbered = 1;
 				//if the read was clobbered the buffer is full
-				state->atomic_position.access.tail = frame_size;
+				state->atomic_position.access.tail = count;
 			}
 			state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY|FIFO_FLAG_IS_READ_BUSY);
 
@@ -178,35 +179,214 @@ int ffifo_write_buffer(const ffifo_config_t * config, ffifo_state_t * state, con
 	return i; //number of frames written
 }
 
+static int get_lent_frame(const ffifo_config_t * config, const ffifo_lend_t * lend){
+	u32 offset = (char*)lend->frame - config->buffer;
+	if( ((char*)lend->frame < config->buffer) ||
+		 (offset % config->frame_size) ||
+		 (offset / config->frame_size + lend->frame_count > config->frame_count) ){
+		return -1;
+	}
+	return offset / config->frame_size;
+}
+
+int ffifo_acquire_read(const ffifo_config_t * config, ffifo_state_t * state, ffifo_lend_t * lend){
+	u16 count = config->frame_count;
+	u16 frames_ready;
+	fifo_atomic_position_t atomic_position;
+
+	if( state->o_flags & FIFO_FLAG_IS_READ_LENT ){
+		return SYSFS_SET_RETURN(EBUSY);
+	}
+
+	//the read stays busy until the frames are released so overwrites are flagged
+	state->o_flags &= ~FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
+	state->o_flags |= FIFO_FLAG_IS_READ_BUSY;
+	atomic_position.atomic_access = state->atomic_position.atomic_access;
+
+	if( atomic_position.access.head == atomic_position.access.tail ){
+		state->o_flags &= ~FIFO_FLAG_IS_READ_BUSY;
+		return SYSFS_SET_RETURN(EAGAIN);
+	}
+
+	if( atomic_position.access.tail == count ){
+		atomic_position.access.tail = atomic_position.access.head;
+	}
+
+	//only frames up to the end of the buffer are contiguous
+	if( atomic_position.access.head > atomic_position.access.tail ){
+		frames_ready = atomic_position.access.head - atomic_position.access.tail;
+	} else {
+		frames_ready = count - atomic_position.access.tail;
+	}
+
+	if( (lend->frame_count == 0) || (lend->frame_count > frames_ready) ){
+		lend->frame_count = frames_ready;
+	}
+
+	lend->frame = ffifo_get_frame(config, atomic_position.access.tail);
+	lend->frame_size = config->frame_size;
+	state->o_flags |= FIFO_FLAG_IS_READ_LENT;
+	return lend->frame_count;
+}
+
+int ffifo_release_read(const ffifo_config_t * config, ffifo_state_t * state, const ffifo_lend_t * lend){
+	u16 count = config->frame_count;
+	int tail;
+
+	if( (state->o_flags & FIFO_FLAG_IS_READ_LENT) == 0 ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	if( state->o_flags & FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY ){
+		//the lent frames were overwritten -- the buffer is full
+		state->atomic_position.access.tail = count;
+		state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY|FIFO_FLAG_IS_READ_BUSY|FIFO_FLAG_IS_READ_LENT);
+		return SYSFS_SET_RETURN(EIO);
+	}
+
+	//a full buffer starts reading at the head
+	tail = state->atomic_position.access.tail;
+	if( tail == count ){
+		tail = state->atomic_position.access.head;
+	}
+
+	if( get_lent_frame(config, lend) != tail ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	tail += lend->frame_count;
+	if( tail >= count ){
+		tail -= count;
+	}
+
+	state->atomic_position.access.tail = tail;
+	state->o_flags &= ~(FIFO_FLAG_IS_READ_BUSY|FIFO_FLAG_IS_READ_LENT);
+	return 0;
+}
+
+static u16 get_contiguous_frames_free(const ffifo_config_t * config, ffifo_state_t * state){
+	fifo_atomic_position_t atomic_position;
+	atomic_position.atomic_access = state->atomic_position.atomic_access;
+	if( atomic_position.access.tail == config->frame_count ){
+		return 0;
+	}
+
+	if( atomic_position.access.tail > atomic_position.access.head ){
+		return atomic_position.access.tail - atomic_position.access.head;
+	}
+	return config->frame_count - atomic_position.access.head;
+}
+
+int ffifo_acquire_write(const ffifo_config_t * config, ffifo_state_t * state, ffifo_lend_t * lend){
+	u16 frames_free;
+
+	if( state->o_flags & FIFO_FLAG_IS_WRITE_LENT ){
+		return SYSFS_SET_RETURN(EBUSY);
+	}
+
+	//lent frames never overwrite data that hasn't been read
+	frames_free = get_contiguous_frames_free(config, state);
+	if( frames_free == 0 ){
+		return SYSFS_SET_RETURN(EAGAIN);
+	}
+
+	if( (lend->frame_count == 0) || (lend->frame_count > frames_free) ){
+		lend->frame_count = frames_free;
+	}
+
+	lend->frame = ffifo_get_frame(config, state->atomic_position.access.head);
+	lend->frame_size = config->frame_size;
+	state->o_flags &= ~FIFO_FLAG_IS_WRITE_WHILE_WRITE_BUSY;
+	state->o_flags |= FIFO_FLAG_IS_WRITE_BUSY | FIFO_FLAG_IS_WRITE_LENT;
+	return lend->frame_count;
+}
+
+int ffifo_release_write(const ffifo_config_t * config, ffifo_state_t * state, const ffifo_lend_t * lend){
+	u16 i;
+	int result = 0;
+
+	if( (state->o_flags & FIFO_FLAG_IS_WRITE_LENT) == 0 ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	if( state->o_flags & FIFO_FLAG_IS_WRITE_WHILE_WRITE_BUSY ){
+		//the frames were written by the driver while they were lent
+		result = SYSFS_SET_RETURN(EIO);
+	} else if( (get_lent_frame(config, lend) != state->atomic_position.access.head) ||
+				  (lend->frame_count > get_contiguous_frames_free(config, state)) ){
+		return SYSFS_SET_RETURN(EINVAL);
+	} else {
+		//don't inc head until the data is in place
+		for(i=0; i < lend->frame_count; i++){
+			ffifo_inc_head(state, config->frame_count);
+		}
+	}
+
+	state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_WRITE_BUSY|FIFO_FLAG_IS_WRITE_BUSY|FIFO_FLAG_IS_WRITE_LENT);
+	return result;
+}
+
 void ffifo_flush(ffifo_state_t * state){
 	state->atomic_position.atomic_access = 0;
 	ffifo_set_overflow(state, 0);
 }
 
-int ffifo_getinfo(ffifo_info_t * info, const ffifo_config_t * config, ffifo_state_t * state){
-	info->o_flags = FIFO_FLAG_SET_WRITEBLOCK | FIFO_FLAG_IS_OVERFLOW;
-	info->frame_count = config->frame_count;
-	info->frame_size = config->frame_size;
+u16 ffifo_get_frame_count_ready(const ffifo_config_t * config, ffifo_state_t * state){
 	fifo_atomic_position_t atomic_position;
 	atomic_position.atomic_access = state->atomic_position.atomic_access;
 
 	if( atomic_position.access.tail == config->frame_count ){
-		info->frame_count_ready = info->frame_count;
+		return config->frame_count;
 	} else if( atomic_position.access.head >= atomic_position.access.tail ){
-		info->frame_count_ready = atomic_position.access.head - atomic_position.access.tail;
-	} else {
-		info->frame_count_ready = info->frame_count - atomic_position.access.tail + atomic_position.access.head;
+		return atomic_position.access.head - atomic_position.access.tail;
 	}
+	return config->frame_count - atomic_position.access.tail + atomic_position.access.head;
+}
+
+int ffifo_getinfo(ffifo_info_t * info, const ffifo_config_t * config, ffifo_state_t * state){
+	info->o_flags = FIFO_FLAG_SET_WRITEBLOCK | FIFO_FLAG_IS_OVERFLOW;
+	info->frame_count = config->frame_count;
+	info->frame_size = config->frame_size;
+	info->frame_count_ready = ffifo_get_frame_count_ready(config, state);
+	info->overflow_count = state->overflow_count;
 
 	info->o_flags = state->o_flags;
 	state->o_flags &= ~FIFO_FLAG_IS_OVERFLOW;
 	return 0;
 }
 
+static void check_watermark(const ffifo_config_t * config, ffifo_state_t * state, u32 o_events){
+	mcu_event_t event;
+	u16 frame_count;
+
+	if( (state->watermark.handler.callback == NULL) ||
+		 ((state->watermark.o_events & o_events) == 0) ){
+		return;
+	}
+
+	frame_count = ffifo_get_frame_count_ready(config, state);
+	if( o_events == MCU_EVENT_FLAG_WRITE_COMPLETE ){
+		frame_count = config->frame_count - frame_count;
+	}
+
+	if( frame_count >= state->watermark.frame_count ){
+		event.o_events = o_events;
+		event.data = (void*)(u32)frame_count;
+		if( state->watermark.handler.callback(state->watermark.handler.context, &event) == 0 ){
+			state->watermark.handler.callback = NULL;
+		}
+	}
+}
+
 void ffifo_data_received(const ffifo_config_t * handle, ffifo_state_t * state){
 	int bytes_read;
+	check_watermark(handle, state, MCU_EVENT_FLAG_DATA_READY);
 	if( state->transfer_handler.read != NULL ){
-		if( (bytes_read = ffifo_read_buffer(
+		if( devfs_is_poll_async(state->transfer_handler.read) ){
+			if( fifo_get_ready_events(state->atomic_position.atomic_access, handle->frame_count, ffifo_is_writeblock(state)) & MCU_EVENT_FLAG_DATA_READY ){
+				devfs_execute_read_handler(&state->transfer_handler, 0, 0, MCU_EVENT_FLAG_DATA_READY);
+			}
+		} else if( (bytes_read = ffifo_read_buffer(
 				  handle,
 				  state,
 				  state->transfer_handler.read->buf,
@@ -243,8 +423,13 @@ void ffifo_cancel_async_write(ffifo_state_t * state){
 
 void ffifo_data_transmitted(const ffifo_config_t * config, ffifo_state_t * state){
 	int bytes_written;
+	check_watermark(config, state, MCU_EVENT_FLAG_WRITE_COMPLETE);
 	if( state->transfer_handler.write != NULL ){
-		if( (bytes_written = ffifo_write_buffer(config, state, state->transfer_handler.write->buf_const, state->transfer_handler.write->nbyte)) > 0 ){
+		if( devfs_is_poll_async(state->transfer_handler.write) ){
+			if( fifo_get_ready_events(state->atomic_position.atomic_access, config->frame_count, ffifo_is_writeblock(state)) & MCU_EVENT_FLAG_WRITE_COMPLETE ){
+				devfs_execute_write_handler(&state->transfer_handler, 0, 0, MCU_EVENT_FLAG_WRITE_COMPLETE);
+			}
+		} else if( (bytes_written = ffifo_write_buffer(config, state, state->transfer_handler.write->buf_const, state->transfer_handler.write->nbyte)) > 0 ){
 			devfs_execute_write_handler(
 						&state->transfer_handler,
 						0,
@@ -299,6 +484,10 @@ int ffifo_ioctl_local(const ffifo_config_t * config, ffifo_state_t * state, int
 	ffifo_attr_t * attr = ctl;
 	ffifo_info_t * info = ctl;
 	mcu_action_t * action = ctl;
+	const ffifo_watermark_t * watermark = ctl;
+	ffifo_lend_t * lend = ctl;
+	mcu_event_handler_t handler;
+	int result;
 	switch(request){
 		case I_MCU_SETACTION:
 			if( action->handler.callback == 0 ){
@@ -319,14 +508,56 @@ int ffifo_ioctl_local(const ffifo_config_t * config, ffifo_state_t * state, int
 		case I_FFIFO_GETINFO:
 			ffifo_getinfo(info, config, state);
 			return 0;
+		case I_DEVFS_POLL:
+			return devfs_poll_transfer_handler(&state->transfer_handler, ctl, fifo_get_ready_events(state->atomic_position.atomic_access, config->frame_count, ffifo_is_writeblock(state)));
+		case I_FFIFO_SETWATERMARK:
+			if( (watermark->frame_count > config->frame_count) ||
+				 ((watermark->o_events & (MCU_EVENT_FLAG_DATA_READY|MCU_EVENT_FLAG_WRITE_COMPLETE)) == 0) ){
+				return SYSFS_SET_RETURN(EINVAL);
+			}
+			//the handler runs in the interrupt that moves the frames
+			handler = watermark->handler;
+			if( devfs_validate_event_handler(&handler) < 0 ){
+				return SYSFS_SET_RETURN(EPERM);
+			}
+			state->watermark = *watermark;
+			return 0;
 		case I_FFIFO_INIT:
 			state->transfer_handler.read = NULL;
 			state->transfer_handler.write = NULL;
+			state->watermark.handler.callback = NULL;
+			state->overflow_count = 0;
 			/* no break */
 		case I_FFIFO_FLUSH:
 			ffifo_flush(state);
 			ffifo_data_transmitted(config, state); //something might be waiting to write the fifo
 			return 0;
+		case I_FFIFO_ACQUIRE_READ:
+			return ffifo_acquire_read(config, state, ctl);
+		case I_FFIFO_RELEASE_READ:
+			result = ffifo_release_read(config, state, ctl);
+			//see if anything needs to write the FIFO
+			ffifo_data_transmitted(config, state);
+			return result;
+		case I_FFIFO_ACQUIRE_WRITE:
+			return ffifo_acquire_write(config, state, ctl);
+		case I_FFIFO_RELEASE_WRITE:
+			result = ffifo_release_write(config, state, ctl);
+			//see if anything is waiting to read the FIFO
+			ffifo_data_received(config, state);
+			return result;
+		case I_FFIFO_EXCHANGE_READ:
+			result = ffifo_release_read(config, state, lend);
+			ffifo_data_transmitted(config, state);
+			if( result < 0 ){ return result; }
+			lend->frame_count = 0;
+			return ffifo_acquire_read(config, state, lend);
+		case I_FFIFO_EXCHANGE_WRITE:
+			result = ffifo_release_write(config, state, lend);
+			ffifo_data_received(config, state);
+			if( result < 0 ){ return result; }
+			lend->frame_count = 0;
+			return ffifo_acquire_write(config, state, lend);
 		case I_FFIFO_SETATTR:
 			if( attr->o_flags & FIFO_FLAG_SET_WRITEBLOCK ){
 				ffifo_set_writeblock(state, 1);
@@ -351,6 +582,9 @@ int ffifo_read_local(const ffifo_config_t * config, ffifo_state_t * state, devfs
 	//reads need to be a integer multiple of the frame size
 	if( (async->nbyte % config->frame_size) != 0 ){
 		bytes_read = SYSFS_SET_RETURN(EINVAL);
+	} else if( state->o_flags & FIFO_FLAG_IS_READ_LENT ){
+		//the oldest frames are lent with I_FFIFO_ACQUIRE_READ
+		bytes_read = SYSFS_SET_RETURN(EBUSY);
 	} else {
 
 		bytes_read = ffifo_read_buffer(config, state, async->buf, async->nbyte); //see if there are bytes in the buffer
@@ -381,6 +615,9 @@ int ffifo_write_local(const ffifo_config_t * config, ffifo_state_t * state, devf
 	//writes need to be a integer multiple of the frame size
 	if( (async->nbyte % config->frame_size) != 0 ){
 		bytes_written = SYSFS_SET_RETURN(EINVAL);
+	} else if( state->o_flags & FIFO_FLAG_IS_WRITE_LENT ){
+		//the next free frames are lent with I_FFIFO_ACQUIRE_WRITE
+		bytes_written = SYSFS_SET_RETURN(EBUSY);
 	} else {
 		bytes_written = ffifo_write_buffer(config, state, async->buf_const, async->nbyte); //see if there are bytes in the buffer
 		if ( bytes_written == 0 ){
@@ -20,6 +20,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stddef.h>
+#include <string.h>
 #include "mcu/debug.h"
 #include "device/fifo.h"
 
@@ -89,68 +90,141 @@ void fifo_set_overflow(fifo_state_t * state, int value){
    }
 }
 
+static void copy_to_buffer(const fifo_config_t * config, int position, const char * buf, int nbyte){
+   //copy up to the end of the buffer then wrap to the start
+   int first_span = config->size - position;
+   if( first_span > nbyte ){
+      first_span = nbyte;
+   }
+   memcpy(config->buffer + position, buf, first_span);
+   memcpy(config->buffer, buf + first_span, nbyte - first_span);
+}
+
+static void copy_from_buffer(const fifo_config_t * config, int position, char * buf, int nbyte){
+   int first_span = config->size - position;
+   if( first_span > nbyte ){
+      first_span = nbyte;
+   }
+   memcpy(buf, config->buffer + position, first_span);
+   memcpy(buf + first_span, config->buffer, nbyte - first_span);
+}
+
 int fifo_read_buffer(const fifo_config_t * config, fifo_state_t * state, char * buf, int nbyte){
-   int i;
    u16 size = config->size;
    int read_was_clobbered = 0;
-   char * dest_buffer = config->buffer;
+   int bytes_ready;
    fifo_atomic_position_t atomic_position;
-   for(i=0; i < nbyte; i++){
 
-      state->o_flags |= FIFO_FLAG_IS_READ_BUSY;
-      atomic_position.atomic_access = state->atomic_position.atomic_access;
+   state->o_flags |= FIFO_FLAG_IS_READ_BUSY;
+   atomic_position.atomic_access = state->atomic_position.atomic_access;
 
-      if( atomic_position.access.head != atomic_position.access.tail ){
-         if( atomic_position.access.tail == size ){
-            //buffer is full -- restore tail position
-            atomic_position.access.tail = atomic_position.access.head;
-         }
-         buf[i] = dest_buffer[atomic_position.access.tail];
-         atomic_position.access.tail++;
-         if( atomic_position.access.tail == size ){
-            atomic_position.access.tail = 0;
-         }
-         //an interrupt here before the tail is assigned will cause a problem
-         state->atomic_position.access.tail = atomic_position.access.tail;
-         //an interrupt here is OK because the write can write to the open spot
-         if( state->o_flags & FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY ){
-            read_was_clobbered = 1;
-            //if the read was clobbered the buffer is full
-            state->atomic_position.access.tail = size;
-         }
+   if( (nbyte <= 0) || (atomic_position.access.head == atomic_position.access.tail) ){
+      state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY|FIFO_FLAG_IS_READ_BUSY);
+      return 0;
+   }
 
-         state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY|FIFO_FLAG_IS_READ_BUSY);
+   if( atomic_position.access.tail == size ){
+      //buffer is full -- restore tail position
+      atomic_position.access.tail = atomic_position.access.head;
+      bytes_ready = size;
+   } else if( atomic_position.access.head > atomic_position.access.tail ){
+      bytes_ready = atomic_position.access.head - atomic_position.access.tail;
+   } else {
+      bytes_ready = size - atomic_position.access.tail + atomic_position.access.head;
+   }
 
-         if( read_was_clobbered ){
-            return i;
-         }
+   if( nbyte > bytes_ready ){
+      nbyte = bytes_ready;
+   }
 
-      } else {
-         state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY|FIFO_FLAG_IS_READ_BUSY);
-         break;
-      }
+   //the writer only uses the free space while a read is busy so the ready bytes can be copied in bulk
+   copy_from_buffer(config, atomic_position.access.tail, buf, nbyte);
+
+   atomic_position.access.tail += nbyte;
+   if( atomic_position.access.tail >= size ){
+      atomic_position.access.tail -= size;
+   }
+
+   //an interrupt here before the tail is assigned will cause a problem
+   state->atomic_position.access.tail = atomic_position.access.tail;
+   //an interrupt here is OK because the write can write to the open spot
+   if( state->o_flags & FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY ){
+      read_was_clobbered = 1;
+      //if the read was clobbered the buffer is full
+      state->atomic_position.access.tail = size;
+   }
 
+   state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY|FIFO_FLAG_IS_READ_BUSY);
+
+   if( read_was_clobbered ){
+      //the oldest data was overwritten while it was being copied
+      return 0;
    }
-   return i; //number of bytes read
+
+   return nbyte; //number of bytes read
 }
 
 
 int fifo_write_buffer(const fifo_config_t * cfgp, fifo_state_t * state, const char * buf, int nbyte, int non_blocking){
-   int i;
    int size = cfgp->size;
    int writeblock = 1;
+   int bytes_free;
+   int bytes_written;
+   int skip;
+   int head;
+   fifo_atomic_position_t atomic_position;
+
+   if( nbyte <= 0 ){
+      return 0;
+   }
+
    if( non_blocking == 0 ){
       writeblock = fifo_is_writeblock(state);
    }
-   for(i=0; i < nbyte; i++){
-      if( fifo_is_write_ok(state, size, writeblock) ){
-         cfgp->buffer[state->atomic_position.access.head] = buf[i];
-         fifo_inc_head(state, size);
+
+   atomic_position.atomic_access = state->atomic_position.atomic_access;
+   if( atomic_position.access.tail == size ){  //the tail is set to size when the buffer is full
+      bytes_free = 0;
+   } else if( atomic_position.access.tail > atomic_position.access.head ){
+      bytes_free = atomic_position.access.tail - atomic_position.access.head;
+   } else {
+      bytes_free = size - atomic_position.access.head + atomic_position.access.tail;
+   }
+
+   bytes_written = nbyte;
+   if( bytes_written > bytes_free ){
+      if( writeblock || (state->o_flags & FIFO_FLAG_IS_READ_BUSY) ){
+         //cannot write anymore data at this time
+         bytes_written = bytes_free;
+         if( bytes_written == 0 ){
+            return 0;
+         }
       } else {
-         break;
+         //OK to write but the oldest data is overwritten
+         fifo_set_overflow(state, 1);
       }
    }
-   return i; //number of bytes written
+
+   //bytes that would be overwritten by this same write are skipped
+   skip = 0;
+   if( bytes_written > size ){
+      skip = bytes_written - size;
+   }
+
+   head = atomic_position.access.head + skip;
+   if( head >= size ){
+      head %= size;
+   }
+   copy_to_buffer(cfgp, head, buf + skip, bytes_written - skip);
+
+   head = (atomic_position.access.head + bytes_written) % size;
+   state->atomic_position.access.head = head;
+   if( bytes_written >= bytes_free ){
+      //set tail to size when full
+      state->atomic_position.access.tail = size;
+   }
+
+   return bytes_written; //number of bytes written
 }
 
 void fifo_flush(fifo_state_t * state){
@@ -180,13 +254,46 @@ void fifo_getinfo(fifo_info_t * info, const fifo_config_t * config, fifo_state_t
    fifo_set_overflow(state, 0);
 }
 
+u32 fifo_get_ready_events(u32 atomic_access, u16 full_tail, int writeblock){
+   u32 o_events = 0;
+   fifo_atomic_position_t atomic_position;
+   //the caller reads head and tail in one access
+   atomic_position.atomic_access = atomic_access;
+
+   //tail is set to full_tail when the fifo is full
+   if( atomic_position.access.head != atomic_position.access.tail ){
+      o_events |= MCU_EVENT_FLAG_DATA_READY;
+   }
+
+   if( (atomic_position.access.tail != full_tail) || (writeblock == 0) ){
+      o_events |= MCU_EVENT_FLAG_WRITE_COMPLETE;
+   }
+
+   return o_events;
+}
+
+int fifo_poll_read(const fifo_config_t * config, fifo_state_t * state, devfs_poll_t * request){
+   u32 o_events = request->o_events;
+   int result;
+
+   //writes go directly to the hardware and are always ready -- only reads use the fifo
+   request->o_events &= MCU_EVENT_FLAG_DATA_READY;
+   result = fifo_ioctl_local(config, state, I_DEVFS_POLL, request);
+   request->o_events |= (o_events & MCU_EVENT_FLAG_WRITE_COMPLETE);
+   return result;
+}
+
 void fifo_data_received(const fifo_config_t * config, fifo_state_t * state){
    if( state->transfer_handler.read != 0 ){
       int bytes_read;
-      if( (bytes_read = fifo_read_buffer(config,
-                                         state,
-                                         state->transfer_handler.read->buf,
-                                         state->transfer_handler.read->nbyte)) > 0 ){
+      if( devfs_is_poll_async(state->transfer_handler.read) ){
+         if( fifo_get_ready_events(state->atomic_position.atomic_access, config->size, fifo_is_writeblock(state)) & MCU_EVENT_FLAG_DATA_READY ){
+            devfs_execute_read_handler(&state->transfer_handler, 0, 0, MCU_EVENT_FLAG_DATA_READY);
+         }
+      } else if( (bytes_read = fifo_read_buffer(config,
+                                                state,
+                                                state->transfer_handler.read->buf,
+                                                state->transfer_handler.read->nbyte)) > 0 ){
          devfs_execute_read_handler(
                   &state->transfer_handler,
                   0,
@@ -194,6 +301,9 @@ void fifo_data_received(const fifo_config_t * config, fifo_state_t * state){
                   MCU_EVENT_FLAG_DATA_READY);
       }
    }
+
+   //a group of fifos (cfifo) keeps track of which ones have data (after a blocked read has taken its share)
+   devfs_execute_event_handler(&state->data_received, MCU_EVENT_FLAG_DATA_READY, state);
 }
 
 void fifo_cancel_async_read(fifo_state_t * state){
@@ -207,7 +317,11 @@ void fifo_cancel_async_write(fifo_state_t * state){
 int fifo_data_transmitted(const fifo_config_t * cfgp, fifo_state_t * state){
    int bytes_written;
    if( state->transfer_handler.write != NULL ){
-      if( (bytes_written = fifo_write_buffer(cfgp, state,
+      if( devfs_is_poll_async(state->transfer_handler.write) ){
+         if( fifo_get_ready_events(state->atomic_position.atomic_access, cfgp->size, fifo_is_writeblock(state)) & MCU_EVENT_FLAG_WRITE_COMPLETE ){
+            devfs_execute_write_handler(&state->transfer_handler, 0, 0, MCU_EVENT_FLAG_WRITE_COMPLETE);
+         }
+      } else if( (bytes_written = fifo_write_buffer(cfgp, state,
                                              state->transfer_handler.write->buf_const,
                                              state->transfer_handler.write->nbyte,
                                              0)) > 0 ){
@@ -285,6 +399,8 @@ int fifo_ioctl_local(const fifo_config_t * config, fifo_state_t * state, int req
 
          //fifo doesn't store a local handler so it can't set an arbitrary action
          return SYSFS_SET_RETURN(ENOTSUP);
+      case I_DEVFS_POLL:
+         return devfs_poll_transfer_handler(&state->transfer_handler, ctl, fifo_get_ready_events(state->atomic_position.atomic_access, config->size, fifo_is_writeblock(state)));
       case I_FIFO_INIT:
          state->transfer_handler.read = NULL;
          state->transfer_handler.write = NULL;
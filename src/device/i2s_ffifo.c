@@ -88,6 +88,7 @@ int i2s_event_data_ready(void * context, const mcu_event_t * event){
             ffifo_state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
         }
         ffifo_state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
+        ffifo_state->overflow_count++;
     }
     ffifo_inc_head(&state->rx.ffifo, config->rx.frame_count);
 
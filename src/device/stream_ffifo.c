@@ -28,6 +28,7 @@
 
 static int event_write_complete(void * context, const mcu_event_t * event);
 static int event_data_ready(void * context, const mcu_event_t * event);
+static int poll_stream(const stream_ffifo_config_t * config, stream_ffifo_state_t * state, devfs_poll_t * request);
 
 int event_write_complete(void * context, const mcu_event_t * event){
 	const devfs_handle_t * handle = context;
@@ -57,10 +58,16 @@ int event_write_complete(void * context, const mcu_event_t * event){
 	if( ffifo_state->atomic_position.access.tail != config->tx.frame_count ){ //buffer should be full when this event fires -- if not fill it with zeros
 		char frame[config->tx.frame_size];
 		ffifo_state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
+		state->tx.overflow_access_count = state->tx.access_count;
+		if( ffifo_state->o_flags & FIFO_FLAG_IS_WRITE_LENT ){
+			//the zeros go in the frames lent to the application -- I_FFIFO_RELEASE_WRITE will discard them
+			ffifo_state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_WRITE_BUSY;
+		}
 		memset(frame, 0, config->tx.frame_size);
 		while( ffifo_state->atomic_position.access.tail != config->tx.frame_count ){
 			//if buffer is not full -- make it full of zeros -- what happens if application is writing while this write -- interrupt priority?
 			ffifo_write_buffer(&config->tx, ffifo_state, frame, config->tx.frame_size);
+			ffifo_state->overflow_count++;
 		}
 	}
 
@@ -129,6 +136,8 @@ int event_data_ready(void * context, const mcu_event_t * event){
 			ffifo_state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
 		}
 		ffifo_state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
+		ffifo_state->overflow_count += ffifo_get_frame_count_ready(&config->rx, ffifo_state);
+		state->rx.overflow_access_count = state->rx.access_count;
 		ffifo_state->atomic_position.access.tail = ffifo_state->atomic_position.access.head; //forces the buffer to be empty
 	}
 
@@ -275,12 +284,38 @@ int stream_ffifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 			info->rx.access_count = state->rx.access_count;
 			info->tx.error = state->tx.error;
 			info->rx.error = state->rx.error;
+			info->tx.overflow_access_count = state->tx.overflow_access_count;
+			info->rx.overflow_access_count = state->rx.overflow_access_count;
 			info->o_flags = STREAM_FFIFO_FLAG_FLUSH |
 					STREAM_FFIFO_FLAG_START |
 					STREAM_FFIFO_FLAG_STOP;
 			info->o_status = state->o_flags;
 			return 0;
 
+		case I_FFIFO_ACQUIRE_READ:
+		case I_FFIFO_RELEASE_READ:
+		case I_FFIFO_EXCHANGE_READ:
+			if( config->rx.buffer == 0 ){ return SYSFS_SET_RETURN(ENOSYS); }
+			return ffifo_ioctl_local(&(config->rx), &(state->rx.ffifo), request, ctl);
+
+		case I_FFIFO_ACQUIRE_WRITE:
+		case I_FFIFO_RELEASE_WRITE:
+		case I_FFIFO_EXCHANGE_WRITE:
+			if( config->tx.buffer == 0 ){ return SYSFS_SET_RETURN(ENOSYS); }
+			return ffifo_ioctl_local(&(config->tx), &(state->tx.ffifo), request, ctl);
+
+		case I_FFIFO_SETWATERMARK:
+			//read watermarks are on the rx ffifo, write watermarks are on the tx ffifo
+			if( ((const ffifo_watermark_t*)ctl)->o_events & MCU_EVENT_FLAG_DATA_READY ){
+				if( config->rx.buffer == 0 ){ return SYSFS_SET_RETURN(ENOSYS); }
+				return ffifo_ioctl_local(&(config->rx), &(state->rx.ffifo), request, ctl);
+			}
+			if( config->tx.buffer == 0 ){ return SYSFS_SET_RETURN(ENOSYS); }
+			return ffifo_ioctl_local(&(config->tx), &(state->tx.ffifo), request, ctl);
+
+		case I_DEVFS_POLL:
+			return poll_stream(config, state, ctl);
+
 		case I_STREAM_FFIFO_SETACTION:
 		case I_MCU_SETACTION:
 
@@ -301,6 +336,35 @@ int stream_ffifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 	return config->device->driver.ioctl(&config->device->handle, request, ctl);
 }
 
+int poll_stream(const stream_ffifo_config_t * config, stream_ffifo_state_t * state, devfs_poll_t * request){
+	devfs_poll_t rx_request;
+	devfs_poll_t tx_request;
+	int result;
+
+	//reads are checked on the rx ffifo and writes on the tx ffifo
+	rx_request = *request;
+	rx_request.o_events &= MCU_EVENT_FLAG_DATA_READY;
+	tx_request = *request;
+	tx_request.o_events &= MCU_EVENT_FLAG_WRITE_COMPLETE;
+
+	if( config->rx.buffer ){
+		result = ffifo_ioctl_local(&(config->rx), &(state->rx.ffifo), I_DEVFS_POLL, &rx_request);
+		if( result < 0 ){ return result; }
+	} else if( rx_request.o_events ){
+		return SYSFS_SET_RETURN(ENOSYS);
+	}
+
+	if( config->tx.buffer ){
+		result = ffifo_ioctl_local(&(config->tx), &(state->tx.ffifo), I_DEVFS_POLL, &tx_request);
+		if( result < 0 ){ return result; }
+	} else if( tx_request.o_events ){
+		return SYSFS_SET_RETURN(ENOSYS);
+	}
+
+	request->o_events = rx_request.o_events | tx_request.o_events;
+	return 0;
+}
+
 int stream_ffifo_read(const devfs_handle_t * handle, devfs_async_t * async){
 	const stream_ffifo_config_t * config = handle->config;
 	stream_ffifo_state_t * state = handle->state;
@@ -20,14 +20,19 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stddef.h>
+#include "cortexm/cortexm.h"
 #include "cortexm/task.h"
 #include "device/switchboard.h"
 #include "mcu/debug.h"
 
 
 static int create_connection(const switchboard_config_t * config, switchboard_state_t * state, const switchboard_attr_t * attr);
+static int create_fan_out(switchboard_state_t * state, switchboard_state_t * source, const switchboard_attr_t * attr);
+static switchboard_state_t * find_source(const switchboard_config_t * config, switchboard_state_t * state, const devfs_device_t * device, u32 loc);
 static void abort_connection(switchboard_state_t * state);
 static void close_connection(switchboard_state_t * state);
+static void close_output(switchboard_state_t * state);
+static void detach_stopped_outputs(switchboard_state_t * state);
 static int destroy_connection(const switchboard_config_t * config, switchboard_state_t * state, u16 i);
 static int clean_connections(const switchboard_config_t * config, switchboard_state_t * state);
 static int open_terminal(const switchboard_state_terminal_t * state_terminal);
@@ -40,9 +45,14 @@ static int read_then_write_until_async(switchboard_state_t * state);
 static void complete_read(switchboard_state_t * state, int bytes_read);
 static void complete_write(switchboard_state_t * state);
 static void update_bytes_transferred(switchboard_state_t * state, switchboard_state_terminal_t * terminal);
+static int transform_packet(switchboard_state_t * state, int bytes_read);
 static void switch_input_buffer(switchboard_state_t * state, int bytes_read);
 static void switch_output_buffer(switchboard_state_t * state);
+static void release_buffer(switchboard_state_t * state, int buffer);
+static int get_buffer_index(switchboard_state_t * state, void * buf);
 static int write_to_device(switchboard_state_t * state);
+static int write_to_outputs(switchboard_state_t * state);
+static int is_async_busy(switchboard_state_t * state);
 static int check_for_stopped_or_destroyed(switchboard_state_t * state);
 
 int switchboard_open(const devfs_handle_t * handle){
@@ -55,6 +65,7 @@ int switchboard_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 	switchboard_state_t * state = handle->state;
 	switchboard_attr_t * attr = ctl;
 	switchboard_info_t * info = ctl;
+	const switchboard_transform_t * transform = ctl;
 	mcu_action_t * action = ctl;
 	int ret;
 	u32 o_flags;
@@ -66,7 +77,8 @@ int switchboard_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 		case I_SWITCHBOARD_GETINFO:
 			info->o_flags = SWITCHBOARD_FLAG_CONNECT |
 					SWITCHBOARD_FLAG_DISCONNECT |
-					SWITCHBOARD_FLAG_IS_PERSISTENT;
+					SWITCHBOARD_FLAG_IS_PERSISTENT |
+					SWITCHBOARD_FLAG_IS_FAN_OUT;
 			info->connection_count = config->connection_count;
 			info->connection_buffer_size = config->connection_buffer_size;
 			info->transaction_limit = config->transaction_limit;
@@ -86,6 +98,17 @@ int switchboard_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 			}
 			return ret;
 
+		case I_SWITCHBOARD_SETTRANSFORM:
+			if( transform->id < config->connection_count ){
+				//outputs that fan out from another connection share the source's transformed packets
+				if( state[transform->id].o_flags & SWITCHBOARD_FLAG_IS_FAN_OUT ){
+					return SYSFS_SET_RETURN(EINVAL);
+				}
+				state[transform->id].transform = *transform;
+				return 0;
+			}
+			return SYSFS_SET_RETURN(EINVAL);
+
 		case I_MCU_SETACTION:
 		case I_SWITCHBOARD_SETACTION:
 			if( action->channel < config->connection_count ){
@@ -167,12 +190,16 @@ int update_priority(const devfs_device_t * device, const switchboard_terminal_t
 
 int create_connection(const switchboard_config_t * config, switchboard_state_t * state, const switchboard_attr_t * attr){
 	u16 id = attr->id;
+	switchboard_state_t * source = 0;
+	switchboard_transform_t transform;
 	int i;
 
 	if( state[id].o_flags != 0 ){
 		return SYSFS_SET_RETURN(EBUSY);
 	}
 
+	//the transform can be set before the connection is made
+	transform = state[id].transform;
 	memset(state + id, 0, sizeof(switchboard_state_t));
 
 	state[id].input.device = devfs_lookup_device(config->devfs_list, attr->input.name); //lookup input device from attr->input.name
@@ -186,10 +213,18 @@ int create_connection(const switchboard_config_t * config, switchboard_state_t *
 		return SYSFS_SET_RETURN(ENOENT);
 	}
 
+	if( attr->o_flags & SWITCHBOARD_FLAG_IS_FAN_OUT ){
+		source = find_source(config, state, state[id].input.device, attr->input.loc);
+		if( source == 0 ){
+			memset(state + id, 0, sizeof(switchboard_state_t));
+			return SYSFS_SET_RETURN(ENOENT);
+		}
+	}
+
 	//check to see if the input or output is already an active connection
 	for(i=0; i < config->connection_count; i++){
 		if( i != id ){
-			if( (state[id].input.device == state[i].input.device)  ){
+			if( (source == 0) && (state[id].input.device == state[i].input.device)  ){
 				memset(state + id, 0, sizeof(switchboard_state_t));
 				return SYSFS_SET_RETURN(EBUSY);
 			}
@@ -201,6 +236,14 @@ int create_connection(const switchboard_config_t * config, switchboard_state_t *
 		}
 	}
 
+	if( source ){
+		return create_fan_out(state + id, source, attr);
+	}
+
+	state[id].source = state + id;
+	state[id].transform = transform;
+	state[id].buffer_size = config->connection_buffer_size;
+
 	if( attr->o_flags & SWITCHBOARD_FLAG_SET_TRANSACTION_LIMIT ){
 		state[id].transaction_limit = attr->transaction_limit;
 	} else {
@@ -256,14 +299,14 @@ int create_connection(const switchboard_config_t * config, switchboard_state_t *
 		state[id].output.async.flags |= O_NONBLOCK;
 	}
 
-	if( open_terminal(&state->input) < 0 ){
+	if( open_terminal(&state[id].input) < 0 ){
 		memset(state + id, 0, sizeof(switchboard_state_t));
 		return SYSFS_SET_RETURN(EIO);
 	}
 
 
-	if( open_terminal(&state->output) < 0 ){
-		close_terminal(&state->input);
+	if( open_terminal(&state[id].output) < 0 ){
+		close_terminal(&state[id].input);
 		memset(state + id, 0, sizeof(switchboard_state_t));
 		return SYSFS_SET_RETURN(EIO);
 	}
@@ -290,6 +333,65 @@ int create_connection(const switchboard_config_t * config, switchboard_state_t *
 	return 0;
 }
 
+int create_fan_out(switchboard_state_t * state, switchboard_state_t * source, const switchboard_attr_t * attr){
+
+	//the input is only used for status -- the source reads the input device
+	state->input.async.loc = attr->input.loc;
+
+	state->source = source;
+	state->transaction_limit = source->transaction_limit;
+	state->packet_size = source->packet_size;
+	state->nbyte = source->nbyte;
+	state->o_flags = SWITCHBOARD_FLAG_IS_CONNECTED | SWITCHBOARD_FLAG_IS_FAN_OUT;
+	state->o_flags |= (source->o_flags & SWITCHBOARD_FLAG_IS_PERSISTENT);
+	state->o_flags |= (attr->o_flags & SWITCHBOARD_FLAG_IS_OUTPUT_NON_BLOCKING);
+
+	memcpy(&state->output.async, &source->output.async, sizeof(devfs_async_t));
+	state->output.async.tid = task_get_current();
+	state->output.async.handler.context = state;
+	state->output.async.loc = attr->output.loc;
+	state->output.async.nbyte = 0;
+	state->output.async.flags = O_RDWR;
+	if( attr->o_flags & SWITCHBOARD_FLAG_IS_OUTPUT_NON_BLOCKING ){
+		state->output.async.flags |= O_NONBLOCK;
+	}
+
+	if( open_terminal(&state->output) < 0 ){
+		memset(state, 0, sizeof(switchboard_state_t));
+		return SYSFS_SET_RETURN(EIO);
+	}
+
+	if( update_priority(state->output.device, &attr->output, MCU_EVENT_FLAG_WRITE_COMPLETE) < 0 ){
+		close_terminal(&state->output);
+		memset(state, 0, sizeof(switchboard_state_t));
+		return SYSFS_SET_RETURN(EIO);
+	}
+
+	//start with the next packet that is read so the output stays in order with the source's output
+	mcu_debug_log_info(MCU_DEBUG_DEVICE, "(%p) Fan out %s -> %s", state, source->input.device->name, state->output.device->name);
+	cortexm_disable_interrupts();
+	state->output.async.buf = source->input.async.buf;
+	state->fan_out = source->fan_out;
+	source->fan_out = state;
+	cortexm_enable_interrupts();
+
+	return 0;
+}
+
+switchboard_state_t * find_source(const switchboard_config_t * config, switchboard_state_t * state, const devfs_device_t * device, u32 loc){
+	u16 i;
+	for(i=0; i < config->connection_count; i++){
+		if( (state[i].o_flags & SWITCHBOARD_FLAG_IS_CONNECTED) &&
+			 ((state[i].o_flags & (SWITCHBOARD_FLAG_IS_FAN_OUT|SWITCHBOARD_FLAG_IS_DESTROYED)) == 0) &&
+			 (state[i].nbyte >= 0) &&
+			 (state[i].input.device == device) &&
+			 (state[i].input.async.loc == loc) ){
+			return state + i;
+		}
+	}
+	return 0;
+}
+
 void abort_connection(switchboard_state_t * state){
 	if( (state->o_flags & SWITCHBOARD_FLAG_IS_ERROR) == 0 ){
 		close_terminal(&state->input);
@@ -312,7 +414,8 @@ int destroy_connection(const switchboard_config_t * config, switchboard_state_t
 
 	if( id < config->connection_count ){
 
-		if( state[id].o_flags & (SWITCHBOARD_FLAG_IS_ERROR|SWITCHBOARD_FLAG_IS_CANCELED) ){
+		if( (state[id].o_flags & (SWITCHBOARD_FLAG_IS_ERROR|SWITCHBOARD_FLAG_IS_CANCELED)) ||
+			 ((state[id].o_flags & SWITCHBOARD_FLAG_IS_CONNECTED) == 0) ){
 			memset(state + id, 0, sizeof(switchboard_state_t));
 		} else {
 			//connection is still on going -- it will clear once it stops -- what happens if the connection never cleans up
@@ -327,6 +430,20 @@ int destroy_connection(const switchboard_config_t * config, switchboard_state_t
 }
 
 void close_connection(switchboard_state_t * state){
+	switchboard_state_t * output = state->fan_out;
+	switchboard_state_t * next;
+
+	//outputs that fan out from this connection stop with it
+	state->fan_out = 0;
+	while( output != 0 ){
+		next = output->fan_out;
+		if( output->nbyte >= 0 ){
+			output->nbyte = state->nbyte;
+		}
+		close_output(output);
+		output = next;
+	}
+
 	close_terminal(&state->input);
 	close_terminal(&state->output);
 
@@ -339,17 +456,59 @@ void close_connection(switchboard_state_t * state){
 	}
 }
 
+void close_output(switchboard_state_t * state){
+	u32 o_events = MCU_EVENT_FLAG_STOP | MCU_EVENT_FLAG_CANCELED;
+	mcu_debug_log_warning(MCU_DEBUG_DEVICE, "Stopping output %s (%d, %d) 0x%lX", state->output.device->name, SYSFS_GET_RETURN(state->nbyte), SYSFS_GET_RETURN_ERRNO(state->nbyte), state->o_flags);
+
+	if( state->o_flags & SWITCHBOARD_FLAG_IS_ERROR ){
+		o_events |= MCU_EVENT_FLAG_ERROR;
+	}
+
+	close_terminal(&state->output);
+	state->o_flags &= ~SWITCHBOARD_FLAG_IS_CONNECTED;
+	state->fan_out = 0;
+	state->pending = 0;
+	mcu_execute_event_handler(&state->event_handler, o_events, 0);
+
+	if( state->o_flags & SWITCHBOARD_FLAG_IS_DESTROYED ){
+		memset(state, 0, sizeof(switchboard_state_t));
+	}
+}
+
+void detach_stopped_outputs(switchboard_state_t * state){
+	switchboard_state_t * previous = state;
+	switchboard_state_t * output = state->fan_out;
+	switchboard_state_t * next;
+
+	while( output != 0 ){
+		next = output->fan_out;
+		if( (output->nbyte < 0) && ((output->o_flags & SWITCHBOARD_FLAG_IS_WRITING_ASYNC) == 0) ){
+			//the output stopped (error or disconnected) -- the source keeps going without it
+			previous->fan_out = next;
+			release_buffer(output, 0);
+			release_buffer(output, 1);
+			close_output(output);
+		} else {
+			previous = output;
+		}
+		output = next;
+	}
+}
+
 int check_for_stopped_or_destroyed(switchboard_state_t * state){
 	if( state->nbyte < 0 ){
 		u32 o_events = MCU_EVENT_FLAG_STOP | MCU_EVENT_FLAG_CANCELED;
+		mcu_event_handler_t event_handler = state->event_handler;
 		mcu_debug_log_warning(MCU_DEBUG_DEVICE, "Stopping %s -> %s (%d, %d) 0x%lX", state->input.device->name, state->output.device->name, SYSFS_GET_RETURN(state->nbyte), SYSFS_GET_RETURN_ERRNO(state->nbyte), state->o_flags);
 
 		if( state->o_flags & SWITCHBOARD_FLAG_IS_ERROR ){
 			o_events |= MCU_EVENT_FLAG_ERROR;
 		}
 
+		//a destroyed connection is cleared when it closes -- the handler still needs to know it stopped
+		state->event_handler.callback = 0;
 		close_connection(state);
-		mcu_execute_event_handler(&state->event_handler, o_events, 0);
+		mcu_execute_event_handler(&event_handler, o_events, 0);
 		return 1;
 	}
 	return 0;
@@ -398,45 +557,81 @@ int is_ready_to_read_device(switchboard_state_t * state){
 	return buffer_is_free;
 }
 
+int get_buffer_index(switchboard_state_t * state, void * buf){
+	return buf != state->buffer[0];
+}
+
 //switch happens after data is written -- so previous buffer will be unused
 void switch_input_buffer(switchboard_state_t * state, int bytes_read){
-	if( state->input.async.buf == state->buffer[0] ){
-		//the read completed on this buffer -- set the number of bytes read
-		state->bytes_in_buffer[0] = bytes_read;
-		state->input.async.buf = state->buffer[1];
-	} else {
-		state->bytes_in_buffer[1] = bytes_read;
-		state->input.async.buf = state->buffer[0];
+	switchboard_state_t * output;
+	int buffer = get_buffer_index(state, state->input.async.buf);
+
+	if( bytes_read > 0 ){
+		//the read completed on this buffer -- every output needs to write it before it is free
+		cortexm_disable_interrupts();
+		state->bytes_in_buffer[buffer] = bytes_read;
+		for(output = state; output != 0; output = output->fan_out){
+			if( output->nbyte >= 0 ){
+				output->pending |= (1<<buffer);
+				state->reference_count[buffer]++;
+			}
+		}
+		if( state->reference_count[buffer] == 0 ){
+			state->bytes_in_buffer[buffer] = 0;
+			bytes_read = 0;
+		}
+		cortexm_enable_interrupts();
+	}
+
+	//the outputs write the buffers in turn -- if the packet was dropped, the next one goes in the same buffer
+	if( bytes_read > 0 ){
+		state->input.async.buf = state->buffer[buffer ^ 1];
 	}
 }
 
 //switch happens after data is written -- so previous buffer will be unused
 void switch_output_buffer(switchboard_state_t * state){
-	if( state->output.async.buf == state->buffer[0] ){
-		state->bytes_in_buffer[0] = 0; //bytes were written
-		state->output.async.buf = state->buffer[1];
-	} else {
-		state->bytes_in_buffer[1] = 0; //bytes were written
-		state->output.async.buf = state->buffer[0];
+	switchboard_state_t * source = state->source;
+	int buffer = get_buffer_index(source, state->output.async.buf);
+	release_buffer(state, buffer); //bytes were written
+	state->output.async.buf = source->buffer[buffer ^ 1];
+}
+
+void release_buffer(switchboard_state_t * state, int buffer){
+	switchboard_state_t * source = state->source;
+
+	//outputs complete at their own interrupt priority
+	cortexm_disable_interrupts();
+	if( state->pending & (1<<buffer) ){
+		state->pending &= ~(1<<buffer);
+		source->reference_count[buffer]--;
+		if( source->reference_count[buffer] == 0 ){
+			//the last output is done with the buffer -- it can be read again
+			source->bytes_in_buffer[buffer] = 0;
+		}
 	}
+	cortexm_enable_interrupts();
 }
 
 int is_ready_to_write_device(switchboard_state_t * state){
+	switchboard_state_t * source = state->source;
+	int buffer;
 
 	if( state->o_flags & SWITCHBOARD_FLAG_IS_WRITING_ASYNC ){
 		//a write is already in progress
 		return 0;
 	}
 
-	if( (state->output.async.nbyte < 0) || (state->nbyte < 0) ){
+	if( (state->output.async.nbyte < 0) || (state->nbyte < 0) || (source->nbyte < 0) ){
 		//all writes are complete or an error occurred
 		return 0;
 	}
 
-	if( state->output.async.buf == state->buffer[0] ){
-		state->output.async.nbyte = state->bytes_in_buffer[0];
+	buffer = get_buffer_index(source, state->output.async.buf);
+	if( state->pending & (1<<buffer) ){
+		state->output.async.nbyte = source->bytes_in_buffer[buffer];
 	} else {
-		state->output.async.nbyte = state->bytes_in_buffer[1];
+		state->output.async.nbyte = 0;
 	}
 
 	//there there are bytes in the buffer, then the device is ready to bw written
@@ -446,6 +641,7 @@ int is_ready_to_write_device(switchboard_state_t * state){
 
 void complete_read(switchboard_state_t * state, int bytes_read){
 	update_bytes_transferred(state, &state->input);
+	bytes_read = transform_packet(state, bytes_read);
 	switch_input_buffer(state, bytes_read);
 	if( state->input.async.nbyte > 0 ){
 		state->input.async.nbyte = state->packet_size;
@@ -464,8 +660,24 @@ void update_bytes_transferred(switchboard_state_t * state, switchboard_state_ter
 	}
 }
 
+int transform_packet(switchboard_state_t * state, int bytes_read){
+	if( (bytes_read > 0) && (state->transform.callback != 0) ){
+		bytes_read = state->transform.callback(state->transform.context, state->input.async.buf, bytes_read, state->buffer_size);
+		if( bytes_read < 0 ){
+			//the transform has stopped the connection
+			state->nbyte = SYSFS_SET_RETURN(ECANCELED);
+			return 0;
+		}
+
+		if( bytes_read > state->buffer_size ){
+			bytes_read = state->buffer_size;
+		}
+	}
+	return bytes_read;
+}
+
 void complete_write(switchboard_state_t * state){
-	update_bytes_transferred(state, &state->output);
+	update_bytes_transferred(state->source, &state->output);
 
 	//switches and marks the buffer as unused (ready for read device to write to buffer)
 	switch_output_buffer(state);
@@ -498,6 +710,28 @@ int write_to_device(switchboard_state_t * state){
 	return ret;
 }
 
+int write_to_outputs(switchboard_state_t * state){
+	switchboard_state_t * output;
+	int ret = write_to_device(state);
+
+	for(output = state->fan_out; output != 0; output = output->fan_out){
+		//an error on an output that fans out only stops that output
+		if( (write_to_device(output) > 0) && (ret == 0) ){
+			ret = 1;
+		}
+	}
+	return ret;
+}
+
+int is_async_busy(switchboard_state_t * state){
+	switchboard_state_t * output;
+	u32 o_flags = state->o_flags;
+	for(output = state->fan_out; output != 0; output = output->fan_out){
+		o_flags |= output->o_flags;
+	}
+	return (o_flags & (SWITCHBOARD_FLAG_IS_WRITING_ASYNC|SWITCHBOARD_FLAG_IS_READING_ASYNC)) != 0;
+}
+
 int read_from_device(switchboard_state_t * state){
 	//start writing the output device
 	int ret = 0;
@@ -577,10 +811,12 @@ int read_then_write_until_async(switchboard_state_t * state){
 		return 0;
 	}
 
+	detach_stopped_outputs(state);
+
 	do {
 		ret = read_from_device(state);
 		if( ret == 0 ){ //read is either async or both buffers full
-			ret = write_to_device(state);
+			ret = write_to_outputs(state);
 		}
 		transactions++;
 	} while( ret > 0 && (transactions < state->transaction_limit) );
@@ -588,7 +824,7 @@ int read_then_write_until_async(switchboard_state_t * state){
 	if( transactions == state->transaction_limit ){
 		state->nbyte = SYSFS_SET_RETURN(EDEADLK);
 	} else {
-		if( (state->o_flags & (SWITCHBOARD_FLAG_IS_WRITING_ASYNC|SWITCHBOARD_FLAG_IS_READING_ASYNC)) == 0 ){
+		if( is_async_busy(state) == 0 ){
 			state->nbyte = SYSFS_SET_RETURN(ENODATA);
 		}
 	}
@@ -662,7 +898,8 @@ int handle_write_complete(void * context, const mcu_event_t * event){
 		write_to_device(state);
 	}
 
-	read_then_write_until_async(state);
+	//the source reads the input for all of its outputs
+	read_then_write_until_async(state->source);
 
 	return 0;
 }
@@ -35,7 +35,6 @@ static int set_read_action(const devfs_handle_t * handle, mcu_callback_t callbac
 }
 
 static int data_received(void * context, const mcu_event_t * data){
-	int i;
 	const devfs_handle_t * handle;
 	const uartfifo_config_t * config;
 	uartfifo_state_t * state;
@@ -43,7 +42,6 @@ static int data_received(void * context, const mcu_event_t * data){
 	config = handle->config;
 	state = handle->state;
 	int result;
-	int size = config->fifo.size;
 
 	result = state->async_read.nbyte;
 	do {
@@ -51,10 +49,7 @@ static int data_received(void * context, const mcu_event_t * data){
 		if( result > 0 ){
 
 			//write the new bytes to the buffer
-			for(i=0; i < result; i++){
-				config->fifo.buffer[ state->fifo.atomic_position.access.head ] = config->read_buffer[i];
-				fifo_inc_head(&(state->fifo), size);
-			}
+			fifo_write_buffer(&(config->fifo), &(state->fifo), config->read_buffer, result, 0);
 
 			//see if any functions are blocked waiting for data to arrive
 			fifo_data_received(&(config->fifo), &(state->fifo));
@@ -94,6 +89,8 @@ int uartfifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 
 
 	switch(request){
+		case I_DEVFS_POLL:
+			return fifo_poll_read(&(config->fifo), &(state->fifo), ctl);
 		case I_FIFO_GETINFO:
 			fifo_getinfo(ctl, &(config->fifo), &(state->fifo));
 			break;
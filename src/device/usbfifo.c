@@ -38,7 +38,6 @@ static int cancel_read_action(const devfs_handle_t * handle){
 }
 
 static int data_received(void * context, const mcu_event_t * data){
-	int i;
 	const devfs_handle_t * handle;
 	const usbfifo_config_t * config;
 	usbfifo_state_t * state;
@@ -46,7 +45,6 @@ static int data_received(void * context, const mcu_event_t * data){
 	config = handle->config;
 	state = handle->state;
 	int result;
-	int size = config->fifo.size;
 
 	result = state->async_read.nbyte;
 
@@ -56,10 +54,7 @@ static int data_received(void * context, const mcu_event_t * data){
 
 
 			//write the new bytes to the buffer
-			for(i=0; i < result; i++){
-				config->fifo.buffer[ state->fifo.atomic_position.access.head ] = config->read_buffer[i];
-				fifo_inc_head(&(state->fifo), size);
-			}
+			fifo_write_buffer(&(config->fifo), &(state->fifo), config->read_buffer, result, 0);
 
 			//see if any functions are blocked waiting for data to arrive
 			fifo_data_received(&(config->fifo), &(state->fifo));
@@ -113,6 +108,8 @@ int usbfifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 	int result;
 	int count;
 	switch(request){
+		case I_DEVFS_POLL:
+			return fifo_poll_read(&(config->fifo), &(state->fifo), ctl);
 		case I_FIFO_GETINFO:
 			fifo_getinfo(info, &(config->fifo), &(state->fifo));
 			break;
@@ -27,9 +27,11 @@
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
+#include <sys/ioctl.h>
 #include "cortexm/cortexm.h"
 #include "mcu/debug.h"
 #include "sos/fs/sysfs.h"
+#include "sos/fs/devfs.h"
 #include "../scheduler/scheduler_local.h"
 #include "../unistd/unistd_local.h"
 #include "../signal/sig_local.h"
@@ -37,15 +39,20 @@
 
 /*! \cond */
 static void svcall_suspend(void * args) MCU_ROOT_EXEC_CODE;
+static void svcall_queue_wait(void * args) MCU_ROOT_EXEC_CODE;
 static int suspend(struct aiocb *const list[], int nent, const struct timespec * timeout, bool block_on_all);
 static int data_transfer(struct aiocb * aiocbp);
+static int start_list(aio_queue_t * queue, struct aiocb * const list[], int nent);
+static void set_error(struct aiocb * aiocbp, int error);
+static int root_is_waiting(int tid, void * block_object) MCU_ROOT_CODE;
+static void root_wake(int tid) MCU_ROOT_CODE;
+static void root_queue_push(aio_queue_t * queue, struct aiocb * aiocbp) MCU_ROOT_CODE;
 
 typedef struct {
-	const devfs_device_t * device;
-	struct aiocb * aiocbp;
-	int read;
-	int result;
-} root_aio_transfer_t;
+	aio_queue_t * queue;
+	struct mcu_timeval abs_timeout;
+	int is_blocked;
+} root_aio_queue_wait_t;
 /*! \endcond */
 
 
@@ -129,11 +136,13 @@ ssize_t aio_return(struct aiocb * aiocbp /*! a pointer to the AIO data struture
 
 int suspend(struct aiocb *const list[], int nent, const struct timespec * timeout, bool block_on_all){
 	sysfs_aio_suspend_t args;
+	int i;
 
 	//suspend until an AIO operation completes or until timeout is exceeded
 	args.list = list;
 	args.nent = nent;
 	args.block_on_all = block_on_all; //only block on one or block on all
+	args.result = 0;
 	scheduler_timing_convert_timespec(&args.abs_timeout, timeout);
 	cortexm_svcall(svcall_suspend, &args);
 
@@ -141,6 +150,19 @@ int suspend(struct aiocb *const list[], int nent, const struct timespec * timeou
 		return 0; //one of the AIO's in the list has already completed
 	}
 
+	if( args.result < 0 ){
+		//another thread is already waiting on an operation in the list
+		errno = SYSFS_GET_RETURN_ERRNO(args.result);
+		return -1;
+	}
+
+	//operations that are still in progress are tagged with args (no other thread can replace the tag)
+	for(i=0; i < nent; i++){
+		if( (list[i] != NULL) && (list[i]->suspend == &args) ){
+			list[i]->suspend = NULL;
+		}
+	}
+
 	//Check the unblock type
 	if ( scheduler_unblock_type( task_get_current() ) == SCHEDULER_UNBLOCK_SLEEP ){
 		errno = EAGAIN;
@@ -158,9 +180,12 @@ int suspend(struct aiocb *const list[], int nent, const struct timespec * timeou
  * in \a list completes or until the \a timeout value is surpassed.  If \a timeout is NULL, it is
  * ignored.
  *
+ * Only one thread can wait on an operation at a time.
+ *
  * \return 0 on success or -1 with errno (see \ref errno) set to:
  *  - EAGAIN:  \a timeout was exceeded before any operations completed.
  *  - EINTR:  the thread received a signal before any operations completed.
+ *  - EBUSY:  another thread is already waiting on an operation in \a list
  */
 int aio_suspend(struct aiocb *const list[] /*! a list of AIO transfer structures */,
 					 int nent /*! the number of transfer in \a list */,
@@ -169,6 +194,9 @@ int aio_suspend(struct aiocb *const list[] /*! a list of AIO transfer structures
 }
 
 /*! \details This function initiates a list of asynchronous transfers.
+ *
+ * The transfers on devices are all started with a single
+ * svcall.
  *
  * \note Asynchronous notification is not supported in this version.  \a ENOTSUP
  * is returned if an attempt is made to invoke an asynchronous notification.
@@ -178,12 +206,14 @@ int aio_suspend(struct aiocb *const list[] /*! a list of AIO transfer structures
  * \return Zero on success or -1 with errno (see \ref errno) set to:
  * - EINTR:  the thread received an signal before completed all transactions
  * - ENOTSUP: \a mode is LIO_NOWAIT and \a sig is not null or sigev_notify is not set to SIGEV_NONE
- * - EINVAL:  \a mode is not set to LIO_NOWAIT or LIO_WAIT
+ * - EINVAL:  \a mode is not set to LIO_NOWAIT or LIO_WAIT or \a nent is greater than AIO_LISTIO_MAX
+ * - EIO: one or more transfers failed to start (use aio_error() to see why)
  */
 int lio_listio(int mode /*! The mode:  \a LIO_WAIT or \a LIO_NOWAIT */,
 					struct aiocb * const list[] /*! The list of AIO transfers */,
 					int nent /*! The number of transfers in \a list */,
 					struct sigevent * sig /*! The sigevent structure */){
+	int failed;
 	int i;
 
 	switch(mode){
@@ -205,20 +235,117 @@ int lio_listio(int mode /*! The mode:  \a LIO_WAIT or \a LIO_NOWAIT */,
 			return -1;
 	}
 
-	for(i=0; i < nent; i++){
-		//start all of the operations in the list
-		if( list[i] != NULL ){  //ignore NULL entries
-			data_transfer(list[i]);
-		}
+	failed = start_list(NULL, list, nent);
+	if( failed < 0 ){
+		return -1;
 	}
 
 	if ( mode == LIO_WAIT ){
-		return suspend(list, nent, NULL, true);
+		if( suspend(list, nent, NULL, true) < 0 ){
+			return -1;
+		}
 	}
 
+	if( failed > 0 ){
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*! \details This function initializes \a queue to use \a entry
+ * to hold up to \a size - 1 finished operations.
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL: \a size is less than 2
+ */
+int aio_queue_init(aio_queue_t * queue /*! The queue to initialize */,
+						 struct aiocb ** entry /*! The memory for the ring (\a size entries) */,
+						 u16 size /*! The number of entries in \a entry */){
+	if( size < 2 ){
+		errno = EINVAL;
+		return -1;
+	}
+	queue->entry = entry;
+	queue->size = size;
+	queue->head = 0;
+	queue->tail = 0;
+	queue->overflow_count = 0;
+	queue->tid = -1;
 	return 0;
 }
 
+/*! \details This function starts a list of asynchronous transfers (like lio_listio()
+ * with LIO_NOWAIT) and adds each one to \a queue when it finishes. The transfers
+ * on devices are started with a single svcall.
+ *
+ * Transfers that can't be started are not added to \a queue. That includes
+ * every transfer if \a queue (or its ring) isn't in memory the caller can
+ * access (aio_error() reports EPERM).
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL:  \a nent is greater than AIO_LISTIO_MAX
+ * - EIO: one or more transfers failed to start (use aio_error() to see why)
+ */
+int aio_queue_submit(aio_queue_t * queue /*! The completion queue */,
+							struct aiocb * const list[] /*! The list of AIO transfers */,
+							int nent /*! The number of transfers in \a list */){
+	int failed;
+
+	failed = start_list(queue, list, nent);
+	if( failed < 0 ){
+		return -1;
+	}
+
+	if( failed > 0 ){
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*! \details This function gets the oldest finished operation from \a queue. If
+ * \a queue is empty, the thread blocks until an operation finishes or until
+ * the \a timeout value is surpassed. If \a timeout is NULL, it is ignored.
+ *
+ * \return A pointer to the finished operation or NULL with errno (see \ref errno) set to:
+ *  - EAGAIN:  \a timeout was exceeded before any operations finished.
+ *  - EINTR:  the thread received a signal before any operations finished.
+ */
+struct aiocb * aio_queue_get(aio_queue_t * queue /*! The completion queue */,
+									  const struct timespec * timeout /*! the absolute timeout value */){
+	root_aio_queue_wait_t args;
+	struct aiocb * aiocbp;
+	u16 tail;
+
+	args.queue = queue;
+	scheduler_timing_convert_timespec(&args.abs_timeout, timeout);
+	while( queue->head == queue->tail ){
+		cortexm_svcall(svcall_queue_wait, &args);
+		if( args.is_blocked ){
+			queue->tid = -1;
+			if ( scheduler_unblock_type( task_get_current() ) == SCHEDULER_UNBLOCK_SLEEP ){
+				errno = EAGAIN;
+				return NULL;
+			} else if ( scheduler_unblock_type( task_get_current() ) == SCHEDULER_UNBLOCK_SIGNAL ){
+				errno = EINTR;
+				return NULL;
+			}
+		}
+	}
+
+	tail = queue->tail;
+	aiocbp = queue->entry[tail];
+	tail++;
+	if( tail == queue->size ){
+		tail = 0;
+	}
+	queue->tail = tail;
+	return aiocbp;
+}
+
 /*! \cond */
 int data_transfer(struct aiocb * aiocbp){
 	int fildes;
@@ -231,60 +358,177 @@ int data_transfer(struct aiocb * aiocbp){
 		return -1;
 	}
 	aiocbp->aio_fildes = fildes;
+	aiocbp->aio_queue = NULL;
+	aiocbp->suspend = NULL;
 	file = get_open_file(fildes);
 	return sysfs_file_aio(file, aiocbp);
 }
 
+int start_list(aio_queue_t * queue, struct aiocb * const list[], int nent){
+	const devfs_device_t * device_list[AIO_LISTIO_MAX];
+	struct aiocb * aiocbp;
+	int fildes;
+	int failed;
+	int i;
+
+	if( (nent < 0) || (nent > AIO_LISTIO_MAX) ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	failed = 0;
+	for(i=0; i < nent; i++){
+		device_list[i] = NULL;
+		aiocbp = list[i];
+		if( (aiocbp == NULL) || (aiocbp->aio_lio_opcode == LIO_NOP) ){  //ignore NULL entries
+			continue;
+		}
+
+		aiocbp->aio_queue = queue;
+		aiocbp->suspend = NULL;
+		fildes = u_fildes_is_bad(aiocbp->aio_fildes);
+		if ( fildes < 0 ){
+			set_error(aiocbp, EBADF);
+			failed++;
+			continue;
+		}
+		aiocbp->aio_fildes = fildes;
+
+		if( get_fs(fildes)->aio == devfs_aio ){
+			//devices are started together below
+			device_list[i] = get_handle(fildes);
+		} else if( sysfs_file_aio(get_open_file(fildes), aiocbp) < 0 ){
+			set_error(aiocbp, errno);
+			failed++;
+		}
+	}
+
+	return failed + devfs_aio_list(device_list, list, nent);
+}
+
+void set_error(struct aiocb * aiocbp, int error){
+	aiocbp->aio_nbytes = -1;
+	aiocbp->async.nbyte = error;
+	aiocbp->async.buf = NULL;
+}
+
 
 void svcall_suspend(void * args){
 	CORTEXM_SVCALL_ENTER();
 	int i;
-	bool suspend;
 	sysfs_aio_suspend_t * p = (sysfs_aio_suspend_t*)args;
-	//disable interrupts
-	//! \todo See if an operation is in progress
-	if ( p->block_on_all == false ){
-		suspend = true;
-	} else {
-		suspend = false;
-	}
+
+	int is_busy;
+
+	p->pending = 0;
+	p->tid = task_get_current();
+	is_busy = 0;
 	cortexm_disable_interrupts(); //no switching until the transfer is started
 	for(i = 0; i < p->nent; i++ ){
 		if (p->list[i] != NULL ){
-
-			//first check to see if we block on aio suspend (if anything is complete don't block)
-			if ( (p->list[i]->async.buf == NULL) && (p->block_on_all == false) ){ //if op.buf is NULL the operation is complete
-				suspend = false;
+			//if op.buf is NULL the operation is complete
+			if ( p->list[i]->async.buf != NULL ){
+				if( p->list[i]->suspend != NULL ){
+					//the completion wakes only one thread
+					is_busy = 1;
+				}
+				p->pending++;
+			} else if ( p->block_on_all == false ){
+				//aio suspend doesn't block if anything is complete (even if another thread waits on the rest)
+				p->pending = 0;
+				is_busy = 0;
 				break;
 			}
+		}
+	}
 
-			//now check to see if we block on listio suspend (if anything is incomplete block)
-			if ( (p->list[i]->async.buf != NULL) && (p->block_on_all == true) ){
-				suspend = true;
+	if( is_busy ){
+		p->result = SYSFS_SET_RETURN(EBUSY);
+	} else if ( p->pending > 0 ){
+		//the completion callback uses the tag to find the waiting thread without scanning the list
+		for(i = 0; i < p->nent; i++ ){
+			if ( (p->list[i] != NULL) && (p->list[i]->async.buf != NULL) ){
+				p->list[i]->suspend = p;
 			}
-
 		}
+		scheduler_root_assert_aiosuspend(p->tid);
+		scheduler_timing_root_timedblock(args, &p->abs_timeout);
+	} else if( p->result == 0 ){
+		p->nent = -1;
 	}
 
-	if ( suspend == true ){
+	//enable interrupts
+	cortexm_enable_interrupts();
+
+}
+
+void svcall_queue_wait(void * args){
+	CORTEXM_SVCALL_ENTER();
+	root_aio_queue_wait_t * p = (root_aio_queue_wait_t*)args;
+
+	cortexm_disable_interrupts();
+	if( p->queue->head == p->queue->tail ){
+		p->is_blocked = 1;
+		p->queue->tid = task_get_current();
 		scheduler_root_assert_aiosuspend(task_get_current());
-		scheduler_timing_root_timedblock(args, &p->abs_timeout);
+		scheduler_timing_root_timedblock(p->queue, &p->abs_timeout);
 	} else {
-		p->nent = -1;
+		p->is_blocked = 0;
 	}
+	cortexm_enable_interrupts();
+}
 
-	//enable interrupts
+int root_is_waiting(int tid, void * block_object){
+	return (tid >= 0) &&
+			(tid < task_get_total()) &&
+			task_enabled(tid) &&
+			scheduler_aiosuspend_asserted(tid) &&
+			(sos_sched_table[tid].block_object == block_object);
+}
+
+void root_wake(int tid){
+	scheduler_root_assert_active(tid, SCHEDULER_UNBLOCK_AIO);
+	scheduler_root_update_on_wake(tid, task_get_priority(tid));
+}
+
+void root_queue_push(aio_queue_t * queue, struct aiocb * aiocbp){
+	u16 head;
+	int tid;
+
+	//a higher priority interrupt can finish another operation on the same queue
+	cortexm_disable_interrupts();
+	head = queue->head + 1;
+	if( head == queue->size ){
+		head = 0;
+	}
+
+	//the queue was validated when the operation was submitted but the indexes are in application memory
+	if( (head == queue->tail) || (queue->head >= queue->size) ){
+		queue->overflow_count++;
+	} else {
+		queue->entry[queue->head] = aiocbp;
+		queue->head = head;
+	}
+
+	//only one completion wakes the waiting thread
+	tid = queue->tid;
+	if( root_is_waiting(tid, queue) ){
+		queue->tid = -1;
+	} else {
+		tid = -1;
+	}
 	cortexm_enable_interrupts();
 
+	if( tid >= 0 ){
+		root_wake(tid);
+	}
 }
 
 int sysfs_aio_data_transfer_callback(void * context, const mcu_event_t * event){
 	struct aiocb * aiocbp;
 	unsigned int tid;
-	int i;
-	bool wakeup;
-	aiocbp = context;
 	sysfs_aio_suspend_t * p;
+	aiocbp = context;
 	aiocbp->aio_nbytes = aiocbp->async.nbyte;
 	aiocbp->async.buf = NULL;
 	if( aiocbp->async.nbyte < 0 ){
@@ -293,7 +537,22 @@ int sysfs_aio_data_transfer_callback(void * context, const mcu_event_t * event){
 		aiocbp->async.nbyte = 0;
 	}
 
-	//Check to see if the thread is suspended on aio -- the block object is a list of aiocb -- check if aiocbp is in list
+	//aio_suspend() and lio_listio() tag the operations they are waiting on
+	p = aiocbp->suspend;
+	if( p != NULL ){
+		aiocbp->suspend = NULL;
+		if( root_is_waiting(p->tid, p) ){
+			p->pending--;
+			if( (p->block_on_all == false) || (p->pending == 0) ){
+				root_wake(p->tid);
+			}
+		}
+	}
+
+	if( aiocbp->aio_queue != NULL ){
+		root_queue_push(aiocbp->aio_queue, aiocbp);
+	}
+
 	tid = aiocbp->async.tid;
 	if( tid >= task_get_total() ){
 		//This is not a valid task id
@@ -301,33 +560,6 @@ int sysfs_aio_data_transfer_callback(void * context, const mcu_event_t * event){
 	}
 
 	if( task_enabled(tid) ){ //if task is no longer enabled (don't do anything)
-		if ( scheduler_aiosuspend_asserted(tid) ){
-			p = (sysfs_aio_suspend_t*)sos_sched_table[tid].block_object;
-
-			if ( p->block_on_all == false ){
-				for(i=0; i < p->nent; i++){
-					if ( aiocbp == p->list[i] ){ //If this is true the thread is blocked on the operation that is currently completing
-						scheduler_root_assert_active(tid, SCHEDULER_UNBLOCK_AIO);
-						scheduler_root_update_on_wake(tid, task_get_priority(tid) );
-						break;
-					}
-				}
-			} else {
-				wakeup = true;
-				for(i=0; i < p->nent; i++){
-					if ( p->list[i]->async.buf != NULL ){ //operation is not complete
-						//don't wakeup because this operation is not complete
-						wakeup = false;
-					}
-				}
-
-				if( wakeup == true ){
-					scheduler_root_assert_active(tid, SCHEDULER_UNBLOCK_AIO);
-					scheduler_root_update_on_wake(tid, task_get_priority(tid));
-				}
-			}
-		}
-
 		//Need to send an asynchronous notification if a lio_listio call was made -- no limit to number of lio_listio calls
 		if( aiocbp->aio_sigevent.sigev_notify == SIGEV_SIGNAL ){
 			//send a signal
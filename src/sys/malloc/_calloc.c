@@ -22,6 +22,7 @@
 #include <malloc.h>
 #include <sys/types.h>
 #include <string.h>
+#include "sys/malloc/malloc_local.h"
 
 void * _calloc_r(struct _reent * reent_ptr, size_t s1, size_t s2){
 	int size;
@@ -29,6 +30,12 @@ void * _calloc_r(struct _reent * reent_ptr, size_t s1, size_t s2){
 	size = s1*s2;
 	alloc = _malloc_r(reent_ptr, size);
 	if ( alloc != NULL ){
+#if MALLOC_USE_PROFILER
+		//attribute the allocation to the caller of calloc() rather than to _calloc_r()
+		__malloc_lock(reent_ptr);
+		malloc_set_chunk_caller(malloc_chunk_from_addr(alloc), __builtin_return_address(0));
+		__malloc_unlock(reent_ptr);
+#endif
 		memset(alloc, 0, size);
 	}
 	return alloc;
@@ -19,11 +19,18 @@
 
 #include <sys/malloc/malloc_local.h>
 
+static u16 get_available_chunks(malloc_chunk_t * chunk);
+#if !MALLOC_USE_FREE_LIST_BINS
+static malloc_chunk_t * find_prev_chunk(struct _reent * reent_ptr, malloc_chunk_t * chunk);
+static malloc_chunk_t * resize_chunk(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks, u32 size);
+#endif
+
 void * _realloc_r(struct _reent * reent_ptr, void * addr, size_t size){
 	u16 num_chunks;
-	u16 free_chunks;
+	u16 available_chunks;
+	u32 copy_size;
 	malloc_chunk_t * chunk;
-	malloc_chunk_t * next;
+	malloc_chunk_t * new_chunk;
 	void * alloc;
 
 	if ( reent_ptr == NULL ){
@@ -33,7 +40,7 @@ void * _realloc_r(struct _reent * reent_ptr, void * addr, size_t size){
 
 	if ( size == 0 ){
 		if ( addr != NULL ){
-			free(addr);
+			_free_r(reent_ptr, addr);
 		}
 		return NULL;
 	}
@@ -48,60 +55,125 @@ void * _realloc_r(struct _reent * reent_ptr, void * addr, size_t size){
 
 	//Check to see if there is memory allocated already
 	if ( reent_ptr->procmem_base->size == 0 ){
+		//since base has not been initialized, addr cannot be valid
+		__malloc_unlock(reent_ptr);
+		errno = ENOMEM;
+		return NULL;
+	}
 
-		if ( addr != NULL ){ //since base has not been initialized, this cannot be valid
-			__malloc_unlock(reent_ptr);
-			errno = ENOMEM;
-			return NULL;
-		}
-
-	} else {
-
-		num_chunks = malloc_calc_num_chunks(size);
-		//Check to see if current memory can be resized
-		chunk = malloc_chunk_from_addr(addr);
-		if ( malloc_chunk_is_free(chunk) != 0 ){ //chunk is either corrupt or free
-			errno = EINVAL;
-			__malloc_unlock(reent_ptr);
-			return NULL;
-		}
-
-		if ( num_chunks <= chunk->header.num_chunks ){ //check to see if new chunk count is less than or equal to current count
-			free_chunks = chunk->header.num_chunks - num_chunks;
-			malloc_set_chunk_used(reent_ptr, chunk, num_chunks, size);
-			next = chunk + num_chunks;
-			if( free_chunks != 0 ){
-				malloc_set_chunk_free(next, free_chunks);
+	num_chunks = malloc_calc_num_chunks(size);
+	//Check to see if current memory can be resized
+	chunk = malloc_chunk_from_addr(addr);
+	if ( malloc_chunk_is_free(chunk) != 0 ){ //chunk is either corrupt or free
+		errno = EINVAL;
+		__malloc_unlock(reent_ptr);
+		return NULL;
+	}
+	copy_size = chunk->header.actual_size;
+
+	/*
+	 * Resize in place by shrinking or absorbing the free chunks on either side (data is
+	 * moved down if the chunk grows backward). If that isn't enough and nothing but free
+	 * memory follows the chunk, the heap is extended so the chunk can grow forward.
+	 *
+	 */
+#if MALLOC_USE_FREE_LIST_BINS
+	new_chunk = malloc_bins_resize(reent_ptr, chunk, num_chunks, size);
+#else
+	new_chunk = resize_chunk(reent_ptr, chunk, num_chunks, size);
+#endif
+
+	if( new_chunk == NULL ){
+		available_chunks = get_available_chunks(chunk);
+		if( (chunk + available_chunks)->header.num_chunks == 0 ){
+			if( malloc_extend_heap(reent_ptr, (num_chunks - available_chunks) * MALLOC_CHUNK_SIZE) == 0 ){
+#if MALLOC_USE_FREE_LIST_BINS
+				new_chunk = malloc_bins_resize(reent_ptr, chunk, num_chunks, size);
+#else
+				new_chunk = resize_chunk(reent_ptr, chunk, num_chunks, size);
+#endif
 			}
-			__malloc_unlock(reent_ptr);
-			return addr;
 		}
+	}
 
-		next = chunk + chunk->header.num_chunks;
-
-		if ( malloc_chunk_is_free(next) == 1 ){ //The next chunk is free
-			free_chunks = next->header.num_chunks + chunk->header.num_chunks;
-			if ( free_chunks < num_chunks ){
-				malloc_set_chunk_used(reent_ptr, chunk, num_chunks, size);
-				next = chunk + chunk->header.num_chunks;
-				malloc_set_chunk_free(next, num_chunks - free_chunks);
-				__malloc_unlock(reent_ptr);
-				return addr;
-			} else if ( free_chunks == num_chunks ){
-				malloc_set_chunk_used(reent_ptr, chunk, num_chunks, size);
-				__malloc_unlock(reent_ptr);
-				return addr;
-			}
-		}
+#if MALLOC_USE_PROFILER
+	if( new_chunk != NULL ){
+		malloc_set_chunk_caller(new_chunk, __builtin_return_address(0));
 	}
+#endif
 
 	__malloc_unlock(reent_ptr);
 
+	if( new_chunk != NULL ){
+		return new_chunk->memory;
+	}
+
 	alloc = _malloc_r(reent_ptr, size);
 
 	if ( alloc != NULL ){
+		if( copy_size > size ){
+			copy_size = size;
+		}
+		memcpy(alloc, addr, copy_size);
 		_free_r(reent_ptr, addr);
 	}
 
 	return alloc;
 }
+
+u16 get_available_chunks(malloc_chunk_t * chunk){
+	malloc_chunk_t * next;
+	u16 available_chunks = chunk->header.num_chunks;
+	next = chunk + available_chunks;
+	if( (next->header.num_chunks != 0) && (malloc_chunk_is_free(next) == 1) ){
+		available_chunks += next->header.num_chunks;
+	}
+	return available_chunks;
+}
+
+#if !MALLOC_USE_FREE_LIST_BINS
+malloc_chunk_t * find_prev_chunk(struct _reent * reent_ptr, malloc_chunk_t * chunk){
+	malloc_chunk_t * current = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+	malloc_chunk_t * prev = NULL;
+	while( current != chunk ){
+		if( current->header.num_chunks == 0 ){
+			return NULL;
+		}
+		prev = current;
+		current += current->header.num_chunks;
+	}
+	return prev;
+}
+
+malloc_chunk_t * resize_chunk(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks, u32 size){
+	malloc_chunk_t * prev;
+	u16 total_chunks;
+	u32 copy_size;
+
+	//adjacent free chunks are always merged so there is at most one free chunk on each side
+	total_chunks = get_available_chunks(chunk);
+
+	if( num_chunks > total_chunks ){
+		prev = find_prev_chunk(reent_ptr, chunk);
+		if( (prev == NULL) ||
+			 (malloc_chunk_is_free(prev) != 1) ||
+			 (prev->header.num_chunks + total_chunks < num_chunks) ){
+			return NULL;
+		}
+
+		copy_size = chunk->header.actual_size;
+		if( copy_size > size ){
+			copy_size = size;
+		}
+		total_chunks += prev->header.num_chunks;
+		memmove(prev->memory, chunk->memory, copy_size);
+		chunk = prev;
+	}
+
+	malloc_set_chunk_used(reent_ptr, chunk, num_chunks, size);
+	if( total_chunks > num_chunks ){
+		malloc_set_chunk_free(chunk + num_chunks, total_chunks - num_chunks);
+	}
+	return chunk;
+}
+#endif
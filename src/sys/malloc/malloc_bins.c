@@ -0,0 +1,276 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Segregated free lists for the chunk allocator (MALLOC_USE_FREE_LIST_BINS).
+ *
+ * The first chunk of the heap holds malloc_bins_t. Free chunks are kept in
+ * doubly linked lists (one per power of two size class) that are linked using
+ * chunk indices stored in the free chunk's memory. A bitmap marks the non-empty
+ * size classes so finding a free chunk is a bit scan plus a list head.
+ *
+ * Free chunks also store their size in the last two bytes (the boundary tag)
+ * and the chunk following a free chunk has MALLOC_TASK_ID_PREV_FREE set in
+ * its task_id. That allows free() to merge with both neighbors immediately
+ * so the heap never needs to be walked to coalesce.
+ *
+ */
+
+#include "sys/malloc/malloc_local.h"
+#include "cortexm/cortexm.h"
+
+#if MALLOC_USE_FREE_LIST_BINS
+
+static malloc_chunk_t * get_base(struct _reent * reent_ptr){
+	return (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+}
+
+static malloc_bins_t * get_bins(struct _reent * reent_ptr){
+	return (malloc_bins_t *)get_base(reent_ptr)->memory;
+}
+
+static malloc_free_link_t * get_link(malloc_chunk_t * chunk){
+	return (malloc_free_link_t *)chunk->memory;
+}
+
+static u16 * get_boundary_tag(malloc_chunk_t * chunk, u16 num_chunks){
+	return (u16*)(chunk + num_chunks) - 1;
+}
+
+static u16 get_index(struct _reent * reent_ptr, malloc_chunk_t * chunk){
+	return chunk - get_base(reent_ptr);
+}
+
+static malloc_chunk_t * get_chunk(struct _reent * reent_ptr, u16 index){
+	return get_base(reent_ptr) + index;
+}
+
+static int get_bin(u16 num_chunks){
+	//floor(log2(num_chunks))
+	return 31 - __builtin_clz(num_chunks);
+}
+
+static void set_prev_free(malloc_chunk_t * chunk, int is_prev_free){
+	if( is_prev_free ){
+		chunk->header.task_id |= MALLOC_TASK_ID_PREV_FREE;
+	} else {
+		chunk->header.task_id &= ~MALLOC_TASK_ID_PREV_FREE;
+	}
+	cortexm_assign_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t));
+}
+
+static void insert_chunk(struct _reent * reent_ptr, malloc_chunk_t * chunk){
+	malloc_bins_t * bins = get_bins(reent_ptr);
+	malloc_free_link_t * link = get_link(chunk);
+	int bin = get_bin(chunk->header.num_chunks);
+	u16 index = get_index(reent_ptr, chunk);
+
+	link->prev = 0;
+	link->next = bins->head[bin];
+	if( link->next ){
+		get_link(get_chunk(reent_ptr, link->next))->prev = index;
+	}
+	bins->head[bin] = index;
+	bins->bitmap |= (1<<bin);
+	*get_boundary_tag(chunk, chunk->header.num_chunks) = chunk->header.num_chunks;
+}
+
+static void remove_chunk(struct _reent * reent_ptr, malloc_chunk_t * chunk){
+	malloc_bins_t * bins = get_bins(reent_ptr);
+	malloc_free_link_t * link = get_link(chunk);
+	int bin = get_bin(chunk->header.num_chunks);
+
+	if( link->prev ){
+		get_link(get_chunk(reent_ptr, link->prev))->next = link->next;
+	} else {
+		bins->head[bin] = link->next;
+		if( link->next == 0 ){
+			bins->bitmap &= ~(1<<bin);
+		}
+	}
+
+	if( link->next ){
+		get_link(get_chunk(reent_ptr, link->next))->prev = link->prev;
+	}
+}
+
+void malloc_bins_init(struct _reent * reent_ptr){
+	malloc_chunk_t * chunk = get_base(reent_ptr);
+	malloc_bins_t * bins = get_bins(reent_ptr);
+
+	//the first chunk is reserved for the bins and is never freed
+	chunk->header.task_id = 0;
+	chunk->header.num_chunks = 1;
+	chunk->header.actual_size = sizeof(malloc_bins_t);
+#if MALLOC_USE_PROFILER
+	chunk->header.caller = 0;
+#endif
+	cortexm_assign_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t));
+	memset(bins, 0, sizeof(malloc_bins_t));
+}
+
+malloc_chunk_t * malloc_bins_find(struct _reent * reent_ptr, u16 num_chunks){
+	malloc_bins_t * bins = get_bins(reent_ptr);
+	malloc_chunk_t * chunk;
+	int bin;
+	u32 mask;
+	u16 index;
+
+	//any chunk in a bin above floor(log2(num_chunks)) is big enough (unless num_chunks is a power of 2)
+	bin = get_bin(num_chunks);
+	if( (num_chunks & (num_chunks - 1)) == 0 ){
+		mask = bins->bitmap & ~((1<<bin) - 1);
+	} else {
+		mask = bins->bitmap & ~((2<<bin) - 1);
+	}
+
+	if( mask ){
+		chunk = get_chunk(reent_ptr, bins->head[__builtin_ctz(mask)]);
+		if( malloc_chunk_is_free(chunk) != 1 ){
+			return NULL;
+		}
+		remove_chunk(reent_ptr, chunk);
+		return chunk;
+	}
+
+	//fall back to checking the chunks in the same size class before asking for more memory
+	for(index = bins->head[bin]; index != 0; index = get_link(chunk)->next){
+		chunk = get_chunk(reent_ptr, index);
+		if( malloc_chunk_is_free(chunk) != 1 ){
+			return NULL;
+		}
+		if( chunk->header.num_chunks >= num_chunks ){
+			remove_chunk(reent_ptr, chunk);
+			return chunk;
+		}
+	}
+
+	return NULL;
+}
+
+void malloc_bins_split(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks){
+	malloc_chunk_t * next;
+
+	if( chunk->header.num_chunks > num_chunks ){
+		//the chunk after the remainder is already marked as following a free chunk
+		next = chunk + num_chunks;
+		malloc_set_chunk_free(next, chunk->header.num_chunks - num_chunks);
+		insert_chunk(reent_ptr, next);
+	} else {
+		set_prev_free(chunk + chunk->header.num_chunks, 0);
+	}
+}
+
+malloc_chunk_t * malloc_bins_free(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks, int is_prev_free){
+	malloc_chunk_t * next;
+	malloc_chunk_t * prev;
+
+	next = chunk + num_chunks;
+	if( (next->header.num_chunks != 0) && (malloc_chunk_is_free(next) == 1) ){
+		remove_chunk(reent_ptr, next);
+		num_chunks += next->header.num_chunks;
+	}
+
+	if( is_prev_free ){
+		prev = chunk - *((u16*)chunk - 1);
+		if( malloc_chunk_is_free(prev) != 1 ){
+			return NULL;
+		}
+		remove_chunk(reent_ptr, prev);
+		num_chunks += prev->header.num_chunks;
+		chunk = prev;
+	}
+
+	malloc_set_chunk_free(chunk, num_chunks);
+	insert_chunk(reent_ptr, chunk);
+	set_prev_free(chunk + num_chunks, 1);
+	return chunk;
+}
+
+malloc_chunk_t * malloc_bins_resize(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks, u32 actual_size){
+	malloc_chunk_t * next;
+	malloc_chunk_t * prev;
+	u16 total_chunks = chunk->header.num_chunks;
+	u16 next_chunks = 0;
+	u32 copy_size;
+	int is_prev_free = chunk->header.task_id & MALLOC_TASK_ID_PREV_FREE;
+
+	next = chunk + total_chunks;
+	if( (next->header.num_chunks != 0) && (malloc_chunk_is_free(next) == 1) ){
+		next_chunks = next->header.num_chunks;
+	}
+
+	if( num_chunks > total_chunks + next_chunks ){
+		//try to grow backward into the free chunk before this one
+		if( is_prev_free == 0 ){
+			return NULL;
+		}
+		prev = chunk - *((u16*)chunk - 1);
+		if( (malloc_chunk_is_free(prev) != 1) ||
+			 (prev->header.num_chunks + total_chunks + next_chunks < num_chunks) ){
+			return NULL;
+		}
+
+		copy_size = chunk->header.actual_size;
+		if( copy_size > actual_size ){
+			copy_size = actual_size;
+		}
+
+		remove_chunk(reent_ptr, prev);
+		if( next_chunks ){
+			remove_chunk(reent_ptr, next);
+		}
+		total_chunks += prev->header.num_chunks + next_chunks;
+		memmove(prev->memory, chunk->memory, copy_size);
+		chunk = prev;
+		//free chunks are always merged so the chunk before prev is in use
+		is_prev_free = 0;
+	} else if( num_chunks > total_chunks ){
+		remove_chunk(reent_ptr, next);
+		total_chunks += next_chunks;
+	}
+
+	malloc_set_chunk_used(reent_ptr, chunk, num_chunks, actual_size);
+	set_prev_free(chunk, is_prev_free);
+
+	if( total_chunks > num_chunks ){
+		malloc_bins_free(reent_ptr, chunk + num_chunks, total_chunks - num_chunks, 0);
+	} else {
+		set_prev_free(chunk + total_chunks, 0);
+	}
+	return chunk;
+}
+
+malloc_chunk_t * malloc_bins_release_last(struct _reent * reent_ptr, malloc_chunk_t * last_chunk){
+	malloc_chunk_t * chunk;
+
+	if( (last_chunk->header.task_id & MALLOC_TASK_ID_PREV_FREE) == 0 ){
+		return NULL;
+	}
+
+	chunk = last_chunk - *((u16*)last_chunk - 1);
+	if( malloc_chunk_is_free(chunk) != 1 ){
+		return NULL;
+	}
+
+	remove_chunk(reent_ptr, chunk);
+	return chunk;
+}
+
+#endif
@@ -33,12 +33,16 @@
 #include <string.h>
 #include "mcu/mcu.h"
 #include "cortexm/task.h"
+#include "sos/dev/sys.h"
 
 
 typedef struct MCU_PACK {
 	u16 task_id;
 	u16 num_chunks;
 	u32 actual_size;
+#if MALLOC_USE_PROFILER
+	u32 caller;
+#endif
 	u32 checksum;
 } malloc_chunk_header_t;
 
@@ -49,11 +53,37 @@ typedef struct {
 	char memory[MALLOC_DATA_SIZE];
 } malloc_chunk_t;
 
+//set in the chunk following a free chunk when using MALLOC_USE_FREE_LIST_BINS
+#define MALLOC_TASK_ID_PREV_FREE 0x8000
+#define MALLOC_TASK_ID_MASK 0x7FFF
+
+#define MALLOC_BIN_COUNT 16
+
+typedef struct MCU_PACK {
+	u32 bitmap /*! Bit n is set if head[n] has chunks */;
+	u16 head[MALLOC_BIN_COUNT] /*! Chunk index of the first free chunk with 2^n to 2^(n+1)-1 chunks (0 if empty) */;
+} malloc_bins_t;
+
+typedef struct MCU_PACK {
+	u16 next;
+	u16 prev;
+} malloc_free_link_t;
+
 void malloc_set_chunk_used(struct _reent * reent, malloc_chunk_t * chunk, u16 num_chunks, u32 actual_size);
 void malloc_set_chunk_free(malloc_chunk_t * chunk, u16 num_chunks);
 int malloc_chunk_is_free(malloc_chunk_t * chunk);
 u16 malloc_calc_num_chunks(u32 size);
 malloc_chunk_t * malloc_chunk_from_addr(void * addr);
+int malloc_extend_heap(struct _reent * reent_ptr, u32 size);
+void malloc_set_chunk_caller(malloc_chunk_t * chunk, void * caller);
+int malloc_get_heap_info(struct _reent * reent_ptr, sys_heapinfo_t * info);
+
+void malloc_bins_init(struct _reent * reent_ptr);
+malloc_chunk_t * malloc_bins_find(struct _reent * reent_ptr, u16 num_chunks);
+void malloc_bins_split(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks);
+malloc_chunk_t * malloc_bins_free(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks, int is_prev_free);
+malloc_chunk_t * malloc_bins_resize(struct _reent * reent_ptr, malloc_chunk_t * chunk, u16 num_chunks, u32 actual_size);
+malloc_chunk_t * malloc_bins_release_last(struct _reent * reent_ptr, malloc_chunk_t * last_chunk);
 
 void malloc_free_task_r(struct _reent * reent_ptr, int task_id);
 
@@ -0,0 +1,138 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Heap profiling
+ *
+ * Nothing is recorded while allocating except (with MALLOC_USE_PROFILER) the
+ * caller of each allocation, which is kept in the chunk header. The size
+ * histogram, per-caller live bytes and the fragmentation are computed when a
+ * snapshot is requested by walking the heap, so the cost is only paid by the
+ * task asking for the snapshot.
+ *
+ */
+
+#include "sys/malloc/malloc_local.h"
+#include "cortexm/cortexm.h"
+
+static int get_histogram_index(u32 size);
+#if MALLOC_USE_PROFILER
+static void add_caller(sys_heapinfo_t * info, u32 address, u32 size);
+#endif
+
+#if MALLOC_USE_PROFILER
+void malloc_set_chunk_caller(malloc_chunk_t * chunk, void * caller){
+	chunk->header.caller = (u32)caller;
+	cortexm_assign_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t));
+}
+#endif
+
+int malloc_get_heap_info(struct _reent * reent_ptr, sys_heapinfo_t * info){
+	malloc_chunk_t * chunk;
+	malloc_chunk_t * end;
+	u32 tid = info->tid;
+	u32 chunk_size;
+
+	memset(info, 0, sizeof(sys_heapinfo_t));
+	info->tid = tid;
+#if MALLOC_USE_PROFILER
+	info->o_flags = SYS_HEAP_FLAG_IS_PROFILER;
+#endif
+
+	if( (reent_ptr == NULL) ||
+		 (reent_ptr->procmem_base == NULL) ||
+		 (reent_ptr->procmem_base->size == 0) ){
+		return 0;
+	}
+
+	chunk = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+	//the walk never goes past the memory given to the heap even if the terminating chunk is missing
+	end = (malloc_chunk_t *)((char*)chunk + reent_ptr->procmem_base->size);
+#if MALLOC_USE_FREE_LIST_BINS
+	//the first chunk holds the free list bins
+	chunk++;
+#endif
+
+	while( (chunk < end) && (chunk->header.num_chunks != 0) ){
+		//the heap belongs to another task that may be using it -- don't fault on a bad checksum
+		if( cortexm_verify_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t)) == 0 ){
+			errno = EAGAIN;
+			return -1;
+		}
+
+		if( chunk + chunk->header.num_chunks > end ){
+			errno = EAGAIN;
+			return -1;
+		}
+
+		chunk_size = chunk->header.num_chunks * MALLOC_CHUNK_SIZE;
+		info->size += chunk_size;
+		if( chunk->header.actual_size == 0 ){
+			info->free_count++;
+			info->free_size += chunk_size;
+			if( chunk_size > info->largest_free_size ){
+				info->largest_free_size = chunk_size;
+			}
+		} else {
+			info->used_count++;
+			info->used_size += chunk->header.actual_size;
+			info->histogram[ get_histogram_index(chunk->header.actual_size) ]++;
+#if MALLOC_USE_PROFILER
+			add_caller(info, chunk->header.caller, chunk->header.actual_size);
+#endif
+		}
+		chunk += chunk->header.num_chunks;
+	}
+
+	if( info->free_size ){
+		info->fragmentation = 1000 - (u32)(((u64)info->largest_free_size * 1000) / info->free_size);
+	}
+
+	return 0;
+}
+
+int get_histogram_index(u32 size){
+	//2^(n+3) to 2^(n+4)-1 bytes
+	int index = 31 - __builtin_clz(size) - 3;
+	if( index < 0 ){
+		return 0;
+	}
+	if( index >= SYS_HEAP_HISTOGRAM_COUNT ){
+		return SYS_HEAP_HISTOGRAM_COUNT-1;
+	}
+	return index;
+}
+
+#if MALLOC_USE_PROFILER
+void add_caller(sys_heapinfo_t * info, u32 address, u32 size){
+	int i;
+	for(i=0; i < SYS_HEAP_CALLER_COUNT; i++){
+		if( info->caller[i].count == 0 ){
+			info->caller[i].address = address;
+		}
+
+		if( info->caller[i].address == address ){
+			info->caller[i].count++;
+			info->caller[i].live_bytes += size;
+			return;
+		}
+	}
+	info->other_caller_live_bytes += size;
+}
+#endif
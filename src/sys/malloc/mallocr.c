@@ -36,6 +36,9 @@ static void cleanup_memory(struct _reent * reent_ptr, int release_extra_memory);
 static int get_more_memory(struct _reent * reent_ptr, u32 size, int is_new_heap);
 static malloc_chunk_t * find_free_chunk(struct _reent * reent_ptr, u32 num_chunks);
 static int is_memory_corrupt(struct _reent * reent_ptr);
+#if MALLOC_USE_FREE_LIST_BINS
+static malloc_chunk_t * get_last_chunk(struct _reent * reent_ptr);
+#endif
 
 
 void malloc_process_fault(void * loc);
@@ -50,7 +53,17 @@ u16 malloc_calc_num_chunks(u32 size){
 	return num_chunks;
 }
 
+#if MALLOC_USE_FREE_LIST_BINS
+malloc_chunk_t * get_last_chunk(struct _reent * reent_ptr){
+	//there is always MALLOC_SBRK_JUMP_SIZE bytes at the end of the heap after the last chunk
+	return (malloc_chunk_t *)((char*)&(reent_ptr->procmem_base->base) + reent_ptr->procmem_base->size - MALLOC_SBRK_JUMP_SIZE);
+}
+#endif
+
 malloc_chunk_t * find_free_chunk(struct _reent * reent_ptr, u32 num_chunks){
+#if MALLOC_USE_FREE_LIST_BINS
+	return malloc_bins_find(reent_ptr, num_chunks);
+#else
 	int loop_count = 0;
 	int is_free;
 	malloc_chunk_t * chunk = (malloc_chunk_t *) &(reent_ptr->procmem_base->base);
@@ -71,6 +84,7 @@ malloc_chunk_t * find_free_chunk(struct _reent * reent_ptr, u32 num_chunks){
 
 	//No block found to fit size
 	return NULL;
+#endif
 }
 
 
@@ -89,6 +103,19 @@ int is_memory_corrupt(struct _reent * reent_ptr){
 }
 
 void cleanup_memory(struct _reent * reent_ptr, int release_extra_memory){
+#if MALLOC_USE_FREE_LIST_BINS
+	malloc_chunk_t * last_chunk_if_free;
+
+	//free chunks are merged when they are freed -- the last free chunk just needs to be given back
+	if( release_extra_memory ){
+		last_chunk_if_free = malloc_bins_release_last(reent_ptr, get_last_chunk(reent_ptr));
+		if( last_chunk_if_free != 0 ){
+			ptrdiff_t size = -1*(last_chunk_if_free->header.num_chunks * MALLOC_CHUNK_SIZE);
+			_sbrk_r(reent_ptr, size);
+			set_last_chunk(last_chunk_if_free);
+		}
+	}
+#else
 	malloc_chunk_t * current;
 	malloc_chunk_t * next;
 	int next_free;
@@ -127,7 +154,7 @@ void cleanup_memory(struct _reent * reent_ptr, int release_extra_memory){
 		_sbrk_r(reent_ptr, size);
 		set_last_chunk(last_chunk_if_free);
 	}
-
+#endif
 }
 
 malloc_chunk_t * malloc_chunk_from_addr(void * addr){
@@ -147,7 +174,7 @@ void malloc_free_task_r(struct _reent * reent_ptr, int task_id){
 
 	while( chunk->header.num_chunks != 0 ){
 		next = chunk + chunk->header.num_chunks;
-		if ( chunk->header.task_id == task_id ){
+		if ( ((chunk->header.task_id & MALLOC_TASK_ID_MASK) == task_id) && (malloc_chunk_is_free(chunk) == 0) ){
 			_free_r(reent_ptr, chunk->memory);
 		}
 		chunk = next;
@@ -217,7 +244,8 @@ void _free_r(struct _reent * reent_ptr, void * addr){
 	}
 
 	__malloc_lock(reent_ptr);
-	//check for corrupt memory
+#if !MALLOC_USE_FREE_LIST_BINS
+	//check for corrupt memory (with bins, only the chunk and its neighbors are checked)
 	if( is_memory_corrupt(reent_ptr) < 0 ){
 		mcu_debug_log_error(MCU_DEBUG_MALLOC, "Free Memory Corrupt 0x%lX", (u32)reent_ptr);
 		SOS_TRACE_CRITICAL("Heap Fault");
@@ -225,6 +253,7 @@ void _free_r(struct _reent * reent_ptr, void * addr){
 		malloc_process_fault(reent_ptr); //this will exit the process
 		return;
 	}
+#endif
 
 	tmp = (unsigned int)chunk - (unsigned int)(&(base->base));
 	if ( tmp % MALLOC_CHUNK_SIZE ){
@@ -243,8 +272,12 @@ void _free_r(struct _reent * reent_ptr, void * addr){
 	}
 
 	//mcu_debug_log_info(MCU_DEBUG_MALLOC, "f:%d 0x%X", getpid(), addr);
+#if MALLOC_USE_FREE_LIST_BINS
+	malloc_bins_free(reent_ptr, chunk, chunk->header.num_chunks, chunk->header.task_id & MALLOC_TASK_ID_PREV_FREE);
+#else
 	malloc_set_chunk_free(chunk, chunk->header.num_chunks);
 	cleanup_memory(reent_ptr, 0);
+#endif
 
 	mcu_debug_log_info(MCU_DEBUG_MALLOC, "f:%d %p %p %p", getpid(), addr, reent_ptr, _GLOBAL_REENT);
 
@@ -257,9 +290,17 @@ int get_more_memory(struct _reent * reent_ptr, u32 size, int is_new_heap){
 	malloc_chunk_t * chunk;
 	void * new_heap = 0;
 	int extra_bytes = 0;
+#if MALLOC_USE_FREE_LIST_BINS
+	u16 num_chunks;
+	int is_prev_free;
+#endif
 
 	if( is_new_heap ){
 		extra_bytes = MALLOC_SBRK_JUMP_SIZE;
+#if MALLOC_USE_FREE_LIST_BINS
+		//the first chunk holds the free list bins
+		size += MALLOC_CHUNK_SIZE;
+#endif
 	}
 
 	//jump as size but round up to a multiple of MALLOC_SBRK_JUMP_SIZE
@@ -281,12 +322,38 @@ int get_more_memory(struct _reent * reent_ptr, u32 size, int is_new_heap){
 			 */
 			chunk = new_heap - MALLOC_SBRK_JUMP_SIZE;
 		}
+#if MALLOC_USE_FREE_LIST_BINS
+		num_chunks = jump_size / MALLOC_CHUNK_SIZE;
+		if( is_new_heap ){
+			malloc_bins_init(reent_ptr);
+			chunk++;
+			num_chunks--;
+			is_prev_free = 0;
+		} else {
+			//chunk is the old last chunk -- the new memory merges with a free chunk before it
+			is_prev_free = chunk->header.task_id & MALLOC_TASK_ID_PREV_FREE;
+		}
+		set_last_chunk(chunk + num_chunks);
+		malloc_bins_free(reent_ptr, chunk, num_chunks, is_prev_free);
+#else
 		malloc_set_chunk_free(chunk, jump_size / MALLOC_CHUNK_SIZE);
 		set_last_chunk(chunk + chunk->header.num_chunks); //mark the last block (heap should have extra room for this)
+#endif
 	}
 	return 0;
 }
 
+int malloc_extend_heap(struct _reent * reent_ptr, u32 size){
+	//the new memory is added as a free chunk after the current last chunk
+	if( get_more_memory(reent_ptr, size, 0) < 0 ){
+		return -1;
+	}
+#if !MALLOC_USE_FREE_LIST_BINS
+	cleanup_memory(reent_ptr, 0);
+#endif
+	return 0;
+}
+
 int malloc_is_memory_corrupt(struct _reent * reent_ptr){
 	int is_free;
 	if( reent_ptr == NULL ){
@@ -311,7 +378,9 @@ void * _malloc_r(struct _reent * reent_ptr, size_t size){
 	void * alloc;
 	u16 num_chunks;
 	malloc_chunk_t * chunk;
+#if !MALLOC_USE_FREE_LIST_BINS
 	malloc_chunk_t * next;
+#endif
 	alloc = NULL;
 
 	mcu_debug_log_info(MCU_DEBUG_MALLOC, "%s():%d->", __FUNCTION__, __LINE__);
@@ -367,6 +436,10 @@ void * _malloc_r(struct _reent * reent_ptr, size_t size){
 
 		} else {
 
+#if MALLOC_USE_FREE_LIST_BINS
+			//the remainder of the chunk goes back to the bins
+			malloc_bins_split(reent_ptr, chunk, num_chunks);
+#else
 			//See if the memory will fit in this chunk
 			if ( chunk->header.num_chunks > num_chunks ){
 				next = chunk + (num_chunks);
@@ -377,7 +450,12 @@ void * _malloc_r(struct _reent * reent_ptr, size_t size){
 				mcu_debug_log_info(MCU_DEBUG_MALLOC, "ENOMEM %s():%d<-", __FUNCTION__, __LINE__);
 				return NULL;
 			}
+#endif
 			malloc_set_chunk_used(reent_ptr, chunk, num_chunks, size);
+#if MALLOC_USE_PROFILER
+			//malloc() tail calls _malloc_r() so this is where malloc() was called
+			malloc_set_chunk_caller(chunk, __builtin_return_address(0));
+#endif
 			alloc = chunk->memory;
 		}
 	} while(alloc == NULL);
@@ -111,24 +111,44 @@
 struct message {
 	int prio;
 	int size;
-	int age;
+	int next; //index of the next message in the priority list or the free list
 	//! \todo Add a checksum to the message -- generate on send and check on receive
 };
 
+/*
+ * The free messages are in a list. The messages in the queue are in
+ * a FIFO list for each priority. The bitmap has a bit set for each priority that
+ * has messages so finding the oldest, highest priority message is a CLZ.
+ * Sending and receiving don't depend on the depth of the queue.
+ *
+ */
+#define MQ_NO_MESSAGE (-1)
+#define MQ_LENT_MESSAGE (-2) //reserved by a sender or borrowed by a receiver
+
+typedef struct {
+	int16_t head; //the oldest message -- next to be received
+	int16_t tail; //the newest message
+} mq_fifo_t;
+
 #define MQ_STATUS_REFS_MASK (0xFFFF)
 #define MQ_STATUS_UNLINK_ON_CLOSE_MASK (1<<16)
 #define MQ_STATUS_NONBLOCK_MASK (1<<17)
 #define MQ_STATUS_RDWR_MASK (1<<18)
 #define MQ_STATUS_LOOP_MASK (1<<19)
 
+#define MQ_MAX_MSGS INT16_MAX
+#define MQ_MAX_SIZE INT16_MAX
+
 typedef struct {
 	size_t max_size; //maximum message size
 	size_t max_msgs; //maximum number of messages
-	size_t age; //The running age -- 0 is the oldest message
+	size_t cur_msgs; //number of messages in the queue
 	int mode; //not currently implemented
 	char name[NAME_MAX]; //The name of the queue
-	struct message * msg_table; //a pointer to the message table
+	sos_pool_t msg_pool; //the free messages (memory is null if the queue isn't in use)
 	uint32_t status; //how many tasks are accessing the message queue, other flags
+	uint32_t prio_bitmap; //bit n is set if prio_list[n] has messages
+	mq_fifo_t prio_list[MQ_PRIO_MAX];
 	pthread_mutex_t mutex;
 } mq_t;
 
@@ -139,49 +159,35 @@ typedef struct {
 
 static mq_list_t * mq_first = 0;
 
+#define MQ_POOL_GROW_COUNT 4
+static sos_pool_t mq_pool = SOS_POOL_INITIALIZER(sizeof(mq_list_t));
+
 //static void root_send(void * args) MCU_ROOT_EXEC_CODE;
 //static void root_receive(void * args) MCU_ROOT_EXEC_CODE;
 static void svcall_wake_blocked(void * args) MCU_ROOT_EXEC_CODE;
 static void svcall_block_on_mq(void * args) MCU_ROOT_EXEC_CODE;
+static void svcall_lend_message(void * args) MCU_ROOT_EXEC_CODE;
+static void root_wake_blocked(void * block) MCU_ROOT_EXEC_CODE;
 
 
-static int mq_entry_size(const mq_t * mq){
-	return sizeof(struct message) + mq->max_size;
-}
-
-static struct message * mq_next_message(const struct message * msg, int entry_size){
-	const void * ptr;
-	ptr = msg + entry_size;
-	return (struct message *)ptr;
+static struct message * mq_get_message(const mq_t * mq, int index){
+	void * ptr = mq->msg_pool.memory;
+	return ptr + index * mq->msg_pool.object_size;
 }
 
 
 static mq_t * mq_find_named(const char * name){
 	mq_list_t * entry;
 	for(entry = mq_first; entry != 0; entry = entry->next){
-		if( entry->mq.msg_table != 0 ){
-			if( strncmp(entry->mq.name, name, NAME_MAX) == 0 ){
-				return &entry->mq;
-			}
+		if( strncmp(entry->mq.name, name, NAME_MAX) == 0 ){
+			return &entry->mq;
 		}
 	}
 	return 0;
 }
 
 static ssize_t mq_cur_msgs(const mq_t * mq){
-	ssize_t i;
-	ssize_t count = 0;
-
-	struct message * imsg = mq->msg_table;
-	int entry_size = mq_entry_size(mq);
-
-	for(i=0; i < mq->max_msgs; i++){
-		if( imsg->size != 0 ){
-			count++;
-		}
-		imsg = mq_next_message(imsg, entry_size);
-	}
-	return count;
+	return mq->cur_msgs;
 }
 
 static void * mq_message_data(struct message * msg){
@@ -189,87 +195,126 @@ static void * mq_message_data(struct message * msg){
 	return ptr + sizeof(struct message);
 }
 
-static mq_t * mq_find_free(){
-	mq_list_t * entry;
+static mq_t * mq_alloc(){
 	mq_list_t * new_entry;
-	mq_list_t * last_entry;
-	last_entry = 0;
-	for(entry = mq_first; entry != 0; entry = entry->next){
-		last_entry = entry;
-		if( entry->mq.msg_table == 0 ){
-			return &entry->mq;
-		}
-	}
 
-	//no free message queues
-	new_entry = _malloc_r(sos_task_table[0].global_reent, sizeof(mq_list_t));
+	//the list only has queues that are in use
+	new_entry = sos_pool_alloc_kernel(&mq_pool, MQ_POOL_GROW_COUNT);
 	if( new_entry == 0 ){
 		return 0;
 	}
 
-	if( last_entry == 0 ){
-		mq_first = new_entry;
-	} else {
-		last_entry->next = new_entry;
-	}
-	new_entry->next = 0;
+	memset(&new_entry->mq, 0, sizeof(mq_t));
+	new_entry->next = mq_first;
+	mq_first = new_entry;
 	return &new_entry->mq;
 }
 
+static void mq_free(mq_t * mq){
+	mq_list_t * entry;
+	mq_list_t * prev_entry;
+
+	sos_pool_destroy_kernel(&mq->msg_pool);
+
+	prev_entry = 0;
+	for(entry = mq_first; entry != 0; entry = entry->next){
+		if( &entry->mq == mq ){
+			if( prev_entry == 0 ){
+				mq_first = entry->next;
+			} else {
+				prev_entry->next = entry->next;
+			}
+			//the entry stays in the pool so a stale descriptor can still be checked with mq_get_ptr()
+			sos_pool_free(&mq_pool, entry);
+			return;
+		}
+		prev_entry = entry;
+	}
+}
+
 static void mq_init_table(mq_t * mq){
 	int i;
-	struct message * imsg = mq->msg_table;
-	int entry_size = mq_entry_size(mq);
-	for(i=0; i < mq->max_msgs; i++){
+	struct message * imsg;
+	//every message goes back to the pool (in address order)
+	mq->msg_pool.free = 0;
+	for(i=mq->max_msgs-1; i >= 0; i--){
+		imsg = mq_get_message(mq, i);
 		imsg->size = 0;
-		imsg = mq_next_message(imsg, entry_size);
+		imsg->next = MQ_NO_MESSAGE;
+		sos_pool_free(&mq->msg_pool, imsg);
 	}
+	mq->prio_bitmap = 0;
+	mq->cur_msgs = 0;
 }
 
-static struct message * mq_find_oldest_highest(const mq_t * mq){
-	int i;
-	struct message * msg;
-	int max_prio = 0;
-	int max_age = INT_MAX;
-	struct message * imsg = mq->msg_table;
-	int entry_size = mq_entry_size(mq);
-
-	msg = 0;
-	//find the oldest, highest priority message from the queue
-	for(i=0; i < mq->max_msgs; i++ ){
-		if( imsg->size != 0 ){
-			if ( imsg->prio > max_prio ){
-				max_prio = imsg->prio;
-				max_age = imsg->age;
-				msg = imsg;
-			} else if ( imsg->prio == max_prio ){
-				if ( (imsg->age < max_age) ){
-					max_prio = imsg->prio;
-					max_age = imsg->age;
-					msg = imsg;
-				}
-			}
-		}
-		imsg = mq_next_message(imsg, entry_size);
+static int mq_find_oldest_highest(const mq_t * mq){
+	int prio;
+	if( mq->prio_bitmap == 0 ){
+		return MQ_NO_MESSAGE;
 	}
-	return msg;
+	prio = 31 - __builtin_clz(mq->prio_bitmap);
+	return mq->prio_list[prio].head;
 }
 
-static struct message * mq_find_free_msg(const mq_t * mq){
-	int i;
-	struct message * imsg = mq->msg_table;
-	int entry_size = mq_entry_size(mq);
-	for(i=0; i < mq->max_msgs; i++){
-		if( imsg->size == 0 ){
-			return imsg;
-		}
-		imsg = mq_next_message(imsg, entry_size);
+static void mq_remove_oldest_highest(mq_t * mq){
+	int prio = 31 - __builtin_clz(mq->prio_bitmap);
+	mq_fifo_t * fifo = mq->prio_list + prio;
+	fifo->head = mq_get_message(mq, fifo->head)->next;
+	if( fifo->head == MQ_NO_MESSAGE ){
+		mq->prio_bitmap &= ~(1<<prio);
 	}
+	mq->cur_msgs--;
+}
 
-	return 0;
+static void mq_insert_msg(mq_t * mq, int index){
+	struct message * msg = mq_get_message(mq, index);
+	mq_fifo_t * fifo = mq->prio_list + msg->prio;
+	msg->next = MQ_NO_MESSAGE;
+	if( mq->prio_bitmap & (1<<msg->prio) ){
+		mq_get_message(mq, fifo->tail)->next = index;
+	} else {
+		fifo->head = index;
+		mq->prio_bitmap |= (1<<msg->prio);
+	}
+	fifo->tail = index;
+	mq->cur_msgs++;
+}
+
+static int mq_get_index(const mq_t * mq, const void * msg_ptr){
+	int entry_size = mq->msg_pool.object_size;
+	int offset = (const char*)msg_ptr - (const char*)mq->msg_pool.memory - sizeof(struct message);
+	if( (offset < 0) || (offset % entry_size) || (offset / entry_size >= mq->max_msgs) ){
+		return MQ_NO_MESSAGE;
+	}
+	return offset / entry_size;
+}
+
+static int mq_alloc_msg(mq_t * mq){
+	struct message * msg = sos_pool_alloc(&mq->msg_pool);
+	if( msg == 0 ){
+		return MQ_NO_MESSAGE;
+	}
+	return ((char*)msg - (char*)mq->msg_pool.memory) / mq->msg_pool.object_size;
+}
+
+static void mq_free_msg(mq_t * mq, int index){
+	struct message * msg = mq_get_message(mq, index);
+	msg->size = 0;
+	//a free message can't be committed or released
+	msg->next = MQ_NO_MESSAGE;
+	sos_pool_free(&mq->msg_pool, msg);
 }
 
 
+//receivers block on the queue and senders block on the free messages so a wake goes to the right one
+static void * mq_receive_block(mq_t * mq){
+	return mq;
+}
+
+static void * mq_send_block(mq_t * mq){
+	return &mq->msg_pool;
+}
+
 static int mq_init_mutex(mq_t * mq){
 	pthread_mutexattr_t mutexattr;
 
@@ -322,6 +367,32 @@ typedef struct {
 	int entry_size;
 	struct message * new_msg;
 } root_send_receive_t;
+
+/*
+ * Reserving, committing, borrowing and releasing only move a message between
+ * the lists so each is done in one svcall (no thread can run in the middle of it)
+ * rather than locking and unlocking the queue mutex (a svcall each because of the
+ * priority ceiling). If a thread holds the mutex, it might be part way
+ * through sending or receiving so the mutex is used instead.
+ *
+ */
+enum {
+	MQ_LEND_RESERVE,
+	MQ_LEND_COMMIT,
+	MQ_LEND_BORROW,
+	MQ_LEND_RELEASE
+};
+
+typedef struct {
+	mq_t * mq;
+	int request;
+	int index; //the message or MQ_NO_MESSAGE if the request failed
+	int size;
+	int prio;
+	int is_busy;
+} root_lend_t;
+
+static int lend_message(root_lend_t * args);
 /*! \endcond */
 
 /*! \details This function gets the message queue attributes and stores them at \a mqstat.
@@ -416,7 +487,8 @@ int mq_setattr(mqd_t mqdes, const struct mq_attr * mqstat, struct mq_attr * omqs
  * - ENOENT:  O_CREAT is not set in \a oflag and the queue does not exist
  * - ENOMEM:  not enough memory for the queue
  * - EACCES:  permission to create \a name queue is denied
- * - EINVAL: O_CREAT is set and \a attr is not null but \a mq_maxmsg or \a mq_msgsize is less than or equal to zero
+ * - EINVAL: O_CREAT is set and \a attr is not null but \a mq_maxmsg or \a mq_msgsize is less than or equal to zero or greater than INT16_MAX
+ * (or \a mq_maxmsg is greater than INT16_MAX)
  *
  *
  */
@@ -429,7 +501,6 @@ mqd_t mq_open(const char * name /*! the full path to the message queue */,
 	mode_t mode;
 	const struct mq_attr * attr;
 	va_list ap;
-	struct _reent * reent_ptr;
 	int tmp;
 
 	if ( strnlen(name, NAME_MAX) == NAME_MAX ){
@@ -477,14 +548,13 @@ mqd_t mq_open(const char * name /*! the full path to the message queue */,
 			va_end(ap);
 
 			//check for valid message attributes
-			if ( (attr->mq_maxmsg <= 0) || (attr->mq_msgsize <= 0) ){
+			if ( (attr->mq_maxmsg <= 0) || (attr->mq_maxmsg > MQ_MAX_MSGS) || (attr->mq_msgsize <= 0) || (attr->mq_msgsize > MQ_MAX_SIZE) ){
 				errno = EINVAL;
 				return -1;
 			}
 
 			//Create the new message queue
-			reent_ptr = sos_task_table[0].global_reent;
-			new_mq = mq_find_free();
+			new_mq = mq_alloc();
 			if ( new_mq == NULL ){
 				//errno is set by malloc
 				return -1;
@@ -492,6 +562,7 @@ mqd_t mq_open(const char * name /*! the full path to the message queue */,
 
 			//initialize the mutex
 			if( mq_init_mutex(new_mq) < 0 ){
+				mq_free(new_mq);
 				return -1;
 			}
 
@@ -506,9 +577,8 @@ mqd_t mq_open(const char * name /*! the full path to the message queue */,
 				new_mq->max_size = attr->mq_msgsize;
 			}
 			new_mq->status = 1;
-			new_mq->age = 0;
-			new_mq->msg_table = _calloc_r(reent_ptr, new_mq->max_msgs , (new_mq->max_size + sizeof(struct message)) );
-			if ( new_mq->msg_table == NULL ){
+			if( sos_pool_create_kernel(&new_mq->msg_pool, sizeof(struct message) + new_mq->max_size, new_mq->max_msgs) < 0 ){
+				mq_free(new_mq);
 				return -1;
 			}
 
@@ -566,8 +636,7 @@ int mq_close(mqd_t mqdes /*! the message queue handler */){
 	if ( (mq->status & MQ_STATUS_REFS_MASK) == 0 ){
 		//Should message queue be unlinked now?
 		if ( mq->status & MQ_STATUS_UNLINK_ON_CLOSE_MASK ){
-			_free_r(sos_task_table[0].global_reent, mq->msg_table);
-			mq->msg_table = 0;
+			mq_free(mq);
 		}
 	}
 
@@ -600,8 +669,7 @@ int mq_unlink(const char * name /*! the full path to the message queue */){
 	}
 
 	if ( (mq->status & MQ_STATUS_REFS_MASK) == 0 ){
-		_free_r(sos_task_table[0].global_reent, mq->msg_table);
-		mq->msg_table = 0;
+		mq_free(mq);
 	} else {
 		//Mark the message queue for deletion when all refs are done
 		mq->status |= MQ_STATUS_UNLINK_ON_CLOSE_MASK;
@@ -616,8 +684,7 @@ void mq_discard(mqd_t mqdes){
 		return;
 	}
 
-	_free_r(sos_task_table[0].global_reent, mq->msg_table);
-	mq->msg_table = 0;
+	mq_free(mq);
 }
 
 void mq_flush(mqd_t mqdes){
@@ -714,6 +781,7 @@ ssize_t mq_timedreceive(mqd_t mqdes /*! see \ref mq_receive() */,
 								const struct timespec * abs_timeout /*! the absolute timeout value */){
 
 	struct message * new_msg;
+	int index;
 	int size;
 
 	mq_t * mq = mq_get_ptr(mqdes);
@@ -726,8 +794,9 @@ ssize_t mq_timedreceive(mqd_t mqdes /*! see \ref mq_receive() */,
 		if( pthread_mutex_lock(&(mq->mutex)) < 0 ){
 			return -1;
 		}
-		new_msg = mq_find_oldest_highest(mq);
-		if ( new_msg != 0 ){
+		index = mq_find_oldest_highest(mq);
+		if ( index != MQ_NO_MESSAGE ){
+			new_msg = mq_get_message(mq, index);
 
 			//calculate the pointer to the entry
 			//Mark message as retrieved
@@ -744,7 +813,8 @@ ssize_t mq_timedreceive(mqd_t mqdes /*! see \ref mq_receive() */,
 
 				//Remove the message from the queue
 				size = new_msg->size;
-				new_msg->size = 0;
+				mq_remove_oldest_highest(mq);
+				mq_free_msg(mq, index);
 
 			}
 		} else {
@@ -758,13 +828,13 @@ ssize_t mq_timedreceive(mqd_t mqdes /*! see \ref mq_receive() */,
 				errno = EAGAIN;
 				return -1;
 			}
-			size = block_on_mq(mq, abs_timeout);
+			size = block_on_mq(mq_receive_block(mq), abs_timeout);
 		}
 	} while( size == 0 ); //wait for either a successful receive or an error
 
 	if( size > 0 ){
 		//message was successfully received -- now see if any threads are blocked trying to send to this queue
-		check_for_blocked_task(mq);
+		check_for_blocked_task(mq_send_block(mq));
 	}
 
 	return size;
@@ -781,6 +851,7 @@ ssize_t mq_timedreceive(mqd_t mqdes /*! see \ref mq_receive() */,
  * - EAGAIN:  no room on the queue and O_NONBLOCK is set in the descriptor flags
  * - EIO:  I/O error while accessing the queue
  * - EBADF: \a mqdes is not a valid message queue descriptor
+ * - EINVAL: \a msg_prio is not less than MQ_PRIO_MAX or \a msg_len is zero
  *
  */
 int mq_send(mqd_t mqdes /*! the message queue handle */,
@@ -849,6 +920,7 @@ void root_send(void * args){
  * - EIO:  I/O error while accessing the queue
  * - ETIMEDOUT:  \a abs_timeout was exceeded by \a CLOCK_REALTIME
  * - EBADF: \a mqdes is not a valid message queue descriptor
+ * - EINVAL: \a msg_prio is not less than MQ_PRIO_MAX or \a msg_len is zero
  *
  */
 int mq_timedsend(mqd_t mqdes /*! see \ref mq_send() */,
@@ -859,6 +931,7 @@ int mq_timedsend(mqd_t mqdes /*! see \ref mq_send() */,
 
 	mq_t * mq;
 	int size;
+	int index;
 	struct message * new_msg;
 
 	mq = mq_get_ptr(mqdes);
@@ -875,6 +948,12 @@ int mq_timedsend(mqd_t mqdes /*! see \ref mq_send() */,
 			return -1;
 		}
 
+		//an empty message can't be told apart from a free one
+		if( (msg_prio >= MQ_PRIO_MAX) || (msg_len == 0) ){
+			errno = EINVAL;
+			return -1;
+		}
+
 		do {
 
 			if( pthread_mutex_lock(&(mq->mutex)) < 0 ){
@@ -884,21 +963,25 @@ int mq_timedsend(mqd_t mqdes /*! see \ref mq_send() */,
 			//if this stays 0, there is no room for a message
 			size = 0;
 
-			new_msg = mq_find_free_msg(mq);
+			index = mq_alloc_msg(mq);
 
-			if( new_msg != 0 ){
+			if( index != MQ_NO_MESSAGE ){
 				size = msg_len;
 			} else if( (mq->status & MQ_STATUS_LOOP_MASK) != 0 ){
 				//if mq is full, discard the oldest message
-				new_msg = mq_find_oldest_highest(mq);
-				size = msg_len;
+				index = mq_find_oldest_highest(mq);
+				if( index != MQ_NO_MESSAGE ){
+					mq_remove_oldest_highest(mq);
+					size = msg_len;
+				}
 			}
 
 			if( size > 0 ){
+				new_msg = mq_get_message(mq, index);
 				memcpy(mq_message_data(new_msg), msg_ptr, msg_len);
 				new_msg->size = msg_len;
-				new_msg->age = mq->age++;
 				new_msg->prio = msg_prio;
+				mq_insert_msg(mq, index);
 			}
 
 			if( pthread_mutex_unlock(&(mq->mutex)) < 0 ){
@@ -911,15 +994,15 @@ int mq_timedsend(mqd_t mqdes /*! see \ref mq_send() */,
 					errno = EAGAIN;
 					size = -1;
 				} else {
-					size = block_on_mq(mq, abs_timeout);
+					size = block_on_mq(mq_send_block(mq), abs_timeout);
 				}
 			}
 
 		} while( size  == 0 );
 
 		if( size > 0 ){
-			//message was successfully sent -- now see if any threads are blocked trying to send to this queue
-			check_for_blocked_task(mq);
+			//message was successfully sent -- now see if any threads are blocked trying to receive from this queue
+			check_for_blocked_task(mq_receive_block(mq));
 		}
 		return size;
 	}
@@ -942,7 +1025,332 @@ int mq_trysend(mqd_t mqdes, const char * msg_ptr, size_t msg_len, unsigned msg_p
 	return mq_timedsend(mqdes, msg_ptr, msg_len, msg_prio, &abs_timeout);
 }
 
+/*! \details This function reserves a message in the queue so that
+ * the caller can write the message in place (rather than having mq_send()
+ * copy it). The message is sent using mq_commit().
+ *
+ * This is the same as mq_timedreserve() with no timeout.
+ *
+ */
+void * mq_reserve(mqd_t mqdes){
+	return mq_timedreserve(mqdes, NULL);
+}
+
+/*! \details This function reserves a message in the queue and returns a pointer
+ * to the message data (\a mq_msgsize bytes). If there is no room in the queue
+ * (and O_NONBLOCK is not set in \a mqdes), the thread is blocked until a message
+ * is released or until the value of \a CLOCK_REALTIME exceeds \a abs_timeout.
+ *
+ * The message must be passed to mq_commit() to either send it or cancel the
+ * reservation.
+ *
+ * \return A pointer to the message data or NULL with errno (see \ref errno) set to:
+ * - EAGAIN:  no room on the queue and O_NONBLOCK is set in the descriptor flags
+ * - ETIMEDOUT:  \a abs_timeout was exceeded by \a CLOCK_REALTIME
+ * - EACCES: \a mqdes is not open for writing
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+void * mq_timedreserve(mqd_t mqdes, const struct timespec * abs_timeout){
+	mq_t * mq;
+	root_lend_t args;
+
+	mq = mq_get_ptr(mqdes);
+	if( mq == 0 ){
+		return 0;
+	}
+
+	if( (mq->status & MQ_STATUS_RDWR_MASK) == 0 ){
+		errno = EACCES;
+		return 0;
+	}
+
+	args.mq = mq;
+	args.request = MQ_LEND_RESERVE;
+	do {
+		if( lend_message(&args) < 0 ){
+			return 0;
+		}
+
+		if( args.index == MQ_NO_MESSAGE ){
+			if ( mq->status & MQ_STATUS_NONBLOCK_MASK ){
+				errno = EAGAIN;
+				return 0;
+			}
+
+			if( block_on_mq(mq_send_block(mq), abs_timeout) < 0 ){
+				return 0;
+			}
+		}
+
+	} while( args.index == MQ_NO_MESSAGE );
+
+	return mq_message_data(mq_get_message(mq, args.index));
+}
+
+/*! \details This function sends a message that was reserved using mq_reserve()
+ * and written in place. If \a msg_len is zero, the reservation is cancelled
+ * and the message is not sent.
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL: \a msg_ptr is not a reserved message or \a msg_prio is not less than MQ_PRIO_MAX
+ * - EMSGSIZE: \a msg_len is greater than the message size of the queue
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+int mq_commit(mqd_t mqdes /*! the message queue handle */,
+				  void * msg_ptr /*! the pointer returned by mq_reserve() */,
+				  size_t msg_len /*! the number of bytes written to \a msg_ptr */,
+				  unsigned msg_prio /*! the priority of the message (see MQ_PRIO_MAX) */){
+	mq_t * mq;
+	root_lend_t args;
+
+	mq = mq_get_ptr(mqdes);
+	if( mq == 0 ){
+		return -1;
+	}
+
+	if( mq->max_size < msg_len ){
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	if( msg_prio >= MQ_PRIO_MAX ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	args.index = mq_get_index(mq, msg_ptr);
+	if( args.index == MQ_NO_MESSAGE ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	//a sent message wakes a receiver and a cancelled one wakes a sender
+	args.mq = mq;
+	args.request = MQ_LEND_COMMIT;
+	args.size = msg_len;
+	args.prio = msg_prio;
+	if( lend_message(&args) < 0 ){
+		return -1;
+	}
+
+	if( args.index == MQ_NO_MESSAGE ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*! \details This function borrows the oldest, highest priority message from
+ * the queue so that the caller can read it in place (rather than having mq_receive()
+ * copy it). The message is removed from the queue but is not available
+ * to senders until it is returned using mq_release().
+ *
+ * This is the same as mq_timedborrow() with no timeout.
+ *
+ */
+void * mq_borrow(mqd_t mqdes, size_t * msg_len, unsigned * msg_prio){
+	return mq_timedborrow(mqdes, msg_len, msg_prio, NULL);
+}
+
+/*! \details This function borrows a message from the queue and returns
+ * a pointer to the message data. If no messages are available, the thread is blocked
+ * until either a messsage is available or the value of \a CLOCK_REALTIME is less then \a abs_timeout.
+ *
+ * The message must be passed to mq_release() when the caller is done with it.
+ *
+ * \return A pointer to the message data or NULL with errno (see \ref errno) set to:
+ * - EAGAIN:  no message on the queue and O_NONBLOCK is set in the descriptor flags
+ * - ETIMEDOUT:  \a abs_timeout was exceeded by \a CLOCK_REALTIME
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+void * mq_timedborrow(mqd_t mqdes /*! the message queue handle */,
+							 size_t * msg_len /*! if not NULL, the size of the message is stored here */,
+							 unsigned * msg_prio /*! if not NULL, the priority of the message is stored here */,
+							 const struct timespec * abs_timeout /*! the absolute timeout value */){
+	mq_t * mq;
+	root_lend_t args;
+
+	mq = mq_get_ptr(mqdes);
+	if( mq == 0 ){
+		return 0;
+	}
+
+	args.mq = mq;
+	args.request = MQ_LEND_BORROW;
+	do {
+		if( lend_message(&args) < 0 ){
+			return 0;
+		}
+
+		if( args.index == MQ_NO_MESSAGE ){
+			if( mq->status & MQ_STATUS_NONBLOCK_MASK ){
+				errno = EAGAIN;
+				return 0;
+			}
+
+			if( block_on_mq(mq_receive_block(mq), abs_timeout) < 0 ){
+				return 0;
+			}
+		}
+
+	} while( args.index == MQ_NO_MESSAGE );
+
+	if( msg_len != 0 ){
+		*msg_len = args.size;
+	}
+	if( msg_prio != 0 ){
+		*msg_prio = args.prio;
+	}
+	return mq_message_data(mq_get_message(mq, args.index));
+}
+
+/*! \details This function returns a message that was borrowed using mq_borrow()
+ * to the queue so that it can be used by senders.
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL: \a msg_ptr is not a borrowed message
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+int mq_release(mqd_t mqdes, void * msg_ptr){
+	mq_t * mq;
+	root_lend_t args;
+
+	mq = mq_get_ptr(mqdes);
+	if( mq == 0 ){
+		return -1;
+	}
+
+	args.index = mq_get_index(mq, msg_ptr);
+	if( args.index == MQ_NO_MESSAGE ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	//the message is free -- a thread blocked trying to send to this queue is woken
+	args.mq = mq;
+	args.request = MQ_LEND_RELEASE;
+	if( lend_message(&args) < 0 ){
+		return -1;
+	}
+
+	if( args.index == MQ_NO_MESSAGE ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
 /*! \cond */
+//moves a lent message and returns the object to wake (or zero) -- the caller has the queue to itself
+static void * update_lent_message(root_lend_t * p){
+	mq_t * mq = p->mq;
+	struct message * msg;
+
+	switch(p->request){
+		case MQ_LEND_RESERVE:
+			p->index = mq_alloc_msg(mq);
+			if( (p->index == MQ_NO_MESSAGE) && ((mq->status & MQ_STATUS_LOOP_MASK) != 0) ){
+				//if mq is full, discard the oldest message
+				p->index = mq_find_oldest_highest(mq);
+				if( p->index != MQ_NO_MESSAGE ){
+					mq_remove_oldest_highest(mq);
+				}
+			}
+			if( p->index != MQ_NO_MESSAGE ){
+				msg = mq_get_message(mq, p->index);
+				msg->size = 0;
+				msg->next = MQ_LENT_MESSAGE;
+			}
+			return 0;
+
+		case MQ_LEND_COMMIT:
+			msg = mq_get_message(mq, p->index);
+			if( (msg->next != MQ_LENT_MESSAGE) || (msg->size != 0) ){
+				p->index = MQ_NO_MESSAGE;
+				return 0;
+			}
+			if( p->size == 0 ){
+				mq_free_msg(mq, p->index);
+				return mq_send_block(mq);
+			}
+			msg->size = p->size;
+			msg->prio = p->prio;
+			mq_insert_msg(mq, p->index);
+			return mq_receive_block(mq);
+
+		case MQ_LEND_BORROW:
+			p->index = mq_find_oldest_highest(mq);
+			if( p->index != MQ_NO_MESSAGE ){
+				msg = mq_get_message(mq, p->index);
+				p->size = msg->size;
+				p->prio = msg->prio;
+				mq_remove_oldest_highest(mq);
+				msg->next = MQ_LENT_MESSAGE;
+			}
+			return 0;
+
+		case MQ_LEND_RELEASE:
+			msg = mq_get_message(mq, p->index);
+			if( (msg->next != MQ_LENT_MESSAGE) || (msg->size == 0) ){
+				p->index = MQ_NO_MESSAGE;
+				return 0;
+			}
+			mq_free_msg(mq, p->index);
+			return mq_send_block(mq);
+	}
+
+	p->index = MQ_NO_MESSAGE;
+	return 0;
+}
+
+void svcall_lend_message(void * args){
+	CORTEXM_SVCALL_ENTER();
+	root_lend_t * p = (root_lend_t*)args;
+	void * block;
+
+	if( p->mq->mutex.pthread != -1 ){
+		p->is_busy = 1;
+		return;
+	}
+
+	block = update_lent_message(p);
+	if( block != 0 ){
+		root_wake_blocked(block);
+	}
+}
+
+int lend_message(root_lend_t * args){
+	void * block;
+
+	args->is_busy = 0;
+	cortexm_svcall(svcall_lend_message, args);
+	if( args->is_busy == 0 ){
+		return 0;
+	}
+
+	//a thread is sending or receiving
+	if( pthread_mutex_lock(&(args->mq->mutex)) < 0 ){
+		return -1;
+	}
+
+	block = update_lent_message(args);
+
+	if( pthread_mutex_unlock(&(args->mq->mutex)) < 0 ){
+		return -1;
+	}
+
+	if( block != 0 ){
+		check_for_blocked_task(block);
+	}
+	return 0;
+}
+
 void svcall_block_on_mq(void * args){
 	CORTEXM_SVCALL_ENTER();
 	root_block_on_mq_t * argsp = (root_block_on_mq_t*)args;
@@ -969,19 +1377,21 @@ int block_on_mq(void * block, const struct timespec * abs_timeout){
 
 void svcall_wake_blocked(void * args){
 	CORTEXM_SVCALL_ENTER();
-	int * task = (int*)args;
-	int id = *task;
-	scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_MQ);
-	scheduler_root_update_on_wake(id, task_get_priority(id));
+	root_wake_blocked(args);
+}
+
+void root_wake_blocked(void * block){
+	int id = scheduler_root_get_highest_priority_blocked(block);
+	if( id != -1 ){
+		scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_MQ);
+		scheduler_root_update_on_wake(id, task_get_priority(id));
+	}
 }
 
 void check_for_blocked_task(void * block){
-	int new_thread;
-	new_thread = scheduler_get_highest_priority_blocked(block);
-	if ( new_thread != -1 ){
-		cortexm_svcall(svcall_wake_blocked, &new_thread);
-	} else {
-		//See if any tasks need to be notified if a message was just sent
+	//an empty queue means nothing is blocked on block (the walk happens in the svcall)
+	if( scheduler_wait_queue_head(block) != 0 ){
+		cortexm_svcall(svcall_wake_blocked, block);
 	}
 }
 /*! \endcond */
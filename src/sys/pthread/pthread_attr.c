@@ -207,6 +207,11 @@ int pthread_attr_getschedpolicy(const pthread_attr_t *attr /*! a pointer to the
 }
 
 /*! \details This function sets the scheduling policy in \a attr with \a policy.
+ *
+ * The attributes can't hold the runtime, period, and deadline of SCHED_DEADLINE.
+ * Create the thread with another policy and then call pthread_setschedparam()
+ * with a sos_sched_deadline_t.
+ *
  * \return Zero on success or -1 with errno set to:
  * - EINVAL: \a attr does not refer to an initialized thread attribute object
  * - EINVAL: \a policy does not refer to a valid policy.
@@ -32,6 +32,7 @@
 #include <errno.h>
 
 #include "../scheduler/scheduler_local.h"
+#include "pthread_local.h"
 
 /*! \cond */
 #define PSHARED_FLAG 31
@@ -43,7 +44,6 @@ static void svcall_cond_signal(void * args) MCU_ROOT_EXEC_CODE;
 typedef struct {
 	pthread_cond_t *cond;
 	pthread_mutex_t *mutex;
-	int new_thread;
 	struct mcu_timeval interval;
 	int result;
 } svcall_cond_wait_t;
@@ -120,9 +120,11 @@ int pthread_cond_broadcast(pthread_cond_t *cond){
 
 void svcall_cond_signal(void * args){
 	CORTEXM_SVCALL_ENTER();
-	int id = *((int*)args);
-	scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_COND);
-	scheduler_root_update_on_wake(id, task_get_priority(id));
+	int id = scheduler_root_get_highest_priority_blocked(args);
+	if( id != -1 ){
+		scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_COND);
+		scheduler_root_update_on_wake(id, task_get_priority(id));
+	}
 }
 
 /*! \details This function wakes the highest priority thread
@@ -132,8 +134,6 @@ void svcall_cond_signal(void * args){
  * - EINVAL: cond is NULL or not initialized
  */
 int pthread_cond_signal(pthread_cond_t *cond){
-	int new_thread;
-
 	if ( cond == NULL ){
 		errno = EINVAL;
 		return -1;
@@ -144,12 +144,10 @@ int pthread_cond_signal(pthread_cond_t *cond){
 		return -1;
 	}
 
-	new_thread = scheduler_get_highest_priority_blocked(cond);
-
-	if ( new_thread != -1 ){
-		cortexm_svcall(svcall_cond_signal, &new_thread);
+	//an empty queue means nothing is blocked on cond (the walk happens in the svcall)
+	if( scheduler_wait_queue_head(cond) != 0 ){
+		cortexm_svcall(svcall_cond_signal, cond);
 	}
-
 	return 0;
 }
 
@@ -191,7 +189,6 @@ int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex){
 	args.interval.tv_usec = 0;
 
 	//release the mutex and block on the cond
-	args.new_thread = scheduler_get_highest_priority_blocked(mutex);
 	cortexm_svcall(svcall_cond_wait, &args);
 
 	if ( args.result == -1 ){
@@ -256,7 +253,6 @@ int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const s
 
 
 	//release the mutex and block on the cond
-	args.new_thread = scheduler_get_highest_priority_blocked(mutex);
 	cortexm_svcall(svcall_cond_wait, &args);
 
 	if ( args.result == -1 ){
@@ -276,16 +272,17 @@ int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const s
 void svcall_cond_wait(void  * args){
 	CORTEXM_SVCALL_ENTER();
 	svcall_cond_wait_t * argsp = (svcall_cond_wait_t*)args;
-	int new_thread = argsp->new_thread;
+	int new_thread;
 
 
-	if ( argsp->mutex->pthread == task_get_current() ){
+	if ( pthread_mutex_get_owner(argsp->mutex) == task_get_current() ){
 		//First unlock the mutex
 		//Restore the priority to the task that is unlocking the mutex
 		task_set_priority(task_get_current(), sos_sched_table[task_get_current()].attr.schedparam.sched_priority);
 
+		new_thread = scheduler_root_get_highest_priority_blocked(argsp->mutex);
 		if ( new_thread != -1 ){
-			argsp->mutex->pthread = new_thread;
+			argsp->mutex->pthread = new_thread | PTHREAD_MUTEX_PTHREAD_WAITING;
 			argsp->mutex->pid = task_get_pid(new_thread);
 			argsp->mutex->lock = 1;
 			task_set_priority(new_thread, argsp->mutex->prio_ceiling);
@@ -0,0 +1,41 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef PTHREAD_LOCAL_H_
+#define PTHREAD_LOCAL_H_
+
+#include <pthread.h>
+
+/*
+ * A thread that blocks on a mutex sets this bit in mutex->pthread (in the
+ * kernel). The owner can only unlock without a kernel call if the owner word
+ * still holds just its thread id, so it can't miss a waiting thread.
+ *
+ */
+#define PTHREAD_MUTEX_PTHREAD_WAITING 0x40000000
+
+static inline int pthread_mutex_get_owner(const pthread_mutex_t * mutex){
+	int owner = mutex->pthread;
+	if( owner == -1 ){
+		return -1;
+	}
+	return owner & ~PTHREAD_MUTEX_PTHREAD_WAITING;
+}
+
+#endif /* PTHREAD_LOCAL_H_ */
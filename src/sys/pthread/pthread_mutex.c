@@ -38,6 +38,7 @@
 
 #include "mcu/debug.h"
 #include "../scheduler/scheduler_local.h"
+#include "pthread_local.h"
 
 /*! \cond */
 static int mutex_check_initialized(const pthread_mutex_t * mutex);
@@ -58,6 +59,8 @@ typedef struct {
 static void svcall_mutex_unlock(svcall_mutex_unlock_t * args) MCU_ROOT_EXEC_CODE;
 static void root_mutex_block(svcall_mutex_trylock_t *args);
 static void svcall_mutex_unblocked(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_CODE;
+static int mutex_fast_lock(pthread_mutex_t * mutex, int id);
+static int mutex_fast_unlock(pthread_mutex_t * mutex, int id);
 /*! \endcond */
 
 
@@ -150,7 +153,7 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex){
 	}
 
 	args.id = task_get_current();
-	if ( mutex->pthread == args.id ){ //Does this thread have a lock?
+	if ( pthread_mutex_get_owner(mutex) == args.id ){ //Does this thread have a lock?
 		if ( mutex->flags & PTHREAD_MUTEX_FLAGS_RECURSIVE ){
 			mutex->lock--;
 			if( mutex->lock != 0 ){
@@ -162,6 +165,12 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex){
 		return -1;
 	}
 
+	//the kernel is only needed to wake a waiting thread or to undo a priority ceiling
+	if( (task_get_priority(args.id) == sos_sched_table[args.id].attr.schedparam.sched_priority) &&
+		 (mutex_fast_unlock(mutex, args.id) == 0) ){
+		return 0;
+	}
+
 	args.mutex = mutex;  //The Mutex
 	cortexm_svcall((cortexm_svcall_t)svcall_mutex_unlock, &args);
 	return 0;
@@ -229,7 +238,7 @@ int pthread_mutex_timedlock(pthread_mutex_t * mutex, const struct timespec * abs
 			break;
 		case -2:
 			//Either the lock was acquired or the timeout occurred
-			if ( mutex->pthread == task_get_current() ){
+			if ( pthread_mutex_get_owner(mutex) == task_get_current() ){
 				errno = 0;
 				//Lock was acquired
 				return 0;
@@ -307,7 +316,7 @@ int mutex_trylock(pthread_mutex_t *mutex, bool trylock, const struct timespec *
 	id = task_get_current();
 
 	//Does this thread already have a lock?
-	if ( mutex->pthread == id ){
+	if ( pthread_mutex_get_owner(mutex) == id ){
 		//If the mutex is recursive, simply update the count
 		if ( mutex->flags & PTHREAD_MUTEX_FLAGS_RECURSIVE ){
 			//Check the maximum number of locks allowed
@@ -324,7 +333,18 @@ int mutex_trylock(pthread_mutex_t *mutex, bool trylock, const struct timespec *
 		}
 	}
 
-	//Lock the mutex if it is free
+	//a free mutex that doesn't raise the priority is locked without a kernel call
+	if( mutex->prio_ceiling <= task_get_priority(id) ){
+		if( mutex_fast_lock(mutex, id) == 0 ){
+			return 0;
+		}
+
+		if( trylock ){
+			return -2;
+		}
+	}
+
+	//Lock the mutex if it is free (or block until it is)
 	args.id = id;
 	args.mutex = mutex;
 	args.trylock = trylock;
@@ -344,7 +364,7 @@ int pthread_mutex_force_unlock(pthread_mutex_t *mutex){
 
 	if ( mutex->flags & PTHREAD_MUTEX_FLAGS_PSHARED ){ //All pshared objects must be in shared memory space
 		if ( mutex->pid == getpid() && (mutex->lock != 0) ){
-			args.id = mutex->pthread; //Current owner of the mutex
+			args.id = pthread_mutex_get_owner(mutex); //Current owner of the mutex
 			args.mutex = mutex;  //The Mutex
 			cortexm_svcall((cortexm_svcall_t)svcall_mutex_unlock, &args);
 		}
@@ -354,6 +374,9 @@ int pthread_mutex_force_unlock(pthread_mutex_t *mutex){
 }
 
 void root_mutex_block(svcall_mutex_trylock_t *args){
+	//the owner has to unlock in the kernel to wake this thread
+	args->mutex->pthread |= PTHREAD_MUTEX_PTHREAD_WAITING;
+
 	//block the calling mutex
 	sos_sched_table[ args->id ].block_object = args->mutex; //Elevate the priority of the task based on prio_ceiling
 	scheduler_timing_root_timedblock(args->mutex, &args->abs_timeout);
@@ -361,7 +384,7 @@ void root_mutex_block(svcall_mutex_trylock_t *args){
 
 void svcall_mutex_unblocked(svcall_mutex_trylock_t *args){
 	CORTEXM_SVCALL_ENTER();
-	if( args->mutex->pthread == args->id ){
+	if( pthread_mutex_get_owner(args->mutex) == args->id ){
 		//mutex is locked -- exit loop
 		scheduler_root_set_unblock_type(args->id, SCHEDULER_UNBLOCK_MUTEX);
 		return;
@@ -409,10 +432,11 @@ void svcall_mutex_unlock(svcall_mutex_unlock_t * args){
 	sos_sched_table[args->id].block_object = NULL;
 
 	//check to see if another task is waiting for the mutex
-	new_thread = scheduler_get_highest_priority_blocked(args->mutex);
+	new_thread = scheduler_root_get_highest_priority_blocked(args->mutex);
 
 	if ( new_thread > 0 ){
-		args->mutex->pthread = new_thread;
+		//other threads may still be waiting so the next unlock goes through the kernel as well
+		args->mutex->pthread = new_thread | PTHREAD_MUTEX_PTHREAD_WAITING;
 		args->mutex->pid = task_get_pid(new_thread);
 		args->mutex->lock = 1;
 		if( args->mutex->prio_ceiling > task_get_priority(new_thread) ){
@@ -430,6 +454,70 @@ void svcall_mutex_unlock(svcall_mutex_unlock_t * args){
 	}
 }
 
+#if defined __arm__
+static u32 load_exclusive(volatile int * addr){
+	u32 value;
+	asm volatile ("ldrex %0, [%1]" : "=r" (value) : "r" (addr) : "memory");
+	return value;
+}
+
+static int store_exclusive(volatile int * addr, u32 value){
+	int result;
+	asm volatile ("strex %0, %2, [%1]" : "=&r" (result) : "r" (addr), "r" (value) : "memory");
+	return result;
+}
+
+static void clear_exclusive(){
+	asm volatile ("clrex" : : : "memory");
+}
+#else
+//host builds (test/sys) emulate the exclusive monitor with compare-and-swap
+static u32 m_exclusive_value;
+
+static u32 load_exclusive(volatile int * addr){
+	m_exclusive_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+	return m_exclusive_value;
+}
+
+static int store_exclusive(volatile int * addr, u32 value){
+	int expected = m_exclusive_value;
+	return !__atomic_compare_exchange_n(addr, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static void clear_exclusive(){}
+#endif
+
+/*
+ * An exception between the exclusive load and store makes the store fail, so
+ * the kernel (svcall_mutex_trylock() and svcall_mutex_unlock()) never sees a
+ * half-updated owner.
+ *
+ */
+int mutex_fast_lock(pthread_mutex_t * mutex, int id){
+	do {
+		if( load_exclusive(&mutex->pthread) != (u32)-1 ){
+			clear_exclusive();
+			return -1;
+		}
+	} while( store_exclusive(&mutex->pthread, id) );
+
+	mutex->pid = task_get_pid(id);
+	mutex->lock = 1;
+	return 0;
+}
+
+int mutex_fast_unlock(pthread_mutex_t * mutex, int id){
+	mutex->lock = 0;
+	do {
+		if( load_exclusive(&mutex->pthread) != (u32)id ){
+			//another thread is waiting -- the kernel hands the mutex over
+			clear_exclusive();
+			return -1;
+		}
+	} while( store_exclusive(&mutex->pthread, (u32)-1) );
+	return 0;
+}
+
 int mutex_check_initialized(const pthread_mutex_t * mutex){
 	if ( (mutex == NULL) || (((u32)mutex & 0x03) != 0) ){
 		errno = EINVAL;
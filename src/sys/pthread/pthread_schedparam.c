@@ -38,6 +38,7 @@ typedef struct {
 	int tid;
 	int policy;
 	const struct sched_param * param;
+	int result;
 } root_set_pthread_scheduling_param_t;
 static void svcall_set_scheduling_param(void * args) MCU_ROOT_EXEC_CODE;
 /*! \endcond */
@@ -63,7 +64,7 @@ int pthread_getschedparam(pthread_t thread, int *policy,
 		return -1;
 	}
 
-	*policy = PTHREAD_ATTR_GET_SCHED_POLICY( (&(sos_sched_table[thread].attr)) );
+	*policy = scheduler_policy(thread);
 	memcpy(param, (const void *)&(sos_sched_table[thread].attr.schedparam), sizeof(struct sched_param));
 	return 0;
 }
@@ -71,9 +72,15 @@ int pthread_getschedparam(pthread_t thread, int *policy,
 /*! \details This function sets \a thread's scheduling policy and scheduling parameters to
  * \a policy and \a param respectively.
  *
+ * If \a policy is SCHED_DEADLINE, \a param must point to the \a param
+ * member of a sos_sched_deadline_t that holds the runtime, period, and
+ * deadline of the thread.
+ *
  * \return Zero on success or -1 with errno (see \ref errno) set to:
  * - ESRCH:  thread is not a valid
- * - EINVAL:  param is NULL or the priority is invalid
+ * - EINVAL:  param is NULL or the priority (or deadline parameters) are invalid
+ * - EPERM:  the sos_sched_deadline_t for SCHED_DEADLINE is not in memory the caller can read
+ * - EBUSY:  the deadline threads would need more than SOS_SCHED_DEADLINE_DENSITY_MAX of the processor
  *
  */
 int pthread_setschedparam(pthread_t thread,
@@ -102,7 +109,12 @@ int pthread_setschedparam(pthread_t thread,
 		args.tid = thread;
 		args.policy = policy;
 		args.param = param;
+		args.result = 0;
 		cortexm_svcall(svcall_set_scheduling_param, &args);
+		if( args.result < 0 ){
+			errno = SYSFS_GET_RETURN_ERRNO(args.result);
+			return -1;
+		}
 		return 0;
 	}
 
@@ -120,7 +132,23 @@ void svcall_set_scheduling_param(void * args){
 
 	if( task_enabled(id) ){
 
-		PTHREAD_ATTR_SET_SCHED_POLICY( (&(sos_sched_table[id].attr)), p->policy);
+		if( p->policy == SCHED_DEADLINE ){
+			//the sched_param is the first member of sos_sched_deadline_t -- the caller only vouched for the sched_param
+			if( task_validate_memory((void*)p->param, sizeof(sos_sched_deadline_t)) < 0 ){
+				p->result = SYSFS_SET_RETURN(EPERM);
+				return;
+			}
+			p->result = scheduler_root_set_deadline(id, (const sos_sched_deadline_t*)p->param);
+			if( p->result < 0 ){
+				return;
+			}
+			//deadline tasks are reported by scheduler_policy() -- they share their list with the SCHED_RR tasks
+			PTHREAD_ATTR_SET_SCHED_POLICY( (&(sos_sched_table[id].attr)), SCHED_RR);
+		} else {
+			scheduler_root_clear_deadline(id);
+			PTHREAD_ATTR_SET_SCHED_POLICY( (&(sos_sched_table[id].attr)), p->policy);
+		}
+
 		memcpy((void*)&sos_sched_table[id].attr.schedparam, p->param, sizeof(struct sched_param));
 
 		//Issue #161 -- need to set the effective priority -- not just the prio ceiling
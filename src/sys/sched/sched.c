@@ -54,13 +54,14 @@ static int get_pid_task(pid_t pid){
 
 /*! \details This function gets the maximum priority for \a policy.
  * \return Zero on success or -1 with errno (see \ref errno) set to:
- * - EINVAL:  \a policy is not SCHED_RR, SCHED_FIFO, or SCHED_OTHER
+ * - EINVAL:  \a policy is not SCHED_RR, SCHED_FIFO, SCHED_DEADLINE, or SCHED_OTHER
  *
  */
 int sched_get_priority_max(int policy){
 	switch(policy){
 		case SCHED_RR:
 		case SCHED_FIFO:
+		case SCHED_DEADLINE:
 			return SCHED_HIGHEST_PRIORITY;
 		case SCHED_OTHER:
 			return 0;
@@ -72,13 +73,14 @@ int sched_get_priority_max(int policy){
 
 /*! \details This function gets the minimum priority for \a policy.
  * \return Zero on success or -1 with errno (see \ref errno) set to:
- * - EINVAL:  \a policy is not SCHED_RR, SCHED_FIFO, or SCHED_OTHER
+ * - EINVAL:  \a policy is not SCHED_RR, SCHED_FIFO, SCHED_DEADLINE, or SCHED_OTHER
  *
  */
 int sched_get_priority_min(int policy){
 	switch(policy){
 		case SCHED_RR:
 		case SCHED_FIFO:
+		case SCHED_DEADLINE:
 			return 1;
 		case SCHED_OTHER:
 			return 0;
@@ -125,7 +127,7 @@ int sched_getscheduler(pid_t pid){
 	}
 
 	//return the scheduling policy
-	return PTHREAD_ATTR_GET_SCHED_POLICY( (&(sos_sched_table[tid].attr)) );
+	return scheduler_policy(tid);
 }
 
 /*! \details This function gets the round robin interval for \a pid.
@@ -147,6 +149,9 @@ int sched_rr_get_interval(pid_t pid, struct timespec * ts){
 }
 
 /*! \details This function sets the process's scheduling paramater (priority).
+ *
+ * A SCHED_DEADLINE thread keeps its runtime, period, and deadline.
+ *
  * \return Zero on success or -1 with errno (see \ref errno) set to:
  * - ESRCH:  \a pid is not a valid process
  * - EPERM:  the calling process does not have permission to change the scheduling parameters
@@ -161,7 +166,7 @@ int sched_setparam(pid_t pid, const struct sched_param * param){
 		return -1;
 	}
 
-	args.policy = PTHREAD_ATTR_GET_SCHED_POLICY( (&(sos_sched_table[args.tid].attr)) );
+	args.policy = scheduler_policy(args.tid);
 
 	if ( (param->sched_priority > sched_get_priority_max(args.policy)) ||
 		  (param->sched_priority < sched_get_priority_min(args.policy)) ){
@@ -175,6 +180,10 @@ int sched_setparam(pid_t pid, const struct sched_param * param){
 }
 
 /*! \details This function sets the scheduler policy and parameter (priority) for the process.
+ *
+ * A struct sched_param can't hold the runtime, period, and deadline
+ * so use pthread_setschedparam() with a sos_sched_deadline_t for SCHED_DEADLINE.
+ *
  * \return Zero on success or -1 with errno (see \ref errno) set to:
  * - EINVAL:  \a policy is not SCHED_RR, SCHED_FIFO, or SCHED_OTHER
  * - EPERM:  the calling process does not have permission to change the scheduling parameters
@@ -214,6 +223,10 @@ int sched_setscheduler(pid_t pid, int policy, const struct sched_param * param){
 
 /*! \details This function causes the calling thread to yield the processor.  The context
  * is switched to the next active task.  If no tasks are active, the CPU idles.
+ *
+ * A SCHED_DEADLINE thread calls this function when the job for the current
+ * period is done. The thread sleeps until the next job is released.
+ *
  * \return Zero
  */
 int sched_yield(){
@@ -224,6 +237,11 @@ int sched_yield(){
 /*! \cond */
 void svcall_yield(void * args){
 	CORTEXM_SVCALL_ENTER();
+	if( task_deadline_asserted( task_get_current() ) ){
+		//a SCHED_DEADLINE thread yields when its job is done for the period
+		scheduler_root_complete_deadline_job();
+		return;
+	}
 	task_assert_yield( task_get_current() );
 	task_root_switch_context();
 }
@@ -236,7 +254,11 @@ void svcall_set_scheduling_param(void * args){
 
 	if( task_enabled(id) ){
 
-		PTHREAD_ATTR_SET_SCHED_POLICY( (&(sos_sched_table[id].attr)), p->policy);
+		//sched_setparam() passes SCHED_DEADLINE (from scheduler_policy()) to change only the priority
+		if( p->policy != SCHED_DEADLINE ){
+			scheduler_root_clear_deadline(id);
+			PTHREAD_ATTR_SET_SCHED_POLICY( (&(sos_sched_table[id].attr)), p->policy);
+		}
 
 		memcpy((void*)&sos_sched_table[id].attr.schedparam, p->param, sizeof(struct sched_param));
 
@@ -0,0 +1,196 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*! \addtogroup SCHED
+ * @{
+ *
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include "scheduler_local.h"
+
+/*
+ * A SCHED_DEADLINE thread executes one job each period. When the job is
+ * released, the task gets a new absolute deadline (release + deadline) and
+ * a budget of runtime clock cycles (see task_root_set_deadline()). The
+ * context switcher orders the deadline tasks by their deadline and counts the
+ * budget down with the SysTick.
+ *
+ * The job is done when the thread calls sched_yield(). The thread then sleeps
+ * in the wake queue until the next release. If the budget runs out first,
+ * task_budget_event_handler() holds the thread in the wake queue until the next
+ * release (the job continues with the next budget and deadline).
+ *
+ * The release is always a whole number of periods after the previous one
+ * unless the thread is so late that the next release has already passed.
+ * In that case, the next job is released immediately.
+ *
+ */
+
+static u32 get_density(u32 runtime, u32 period, u32 deadline);
+static u32 get_clock(const struct mcu_timeval * tv);
+static struct mcu_timeval add_useconds(const struct mcu_timeval * tv, u32 useconds);
+static void set_next_release(int id, const struct mcu_timeval * now);
+static void start_job(int id);
+
+u32 get_density(u32 runtime, u32 period, u32 deadline){
+	//parts per million of the processor needed to meet every deadline
+	if( deadline > period ){
+		deadline = period;
+	}
+	return ((u64)runtime * 1000000UL) / deadline;
+}
+
+u32 get_clock(const struct mcu_timeval * tv){
+	//microseconds modulo 2^32 -- the context switcher compares the difference
+	return tv->tv_sec * SOS_USECOND_PERIOD + tv->tv_usec;
+}
+
+struct mcu_timeval add_useconds(const struct mcu_timeval * tv, u32 useconds){
+	struct mcu_timeval interval;
+	interval.tv_sec = useconds / SOS_USECOND_PERIOD;
+	interval.tv_usec = useconds % SOS_USECOND_PERIOD;
+	return scheduler_timing_add_mcu_timeval(tv, &interval);
+}
+
+void set_next_release(int id, const struct mcu_timeval * now){
+	volatile sos_sched_deadline_state_t * state = &sos_sched_table[id].deadline;
+	struct mcu_timeval release = add_useconds((const struct mcu_timeval*)&state->release, state->period);
+	if( (release.tv_sec < now->tv_sec) ||
+		 ((release.tv_sec == now->tv_sec) && (release.tv_usec <= now->tv_usec)) ){
+		release = *now;
+	}
+	state->release = release;
+}
+
+void start_job(int id){
+	volatile sos_sched_deadline_state_t * state = &sos_sched_table[id].deadline;
+	struct mcu_timeval deadline = add_useconds((const struct mcu_timeval*)&state->release, state->deadline);
+	task_root_set_deadline(id,
+								  get_clock(&deadline),
+								  state->runtime * SCHEDULER_CLOCK_USEC_MULT);
+}
+
+int scheduler_root_set_deadline(int id, const sos_sched_deadline_t * attr){
+	volatile sos_sched_deadline_state_t * state = &sos_sched_table[id].deadline;
+	u32 deadline;
+	u32 density;
+	struct mcu_timeval now;
+	int i;
+
+	deadline = attr->deadline ? attr->deadline : attr->period;
+	if( (attr->runtime == 0) ||
+		 (attr->runtime > deadline) ||
+		 (deadline > attr->period) ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	//the budget is counted down by the 24-bit SysTick
+	if( (u64)attr->runtime * SCHEDULER_CLOCK_USEC_MULT > 0x00FFFFFF ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	//admission control -- the deadline threads can't reserve more than their share of the processor
+	density = get_density(attr->runtime, attr->period, deadline);
+	for(i=1; i < task_get_total(); i++){
+		if( (i != id) && task_enabled(i) && task_deadline_asserted(i) ){
+			density += get_density(sos_sched_table[i].deadline.runtime,
+										  sos_sched_table[i].deadline.period,
+										  sos_sched_table[i].deadline.deadline);
+		}
+	}
+
+	if( density > SOS_SCHED_DEADLINE_DENSITY_MAX ){
+		return SYSFS_SET_RETURN(EBUSY);
+	}
+
+	if( task_deadline_asserted(id) == 0 ){
+		state->miss_count = 0;
+		state->overrun_count = 0;
+	}
+
+	state->runtime = attr->runtime;
+	state->period = attr->period;
+	state->deadline = deadline;
+
+	scheduler_timing_root_get_realtime(&now);
+	state->release = now;
+
+	if( id == task_get_current() ){
+		//save the time left in the slice so it is charged to the task
+		task_root_switch_context();
+	}
+
+	start_job(id);
+	return 0;
+}
+
+void scheduler_root_clear_deadline(int id){
+	if( task_deadline_asserted(id) ){
+		if( id == task_get_current() ){
+			task_root_switch_context();
+		}
+		task_root_set_deadline(id, 0, 0);
+	}
+}
+
+void scheduler_root_complete_deadline_job(){
+	int id = task_get_current();
+	volatile sos_sched_deadline_state_t * state = &sos_sched_table[id].deadline;
+	struct mcu_timeval now;
+	struct mcu_timeval deadline;
+
+	scheduler_timing_root_get_realtime(&now);
+	deadline = add_useconds((const struct mcu_timeval*)&state->release, state->deadline);
+	if( (deadline.tv_sec < now.tv_sec) ||
+		 ((deadline.tv_sec == now.tv_sec) && (deadline.tv_usec < now.tv_usec)) ){
+		state->miss_count++;
+	}
+
+	//save the budget that is left so it is charged to the task (and let the next task execute)
+	task_root_switch_context();
+	task_assert_yield(id);
+
+	set_next_release(id, &now);
+	scheduler_timing_root_timedblock(NULL, (struct mcu_timeval*)&state->release);
+	start_job(id);
+}
+
+void task_budget_event_handler(int id){
+	volatile sos_sched_deadline_state_t * state = &sos_sched_table[id].deadline;
+	struct mcu_timeval now;
+
+	//the job can't execute again before its deadline (the next release is no earlier)
+	state->overrun_count++;
+	state->miss_count++;
+
+	scheduler_timing_root_get_realtime(&now);
+	set_next_release(id, &now);
+	if( scheduler_timing_root_throttle(id, (struct mcu_timeval*)&state->release) ){
+		//Issue #130
+		cortexm_disable_interrupts();
+		task_root_set_current_priority( task_root_get_highest_ready_priority() );
+		cortexm_enable_interrupts();
+	}
+	start_job(id);
+}
+
+/*! @} */
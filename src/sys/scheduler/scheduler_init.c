@@ -39,6 +39,7 @@ volatile scheduler_fault_t m_scheduler_fault MCU_SYS_MEM;
 int scheduler_init(){
 	memset((void*)sos_task_table, 0, sizeof(task_t) * sos_board_config.task_total);
 	memset((void*)sos_sched_table, 0, sizeof(sched_task_t) * sos_board_config.task_total);
+	memset((void*)scheduler_wait_queue, 0, SCHEDULER_WAIT_QUEUE_COUNT);
 
 	//Do basic init of task 0 so that memory allocation can happen before the scheduler starts
 	sos_task_table[0].reent = _impure_ptr;
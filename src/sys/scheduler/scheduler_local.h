@@ -47,6 +47,13 @@ extern volatile scheduler_fault_t m_scheduler_fault;
 
 
 static inline int scheduler_priority(int id){ return task_get_priority(id); }
+//SCHED_DEADLINE doesn't fit in the policy field of pthread_attr_t so it is tracked in the task table
+static inline int scheduler_policy(int id){
+	if( task_deadline_asserted(id) ){
+		return SCHED_DEADLINE;
+	}
+	return PTHREAD_ATTR_GET_SCHED_POLICY( (&(sos_sched_table[id].attr)) );
+}
 static inline trace_id_t scheduler_trace_id(int id){ return sos_sched_table[id].trace_id; }
 static inline int scheduler_current_priority(){ return task_get_current_priority(); }
 
@@ -67,7 +74,6 @@ int scheduler_create_process(void (*p)(char *),
 		void * reent, int parent_id, int is_root);
 
 int scheduler_switch_context(void * args);
-int scheduler_get_highest_priority_blocked(void * block_object);
 
 u32 scheduler_calculate_heap_end(u32 task_id);
 
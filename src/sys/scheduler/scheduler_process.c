@@ -83,6 +83,9 @@ void svcall_init_sched_task(init_sched_task_t * task){
 	struct _reent * reent;
 	int id = task->tid;
 
+	//a deleted thread that used this slot may still be in a wait queue or timer queue
+	scheduler_root_wait_queue_remove(id);
+	scheduler_timing_root_dequeue_task(id);
 	memset((void*)&sos_sched_table[id], 0, sizeof(sched_task_t));
 
 	PTHREAD_ATTR_SET_IS_INITIALIZED((&(sos_sched_table[id].attr)), 1);
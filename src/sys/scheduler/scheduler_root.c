@@ -24,8 +24,121 @@
 
 /*! \file */
 
+#include "config.h"
 #include "scheduler_local.h"
 
+/*
+ * Threads that are blocked on an object are kept in wait queues so waking
+ * them doesn't scan the task table. The queue is picked by hashing the block
+ * object's address, so one queue may hold threads waiting on different objects.
+ * Each queue is ordered by priority and threads with the same priority are
+ * kept in the order they blocked. That is the round robin order Issue #139
+ * asks for with the longest waiting thread going first.
+ *
+ * The links are in sos_sched_table (task 0 never blocks on an object so zero
+ * is the end of the list). A deleted thread stays in its queue (the walkers
+ * skip it) until the slot is used by a new thread.
+ *
+ */
+volatile u8 scheduler_wait_queue[SCHEDULER_WAIT_QUEUE_COUNT] MCU_SYS_MEM;
+
+static int get_wait_queue(volatile void * block_object){
+	return ((u32)block_object >> 2) & (SCHEDULER_WAIT_QUEUE_COUNT - 1);
+}
+
+static void root_wait_queue_insert(int id){
+	int queue = get_wait_queue(sos_sched_table[id].block_object);
+	int priority = sos_sched_table[id].attr.schedparam.sched_priority;
+	int prev = 0;
+	int next;
+
+	cortexm_disable_interrupts();
+	next = scheduler_wait_queue[queue];
+	while( next && (sos_sched_table[next].attr.schedparam.sched_priority >= priority) ){
+		prev = next;
+		next = sos_sched_table[next].wait_next;
+	}
+
+	sos_sched_table[id].wait_prev = prev;
+	sos_sched_table[id].wait_next = next;
+	if( prev ){
+		sos_sched_table[prev].wait_next = id;
+	} else {
+		scheduler_wait_queue[queue] = id;
+	}
+	if( next ){
+		sos_sched_table[next].wait_prev = id;
+	}
+	sos_sched_table[id].wait_queue = queue + 1;
+	cortexm_enable_interrupts();
+}
+
+void scheduler_root_wait_queue_remove(int id){
+	int queue;
+	int prev;
+	int next;
+
+	cortexm_disable_interrupts();
+	queue = sos_sched_table[id].wait_queue;
+	if( queue != 0 ){
+		prev = sos_sched_table[id].wait_prev;
+		next = sos_sched_table[id].wait_next;
+		if( prev ){
+			sos_sched_table[prev].wait_next = next;
+		} else {
+			scheduler_wait_queue[queue-1] = next;
+		}
+		if( next ){
+			sos_sched_table[next].wait_prev = prev;
+		}
+		sos_sched_table[id].wait_queue = 0;
+	}
+	cortexm_enable_interrupts();
+}
+
+int scheduler_wait_queue_head(volatile void * block_object){
+	return scheduler_wait_queue[ get_wait_queue(block_object) ];
+}
+
+//The queues change in svcalls and interrupts so this is only called from them
+int scheduler_root_get_highest_priority_blocked(void * block_object){
+	int i;
+
+	//the wait queue is in priority order then in the order the threads blocked (Issue #139)
+	for(i = scheduler_wait_queue_head(block_object); i != 0; i = sos_sched_table[i].wait_next){
+		if ( task_enabled(i) &&
+			  (sos_sched_table[i].block_object == block_object) &&
+			  !task_active_asserted(i) &&
+			  !task_stopped_asserted(i) ){
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+//This is only called from SVcall so it is always synchronous -- no re-entrancy issues with it
+int scheduler_root_unblock_all(void * block_object, int unblock_type){
+	int i;
+	int next;
+	int priority;
+	priority = SCHED_LOWEST_PRIORITY - 1;
+	for(i = scheduler_wait_queue_head(block_object); i != 0; i = next){
+		//waking the task removes it from the queue
+		next = sos_sched_table[i].wait_next;
+		if ( task_enabled(i) ){
+			if ( (sos_sched_table[i].block_object == block_object) && ( !task_active_asserted(i) ) ){
+				//it's waiting for the semaphore -- give the semaphore to the highest priority and waiting longest
+				scheduler_root_assert_active(i, unblock_type);
+				if( !task_stopped_asserted(i) && (sos_sched_table[i].attr.schedparam.sched_priority > priority)  ){
+					priority = sos_sched_table[i].attr.schedparam.sched_priority;
+				}
+			}
+		}
+	}
+	return priority;
+}
+
 void scheduler_svcall_set_delaymutex(void * args){
 	CORTEXM_SVCALL_ENTER();
 	sos_sched_table[ task_get_current() ].signal_delay_mutex = args;
@@ -41,19 +154,67 @@ void scheduler_root_set_trace_id(int tid, trace_id_t id){
 	sos_sched_table[tid].trace_id = id;
 }
 
+static u32 get_block_clock(){
+	struct mcu_timeval now;
+	u32 value;
+	scheduler_timing_root_get_realtime(&now);
+	//microseconds (modulo 2^32) -- zero means the task isn't blocked
+	value = now.tv_sec * SOS_USECOND_PERIOD + now.tv_usec;
+	return value ? value : 1;
+}
+
+static int get_block_type(int unblock_type){
+	switch(unblock_type){
+		case SCHEDULER_UNBLOCK_MUTEX:
+		case SCHEDULER_UNBLOCK_RWLOCK:
+			return SYS_TASK_BLOCK_MUTEX;
+		case SCHEDULER_UNBLOCK_SEMAPHORE:
+		case SCHEDULER_UNBLOCK_FUTEX:
+			return SYS_TASK_BLOCK_SEMAPHORE;
+		case SCHEDULER_UNBLOCK_COND:
+			return SYS_TASK_BLOCK_COND;
+		case SCHEDULER_UNBLOCK_SLEEP:
+			return SYS_TASK_BLOCK_SLEEP;
+		case SCHEDULER_UNBLOCK_TRANSFER:
+		case SCHEDULER_UNBLOCK_AIO:
+			return SYS_TASK_BLOCK_IO;
+		case SCHEDULER_UNBLOCK_MQ:
+			return SYS_TASK_BLOCK_MQ;
+		default:
+			return SYS_TASK_BLOCK_OTHER;
+	}
+}
+
 void scheduler_root_assert_active(int id, int unblock_type){
+	if( sos_sched_table[id].block_start != 0 ){
+		//the statistics (I_SYS_GETTASKSTATS) group the time blocked by what woke the task
+		sos_sched_table[id].block_time[ get_block_type(unblock_type) ] +=
+				get_block_clock() - sos_sched_table[id].block_start;
+		sos_sched_table[id].block_start = 0;
+	}
 	task_assert_active(id);
 	scheduler_root_set_unblock_type(id, unblock_type);
 	scheduler_root_deassert_aiosuspend(id);
 	//Remove all blocks (mutex, timing, etc)
+	scheduler_root_wait_queue_remove(id);
+	scheduler_timing_root_dequeue_wake(id);
 	sos_sched_table[id].block_object = NULL;
 	sos_sched_table[id].wake.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
 	sos_sched_table[id].wake.tv_usec = 0;
 }
 
 void scheduler_root_deassert_active(int id){
-	task_deassert_active(id);
-	task_deassert_exec(id);  //stop executing the task
+	//reading the clock on every block and wake is opt-in (block_start stays zero otherwise)
+	if( (id > 0) && task_active_asserted(id) &&
+		 (sos_board_config.o_sys_flags & SYS_FLAG_IS_TASK_STATS) ){
+		sos_sched_table[id].block_start = get_block_clock();
+	}
+	task_deassert_active(id); //stop executing the task
+	if( (id > 0) &&
+		 (sos_sched_table[id].block_object != NULL) &&
+		 (sos_sched_table[id].wait_queue == 0) ){
+		root_wait_queue_insert(id);
+	}
 }
 
 void scheduler_root_stop_task(int id){
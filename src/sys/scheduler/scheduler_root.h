@@ -32,6 +32,10 @@
 #define SCHEDULER_TASK_FLAG_ROOT_SYNC 12
 #define SCHEDULER_TASK_FLAG_AUTHENTICATED 13
 
+#define SCHEDULER_WAIT_QUEUE_COUNT 16
+
+extern volatile u8 scheduler_wait_queue[SCHEDULER_WAIT_QUEUE_COUNT];
+
 typedef enum {
 	SCHEDULER_UNBLOCK_NONE,
 	SCHEDULER_UNBLOCK_MUTEX,
@@ -45,7 +49,8 @@ typedef enum {
 	SCHEDULER_UNBLOCK_MQ,
 	SCHEDULER_UNBLOCK_PTHREAD_JOINED,
 	SCHEDULER_UNBLOCK_PTHREAD_JOINED_THREAD_COMPLETE,
-	SCHEDULER_UNBLOCK_AIO
+	SCHEDULER_UNBLOCK_AIO,
+	SCHEDULER_UNBLOCK_FUTEX
 } scheduler_unblock_type_t;
 
 void scheduler_root_assert(int id, int flag);
@@ -57,12 +62,18 @@ void scheduler_root_update_on_wake(int id, int new_priority);
 
 void scheduler_root_assert_active(int id, int unblock_type);
 void scheduler_root_deassert_active(int id);
+void scheduler_root_wait_queue_remove(int id);
+int scheduler_wait_queue_head(volatile void * block_object);
 void scheduler_root_set_trace_id(int tid, trace_id_t id);
 void scheduler_root_assert_sync(void * args) MCU_ROOT_CODE;
+int scheduler_root_get_highest_priority_blocked(void * block_object);
 int scheduler_root_unblock_all(void * block_object, int unblock_type);
 void scheduler_svcall_set_delaymutex(void * args) MCU_ROOT_EXEC_CODE;
 
 void scheduler_root_stop_task(int id);
+int scheduler_root_set_deadline(int id, const sos_sched_deadline_t * attr);
+void scheduler_root_clear_deadline(int id);
+void scheduler_root_complete_deadline_job();
 void scheulder_root_start_task(int id);
 
 static inline volatile int scheduler_unblock_type(int id) MCU_ALWAYS_INLINE;
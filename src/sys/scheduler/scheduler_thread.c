@@ -113,6 +113,9 @@ void svcall_activate_thread(svcall_activate_thread_t * args){
 	struct _reent * reent;
 
 
+	//a deleted thread that used this slot may still be in a wait queue or timer queue
+	scheduler_root_wait_queue_remove(id);
+	scheduler_timing_root_dequeue_task(id);
 	memset( (void*)&sos_sched_table[id], 0, sizeof(sched_task_t));
 	memcpy( (void*)&(sos_sched_table[id].attr), args->attr, sizeof(pthread_attr_t));
 
@@ -193,6 +196,7 @@ void cleanup_thread(void * status){
 void svcall_elevate_priority(void * args){
 	CORTEXM_SVCALL_ENTER();
 	u32 id = task_get_current();
+	scheduler_root_clear_deadline(id);
 	//Issue #161 -- need to set the effective priority -- not just the prio ceiling
 	PTHREAD_ATTR_SET_SCHED_POLICY( (&(sos_sched_table[id].attr)), SCHED_FIFO);
 	sos_sched_table[id].attr.schedparam.sched_priority = SCHED_HIGHEST_PRIORITY;
@@ -32,6 +32,7 @@
 #include "mcu/rtc.h"
 #include "mcu/debug.h"
 
+//sleeping tasks and armed process timers are queued in scheduler_timing_queue.c
 static volatile u32 sched_usecond_counter MCU_SYS_MEM;
 
 static int open_usecond_tmr();
@@ -45,8 +46,11 @@ static u8 scheduler_timing_process_timer_task_id(timer_t timer_id){ return timer
 static u8 scheduler_timing_process_timer_id_offset(timer_t timer_id){ return timer_id & 0xFF; }
 static u8 scheduler_timing_process_timer_count(){ return SOS_PROCESS_TIMER_COUNT; }
 static void update_tmr_for_process_timer_match(volatile sos_process_timer_t * timer);
+static int is_expired(volatile const struct mcu_timeval * value, u32 now);
+static int root_queue_wake(int id, struct mcu_timeval * abs_time);
 
 int scheduler_timing_init(){
+	scheduler_timing_root_queue_init();
 	if ( open_usecond_tmr() < 0 ){
 		return -1;
 	}
@@ -146,6 +150,7 @@ void svcall_delete_timer(void * args){
 		return;
 	}
 
+	scheduler_timing_root_timer_queue_remove( scheduler_timing_timer_entry(p->timer_id) );
 	memset((void*)timer, 0, sizeof(sos_process_timer_t));
 	cortexm_assign_zero_sum32((void*)timer, sizeof(sos_process_timer_t)/sizeof(u32));
 	p->result = 0;
@@ -211,6 +216,7 @@ void svcall_settime(void * args){
 
 	//stop the timer -- see if event is in past, assign the values, start the timer
 	update_tmr_for_process_timer_match(timer);
+	scheduler_timing_root_timer_queue_update( scheduler_timing_timer_entry(p->timer_id) );
 
 	cortexm_assign_zero_sum32((void*)timer, sizeof(sos_process_timer_t)/sizeof(u32));
 	p->result = 0;
@@ -400,15 +406,33 @@ int send_and_reload_timer(volatile sos_process_timer_t * timer, u8 task_id, u32
 
 void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * abs_time){
 	int id;
+
+	//Initialization
+	id = task_get_current();
+	sos_sched_table[id].block_object = block_object;
+
+	//only sleep if the time hasn't already passed
+	if( root_queue_wake(id, abs_time) ){
+		scheduler_root_update_on_sleep();
+	}
+}
+
+int scheduler_timing_root_throttle(int id, struct mcu_timeval * abs_time){
+	//this is called while the SysTick switches contexts so it doesn't request another switch
+	sos_sched_table[id].block_object = NULL;
+	if( root_queue_wake(id, abs_time) ){
+		scheduler_root_deassert_active(id);
+		return 1;
+	}
+	return 0;
+}
+
+int root_queue_wake(int id, struct mcu_timeval * abs_time){
 	mcu_channel_t chan_req;
 	u32 now;
 	devfs_handle_t tmr_handle;
 	int is_time_to_sleep;
 	tmr_handle.port = sos_board_config.clk_usecond_tmr;
-
-	//Initialization
-	id = task_get_current();
-	sos_sched_table[id].block_object = block_object;
 	is_time_to_sleep = 0;
 
 	if (abs_time->tv_sec >= sched_usecond_counter){
@@ -445,11 +469,10 @@ void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval *
 		}
 	}
 
-	//only sleep if the time hasn't already passed
-	if( is_time_to_sleep ){
-		scheduler_root_update_on_sleep();
+	if( is_time_to_sleep && (abs_time->tv_sec != SCHEDULER_TIMEVAL_SEC_INVALID) ){
+		scheduler_timing_root_wake_queue_insert(id);
 	}
-
+	return is_time_to_sleep;
 }
 
 void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts){
@@ -527,6 +550,12 @@ void scheduler_timing_root_get_realtime(struct mcu_timeval * tv){
 	mcu_tmr_enable(&tmr_handle, 0);
 }
 
+u64 task_root_get_usecond_clock(){
+	struct mcu_timeval now;
+	scheduler_timing_root_get_realtime(&now);
+	return (u64)now.tv_sec * SOS_USECOND_PERIOD + now.tv_usec;
+}
+
 int root_handle_usecond_overflow_event(void * context, const mcu_event_t * data){
 	sched_usecond_counter++;
 	root_handle_usecond_match_event(0, 0);
@@ -535,9 +564,8 @@ int root_handle_usecond_overflow_event(void * context, const mcu_event_t * data)
 }
 
 int root_handle_usecond_match_event(void * context, const mcu_event_t * data){
-	int i;
+	int id;
 	u32 next;
-	u32 tmp;
 	int new_priority;
 	mcu_channel_t chan_req;
 	u32 now;
@@ -555,27 +583,29 @@ int root_handle_usecond_match_event(void * context, const mcu_event_t * data){
 	mcu_tmr_disable(&tmr_handle, 0);
 	mcu_tmr_get(&tmr_handle, &now);
 
-	for(i=1; i < task_get_total(); i++){
+	while( (id = scheduler_timing_root_get_wake_queue_head()) != 0 ){
 
-		if( task_enabled_not_active(i) ){
-			tmp = sos_sched_table[i].wake.tv_usec;
+		//compare the current clock to the wake time
+		if( is_expired(&sos_sched_table[id].wake, now) == 0 ){
+			if( sos_sched_table[id].wake.tv_sec == sched_usecond_counter ){
+				//this is the next event to wake up
+				next = sos_sched_table[id].wake.tv_usec;
+			}
+			break;
+		}
 
-			//compare the current clock to the wake time
-			if ( (sos_sched_table[i].wake.tv_sec < sched_usecond_counter) ||
-				  ( (sos_sched_table[i].wake.tv_sec == sched_usecond_counter) && (tmp <= now) )
-				  ){
-				//wake this task
-				scheduler_root_assert_active(i, SCHEDULER_UNBLOCK_SLEEP);
-				if( !task_stopped_asserted(i) && (scheduler_priority(i) > new_priority) ){
-					new_priority = scheduler_priority(i);
-				}
+		scheduler_timing_root_dequeue_wake(id);
 
-			} else if ( (sos_sched_table[i].wake.tv_sec == sched_usecond_counter) && (tmp < next) ) {
-				//see if this is the next event to wake up
-				next = tmp;
+		//a task that was deleted while it was sleeping stays in the queue until now
+		if( task_enabled_not_active(id) ){
+			//wake this task
+			scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_SLEEP);
+			if( !task_stopped_asserted(id) && (scheduler_priority(id) > new_priority) ){
+				new_priority = scheduler_priority(id);
 			}
 		}
 	}
+
 	if ( next < SOS_USECOND_PERIOD ){
 		chan_req.value = next;
 	}
@@ -589,10 +619,9 @@ int root_handle_usecond_match_event(void * context, const mcu_event_t * data){
 
 int root_handle_usecond_process_timer_match_event(void * context, const mcu_event_t * data){
 	//a system timer expired
-	int i;
-	int j;
+	u16 entry;
+	u8 task_id;
 	u32 next;
-	u32 tmp;
 	mcu_channel_t chan_req;
 	u32 now;
 	devfs_handle_t tmr_handle;
@@ -608,38 +637,24 @@ int root_handle_usecond_process_timer_match_event(void * context, const mcu_even
 	mcu_tmr_disable(&tmr_handle, 0);
 	mcu_tmr_get(&tmr_handle, &now);
 
+	while( (entry = scheduler_timing_root_get_timer_queue_head()) != 0 ){
+		volatile sos_process_timer_t * timer = scheduler_timing_timer_entry_timer(entry);
 
-	for(i=1; i < task_get_total(); i++){
-		//look for the next signal
-
-		if( task_enabled(i) ){
-
-			for(j=0; j < SOS_PROCESS_TIMER_COUNT; j++){
-				volatile sos_process_timer_t * timer = sos_sched_table[i].timer + j;
-
-				if( timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED ){
-					tmp = timer->value.tv_usec;
-					if ( (timer->value.tv_sec < sched_usecond_counter) ||
-						  ( (timer->value.tv_sec == sched_usecond_counter) && (tmp <= now) )
-						  ){
-
-						//reload the timer if interval is valid
-						send_and_reload_timer(timer, i, now);
-
-						//if interval value is non-zero, need to check if this is less than next
-						if( timer->interval.tv_sec + timer->interval.tv_usec ){
-							tmp = timer->value.tv_usec;
-							if( (timer->value.tv_sec == sched_usecond_counter) && (tmp < next) ){
-								next = tmp;
-							}
-						}
-
-					} else if ( (timer->value.tv_sec == sched_usecond_counter) && (tmp < next) ) {
-						//see if this is the next event to wake up
-						next = tmp;
-					}
-				}
+		if( is_expired(&timer->value, now) == 0 ){
+			if( timer->value.tv_sec == sched_usecond_counter ){
+				//this is the next signal
+				next = timer->value.tv_usec;
 			}
+			break;
+		}
+
+		scheduler_timing_root_timer_queue_remove(entry);
+		task_id = scheduler_timing_timer_entry_task_id(entry);
+		if( task_enabled(task_id) &&
+			 (timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED) ){
+			//send the signal and reload the timer if interval is valid (the reloaded timer is later than now)
+			send_and_reload_timer(timer, task_id, now);
+			scheduler_timing_root_timer_queue_update(entry);
 		}
 	}
 
@@ -652,6 +667,11 @@ int root_handle_usecond_process_timer_match_event(void * context, const mcu_even
 	return 1;
 }
 
+int is_expired(volatile const struct mcu_timeval * value, u32 now){
+	return (value->tv_sec < sched_usecond_counter) ||
+			((value->tv_sec == sched_usecond_counter) && (value->tv_usec <= now));
+}
+
 
 int open_usecond_tmr(){
 	int err;
@@ -36,6 +36,7 @@ int scheduler_timing_init();
 u32 scheduler_timing_seconds_to_clocks(int seconds);
 u32 scheduler_timing_useconds_to_clocks(int useconds);
 void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * interval);
+int scheduler_timing_root_throttle(int id, struct mcu_timeval * abs_time) MCU_ROOT_CODE;
 
 void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts);
 void scheduler_timing_convert_mcu_timeval(struct timespec * ts, const struct mcu_timeval * mcu_tv);
@@ -47,6 +48,19 @@ struct mcu_timeval scheduler_timing_subtract_mcu_timeval(const struct mcu_timeva
 
 u32 scheduler_timing_get_realtime();
 
+//sorted sleep and process timer queues (scheduler_timing_queue.c)
+void scheduler_timing_root_queue_init() MCU_ROOT_CODE;
+int scheduler_timing_root_get_wake_queue_head() MCU_ROOT_CODE;
+void scheduler_timing_root_wake_queue_insert(int id) MCU_ROOT_CODE;
+void scheduler_timing_root_dequeue_wake(int id) MCU_ROOT_CODE;
+void scheduler_timing_root_dequeue_task(int id) MCU_ROOT_CODE;
+u16 scheduler_timing_root_get_timer_queue_head() MCU_ROOT_CODE;
+void scheduler_timing_root_timer_queue_remove(u16 entry) MCU_ROOT_CODE;
+void scheduler_timing_root_timer_queue_update(u16 entry) MCU_ROOT_CODE;
+u16 scheduler_timing_timer_entry(timer_t timer_id);
+u8 scheduler_timing_timer_entry_task_id(u16 entry);
+volatile sos_process_timer_t * scheduler_timing_timer_entry_timer(u16 entry);
+
 
 
 
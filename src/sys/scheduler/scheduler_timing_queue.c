@@ -0,0 +1,185 @@
+/* Copyright 2011-2017 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+
+#include <limits.h>
+#include "scheduler_local.h"
+
+/*
+ * Sleeping tasks and armed process timers are kept in queues that are
+ * sorted by expiration time (earliest first). The output compare handlers
+ * only look at the expired entries at the head of the queue and then
+ * program the next match using the new head.
+ *
+ * The sleep queue is linked by task ID (wake_next/wake_prev). The timer queue
+ * is linked by entry (task ID * SOS_PROCESS_TIMER_COUNT + offset + 1) using
+ * timer_next/timer_prev in the scheduler table. Zero is the end of either queue.
+ *
+ * The queues don't touch the timer so they are also built by the host
+ * tests (test/sys).
+ *
+ */
+static volatile u8 sched_wake_queue MCU_SYS_MEM;
+static volatile u16 sched_timer_queue MCU_SYS_MEM;
+
+static int is_earlier(volatile const struct mcu_timeval * a, volatile const struct mcu_timeval * b);
+static u8 get_timer_entry_id_offset(u16 entry){ return (entry - 1) % SOS_PROCESS_TIMER_COUNT; }
+static volatile u16 * get_timer_entry_next(u16 entry);
+static volatile u16 * get_timer_entry_prev(u16 entry);
+static void root_timer_queue_insert(u16 entry);
+
+void scheduler_timing_root_queue_init(){
+	sched_wake_queue = 0;
+	sched_timer_queue = 0;
+}
+
+int scheduler_timing_root_get_wake_queue_head(){ return sched_wake_queue; }
+u16 scheduler_timing_root_get_timer_queue_head(){ return sched_timer_queue; }
+
+u16 scheduler_timing_timer_entry(timer_t timer_id){
+	return (timer_id >> 8) * SOS_PROCESS_TIMER_COUNT + (timer_id & 0xFF) + 1;
+}
+
+u8 scheduler_timing_timer_entry_task_id(u16 entry){ return (entry - 1) / SOS_PROCESS_TIMER_COUNT; }
+
+int is_earlier(volatile const struct mcu_timeval * a, volatile const struct mcu_timeval * b){
+	return (a->tv_sec < b->tv_sec) ||
+			((a->tv_sec == b->tv_sec) && (a->tv_usec < b->tv_usec));
+}
+
+void scheduler_timing_root_wake_queue_insert(int id){
+	int prev = 0;
+	int next;
+
+	//Issue #130 -- the queue is also updated by the timer interrupt
+	cortexm_disable_interrupts();
+	next = sched_wake_queue;
+	while( next && !is_earlier(&sos_sched_table[id].wake, &sos_sched_table[next].wake) ){
+		prev = next;
+		next = sos_sched_table[next].wake_next;
+	}
+
+	sos_sched_table[id].wake_prev = prev;
+	sos_sched_table[id].wake_next = next;
+	if( prev ){
+		sos_sched_table[prev].wake_next = id;
+	} else {
+		sched_wake_queue = id;
+	}
+	if( next ){
+		sos_sched_table[next].wake_prev = id;
+	}
+	cortexm_enable_interrupts();
+}
+
+void scheduler_timing_root_dequeue_wake(int id){
+	int prev;
+	int next;
+
+	cortexm_disable_interrupts();
+	prev = sos_sched_table[id].wake_prev;
+	if( prev || (sched_wake_queue == id) ){
+		next = sos_sched_table[id].wake_next;
+		if( prev ){
+			sos_sched_table[prev].wake_next = next;
+		} else {
+			sched_wake_queue = next;
+		}
+		if( next ){
+			sos_sched_table[next].wake_prev = prev;
+		}
+		sos_sched_table[id].wake_next = 0;
+		sos_sched_table[id].wake_prev = 0;
+	}
+	cortexm_enable_interrupts();
+}
+
+void scheduler_timing_root_dequeue_task(int id){
+	int i;
+	scheduler_timing_root_dequeue_wake(id);
+	for(i=0; i < SOS_PROCESS_TIMER_COUNT; i++){
+		scheduler_timing_root_timer_queue_remove( scheduler_timing_timer_entry(SCHEDULER_TIMING_PROCESS_TIMER(id, i)) );
+	}
+}
+
+volatile sos_process_timer_t * scheduler_timing_timer_entry_timer(u16 entry){
+	return sos_sched_table[ scheduler_timing_timer_entry_task_id(entry) ].timer + get_timer_entry_id_offset(entry);
+}
+
+static volatile u16 * get_timer_entry_next(u16 entry){
+	return sos_sched_table[ scheduler_timing_timer_entry_task_id(entry) ].timer_next + get_timer_entry_id_offset(entry);
+}
+
+static volatile u16 * get_timer_entry_prev(u16 entry){
+	return sos_sched_table[ scheduler_timing_timer_entry_task_id(entry) ].timer_prev + get_timer_entry_id_offset(entry);
+}
+
+void root_timer_queue_insert(u16 entry){
+	volatile sos_process_timer_t * timer = scheduler_timing_timer_entry_timer(entry);
+	u16 prev = 0;
+	u16 next;
+
+	cortexm_disable_interrupts();
+	next = sched_timer_queue;
+	while( next && !is_earlier(&timer->value, &scheduler_timing_timer_entry_timer(next)->value) ){
+		prev = next;
+		next = *get_timer_entry_next(next);
+	}
+
+	*get_timer_entry_prev(entry) = prev;
+	*get_timer_entry_next(entry) = next;
+	if( prev ){
+		*get_timer_entry_next(prev) = entry;
+	} else {
+		sched_timer_queue = entry;
+	}
+	if( next ){
+		*get_timer_entry_prev(next) = entry;
+	}
+	cortexm_enable_interrupts();
+}
+
+void scheduler_timing_root_timer_queue_remove(u16 entry){
+	u16 prev;
+	u16 next;
+
+	cortexm_disable_interrupts();
+	prev = *get_timer_entry_prev(entry);
+	if( prev || (sched_timer_queue == entry) ){
+		next = *get_timer_entry_next(entry);
+		if( prev ){
+			*get_timer_entry_next(prev) = next;
+		} else {
+			sched_timer_queue = next;
+		}
+		if( next ){
+			*get_timer_entry_prev(next) = prev;
+		}
+		*get_timer_entry_next(entry) = 0;
+		*get_timer_entry_prev(entry) = 0;
+	}
+	cortexm_enable_interrupts();
+}
+
+void scheduler_timing_root_timer_queue_update(u16 entry){
+	scheduler_timing_root_timer_queue_remove(entry);
+	if( scheduler_timing_timer_entry_timer(entry)->value.tv_sec != SCHEDULER_TIMEVAL_SEC_INVALID ){
+		root_timer_queue_insert(entry);
+	}
+}
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include "sos/fs/sysfs.h"
+#include "sos/fs/devfs.h"
 
 #include "semaphore.h"
 #include "../scheduler/scheduler_local.h"
@@ -48,16 +49,21 @@ typedef struct {
 } sem_file_hdr_t;
 
 typedef struct {
+	void * next; //a freed entry keeps is_initialized at zero (the pool links objects using the first word)
 	sem_t sem;
-	void * next;
 } sem_list_t;
 
 static void svcall_sem_wait(void * args) MCU_ROOT_EXEC_CODE;
 static void svcall_sem_post(void * args) MCU_ROOT_EXEC_CODE;
+static void root_sem_post(int id) MCU_ROOT_EXEC_CODE;
+static void root_post(sem_t * sem) MCU_ROOT_EXEC_CODE;
+static void root_update_waiters(sem_t * sem) MCU_ROOT_EXEC_CODE;
 static void svcall_sem_trywait(void * args) MCU_ROOT_EXEC_CODE;
 static void svcall_sem_timedwait(void * args) MCU_ROOT_EXEC_CODE;
 
 static int check_initialized(sem_t * sem);
+static int is_valid(sem_t * sem);
+static int fast_post(sem_t * sem);
 
 typedef struct {
 	sem_t * sem;
@@ -69,6 +75,9 @@ typedef struct {
 
 static sem_list_t * sem_first = 0;
 
+#define SEM_POOL_GROW_COUNT 4
+static sos_pool_t sem_pool = SOS_POOL_INITIALIZER(sizeof(sem_list_t));
+
 static sem_t * sem_find_named(const char * name){
 	sem_list_t * entry;
 	for(entry = sem_first; entry != 0; entry = entry->next){
@@ -81,31 +90,38 @@ static sem_t * sem_find_named(const char * name){
 	return SEM_FAILED;
 }
 
-static sem_t * sem_find_free(){
-	sem_list_t * entry;
+static sem_t * sem_alloc(){
 	sem_list_t * new_entry;
-	sem_list_t * last_entry;
-	last_entry = 0;
-	for(entry = sem_first; entry != 0; entry = entry->next){
-		last_entry = entry;
-		if( entry->sem.is_initialized == 0 ){
-			return &entry->sem;
-		}
-	}
 
-	//no free semaphores
-	new_entry = _malloc_r(sos_task_table[0].global_reent, sizeof(sem_list_t));
+	//the list only has named semaphores that are in use
+	new_entry = sos_pool_alloc_kernel(&sem_pool, SEM_POOL_GROW_COUNT);
 	if( new_entry == 0 ){
 		return SEM_FAILED;
 	}
-	if( last_entry == 0 ){
-		sem_first = new_entry;
-	} else {
-		last_entry->next = new_entry;
-	}
-	new_entry->next = 0;
+	new_entry->next = sem_first;
+	sem_first = new_entry;
 	return &new_entry->sem;
 }
+
+static void sem_free(sem_t * sem){
+	sem_list_t * entry;
+	sem_list_t * prev_entry;
+
+	sem->is_initialized = 0;
+	prev_entry = 0;
+	for(entry = sem_first; entry != 0; entry = entry->next){
+		if( &entry->sem == sem ){
+			if( prev_entry == 0 ){
+				sem_first = entry->next;
+			} else {
+				prev_entry->next = entry->next;
+			}
+			sos_pool_free(&sem_pool, entry);
+			return;
+		}
+		prev_entry = entry;
+	}
+}
 /*! \endcond */
 
 /*! \details Initializes \a sem as an unnamed semaphore with
@@ -163,7 +179,8 @@ int sem_getvalue(sem_t *sem, int *sval){
 		return -1;
 	}
 
-	*sval = sem->value;
+	//a negative value only marks that threads are waiting
+	*sval = sem->value > 0 ? sem->value : 0;
 	return 0;
 }
 
@@ -232,7 +249,7 @@ sem_t * sem_open(const char * name, int oflag, ...){
 	switch(action){
 		case 0:
 			//Create the new semaphore
-			new_sem = sem_find_free();
+			new_sem = sem_alloc();
 			if ( new_sem == NULL ){
 				//errno is set by malloc
 				return SEM_FAILED;
@@ -280,7 +297,7 @@ int sem_close(sem_t *sem){
 	if ( sem->references == 0 ){
 		if( sem->is_initialized == 2 ){
 			//Close and delete
-			sem->is_initialized = 0;
+			sem_free(sem);
 			return 0;
 		}
 	}
@@ -295,26 +312,35 @@ int sem_close(sem_t *sem){
  *
  * If other threads or processes have called sem_wait() or sem_timedwait(),
  * the semaphore will be available and one of the threads will lock the semaphore.
+ * When no threads are waiting, the value is incremented without a kernel call.
  *
  */
 int sem_post(sem_t *sem){
-	int new_thread;
 
 	if ( check_initialized(sem) < 0 ){
 		return -1;
 	}
 
-	//unlock the semaphore -- increment the semaphore
-	sem->value++;
+	if( fast_post(sem) < 0 ){
+		//a thread is waiting -- the increment and wake must be atomic with respect to devfs_semaphore_callback()
+		cortexm_svcall(svcall_sem_post, sem);
+	}
 
-	//see if any tasks are blocked on this semaphore
-	new_thread = scheduler_get_highest_priority_blocked(sem);
+	return 0;
+}
 
-	if ( new_thread != -1 ){
-		cortexm_svcall(svcall_sem_post, &new_thread);
+int devfs_semaphore_callback(void * context, const mcu_event_t * data){
+	sem_t * sem = context;
+	MCU_UNUSED_ARGUMENT(data);
+
+	//errno and the caller's pid don't apply in the interrupt
+	if( is_valid(sem) == 0 ){
+		return 0; //stop calling back on a destroyed semaphore
 	}
 
-	return 0;
+	//this runs in the interrupt so it can post directly
+	root_post(sem);
+	return 1;
 }
 
 
@@ -418,7 +444,7 @@ int sem_unlink(const char *name){
 
 	if ( sem->references == 0 ){
 		//Close and delete
-		sem->is_initialized = 0;
+		sem_free(sem);
 		return 0;
 	} else {
 		//Close but don't delete until all references are gone
@@ -461,7 +487,47 @@ int sem_wait(sem_t *sem){
 
 void svcall_sem_post(void * args){
 	CORTEXM_SVCALL_ENTER();
-	int id = *((int*)args);
+	cortexm_disable_interrupts();
+	root_post(args);
+	cortexm_enable_interrupts();
+}
+
+void root_post(sem_t * sem){
+	int new_thread;
+
+	//unlock the semaphore -- a negative value is zero with threads waiting
+	if( sem->value < 0 ){
+		sem->value = 0;
+	}
+	sem->value++;
+
+	//see if any tasks are blocked on this semaphore
+	new_thread = scheduler_root_get_highest_priority_blocked(sem);
+	if( new_thread != -1 ){
+		root_sem_post(new_thread);
+	}
+}
+
+/*
+ * Called (with interrupts disabled) whenever the kernel looks at the value. A
+ * thread that was woken by a post can find more units available (sem_post()
+ * increments in user space while the value is not negative) so it wakes the
+ * next waiter. Otherwise, if threads are still waiting, the value is marked
+ * negative so the next sem_post() comes to the kernel.
+ *
+ */
+void root_update_waiters(sem_t * sem){
+	int new_thread = scheduler_root_get_highest_priority_blocked(sem);
+	if( new_thread != -1 ){
+		if( sem->value > 0 ){
+			root_sem_post(new_thread);
+		} else {
+			sem->value = -1;
+		}
+	}
+}
+
+void root_sem_post(int id){
 	sos_sched_table[id].block_object = NULL;
 	scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_SEMAPHORE);
 	scheduler_root_update_on_wake(id, task_get_priority(id));
@@ -471,13 +537,18 @@ void svcall_sem_timedwait(void * args){
 	CORTEXM_SVCALL_ENTER();
 	root_sem_args_t * p = (root_sem_args_t*)args;
 
+	//devfs_semaphore_callback() can post between the check and the block
+	cortexm_disable_interrupts();
 	if ( p->sem->value <= 0 ){
+		p->sem->value = -1;
 		scheduler_timing_root_timedblock(p->sem, &p->interval);
 		p->result = -1;
 	} else {
 		p->result = 0;
 		p->sem->value--;
+		root_update_waiters(p->sem);
 	}
+	cortexm_enable_interrupts();
 
 }
 
@@ -485,38 +556,98 @@ void svcall_sem_trywait(void * args){
 	CORTEXM_SVCALL_ENTER();
 	root_sem_args_t * p = (root_sem_args_t*)args;
 
+	cortexm_disable_interrupts();
 	if ( p->sem->value > 0 ){
 		p->sem->value--;
 		p->result = 0;
 	} else {
 		p->result = -1;
 	}
+	//a woken thread that lost the unit to another thread leaves the rest waiting
+	root_update_waiters(p->sem);
+	cortexm_enable_interrupts();
 }
 
 void svcall_sem_wait(void * args){
 	CORTEXM_SVCALL_ENTER();
 	root_sem_args_t * p = args;
 
+	//devfs_semaphore_callback() can post between the check and the sleep
+	cortexm_disable_interrupts();
 	sos_sched_table[ task_get_current() ].block_object = p->sem;
 
 	if ( p->sem->value <= 0){
-		//task must be blocked until the semaphore is available
+		//task must be blocked until the semaphore is available -- sem_post() has to wake it
+		p->sem->value = -1;
 		scheduler_root_update_on_sleep();
 		p->result = -1; //didn't get the semaphore
 	} else {
 		//got the semaphore
 		p->sem->value--;
 		p->result = 0;
+		root_update_waiters(p->sem);
 	}
+	cortexm_enable_interrupts();
 }
 
-int check_initialized(sem_t * sem){
-	if( sem == NULL ){
-		errno = EINVAL;
-		return -1;
-	}
+#if defined __arm__
+static int load_exclusive(volatile int * addr){
+	int value;
+	asm volatile ("ldrex %0, [%1]" : "=r" (value) : "r" (addr) : "memory");
+	return value;
+}
+
+static int store_exclusive(volatile int * addr, int value){
+	int result;
+	asm volatile ("strex %0, %2, [%1]" : "=&r" (result) : "r" (addr), "r" (value) : "memory");
+	return result;
+}
+
+static void clear_exclusive(){
+	asm volatile ("clrex" : : : "memory");
+}
+#else
+//host builds (test/sys) emulate the exclusive monitor with compare-and-swap
+static int m_exclusive_value;
+
+static int load_exclusive(volatile int * addr){
+	m_exclusive_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+	return m_exclusive_value;
+}
+
+static int store_exclusive(volatile int * addr, int value){
+	int expected = m_exclusive_value;
+	return !__atomic_compare_exchange_n(addr, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
 
-	if ( sem->is_initialized == 0 ){
+static void clear_exclusive(){}
+#endif
+
+/*
+ * The value is only negative while threads are waiting. Otherwise sem_post()
+ * increments it without a kernel call. An exception (including the kernel
+ * blocking a thread on the semaphore) between the exclusive load and store
+ * makes the store fail and the post is retried.
+ *
+ */
+int fast_post(sem_t * sem){
+	int value;
+	do {
+		value = load_exclusive(&sem->value);
+		if( value < 0 ){
+			clear_exclusive();
+			return -1;
+		}
+	} while( store_exclusive(&sem->value, value+1) );
+	return 0;
+}
+
+int is_valid(sem_t * sem){
+	return (sem != NULL) && (sem->is_initialized != 0);
+}
+
+int check_initialized(sem_t * sem){
+	if( is_valid(sem) == 0 ){
 		errno = EINVAL;
 		return -1;
 	}
@@ -200,8 +200,8 @@ int sffs_fstat(const void * cfg, void * handle, struct stat * stat){
 		stat->st_gid = 0;
 		stat->st_uid = 0;
 		stat->st_ino = (ino_t)h->segment_data.hdr.serialno;
-		stat->st_size = h->size;
-		stat->st_blocks = ((h->size + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE);
+		stat->st_size = sffs_file_getsize(h);
+		stat->st_blocks = ((stat->st_size + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE);
 		stat->st_blksize = BLOCK_DATA_SIZE;
 		stat->st_mode = 0666 | S_IFREG;
 		//stat->st_atime = 0;
@@ -386,6 +386,11 @@ int sffs_read(const void * cfg, void * handle, int flags, int loc, void * buf, i
 
 	h->op = &op;
 
+	if( h->flags & CL_HDR_FLAG_LOG ){
+		//segments before the head have been dropped from the log
+		loc += h->head_segment * BLOCK_DATA_SIZE;
+	}
+
 	op.loc = loc;
 	op.buf = buf;
 	op.nbyte = nbyte;
@@ -444,6 +449,17 @@ int sffs_write(const void * cfg, void * handle, int flags, int loc, const void *
 		return SYSFS_SET_RETURN(EACCES);
 	}
 
+	if( h->flags & CL_HDR_FLAG_LOG ){
+		lock_sffs(cfg);
+		if ( sffs_file_append(cfg, handle) < 0 ){
+			ret = -1;
+		} else {
+			ret = op.nbyte;
+		}
+		unlock_sffs(cfg);
+		return ret;
+	}
+
 	if ( sffs_file_startwrite(cfg, handle) == nbyte ){
 		return op.nbyte;
 	}
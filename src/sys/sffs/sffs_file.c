@@ -218,6 +218,194 @@ int sffs_file_finishwrite(const void * cfg, cl_handle_t * handle){
 	return 0;
 }
 
+static int open_tail_block(const void * cfg, cl_handle_t * handle, int offset){
+	block_t block;
+	int ret;
+
+	handle->mtime = 0;
+	block = sffs_block_alloc(cfg, handle->segment_data.hdr.serialno, handle->segment_list_block, BLOCK_TYPE_FILE_DATA);
+	if ( block == BLOCK_INVALID ){
+		sffs_error("could not alloc block\n");
+		return -1;
+	}
+
+	sffs_debug(DEBUG_LEVEL + 2, "appending segment %d to block %d\n", handle->segment, block);
+
+	//the block is closed with the file -- the unused part of the data stays erased for later appends
+	if ( sffs_block_setstatus(cfg, block, BLOCK_STATUS_OPEN) < 0 ){
+		sffs_error("could not open block %d\n", block);
+		return -1;
+	}
+
+	if ( offset > 0 ){
+		//copy the part of the tail that was written before this block was opened
+		if ( sffs_dev_write(cfg, get_sffs_block_data_addr(cfg, block), handle->segment_data.data, offset) != offset ){
+			sffs_error("could not copy tail to block %d\n", block);
+			return -1;
+		}
+	}
+
+	if( handle->segment < handle->append_segment ){
+		//the segment is referenced by the file on disk -- the old entry must be replaced
+		ret = sffs_filelist_update(cfg, handle->segment_list_block, handle->segment, block);
+	} else {
+		//the segment is new so there is no old entry to strike
+		ret = sffs_filelist_append(cfg, handle->segment_list_block, handle->segment, block);
+	}
+
+	if( ret < 0 ){
+		sffs_error("could not add tail to file list\n");
+		return -1;
+	}
+
+	handle->tail_block = block;
+	return 0;
+}
+
+static int append_trailer(const void * cfg, cl_handle_t * handle){
+	cl_hdr_trailer_t trailer;
+	devfs_async_t * op;
+	serial_t serialno;
+	int addr;
+
+	trailer.size = handle->size;
+	trailer.head_segment = handle->head_segment;
+	trailer.resd = 0xFF;
+	trailer.status = CL_HDR_TRAILER_STATUS_VALID;
+
+	addr = get_sffs_block_data_addr(cfg, handle->hdr_block) + sizeof(cl_hdr_t) + handle->trailer_count * sizeof(cl_hdr_trailer_t);
+
+	//the status is programmed last so a partially written record is never used
+	if ( sffs_dev_write(cfg, addr, &trailer, offsetof(cl_hdr_trailer_t, status)) != offsetof(cl_hdr_trailer_t, status) ){
+		sffs_error("failed to write trailer\n");
+		return -1;
+	}
+
+	if ( sffs_dev_write(cfg, addr + offsetof(cl_hdr_trailer_t, status), &(trailer.status), sizeof(trailer.status)) != sizeof(trailer.status) ){
+		sffs_error("failed to write trailer status\n");
+		return -1;
+	}
+
+	handle->trailer_count++;
+
+	if( handle->trailer_count == CL_HDR_TRAILER_TOTAL ){
+		//the header is full -- the file continues in a new header (the close data matches the last trailer)
+		op = handle->op;
+		serialno = handle->segment_data.hdr.serialno;
+		if( sffs_file_close(cfg, handle) < 0 ){
+			sffs_error("could not close log checkpoint\n");
+			return -1;
+		}
+
+		if( sffs_file_open(cfg, handle, serialno, handle->amode, false) < 0 ){
+			sffs_error("could not reopen log checkpoint\n");
+			return -1;
+		}
+		handle->op = op;
+	}
+
+	return 0;
+}
+
+static int drop_log_head(const void * cfg, cl_handle_t * handle){
+	int max_segments;
+	int addr;
+	block_t block;
+	uint8_t status;
+
+	if( SFFS_CONFIG(cfg)->log_max_size == 0 ){
+		return 0;
+	}
+
+	max_segments = (SFFS_CONFIG(cfg)->log_max_size + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE;
+	while( handle->segment - handle->head_segment + 1 > max_segments ){
+		block = sffs_filelist_get(cfg, handle->segment_list_block, handle->head_segment, SFFS_FILELIST_STATUS_CURRENT, &addr);
+		if( block != BLOCK_INVALID ){
+			if( handle->head_segment >= handle->append_segment ){
+				//the old version of the file doesn't reference this block -- discard it now
+				sffs_debug(DEBUG_LEVEL + 2, "discard log segment %d at block %d\n", handle->head_segment, block);
+				if ( sffs_block_discard(cfg, block) < 0 ){
+					sffs_error("failed to discard block\n");
+					return -1;
+				}
+				status = SFFS_FILELIST_STATUS_DIRTY;
+			} else {
+				//the block is discarded when the file is closed
+				status = SFFS_FILELIST_STATUS_OBSOLETE;
+			}
+
+			if ( sffs_filelist_setstatus(cfg, status, addr) < 0 ){
+				sffs_error("failed to set status of log segment\n");
+				return -1;
+			}
+		}
+		handle->head_segment++;
+	}
+	return 0;
+}
+
+int sffs_file_append(const void * cfg, cl_handle_t * handle){
+	int segment;
+	int offset;
+	int page_size;
+
+	//log files are always written at the end
+	handle->op->loc = handle->size;
+	handle->bytes_left = handle->op->nbyte;
+
+	while( handle->bytes_left > 0 ){
+		segment = handle->op->loc / BLOCK_DATA_SIZE;
+		offset = handle->op->loc % BLOCK_DATA_SIZE;
+		if( segment != handle->segment ){
+			if( offset == 0 ){
+				//the tail segment is full -- start the next one
+				handle->segment = segment;
+				memset(handle->segment_data.data, 0, BLOCK_DATA_SIZE);
+				handle->segment_data.hdr.status = BLOCK_STATUS_OPEN;
+				handle->tail_block = BLOCK_INVALID;
+			} else if( sffs_file_loadsegment(cfg, handle, segment) < 0 ){
+				//a read moved the RAM segment away from the tail
+				sffs_error("could not load tail segment\n");
+				return -1;
+			}
+		}
+
+		if( handle->tail_block == BLOCK_INVALID ){
+			if( (offset == 0) && (drop_log_head(cfg, handle) < 0) ){
+				sffs_error("could not drop log head\n");
+				return -1;
+			}
+
+			if( open_tail_block(cfg, handle, offset) < 0 ){
+				sffs_error("could not open tail block\n");
+				return -1;
+			}
+		}
+
+		page_size = write_current_segment(cfg, handle);
+
+		//only the new bytes are programmed -- the rest of the tail block is still erased
+		if ( sffs_dev_write(cfg, get_sffs_block_data_addr(cfg, handle->tail_block) + offset,
+								  &(handle->segment_data.data[offset]),
+								  page_size) != page_size ){
+			sffs_error("could not write tail block %d\n", handle->tail_block);
+			return -1;
+		}
+		handle->segment_data.hdr.status = BLOCK_STATUS_OPEN;
+	}
+
+	//the append is committed once the trailer is written
+	if( append_trailer(cfg, handle) < 0 ){
+		sffs_error("could not append trailer\n");
+		return -1;
+	}
+
+	if ( handle->op->handler.callback != NULL ){
+		cortexm_svcall((cortexm_svcall_t)svcall_execute_callback, handle);
+	}
+	return 0;
+}
+
 int sffs_file_remove(const void * cfg, serial_t serialno){
 	int addr;
 	block_t sffs_block_num;
@@ -365,12 +553,15 @@ int sffs_file_read(const void * cfg, cl_handle_t * handle, int start_segment, in
 int sffs_file_open(const void * cfg, cl_handle_t * handle, serial_t serialno, int amode, bool trunc){
 	block_t block;
 	cl_hdr_t * hdr;
+	int segment;
+	int serialno_addr; //the handle is packed
 
-	block = sffs_serialno_get(cfg, serialno, SFFS_SNLIST_ITEM_STATUS_CLOSED, &(handle->serialno_addr));
+	block = sffs_serialno_get(cfg, serialno, SFFS_SNLIST_ITEM_STATUS_CLOSED, &serialno_addr);
 	if ( block == BLOCK_INVALID ){
 		sffs_error("serialno does not exist\n");
 		return -1;
 	}
+	handle->serialno_addr = serialno_addr;
 
 	sffs_debug(DEBUG_LEVEL, "file exists at block %d\n", block);
 
@@ -392,10 +583,11 @@ int sffs_file_open(const void * cfg, cl_handle_t * handle, serial_t serialno, in
 			}
 
 			//add an entry in the serial number list -- this entry will be marked as open
-			if ( sffs_serialno_append(cfg, serialno, block, &(handle->serialno_addr), SFFS_SNLIST_ITEM_STATUS_OPEN) < 0 ){
+			if ( sffs_serialno_append(cfg, serialno, block, &serialno_addr, SFFS_SNLIST_ITEM_STATUS_OPEN) < 0 ){
 				sffs_error("failed to append new serialno %d %d\n", serialno, block);
 				return -1;
 			}
+			handle->serialno_addr = serialno_addr;
 
 			if ( (hdr->open.content_block = sffs_filelist_consolidate(cfg, serialno, hdr->open.content_block)) == BLOCK_INVALID ){
 				sffs_error("failed to consolidate list\n");
@@ -436,9 +628,32 @@ int sffs_file_open(const void * cfg, cl_handle_t * handle, serial_t serialno, in
 			handle->size = hdr->close.size;
 		}
 
-		sffs_debug(DEBUG_LEVEL, "Load first segment\n");
-		if ( sffs_file_loadsegment(cfg, handle, 0) < 0 ){
-			sffs_error("failed to load segment 0\n");
+		if( hdr->close.flags == CL_HDR_FLAGS_ERASED ){
+			handle->flags = 0;
+			handle->head_segment = 0;
+		} else {
+			handle->flags = hdr->close.flags;
+			handle->head_segment = hdr->close.head_segment;
+		}
+
+		if( handle->size == 0 ){
+			handle->head_segment = 0;
+		}
+
+		handle->append_segment = (handle->size + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE;
+		handle->tail_block = BLOCK_INVALID;
+		handle->trailer_count = 0;
+
+		if( (handle->flags & CL_HDR_FLAG_LOG) && (amode & W_OK) ){
+			//appends start in the tail segment
+			segment = handle->size / BLOCK_DATA_SIZE;
+		} else {
+			segment = handle->head_segment;
+		}
+
+		sffs_debug(DEBUG_LEVEL, "Load first segment %d\n", segment);
+		if ( sffs_file_loadsegment(cfg, handle, segment) < 0 ){
+			sffs_error("failed to load segment %d\n", segment);
 			return -1;
 		}
 
@@ -454,6 +669,7 @@ int sffs_file_new(const void * cfg, cl_handle_t * handle, const char * name, int
 	cl_hdr_t hdr;
 	block_t block;
 	block_t list_block;
+	int serialno_addr; //the handle is packed
 
 	//Allocate the block for the file header
 	if ( (block = sffs_block_alloc(cfg, entry->serialno, BLOCK_INVALID, type)) == BLOCK_INVALID ){
@@ -463,10 +679,11 @@ int sffs_file_new(const void * cfg, cl_handle_t * handle, const char * name, int
 
 	sffs_debug(DEBUG_LEVEL, "new file serialno %d block %d\n", entry->serialno, block);
 	//mark the serial number as "open" in the serial number list
-	if ( sffs_serialno_append(cfg, entry->serialno, block, &(handle->serialno_addr), SFFS_SNLIST_ITEM_STATUS_OPEN) < 0 ){
+	if ( sffs_serialno_append(cfg, entry->serialno, block, &serialno_addr, SFFS_SNLIST_ITEM_STATUS_OPEN) < 0 ){
 		sffs_error("failed to append serialno\n");
 		return -1;
 	}
+	handle->serialno_addr = serialno_addr;
 
 	//Allocate the block for the file data list
 	if ( (list_block = sffs_block_alloc(cfg, entry->serialno, block, BLOCK_TYPE_FILE_LIST)) == BLOCK_INVALID ){
@@ -484,6 +701,11 @@ int sffs_file_new(const void * cfg, cl_handle_t * handle, const char * name, int
 	handle->mtime = 0;
 	handle->amode = amode;
 	handle->op = NULL;
+	handle->flags = (mode & SFFS_MODE_LOG) ? CL_HDR_FLAG_LOG : 0;
+	handle->head_segment = 0;
+	handle->append_segment = 0;
+	handle->tail_block = BLOCK_INVALID;
+	handle->trailer_count = 0;
 
 	sffs_debug(DEBUG_LEVEL, "new file: list block:%d\n", list_block);
 
@@ -644,46 +866,13 @@ int mark_file_closed(const void * cfg, block_t hdr_block){
 	return 0;
 }
 
-int sffs_file_close(const void * cfg, cl_handle_t * handle){
-	cl_hdr_t hdr;
+static int close_version(const void * cfg, serial_t serialno, block_t hdr_block, int addr){
 	block_t block;
 	uint8_t discard_status;
 	int old_addr;
 
-	if ( !(handle->amode & W_OK) ){
-		//if the file was not written (ie. opened read-only), nothing needs to be done here
-		return 0;
-	}
-
-	//write the RAM segment to disk if it has been modified
-	sffs_debug(DEBUG_LEVEL, "Saving segment\n");
-	if ( sffs_file_savesegment(cfg, handle) ){
-		sffs_error("Failed to save file segment\n");
-		return -1;
-	}
-
-	//write the header to the file -- with the size and modified/accessed date
-	hdr.close.size = handle->size;
-
-	sffs_debug(DEBUG_LEVEL, "content block is %d\n", handle->segment_list_block);
-	sffs_debug(DEBUG_LEVEL, "write to header block %d\n", handle->hdr_block);
-
-	CL_TP_DESC(CL_PROB_COMMON, "about to close (size not written)");
-
-
-	//Write the information available on close (size is written on close)
-	sffs_debug(DEBUG_LEVEL, "close file (size:%d content block:%d)\n", hdr.close.size, handle->segment_list_block);
-	if ( sffs_dev_write(cfg, get_sffs_block_data_addr(cfg, handle->hdr_block) + offsetof(cl_hdr_t, close),
-							  &hdr.close,
-							  sizeof(cl_hdr_close_t)) != sizeof(cl_hdr_close_t) ){
-		sffs_error("failed to write close data\n");
-		return -2;
-	}
-
-	//this should be handled the same every time
-
 	//get the address of the old serial number
-	block = sffs_serialno_get(cfg, handle->segment_data.hdr.serialno, SFFS_SNLIST_ITEM_STATUS_CLOSED, &old_addr);
+	block = sffs_serialno_get(cfg, serialno, SFFS_SNLIST_ITEM_STATUS_CLOSED, &old_addr);
 	sffs_debug(DEBUG_LEVEL, "Old block is %d\n", block);
 
 	if ( block != BLOCK_INVALID ){
@@ -694,15 +883,15 @@ int sffs_file_close(const void * cfg, cl_handle_t * handle){
 		discard_status = SFFS_SNLIST_ITEM_STATUS_DISCARDING_HDR_LIST;
 
 		sffs_debug(DEBUG_LEVEL, "finish close status 0x%X hdr %d old hdr %d serialno %d\n",
-					  discard_status, handle->hdr_block, block, handle->segment_data.hdr.serialno);
-		if ( finish_close(cfg, discard_status, handle->hdr_block, block, handle->serialno_addr, old_addr, false) < 0 ){
-			return -3;
+					  discard_status, hdr_block, block, serialno);
+		if ( finish_close(cfg, discard_status, hdr_block, block, addr, old_addr, false) < 0 ){
+			return -1;
 		}
 
 	} else {
 
 		sffs_debug(DEBUG_LEVEL, "closing new file (file did not previously exist)\n");
-		if ( sffs_serialno_setstatus(cfg, handle->serialno_addr, SFFS_SNLIST_ITEM_STATUS_CLOSING) < 0 ){
+		if ( sffs_serialno_setstatus(cfg, addr, SFFS_SNLIST_ITEM_STATUS_CLOSING) < 0 ){
 			sffs_error("failed to close out new serialno\n");
 			return -1;
 		}
@@ -710,7 +899,7 @@ int sffs_file_close(const void * cfg, cl_handle_t * handle){
 		CL_TP_DESC(CL_PROB_COMMON, "CLOSING but not cleaned");
 
 		//Close the file (includes discarding obsolete segments)
-		if ( mark_file_closed(cfg, handle->hdr_block) < 0 ){
+		if ( mark_file_closed(cfg, hdr_block) < 0 ){
 			sffs_error("failed to clean file list block\n");
 			return -1;
 		}
@@ -719,13 +908,177 @@ int sffs_file_close(const void * cfg, cl_handle_t * handle){
 		CL_TP_DESC(CL_PROB_COMMON, "cleaned but not CLOSED");
 
 
-		if ( sffs_serialno_setstatus(cfg, handle->serialno_addr, SFFS_SNLIST_ITEM_STATUS_CLOSED) < 0 ){
+		if ( sffs_serialno_setstatus(cfg, addr, SFFS_SNLIST_ITEM_STATUS_CLOSED) < 0 ){
 			sffs_error("failed to close out new serialno\n");
-			return -4;
+			return -1;
 		}
 
 	}
 
+	return 0;
+}
+
+/*! \details This function rolls an open log file forward to the
+ * last append that wrote a trailer.
+ *
+ * \return 1 if the file was closed, 0 if there is nothing to recover
+ */
+static int recover_log(const void * cfg, serial_t serialno, block_t hdr_block, int addr){
+	sffs_block_data_t tmp;
+	cl_hdr_t * hdr;
+	cl_hdr_trailer_t * trailer;
+	cl_hdr_close_t close_data;
+	sffs_list_t list;
+	sffs_filelist_item_t file_item;
+	sffs_block_hdr_t block_hdr;
+	int filelist_addr;
+	int tail_addr;
+	int nsegments;
+	int first_segment;
+	int i;
+
+	if( hdr_block >= sffs_block_gettotal(cfg) ){
+		//power was lost while the serial number entry was written
+		return 0;
+	}
+
+	if ( sffs_block_load(cfg, hdr_block, &tmp) < 0 ){
+		sffs_error("failed to load block %d\n", hdr_block);
+		return -1;
+	}
+
+	if ( tmp.hdr.type != BLOCK_TYPE_FILE_HDR ){
+		return 0;
+	}
+
+	hdr = (cl_hdr_t*)tmp.data;
+	trailer = (cl_hdr_trailer_t*)(tmp.data + sizeof(cl_hdr_t));
+
+	//find the last committed append
+	for(i=0; i < CL_HDR_TRAILER_TOTAL; i++){
+		if( trailer[i].status != CL_HDR_TRAILER_STATUS_VALID ){
+			break;
+		}
+	}
+
+	if( i == 0 ){
+		//nothing was appended -- the file rolls back to the last closed version
+		return 0;
+	}
+
+	//the close data is always written to match the last trailer -- it may be partially written
+	close_data.size = trailer[i-1].size;
+	close_data.flags = CL_HDR_FLAG_LOG;
+	close_data.resd = 0xFF;
+	close_data.head_segment = trailer[i-1].head_segment;
+
+	sffs_debug(DEBUG_LEVEL, "recover log serialno %d size %d\n", serialno, close_data.size);
+
+	//segments past the committed size were never part of the file
+	nsegments = (close_data.size + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE;
+	first_segment = nsegments;
+	tail_addr = -1;
+	if ( sffs_filelist_init(cfg, &list, hdr->open.content_block) < 0 ){
+		sffs_error("failed to init file list\n");
+		return -1;
+	}
+
+	while( sffs_list_getnext(cfg, &list, &file_item, &filelist_addr) == 0 ){
+		if( file_item.status == SFFS_FILELIST_STATUS_CURRENT ){
+			if( file_item.segment >= nsegments ){
+				//the entry may be partially written (the status is programmed first) so the block isn't used --
+				//the block is still OPEN and is discarded with the other open blocks
+				if( sffs_filelist_setstatus(cfg, SFFS_FILELIST_STATUS_DIRTY, filelist_addr) < 0 ){
+					sffs_error("failed to set status to dirty\n");
+					return -1;
+				}
+			} else if( (sffs_block_loadhdr(cfg, &block_hdr, file_item.block) == 0) && (block_hdr.status == BLOCK_STATUS_DIRTY) ){
+				//power was lost while the head of the log was dropped -- finish dropping it
+				if( sffs_filelist_setstatus(cfg, SFFS_FILELIST_STATUS_DIRTY, filelist_addr) < 0 ){
+					sffs_error("failed to set status to dirty\n");
+					return -1;
+				}
+			} else {
+				if( file_item.segment == nsegments - 1 ){
+					if( tail_addr != -1 ){
+						//the tail was copied to a new block but the old entry was not struck
+						if( sffs_filelist_setstatus(cfg, SFFS_FILELIST_STATUS_OBSOLETE, tail_addr) < 0 ){
+							sffs_error("failed to set status to obsolete\n");
+							return -1;
+						}
+					}
+					tail_addr = filelist_addr;
+				}
+
+				if( file_item.segment < first_segment ){
+					first_segment = file_item.segment;
+				}
+			}
+		}
+	}
+
+	//the head may have been dropped after the last trailer was written
+	if( (close_data.head_segment < first_segment) && (first_segment < nsegments) ){
+		close_data.head_segment = first_segment;
+	}
+
+	if( memcmp(&(hdr->close), &close_data, sizeof(cl_hdr_close_t)) != 0 ){
+		//programming the same value over the part that was written leaves it unchanged
+		if ( sffs_dev_write(cfg, get_sffs_block_data_addr(cfg, hdr_block) + offsetof(cl_hdr_t, close),
+								  &close_data,
+								  sizeof(cl_hdr_close_t)) != sizeof(cl_hdr_close_t) ){
+			sffs_error("failed to write close data\n");
+			return -1;
+		}
+	}
+
+	if ( close_version(cfg, serialno, hdr_block, addr) < 0 ){
+		sffs_error("failed to close recovered log\n");
+		return -1;
+	}
+
+	return 1;
+}
+
+int sffs_file_close(const void * cfg, cl_handle_t * handle){
+	cl_hdr_t hdr;
+
+	if ( !(handle->amode & W_OK) ){
+		//if the file was not written (ie. opened read-only), nothing needs to be done here
+		return 0;
+	}
+
+	//write the RAM segment to disk if it has been modified
+	sffs_debug(DEBUG_LEVEL, "Saving segment\n");
+	if ( sffs_file_savesegment(cfg, handle) ){
+		sffs_error("Failed to save file segment\n");
+		return -1;
+	}
+
+	//write the header to the file -- with the size and modified/accessed date
+	hdr.close.size = handle->size;
+	hdr.close.flags = handle->flags;
+	hdr.close.resd = 0xFF;
+	hdr.close.head_segment = handle->head_segment;
+
+	sffs_debug(DEBUG_LEVEL, "content block is %d\n", handle->segment_list_block);
+	sffs_debug(DEBUG_LEVEL, "write to header block %d\n", handle->hdr_block);
+
+	CL_TP_DESC(CL_PROB_COMMON, "about to close (size not written)");
+
+
+	//Write the information available on close (size is written on close)
+	sffs_debug(DEBUG_LEVEL, "close file (size:%d content block:%d)\n", hdr.close.size, handle->segment_list_block);
+	if ( sffs_dev_write(cfg, get_sffs_block_data_addr(cfg, handle->hdr_block) + offsetof(cl_hdr_t, close),
+							  &hdr.close,
+							  sizeof(cl_hdr_close_t)) != sizeof(cl_hdr_close_t) ){
+		sffs_error("failed to write close data\n");
+		return -2;
+	}
+
+	if ( close_version(cfg, handle->segment_data.hdr.serialno, handle->hdr_block, handle->serialno_addr) < 0 ){
+		return -3;
+	}
 
 	return 0;
 }
@@ -737,11 +1090,18 @@ int sffs_file_clean(const void * cfg, serial_t serialno, block_t hdr_block, uint
 	block_t new_block;
 	sffs_block_data_t sffs_block_data;
 	bool already_closed;
+	int ret;
 
 
 	sffs_debug(DEBUG_LEVEL, "cleaning file %d\n", serialno);
 
 	old_block = sffs_serialno_get(cfg, serialno, status, &old_addr);
+	if ( old_block == BLOCK_INVALID ){
+		//the entry was partially written when power was lost -- sffs_serialno_get() discards it for the bad checksum
+		sffs_debug(DEBUG_LEVEL, "discarded serialno %d with bad checksum\n", serialno);
+		return 1;
+	}
+
 	if ( hdr_block != old_block ){
 		sffs_error("failed to clean file\n");
 		return -1;
@@ -813,6 +1173,17 @@ int sffs_file_clean(const void * cfg, serial_t serialno, block_t hdr_block, uint
 
 				sffs_debug(DEBUG_LEVEL, "clean CLOSING file (other file is already closed)\n");
 
+				//a log file is committed by its trailers so it rolls forward instead
+				ret = recover_log(cfg, serialno, hdr_block, old_addr);
+				if ( ret < 0 ){
+					sffs_error("failed to recover log\n");
+					return -1;
+				}
+
+				if ( ret == 1 ){
+					return 1;
+				}
+
 				//the file already exists as "CLOSED"
 				sffs_debug(DEBUG_LEVEL, "cleaning CLOSING file but original is still CLOSED\n");
 				if ( cleanup_file(cfg, old_block, old_addr, SFFS_SNLIST_ITEM_STATUS_DISCARDING_HDR) < 0 ){
@@ -826,6 +1197,17 @@ int sffs_file_clean(const void * cfg, serial_t serialno, block_t hdr_block, uint
 		case SFFS_SNLIST_ITEM_STATUS_OPEN:
 
 			sffs_debug(DEBUG_LEVEL, "cleaning open file\n");
+			ret = recover_log(cfg, serialno, hdr_block, old_addr);
+			if ( ret < 0 ){
+				sffs_error("failed to recover log\n");
+				return -1;
+			}
+
+			if ( ret == 1 ){
+				//the log is closed at its last trailer -- open blocks past it are discarded
+				return 1;
+			}
+
 			if ( sffs_serialno_setstatus(cfg, old_addr, SFFS_SNLIST_ITEM_STATUS_DIRTY) < 0 ){
 				sffs_error("failed to close file\n");
 				return -1;
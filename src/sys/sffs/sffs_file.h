@@ -67,6 +67,12 @@ int sffs_file_finishread(const void * cfg, cl_handle_t * handle);
 int sffs_file_startwrite(const void * cfg, cl_handle_t * handle);
 int sffs_file_finishwrite(const void * cfg, cl_handle_t * handle);
 
+int sffs_file_append(const void * cfg, cl_handle_t * handle);
+
+static inline int sffs_file_getsize(const cl_handle_t * handle){
+	return handle->size - handle->head_segment * BLOCK_DATA_SIZE;
+}
+
 int sffs_file_read(const void * cfg, cl_handle_t * handle, int start_segment,  int nsegments);
 void sffs_file_getsegment(const void * cfg, sffs_file_segment_t * segment, int loc);
 
@@ -138,6 +138,27 @@ int sffs_filelist_update(const void * cfg, block_t list_block, int segment, bloc
 	return 0;
 }
 
+int sffs_filelist_append(const void * cfg, block_t list_block, int segment, block_t new_block){
+	sffs_filelist_item_t item;
+	sffs_list_t list;
+
+	if ( sffs_filelist_init(cfg, &list, list_block) < 0 ){
+		return -1;
+	}
+
+	//the segment is not in the list yet so there is no need to look for an entry to strike
+	sffs_debug(DEBUG_LEVEL, "Appending new segment %d\n", segment);
+	item.status = SFFS_FILELIST_STATUS_CURRENT;
+	item.resd = 0xFF;
+	item.block = new_block;
+	item.segment = segment;
+	if( sffs_list_append(cfg, &list, BLOCK_TYPE_FILE_LIST, &item, NULL) < 0 ){
+		return -1;
+	}
+
+	return 0;
+}
+
 block_t sffs_filelist_consolidate(const void * cfg, serial_t serialno, block_t list_block){
 	return sffs_list_consolidate(cfg, serialno, list_block, BLOCK_TYPE_FILE_LIST, sizeof(sffs_filelist_item_t), is_dirty, sffs_filelist_isfree);
 }
@@ -62,6 +62,7 @@ typedef struct {
 
 block_t sffs_filelist_get(const void * cfg, block_t list_block, int segment, uint8_t status, int * addr);
 int sffs_filelist_update(const void * cfg, block_t list_block, int segment, block_t new_block);
+int sffs_filelist_append(const void * cfg, block_t list_block, int segment, block_t new_block);
 int sffs_filelist_setstatus(const void * cfg, uint8_t status, int addr);
 block_t sffs_filelist_consolidate(const void * cfg, serial_t serialno, block_t list_block);
 
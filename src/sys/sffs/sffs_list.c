@@ -36,6 +36,7 @@ static int get_item_addr(const void * cfg, block_t block, int item, int item_siz
 static block_t list_add_block(const void * cfg, serial_t serialno, uint8_t type, block_t list_block);
 static int list_update(const void * cfg, sffs_list_t * list, block_t prev_block);
 static bool list_typeisvalid(uint8_t type);
+static block_t get_next_block(const void * cfg, const sffs_list_hdr_t * hdr);
 
 bool list_typeisvalid(uint8_t type){
 	if ( (type & BLOCK_TYPE_LIST_FLAG) == 0 ){
@@ -58,6 +59,14 @@ void * get_item(sffs_list_block_t * list, int n, int item_size){
 	return list->data + (item_size * n);
 }
 
+block_t get_next_block(const void * cfg, const sffs_list_hdr_t * hdr){
+	if ( hdr->next >= sffs_block_gettotal(cfg) ){
+		//BLOCK_INVALID or the link was partially written when power was lost
+		return BLOCK_INVALID;
+	}
+	return hdr->next;
+}
+
 int get_hdr_addr(const void * cfg, block_t block){
 	return block * BLOCK_SIZE + BLOCK_HEADER_SIZE;
 }
@@ -169,7 +178,7 @@ int sffs_list_getnext(const void * cfg, sffs_list_t * list, void * item, int * a
 
 	if ( list->current_item == list->total_in_block ){
 		sffs_debug(DEBUG_LEVEL + 2, "load next block %d\n", ptr->hdr.next);
-		if ( ptr->hdr.next != BLOCK_INVALID ){
+		if ( get_next_block(cfg, &(ptr->hdr)) != BLOCK_INVALID ){
 			current_block = list->current_block;
 			list->current_block = ptr->hdr.next;
 			if ( current_block == ptr->hdr.next ){
@@ -177,8 +186,11 @@ int sffs_list_getnext(const void * cfg, sffs_list_t * list, void * item, int * a
 				return -1;
 			}
 			if ( list_update(cfg, list, current_block) < 0 ){
+				//the block was being linked when power was lost -- the list ends with the item that was just read
 				sffs_error("error loading block %d\n", list->current_block);
-				return -1;
+				list->current_block = current_block;
+				list->current_item = list->total_in_block;
+				return 0;
 			}
 		} else {
 			sffs_debug(DEBUG_LEVEL, "end of list (none free)\n");
@@ -197,7 +209,7 @@ int sffs_list_setblockstatus(const void * cfg, block_t list_block, uint8_t statu
 	int total;
 
 	last_block = BLOCK_INVALID;
-	for(tmp_block = list_block; tmp_block != BLOCK_INVALID; tmp_block = hdr.next){
+	for(tmp_block = list_block; tmp_block != BLOCK_INVALID; tmp_block = get_next_block(cfg, &hdr)){
 
 		if ( sffs_dev_read(cfg, get_hdr_addr(cfg, tmp_block), &hdr, sizeof(hdr)) != sizeof(hdr) ){
 			sffs_error("failed to read\n");
@@ -205,6 +217,11 @@ int sffs_list_setblockstatus(const void * cfg, block_t list_block, uint8_t statu
 		}
 
 		if ( hdr.prev != last_block ){
+			if ( last_block != BLOCK_INVALID ){
+				//power was lost while this block was linked -- it is still OPEN and is discarded with the open blocks
+				sffs_debug(DEBUG_LEVEL, "list ends at partially linked block %d\n", tmp_block);
+				break;
+			}
 			sffs_error("bad list\n");
 			return -1;
 		}
@@ -340,7 +357,7 @@ block_t sffs_list_consolidate(const void * cfg,
 
 	j = 0;
 	copied_items = 0;
-	for( list->hdr.next = list_block; list->hdr.next != BLOCK_INVALID ; ){
+	for( list->hdr.next = list_block; get_next_block(cfg, &(list->hdr)) != BLOCK_INVALID ; ){
 		old_current_block = list->hdr.next;
 		if ( sffs_block_load(cfg, list->hdr.next, &sffs_block_data) < 0 ){
 			return -1;
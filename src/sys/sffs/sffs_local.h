@@ -103,13 +103,32 @@ typedef struct {
 
 typedef struct {
 	int32_t size;
+	u8 flags;
+	u8 resd;
+	u16 head_segment;
 } cl_hdr_close_t;
 
+#define CL_HDR_FLAG_LOG 0x01
+//headers written before the flags were added read back as erased
+#define CL_HDR_FLAGS_ERASED 0xFF
+
 typedef struct MCU_PACK {
 	cl_hdr_open_t open;
 	cl_hdr_close_t close;
 } cl_hdr_t;
 
+//log files commit each append by programming a trailer record after the header
+typedef struct MCU_PACK {
+	int32_t size;
+	u16 head_segment;
+	u8 resd;
+	u8 status;
+} cl_hdr_trailer_t;
+
+#define CL_HDR_TRAILER_STATUS_FREE 0xFF
+#define CL_HDR_TRAILER_STATUS_VALID 0x00
+#define CL_HDR_TRAILER_TOTAL ((BLOCK_DATA_SIZE - sizeof(cl_hdr_t)) / sizeof(cl_hdr_trailer_t))
+
 
 typedef struct MCU_PACK {
 	block_t hdr_block /*! the block for the file header */;
@@ -120,6 +139,11 @@ typedef struct MCU_PACK {
 	int size /*! The size of the file */;
 	u8 amode /*! The open mode */;
 	u16 segment /*! The segment of the file */;
+	u8 flags /*! CL_HDR_FLAG_LOG for append-only log files */;
+	u16 head_segment /*! The first segment that has not been dropped from a log file */;
+	u16 append_segment /*! The first segment that was created since the file was opened */;
+	block_t tail_block /*! The block holding the partially written tail of a log file */;
+	u8 trailer_count /*! The number of trailer records written to the header block */;
 	u32 mtime /*! The time of the last modification */;
 	sffs_block_data_t segment_data; /*! The RAM buffer for the segment */;
 } cl_handle_t;
@@ -0,0 +1,95 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <errno.h>
+#include "sos/sos.h"
+#include "cortexm/cortexm.h"
+#include "scheduler/scheduler_local.h"
+
+typedef struct {
+	volatile u32 * addr;
+	u32 value;
+	struct mcu_timeval abs_timeout;
+	int result;
+} root_futex_wait_t;
+
+static void svcall_futex_wait(void * args) MCU_ROOT_EXEC_CODE;
+static void svcall_futex_wake(void * args) MCU_ROOT_EXEC_CODE;
+
+int sos_futex_wait(volatile u32 * addr, u32 value, const struct timespec * abs_timeout){
+	root_futex_wait_t args;
+	int unblock_type;
+
+	args.addr = addr;
+	args.value = value;
+	scheduler_timing_convert_timespec(&args.abs_timeout, abs_timeout);
+	cortexm_svcall(svcall_futex_wait, &args);
+
+	if( args.result < 0 ){
+		errno = SYSFS_GET_RETURN_ERRNO(args.result);
+		return -1;
+	}
+
+	if( args.result > 0 ){
+		unblock_type = scheduler_unblock_type(task_get_current());
+		if( unblock_type == SCHEDULER_UNBLOCK_SLEEP ){
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		if( unblock_type == SCHEDULER_UNBLOCK_SIGNAL ){
+			errno = EINTR;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void sos_futex_wake(volatile u32 * addr){
+	cortexm_svcall(svcall_futex_wake, (void*)addr);
+}
+
+void svcall_futex_wait(void * args){
+	CORTEXM_SVCALL_ENTER();
+	root_futex_wait_t * p = args;
+
+	if( task_validate_memory((void*)p->addr, sizeof(u32)) < 0 ){
+		p->result = SYSFS_SET_RETURN(EPERM);
+		return;
+	}
+
+	//the value changed before the thread could block -- the caller should check again
+	if( *(p->addr) != p->value ){
+		p->result = 0;
+		return;
+	}
+
+	//if the timeout has already passed, the thread doesn't block and this reports the timeout
+	scheduler_root_set_unblock_type(task_get_current(), SCHEDULER_UNBLOCK_SLEEP);
+	scheduler_timing_root_timedblock((void*)p->addr, &p->abs_timeout);
+	p->result = 1;
+}
+
+void svcall_futex_wake(void * args){
+	CORTEXM_SVCALL_ENTER();
+	int priority;
+	priority = scheduler_root_unblock_all(args, SCHEDULER_UNBLOCK_FUTEX);
+	scheduler_root_update_on_wake(-1, priority);
+}
@@ -0,0 +1,192 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <errno.h>
+#include "sos/sos.h"
+
+/*
+ * The free list is updated with LDREX/STREX. The Cortex-M clears the local
+ * exclusive monitor on every exception entry and exit, so if an interrupt (or
+ * a context switch) modifies the list between the load and the store, the
+ * store fails and the operation is retried. That makes the pop safe from the
+ * ABA problem on a single core without disabling interrupts, which also means
+ * applications (which run unprivileged) can use the same code.
+ *
+ */
+
+#if defined __arm__
+static void * load_exclusive(void * volatile * addr){
+	void * value;
+	asm volatile ("ldrex %0, [%1]" : "=r" (value) : "r" (addr) : "memory");
+	return value;
+}
+
+static int store_exclusive(void * volatile * addr, void * value){
+	int result;
+	asm volatile ("strex %0, %2, [%1]" : "=&r" (result) : "r" (addr), "r" (value) : "memory");
+	return result;
+}
+
+static void clear_exclusive(){
+	asm volatile ("clrex" : : : "memory");
+}
+#else
+//host builds (test/sys) emulate the exclusive monitor: any successful store clears every monitor
+static volatile unsigned int m_exclusive_generation;
+static volatile char m_exclusive_lock;
+static __thread unsigned int m_exclusive_tag;
+
+static void * load_exclusive(void * volatile * addr){
+	m_exclusive_tag = __atomic_load_n(&m_exclusive_generation, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+}
+
+static int store_exclusive(void * volatile * addr, void * value){
+	int result = 1;
+	while( __atomic_test_and_set(&m_exclusive_lock, __ATOMIC_ACQUIRE) ){}
+	if( m_exclusive_tag == m_exclusive_generation ){
+		__atomic_store_n(addr, value, __ATOMIC_RELEASE);
+		m_exclusive_generation++;
+		result = 0;
+	}
+	__atomic_clear(&m_exclusive_lock, __ATOMIC_RELEASE);
+	return result;
+}
+
+static void clear_exclusive(){}
+#endif
+
+int sos_pool_init(sos_pool_t * pool, void * memory, u32 size, u16 object_size){
+	pool->free = 0;
+	pool->object_size = SOS_POOL_OBJECT_SIZE(object_size);
+	pool->resd = 0;
+	pool->memory = 0;
+	return sos_pool_extend(pool, memory, size);
+}
+
+int sos_pool_create(sos_pool_t * pool, u16 object_size, u16 count){
+	void * memory;
+	u32 size = SOS_POOL_SIZE(object_size, count);
+
+	memory = malloc(size);
+	if( memory == 0 ){
+		return -1;
+	}
+
+	if( sos_pool_init(pool, memory, size, object_size) < 0 ){
+		free(memory);
+		return -1;
+	}
+
+	pool->memory = memory;
+	return 0;
+}
+
+void sos_pool_destroy(sos_pool_t * pool){
+	pool->free = 0;
+	if( pool->memory ){
+		free(pool->memory);
+		pool->memory = 0;
+	}
+}
+
+int sos_pool_extend(sos_pool_t * pool, void * memory, u32 size){
+	u32 count;
+	u32 i;
+
+	if( ((u32)memory & 0x03) || (pool->object_size == 0) ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	count = size / pool->object_size;
+	if( count == 0 ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	//push in reverse so objects are handed out in address order
+	for(i=count; i > 0; i--){
+		sos_pool_free(pool, (char*)memory + (i-1)*pool->object_size);
+	}
+	return count;
+}
+
+void * sos_pool_alloc(sos_pool_t * pool){
+	void * object;
+	do {
+		object = load_exclusive(&pool->free);
+		if( object == 0 ){
+			clear_exclusive();
+			return 0;
+		}
+	} while( store_exclusive(&pool->free, *(void**)object) );
+	return object;
+}
+
+void sos_pool_free(sos_pool_t * pool, void * object){
+	do {
+		*(void**)object = load_exclusive(&pool->free);
+	} while( store_exclusive(&pool->free, object) );
+}
+
+int sos_pool_create_kernel(sos_pool_t * pool, u16 object_size, u16 count){
+	void * memory;
+	u32 size = SOS_POOL_SIZE(object_size, count);
+
+	memory = _malloc_r(sos_task_table[0].global_reent, size);
+	if( memory == 0 ){
+		return -1;
+	}
+
+	if( sos_pool_init(pool, memory, size, object_size) < 0 ){
+		_free_r(sos_task_table[0].global_reent, memory);
+		return -1;
+	}
+
+	pool->memory = memory;
+	return 0;
+}
+
+void sos_pool_destroy_kernel(sos_pool_t * pool){
+	pool->free = 0;
+	if( pool->memory ){
+		_free_r(sos_task_table[0].global_reent, pool->memory);
+		pool->memory = 0;
+	}
+}
+
+void * sos_pool_alloc_kernel(sos_pool_t * pool, u16 count){
+	void * object;
+	void * memory;
+	u32 size;
+
+	object = sos_pool_alloc(pool);
+	if( object == 0 ){
+		//kernel object pools grow from the global heap -- freed objects go back to the pool for the next allocation
+		size = pool->object_size * count;
+		memory = _malloc_r(sos_task_table[0].global_reent, size);
+		if( memory == 0 ){
+			return 0;
+		}
+		sos_pool_extend(pool, memory, size);
+		object = sos_pool_alloc(pool);
+	}
+	return object;
+}
@@ -0,0 +1,300 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "sos/sos.h"
+
+/*
+ * Each slot starts with a sequence number. For the lap where the ring head
+ * is n, a free slot holds n and a written slot holds n+1. Reading the slot
+ * sets it to n+count which is the value the writer on the next lap expects.
+ * A writer that sees a sequence behind the head knows the ring is full, and
+ * the reader knows the ring is empty if the sequence isn't tail+1.
+ *
+ * A blocked thread waits on the sequence of the slot it needs, so it is only
+ * woken when that slot changes. The reader waits on the slot at the tail and
+ * writers only wait when the ring is full (on the slot at the head, which is
+ * the same slot), so the other side skips the wake for any other slot. The waiter counts are set before the sequence
+ * is checked again in the kernel (sos_futex_wait()) and the other side reads
+ * them after it changes the sequence, so a wake can't be missed.
+ *
+ */
+
+typedef struct {
+	volatile u32 sequence;
+	u32 item[];
+} ring_slot_t;
+
+#if defined __arm__
+static u32 load_exclusive(volatile u32 * addr){
+	u32 value;
+	asm volatile ("ldrex %0, [%1]" : "=r" (value) : "r" (addr) : "memory");
+	return value;
+}
+
+static int store_exclusive(volatile u32 * addr, u32 value){
+	int result;
+	asm volatile ("strex %0, %2, [%1]" : "=&r" (result) : "r" (addr), "r" (value) : "memory");
+	return result;
+}
+
+static void clear_exclusive(){
+	asm volatile ("clrex" : : : "memory");
+}
+
+static void memory_barrier(){
+	asm volatile ("dmb" : : : "memory");
+}
+#else
+//host builds (test/sys) emulate the exclusive monitor with compare-and-swap
+static __thread u32 m_exclusive_value;
+
+static u32 load_exclusive(volatile u32 * addr){
+	m_exclusive_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+	return m_exclusive_value;
+}
+
+static int store_exclusive(volatile u32 * addr, u32 value){
+	u32 expected = m_exclusive_value;
+	return !__atomic_compare_exchange_n(addr, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static void clear_exclusive(){}
+
+static void memory_barrier(){
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+static void atomic_add(volatile u32 * addr, int value){
+	u32 current;
+	do {
+		current = load_exclusive(addr);
+	} while( store_exclusive(addr, current + value) );
+}
+
+static ring_slot_t * get_slot(sos_ring_t * ring, u32 sequence){
+	return (ring_slot_t*)((char*)ring->buffer + (sequence & (ring->count - 1)) * SOS_RING_SLOT_SIZE(ring->item_size));
+}
+
+static int try_write(sos_ring_t * ring, const void * item, ring_slot_t ** slot, u32 * sequence);
+static int try_read(sos_ring_t * ring, void * item, ring_slot_t ** slot, u32 * sequence);
+
+/*! \details Initializes a ring using \a buffer for the slots.
+ *
+ * \param ring The ring to initialize
+ * \param buffer Memory for the slots (word aligned)
+ * \param size The number of bytes in \a buffer (see SOS_RING_SIZE())
+ * \param item_size The number of bytes in each item
+ * \param o_flags Zero or SOS_RING_FLAG_IS_MULTI_PRODUCER
+ *
+ * \return The number of slots (the largest power of 2 that fits in \a buffer)
+ * or -1 with errno set to EINVAL if \a buffer is not aligned or is too small
+ *
+ */
+int sos_ring_init(sos_ring_t * ring, void * buffer, u32 size, u16 item_size, u32 o_flags){
+	u32 count;
+	u32 i;
+
+	if( ((u32)buffer & 0x03) || (item_size == 0) ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	count = size / SOS_RING_SLOT_SIZE(item_size);
+	if( count == 0 ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	if( count > 32768 ){
+		count = 32768;
+	}
+
+	ring->buffer = buffer;
+	ring->item_size = item_size;
+	ring->count = 1 << (31 - __builtin_clz(count));
+	ring->o_flags = o_flags;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->write_waiters = 0;
+	ring->read_waiters = 0;
+
+	for(i=0; i < ring->count; i++){
+		get_slot(ring, i)->sequence = i;
+	}
+
+	return ring->count;
+}
+
+/*! \details Copies \a item to the ring. If the ring is full,
+ * the calling thread blocks until a slot is free.
+ *
+ * \param abs_timeout Absolute CLOCK_REALTIME timeout (null to wait forever)
+ *
+ * \return Zero on success or -1 with errno set to ETIMEDOUT or EINTR
+ *
+ */
+int sos_ring_write(sos_ring_t * ring, const void * item, const struct timespec * abs_timeout){
+	ring_slot_t * slot;
+	u32 sequence;
+	int result;
+
+	while( try_write(ring, item, &slot, &sequence) < 0 ){
+		atomic_add(&ring->write_waiters, 1);
+		memory_barrier();
+		result = sos_futex_wait(&slot->sequence, sequence, abs_timeout);
+		atomic_add(&ring->write_waiters, -1);
+		if( result < 0 ){
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*! \details Copies \a item to the ring without blocking.
+ *
+ * \return Zero on success or -1 with errno set to EAGAIN if the ring is full
+ *
+ */
+int sos_ring_trywrite(sos_ring_t * ring, const void * item){
+	ring_slot_t * slot;
+	u32 sequence;
+
+	if( try_write(ring, item, &slot, &sequence) < 0 ){
+		errno = EAGAIN;
+		return -1;
+	}
+	return 0;
+}
+
+/*! \details Copies the oldest item in the ring to \a item. If the ring
+ * is empty, the calling thread blocks until an item is written.
+ *
+ * Only one thread may read a ring.
+ *
+ * \param abs_timeout Absolute CLOCK_REALTIME timeout (null to wait forever)
+ *
+ * \return Zero on success or -1 with errno set to ETIMEDOUT or EINTR
+ *
+ */
+int sos_ring_read(sos_ring_t * ring, void * item, const struct timespec * abs_timeout){
+	ring_slot_t * slot;
+	u32 sequence;
+	int result;
+
+	while( try_read(ring, item, &slot, &sequence) < 0 ){
+		ring->read_waiters = 1;
+		memory_barrier();
+		result = sos_futex_wait(&slot->sequence, sequence, abs_timeout);
+		ring->read_waiters = 0;
+		if( result < 0 ){
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*! \details Copies the oldest item in the ring to \a item
+ * without blocking.
+ *
+ * \return Zero on success or -1 with errno set to EAGAIN if the ring is empty
+ *
+ */
+int sos_ring_tryread(sos_ring_t * ring, void * item){
+	ring_slot_t * slot;
+	u32 sequence;
+
+	if( try_read(ring, item, &slot, &sequence) < 0 ){
+		errno = EAGAIN;
+		return -1;
+	}
+	return 0;
+}
+
+int try_write(sos_ring_t * ring, const void * item, ring_slot_t ** slot, u32 * sequence){
+	const int is_multi_producer = ring->o_flags & SOS_RING_FLAG_IS_MULTI_PRODUCER;
+	u32 head;
+	s32 diff;
+
+	do {
+		if( is_multi_producer ){
+			head = load_exclusive(&ring->head);
+		} else {
+			head = ring->head;
+		}
+
+		*slot = get_slot(ring, head);
+		*sequence = (*slot)->sequence;
+		diff = *sequence - head;
+
+		if( diff != 0 ){
+			if( is_multi_producer ){
+				clear_exclusive();
+			}
+
+			//the slot hasn't been read since the last lap
+			if( diff < 0 ){
+				return -1;
+			}
+		} else if( is_multi_producer == 0 ){
+			ring->head = head + 1;
+			break;
+		}
+
+		//diff > 0 means another producer took the slot -- try the next one
+	} while( (diff != 0) || store_exclusive(&ring->head, head + 1) );
+
+	memcpy((*slot)->item, item, ring->item_size);
+	memory_barrier();
+	(*slot)->sequence = head + 1;
+
+	memory_barrier();
+	//the reader only waits on the slot at its tail
+	if( ring->read_waiters && (ring->tail == head) ){
+		sos_futex_wake(&(*slot)->sequence);
+	}
+	return 0;
+}
+
+int try_read(sos_ring_t * ring, void * item, ring_slot_t ** slot, u32 * sequence){
+	u32 tail = ring->tail;
+
+	*slot = get_slot(ring, tail);
+	*sequence = (*slot)->sequence;
+	if( *sequence != tail + 1 ){
+		return -1;
+	}
+
+	memory_barrier();
+	memcpy(item, (*slot)->item, ring->item_size);
+	memory_barrier();
+	(*slot)->sequence = tail + ring->count;
+	ring->tail = tail + 1;
+
+	memory_barrier();
+	//writers only wait on this slot if the ring was full
+	if( ring->write_waiters && ((s32)(ring->head - tail) >= ring->count) ){
+		sos_futex_wake(&(*slot)->sequence);
+	}
+	return 0;
+}
@@ -0,0 +1,357 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "sos/sos.h"
+#include "sos/dev/ffifo.h"
+
+/*
+ * The worker is a thread in the process that starts the splice so it uses
+ * the process's file descriptors and heap. With an ffifo on either side, the
+ * filesystem reads or writes the frames in place. For a stream_ffifo, those are
+ * the same frames the DMA fills or empties, so the only copy is the one the
+ * filesystem makes to (or from) the flash.
+ *
+ * The worker waits for the device with poll() and a timeout so it can see
+ * the stop flag while the device is idle. Each chunk costs as few kernel
+ * calls as possible: the frames are returned and the next ones are borrowed
+ * with a single I_FFIFO_EXCHANGE_READ (or _WRITE) request, and poll()
+ * is only called when the device has run out of data (or space).
+ *
+ */
+
+#define SPLICE_POLL_TIMEOUT_MS 100
+
+static void * splice_thread(void * args);
+static int is_running(sos_splice_t * splice);
+static u32 get_transfer_size(sos_splice_t * splice, u32 size);
+static int wait_for_events(sos_splice_t * splice, int fd, short events);
+static int acquire_frames(sos_splice_t * splice, int fd, int request, ffifo_lend_t * lend, short events);
+static int release_frames(sos_splice_t * splice, int fd, int request, ffifo_lend_t * lend, short events);
+static int return_frames(int fd, int request, ffifo_lend_t * lend, int lent);
+static int splice_from_ffifo(sos_splice_t * splice);
+static int splice_to_ffifo(sos_splice_t * splice);
+static int splice_with_buffer(sos_splice_t * splice);
+
+/*! \details Starts copying data from \a fd_in to \a fd_out
+ * in a new thread.
+ *
+ * \param splice The splice object (must remain valid until sos_splice_stop() returns)
+ * \param fd_in The input file descriptor (opened for reading)
+ * \param fd_out The output file descriptor (opened for writing)
+ * \param nbyte The number of bytes to transfer (zero to transfer until stopped or the end of the input)
+ * \param o_flags Zero or one of SOS_SPLICE_FLAG_IS_INPUT_FFIFO or SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL: both SOS_SPLICE_FLAG_IS_INPUT_FFIFO and SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO are set
+ * - ENOMEM: not enough memory to create the thread
+ *
+ */
+int sos_splice_start(sos_splice_t * splice, int fd_in, int fd_out, u32 nbyte, u32 o_flags){
+	const u32 ffifo_flags = SOS_SPLICE_FLAG_IS_INPUT_FFIFO | SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO;
+
+	//device to device connections are handled by the switchboard
+	if( (o_flags & ffifo_flags) == ffifo_flags ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	splice->fd_in = fd_in;
+	splice->fd_out = fd_out;
+	splice->nbyte = nbyte;
+	splice->bytes_transferred = 0;
+	splice->overflow_count = 0;
+	splice->error = 0;
+	splice->o_flags = o_flags & ffifo_flags;
+
+	return pthread_create(&splice->thread, 0, splice_thread, splice);
+}
+
+/*! \details Stops a splice and waits for the worker thread
+ * to finish the chunk it is transferring.
+ *
+ * \return The number of bytes transferred or -1 with errno set
+ * to the error that stopped the transfer
+ *
+ */
+int sos_splice_stop(sos_splice_t * splice){
+	splice->o_flags |= SOS_SPLICE_FLAG_IS_STOP;
+	if( pthread_join(splice->thread, 0) < 0 ){
+		return -1;
+	}
+
+	if( splice->error ){
+		errno = splice->error;
+		return -1;
+	}
+
+	return splice->bytes_transferred;
+}
+
+void * splice_thread(void * args){
+	sos_splice_t * splice = args;
+	int result;
+
+	if( splice->o_flags & SOS_SPLICE_FLAG_IS_INPUT_FFIFO ){
+		result = splice_from_ffifo(splice);
+	} else if( splice->o_flags & SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO ){
+		result = splice_to_ffifo(splice);
+	} else {
+		result = splice_with_buffer(splice);
+	}
+
+	if( result < 0 ){
+		splice->error = errno;
+	}
+	splice->o_flags |= SOS_SPLICE_FLAG_IS_DONE;
+	return 0;
+}
+
+int is_running(sos_splice_t * splice){
+	if( splice->o_flags & SOS_SPLICE_FLAG_IS_STOP ){
+		return 0;
+	}
+	return (splice->nbyte == 0) || (splice->bytes_transferred < splice->nbyte);
+}
+
+u32 get_transfer_size(sos_splice_t * splice, u32 size){
+	u32 bytes_remaining;
+	if( splice->nbyte == 0 ){
+		return size;
+	}
+	bytes_remaining = splice->nbyte - splice->bytes_transferred;
+	if( size > bytes_remaining ){
+		return bytes_remaining;
+	}
+	return size;
+}
+
+int wait_for_events(sos_splice_t * splice, int fd, short events){
+	struct pollfd pfd;
+	int result;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	do {
+		result = poll(&pfd, 1, SPLICE_POLL_TIMEOUT_MS);
+		if( result < 0 ){
+			return -1;
+		}
+
+		if( result > 0 ){
+			return 1;
+		}
+	} while( (splice->o_flags & SOS_SPLICE_FLAG_IS_STOP) == 0 );
+
+	return 0;
+}
+
+int acquire_frames(sos_splice_t * splice, int fd, int request, ffifo_lend_t * lend, short events){
+	int result;
+	do {
+		lend->frame_count = 0;
+		result = ioctl(fd, request, lend);
+		if( (result < 0) && (errno == EAGAIN) ){
+			result = wait_for_events(splice, fd, events);
+			if( result <= 0 ){
+				return result;
+			}
+		} else {
+			return result;
+		}
+	} while( 1 );
+}
+
+int release_frames(sos_splice_t * splice, int fd, int request, ffifo_lend_t * lend, short events){
+	int result = ioctl(fd, request, lend);
+	if( result < 0 ){
+		if( errno == EIO ){
+			//the device overwrote (input) or zero-filled (output) the frames while they were lent
+			splice->overflow_count++;
+		} else if( errno == EAGAIN ){
+			//the frames were returned but the device isn't ready with more -- skip the acquire that would fail
+			if( wait_for_events(splice, fd, events) < 0 ){
+				return -1;
+			}
+		} else {
+			return -1;
+		}
+		//nothing is lent
+		return 0;
+	}
+	return result;
+}
+
+int splice_from_ffifo(sos_splice_t * splice){
+	ffifo_lend_t lend;
+	int result;
+	int lent;
+	int request;
+	u32 size;
+
+	lent = 0;
+	while( is_running(splice) ){
+		if( lent == 0 ){
+			lent = acquire_frames(splice, splice->fd_in, I_FFIFO_ACQUIRE_READ, &lend, POLLIN);
+			if( lent <= 0 ){
+				return lent;
+			}
+		}
+
+		//a partial frame is only written (and consumed) at the end of the transfer
+		size = get_transfer_size(splice, lend.frame_count * lend.frame_size);
+		result = write(splice->fd_out, lend.frame, size);
+		if( result > 0 ){
+			splice->bytes_transferred += result;
+			lend.frame_count = (result + lend.frame_size - 1) / lend.frame_size;
+		} else {
+			lend.frame_count = 0;
+		}
+
+		//while the transfer continues, the next frames are borrowed with the same request
+		if( ((u32)result == size) && is_running(splice) ){
+			request = I_FFIFO_EXCHANGE_READ;
+		} else {
+			request = I_FFIFO_RELEASE_READ;
+		}
+
+		lent = release_frames(splice, splice->fd_in, request, &lend, POLLIN);
+		if( (lent < 0) || (result < 0) ){
+			return -1;
+		}
+
+		if( (u32)result < size ){
+			errno = ENOSPC;
+			return -1;
+		}
+	}
+
+	return return_frames(splice->fd_in, I_FFIFO_RELEASE_READ, &lend, lent);
+}
+
+int splice_to_ffifo(sos_splice_t * splice){
+	ffifo_lend_t lend;
+	int result;
+	int lent;
+	int request;
+	u16 frame_count;
+	u32 size;
+
+	lent = 0;
+	while( is_running(splice) ){
+		if( lent == 0 ){
+			lent = acquire_frames(splice, splice->fd_out, I_FFIFO_ACQUIRE_WRITE, &lend, POLLOUT);
+			if( lent <= 0 ){
+				return lent;
+			}
+		}
+
+		size = get_transfer_size(splice, lend.frame_count * lend.frame_size);
+		result = read(splice->fd_in, lend.frame, size);
+		if( result > 0 ){
+			//the end of the input is padded to a full frame
+			splice->bytes_transferred += result;
+			frame_count = (result + lend.frame_size - 1) / lend.frame_size;
+			memset((char*)lend.frame + result, 0, frame_count * lend.frame_size - result);
+			lend.frame_count = frame_count;
+		} else {
+			lend.frame_count = 0;
+		}
+
+		if( ((u32)result == size) && is_running(splice) ){
+			request = I_FFIFO_EXCHANGE_WRITE;
+		} else {
+			request = I_FFIFO_RELEASE_WRITE;
+		}
+
+		lent = release_frames(splice, splice->fd_out, request, &lend, POLLOUT);
+		if( lent < 0 ){
+			return -1;
+		}
+
+		//zero is the end of the input
+		if( result <= 0 ){
+			return result;
+		}
+	}
+
+	return return_frames(splice->fd_out, I_FFIFO_RELEASE_WRITE, &lend, lent);
+}
+
+int return_frames(int fd, int request, ffifo_lend_t * lend, int lent){
+	//the splice was stopped after an exchange borrowed more frames
+	if( lent > 0 ){
+		lend->frame_count = 0;
+		ioctl(fd, request, lend);
+	}
+	return 0;
+}
+
+int splice_with_buffer(sos_splice_t * splice){
+	char * buffer;
+	int result = 0;
+	int bytes_written;
+	u32 size;
+	int is_drained;
+
+	buffer = malloc(BUFSIZ);
+	if( buffer == 0 ){
+		return -1;
+	}
+
+	is_drained = 1;
+	while( is_running(splice) ){
+		//a read that filled the buffer means more data is probably ready (no need to poll)
+		if( is_drained ){
+			result = wait_for_events(splice, splice->fd_in, POLLIN);
+			if( result <= 0 ){
+				break;
+			}
+		}
+
+		size = get_transfer_size(splice, BUFSIZ);
+		result = read(splice->fd_in, buffer, size);
+		if( result <= 0 ){
+			break;
+		}
+		is_drained = (u32)result < size;
+
+		bytes_written = write(splice->fd_out, buffer, result);
+		if( bytes_written > 0 ){
+			splice->bytes_transferred += bytes_written;
+		}
+
+		if( bytes_written != result ){
+			if( bytes_written >= 0 ){
+				errno = ENOSPC;
+			}
+			result = -1;
+			break;
+		}
+	}
+
+	free(buffer);
+	return result < 0 ? -1 : 0;
+}
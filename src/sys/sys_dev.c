@@ -32,10 +32,14 @@
 #include "signal/sig_local.h"
 #include "device/sys.h"
 #include "symbols.h"
+#include "malloc/malloc_local.h"
 
 extern void mcu_core_hardware_id();
 
 static int read_task(sys_taskattr_t * task);
+static int read_heap_info(sys_heapinfo_t * info);
+static int read_task_stats_list(sys_taskstats_list_t * list);
+static void read_task_stats(int start, int count, sys_taskstats_t * stats);
 static int sys_setattr(const devfs_handle_t * handle, void * ctl);
 
 
@@ -125,6 +129,12 @@ int sys_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 		case I_SYS_SETATTR:
 			return sys_setattr(handle, ctl);
 
+		case I_SYS_GETHEAPINFO:
+			return read_heap_info(ctl);
+
+		case I_SYS_GETTASKSTATS:
+			return read_task_stats_list(ctl);
+
 
 
 		default:
@@ -134,7 +144,30 @@ int sys_ioctl(const devfs_handle_t * handle, int request, void * ctl){
 }
 
 int sys_read(const devfs_handle_t * handle, devfs_async_t * rop){
-	return SYSFS_SET_RETURN(ENOTSUP);
+	//the device reads as an array of sys_taskstats_t indexed by task ID
+	int start;
+	int count;
+
+	if( (rop->loc < 0) || (rop->loc % sizeof(sys_taskstats_t)) ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	start = rop->loc / sizeof(sys_taskstats_t);
+	if( start >= task_get_total() ){
+		return 0; //end of file
+	}
+
+	count = rop->nbyte / sizeof(sys_taskstats_t);
+	if( count == 0 ){
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
+	if( count > task_get_total() - start ){
+		count = task_get_total() - start;
+	}
+
+	read_task_stats(start, count, rop->buf);
+	return count * sizeof(sys_taskstats_t);
 }
 
 int sys_write(const devfs_handle_t * handle, devfs_async_t * wop){
@@ -192,6 +225,66 @@ int read_task(sys_taskattr_t * task){
 	return ret;
 }
 
+int read_heap_info(sys_heapinfo_t * info){
+	u32 tid = info->tid;
+	if( (tid >= task_get_total()) || (task_enabled(tid) == 0) ){
+		return SYSFS_SET_RETURN(ESRCH);
+	}
+
+	//all threads in a process share the heap attached to the global reent
+	if( malloc_get_heap_info((struct _reent*)sos_task_table[tid].global_reent, info) < 0 ){
+		return SYSFS_SET_RETURN(errno);
+	}
+	return 0;
+}
+
+int read_task_stats_list(sys_taskstats_list_t * list){
+	u32 count = list->count;
+
+	if( count > task_get_total() ){
+		count = task_get_total();
+	}
+
+	//the array isn't part of the request so it is checked here
+	if( task_validate_memory(list->stats, count * sizeof(sys_taskstats_t)) < 0 ){
+		return SYSFS_SET_RETURN(EPERM);
+	}
+
+	read_task_stats(0, count, list->stats);
+	list->count = count;
+	list->total = task_get_total();
+	return 0;
+}
+
+void read_task_stats(int start, int count, sys_taskstats_t * stats){
+	int i;
+	int tid;
+
+	for(i=0; i < count; i++){
+		tid = start + i;
+		memset(stats + i, 0, sizeof(sys_taskstats_t));
+		//interrupts that wake tasks can't change the task while its entry is copied (but can run between entries)
+		cortexm_disable_interrupts();
+		stats[i].tid = tid;
+		if( task_enabled(tid) ){
+			stats[i].is_enabled = 1;
+			stats[i].pid = task_get_pid(tid);
+			stats[i].timer = task_root_gettime(tid);
+			stats[i].root_timer = sos_task_table[tid].root_time;
+			stats[i].wake_count = sos_task_table[tid].wake_count;
+			stats[i].voluntary_switch_count = sos_task_table[tid].voluntary_switch_count;
+			stats[i].involuntary_switch_count = sos_task_table[tid].involuntary_switch_count;
+			memcpy(stats[i].block_time, (void*)sos_sched_table[tid].block_time, sizeof(stats[i].block_time));
+			stats[i].deadline_miss_count = sos_sched_table[tid].deadline.miss_count;
+			stats[i].deadline_overrun_count = sos_sched_table[tid].deadline.overrun_count;
+			stats[i].prio = task_get_priority(tid);
+			stats[i].is_active = (task_active_asserted(tid) != 0) | ((task_stopped_asserted(tid) != 0)<<1);
+			stats[i].is_thread = task_thread_asserted(tid);
+		}
+		cortexm_enable_interrupts();
+	}
+}
+
 int sys_setattr(const devfs_handle_t * handle, void * ctl){
 	int result;
 	const sys_attr_t * attr = ctl;
@@ -213,6 +213,14 @@ int devfs_write(const void * cfg, void * handle, int flags, int loc, const void
 	return devfs_data_transfer(cfg, handle, flags, loc, (void*)buf, nbyte, 0);
 }
 
+int devfs_readv(const void * cfg, void * handle, int flags, int loc, const struct iovec * iov, int iovcnt){
+	return devfs_data_transfer_vector(cfg, handle, flags, loc, iov, iovcnt, 1);
+}
+
+int devfs_writev(const void * cfg, void * handle, int flags, int loc, const struct iovec * iov, int iovcnt){
+	return devfs_data_transfer_vector(cfg, handle, flags, loc, iov, iovcnt, 0);
+}
+
 int devfs_aio(const void * config, void * handle, struct aiocb * aio){
 	return devfs_aio_data_transfer(handle, aio);
 }
@@ -225,6 +233,11 @@ int devfs_ioctl(const void * cfg, void * handle, int request, void * ctl){
 		return devfs_lookup_name(list, handle, ctl);
 	}
 
+	if( request == I_DEVFS_POLL ){
+		//the poll handler is executed in privileged mode -- only poll() can use this
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
 	args.cfg = cfg;
 	args.handle = handle;
 	args.request = request;
@@ -22,61 +22,139 @@
 typedef struct {
 	const devfs_device_t * device;
 	struct aiocb * aiocbp;
-	int read;
 	int result;
 } root_aio_transfer_t;
 
-//static int data_transfer_callback(struct aiocb * aiocbp, const void * ignore);
-static void svcall_device_data_transfer(void * args);
+typedef struct {
+	const devfs_device_t * const * device_list;
+	struct aiocb * const * list;
+	int nent;
+	int result;
+} root_aio_list_transfer_t;
 
-void svcall_device_data_transfer(void * args){
-	CORTEXM_SVCALL_ENTER();
-	root_aio_transfer_t * p = (root_aio_transfer_t*)args;
+static void svcall_device_data_transfer(void * args) MCU_ROOT_EXEC_CODE;
+static void svcall_device_data_transfer_list(void * args) MCU_ROOT_EXEC_CODE;
+static int root_start_transfer(const devfs_device_t * device, struct aiocb * aiocbp) MCU_ROOT_CODE;
+static int root_validate_queue(const aio_queue_t * queue) MCU_ROOT_CODE;
+static void prepare_transfer(struct aiocb * aiocbp);
+
+int root_start_transfer(const devfs_device_t * device, struct aiocb * aiocbp){
+	int result;
 
-    cortexm_disable_interrupts(); //no switching until the transfer is started -- does Issue #130 change this
+	cortexm_disable_interrupts(); //no switching until the transfer is started -- does Issue #130 change this
 	//set the device callback for the read/write op
-	if ( p->read == 1 ){
-		//Read operation
-        p->result = p->device->driver.read(&p->device->handle, (devfs_async_t*)&p->aiocbp->async);
+	if ( aiocbp->aio_lio_opcode == LIO_READ ){
+		result = device->driver.read(&device->handle, (devfs_async_t*)&aiocbp->async);
 	} else {
-        p->result = p->device->driver.write(&p->device->handle, (devfs_async_t*)&p->aiocbp->async);
+		result = device->driver.write(&device->handle, (devfs_async_t*)&aiocbp->async);
 	}
 
 	sos_sched_table[task_get_current()].block_object = NULL;
 
-    cortexm_enable_interrupts();
+	cortexm_enable_interrupts();
 
-	if ( p->result == 0 ){
-		if( p->aiocbp->async.nbyte > 0 ){
-			//AIO is in progress
-		}
-	} else if ( p->result < 0 ){
-		//AIO was not started -- errno is set by the driver
-        //p->ret = -1;
-	} else if ( p->result > 0 ){
+	if ( result > 0 ){
 		//The transfer happened synchronously -- call the callback manually
-		sysfs_aio_data_transfer_callback(p->aiocbp, 0);
-		p->result = 0;
+		sysfs_aio_data_transfer_callback(aiocbp, 0);
+		return 0;
 	}
+
+	//zero means the AIO is in progress, less than zero means it was not started -- errno is set by the driver
+	return result;
+}
+
+void svcall_device_data_transfer(void * args){
+	CORTEXM_SVCALL_ENTER();
+	root_aio_transfer_t * p = (root_aio_transfer_t*)args;
+	p->result = root_start_transfer(p->device, p->aiocbp);
+}
+
+void svcall_device_data_transfer_list(void * args){
+	CORTEXM_SVCALL_ENTER();
+	root_aio_list_transfer_t * p = (root_aio_list_transfer_t*)args;
+	int result;
+	int i;
+
+	p->result = 0;
+	for(i=0; i < p->nent; i++){
+		if( p->device_list[i] == NULL ){
+			continue;
+		}
+
+		if( root_validate_queue(p->list[i]->aio_queue) < 0 ){
+			result = SYSFS_SET_RETURN(EPERM);
+		} else {
+			result = root_start_transfer(p->device_list[i], p->list[i]);
+		}
+
+		if( result < 0 ){
+			//finish the operation with the error so aio_error() reports it (it isn't added to the completion queue)
+			p->list[i]->aio_queue = NULL;
+			p->list[i]->async.nbyte = result;
+			sysfs_aio_data_transfer_callback(p->list[i], 0);
+			p->result++;
+		}
+	}
+}
+
+int root_validate_queue(const aio_queue_t * queue){
+	//the completion writes the queue and its ring from an interrupt so both must belong to the caller
+	if( queue == NULL ){
+		return 0;
+	}
+
+	if( task_validate_memory((void*)queue, sizeof(aio_queue_t)) < 0 ){
+		return -1;
+	}
+
+	if( (queue->size < 2) ||
+		 (task_validate_memory(queue->entry, queue->size * sizeof(struct aiocb*)) < 0) ){
+		return -1;
+	}
+
+	return 0;
+}
+
+void prepare_transfer(struct aiocb * aiocbp){
+	aiocbp->async.loc = aiocbp->aio_offset;
+	aiocbp->async.flags = 0; //this is never a blocking call
+	aiocbp->async.nbyte = aiocbp->aio_nbytes;
+	aiocbp->async.buf = (void*)aiocbp->aio_buf;
+	aiocbp->async.tid = task_get_current();
+	aiocbp->async.handler.callback = sysfs_aio_data_transfer_callback;
+	aiocbp->async.handler.context = aiocbp;
+	aiocbp->aio_nbytes = -1; //means status is in progress
 }
 
 int devfs_aio_data_transfer(const devfs_device_t * device, struct aiocb * aiocbp){
 	root_aio_transfer_t args;
 	args.device = device;
 	args.aiocbp = aiocbp;
-	if ( aiocbp->aio_lio_opcode == LIO_READ ){
-		args.read = 1;
-	} else {
-		args.read = 0;
-	}
-	args.aiocbp->async.loc = aiocbp->aio_offset;
-	args.aiocbp->async.flags = 0; //this is never a blocking call
-	args.aiocbp->async.nbyte = aiocbp->aio_nbytes;
-	args.aiocbp->async.buf = (void*)aiocbp->aio_buf;
-	args.aiocbp->async.tid = task_get_current();
-	args.aiocbp->async.handler.callback = sysfs_aio_data_transfer_callback;
-	args.aiocbp->async.handler.context = aiocbp;
-	args.aiocbp->aio_nbytes = -1; //means status is in progress
+	prepare_transfer(aiocbp);
 	cortexm_svcall(svcall_device_data_transfer, &args);
 	return args.result;
 }
+
+/*! \details Starts the operations in \a list that have a non-null
+ * entry in \a device_list with a single svcall.
+ *
+ * \return The number of operations that could not be started. Those
+ * operations are finished with the error the driver reported.
+ *
+ */
+int devfs_aio_list(const devfs_device_t * const device_list[], struct aiocb * const list[], int nent){
+	root_aio_list_transfer_t args;
+	int i;
+
+	for(i=0; i < nent; i++){
+		if( device_list[i] != NULL ){
+			prepare_transfer(list[i]);
+		}
+	}
+
+	args.device_list = device_list;
+	args.list = list;
+	args.nent = nent;
+	cortexm_svcall(svcall_device_data_transfer_list, &args);
+	return args.result;
+}
@@ -19,15 +19,19 @@
 
 
 #include <reent.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
 #include "mcu/debug.h"
 
 #include "mcu/mcu.h"
 #include "../scheduler/scheduler_local.h"
 
 #include "sos/fs/sysfs.h"
+#include "semaphore.h"
 #include "devfs_local.h"
 
 #define ARGS_TRANSFER_WRITE 0
@@ -40,6 +44,11 @@ typedef struct {
 	devfs_async_t async;
 	volatile int transfer_type;
 	int result;
+	const struct iovec * iov;
+	int iovcnt;
+	int index /*! The segment being transferred */;
+	int loc /*! The location of the segment being transferred */;
+	int bytes /*! Bytes transferred by the segments before index */;
 } svcall_device_data_transfer_t;
 
 
@@ -116,20 +125,56 @@ void svcall_device_data_transfer(void * args){
 	}
 
 
-	//check async.buf and async.nbyte to ensure if belongs to the process
-	//EPERM if it fails Issue #127
-	if( task_validate_memory(p->async.buf, p->async.nbyte) < 0 ){
+	//the iov array is read in privileged mode so it must belong to the process too
+	if( ((u32)p->iovcnt > INT_MAX / sizeof(struct iovec)) ||
+		 (task_validate_memory((void*)p->iov, p->iovcnt * sizeof(struct iovec)) < 0) ){
 		p->result = SYSFS_SET_RETURN(EPERM);
 		return;
 	}
 
-	//assume the operation is going to block
-	sos_sched_table[ task_get_current() ].block_object = (void*)p->device + p->transfer_type;
-	if ( p->transfer_type == ARGS_TRANSFER_READ ){
-		p->result = dev->driver.read(&(dev->handle), &(p->async));
-	} else {
-		p->result = dev->driver.write(&(dev->handle), &(p->async));
-	}
+	do {
+		//zero length segments are skipped (a single zero length transfer never gets here)
+		while( (p->index < p->iovcnt) && (p->iov[p->index].iov_len == 0) ){
+			p->index++;
+		}
+
+		if( p->index == p->iovcnt ){
+			p->transfer_type = ARGS_TRANSFER_DONE;
+			return;
+		}
+
+		p->async.buf = p->iov[p->index].iov_base;
+		p->async.nbyte = p->iov[p->index].iov_len;
+		p->async.loc = p->loc;
+
+		//check async.buf and async.nbyte to ensure if belongs to the process
+		//EPERM if it fails Issue #127
+		if( task_validate_memory(p->async.buf, p->async.nbyte) < 0 ){
+			p->result = SYSFS_SET_RETURN(EPERM);
+			return;
+		}
+
+		//assume the operation is going to block
+		sos_sched_table[ task_get_current() ].block_object = (void*)p->device + p->transfer_type;
+		if ( p->transfer_type == ARGS_TRANSFER_READ ){
+			p->result = dev->driver.read(&(dev->handle), &(p->async));
+		} else {
+			p->result = dev->driver.write(&(dev->handle), &(p->async));
+		}
+
+		if( (p->index == p->iovcnt-1) || (p->result != (int)p->iov[p->index].iov_len) ){
+			//the last segment, errors and partial transfers finish in the caller
+			break;
+		}
+
+		//the segment completed synchronously -- start the next one without another svcall
+		sos_sched_table[ task_get_current() ].block_object = 0;
+		p->bytes += p->result;
+		if( (p->async.flags & O_CHAR) == 0 ){
+			p->loc += p->result;
+		}
+		p->index++;
+	} while( 1 );
 
 	root_check_op_complete(args);
 }
@@ -188,20 +233,39 @@ int devfs_data_transfer(
 		int nbyte,
 		int is_read
 		){
-	volatile svcall_device_data_transfer_t args;
+	struct iovec iov;
 
 	if ( nbyte == 0 ){
 		//this checks for permissions and other errors
 		return 0;
 	}
 
+	iov.iov_base = buf;
+	iov.iov_len = nbyte;
+	return devfs_data_transfer_vector(config, device, flags, loc, &iov, 1, is_read);
+}
+
+int devfs_data_transfer_vector(
+		const void * config,
+		const devfs_device_t * device,
+		int flags,
+		int loc,
+		const struct iovec * iov,
+		int iovcnt,
+		int is_read
+		){
+	volatile svcall_device_data_transfer_t args;
+
 	args.device = device;
-	args.async.loc = loc;
 	args.async.flags = flags;
-	args.async.buf = buf;
 	args.async.handler.callback = root_data_transfer_callback;
 	args.async.handler.context = (void*)&args;
 	args.async.tid = task_get_current();
+	args.iov = iov;
+	args.iovcnt = iovcnt;
+	args.index = 0;
+	args.loc = loc;
+	args.bytes = 0;
 	int retry = 0;
 
 	//privilege call for the operation
@@ -213,11 +277,15 @@ int devfs_data_transfer(
 			args.transfer_type = ARGS_TRANSFER_WRITE;
 		}
 		args.result = -101010;
-		args.async.nbyte = nbyte;
 
-		//This transfers the data
+		//This transfers the data (all the segments that complete synchronously)
 		cortexm_svcall(svcall_device_data_transfer, (void*)&args);
 
+		if( args.index == args.iovcnt ){
+			//the remaining segments were empty
+			return args.bytes;
+		}
+
 		//We arrive here if
 		//the data is done transferring
 		//OR there is no data to transfer and O_NONBLOCK is set
@@ -233,9 +301,10 @@ int devfs_data_transfer(
 			clear_device_action(
 						config,
 						device,
-						loc,
+						args.loc,
 						args.transfer_type == ARGS_TRANSFER_READ
 						);
+			if( args.bytes ){ return args.bytes; }
 			return SYSFS_SET_RETURN(EINTR);
 		}
 
@@ -278,9 +347,24 @@ int devfs_data_transfer(
 				}
 			}
 		}
-	} while ( args.result == 0 );
 
+		if( args.result > 0 ){
+			args.bytes += args.result;
+			if( (args.index == args.iovcnt-1) || (args.result != (int)iov[args.index].iov_len) ){
+				return args.bytes;
+			}
+
+			//the segment blocked and has completed -- continue with the next one
+			if( (flags & O_CHAR) == 0 ){
+				args.loc += args.result;
+			}
+			args.index++;
+			args.result = 0;
+		}
+	} while ( args.result == 0 );
 
+	//report the error only if nothing was transferred
+	if( args.bytes ){ return args.bytes; }
 	return args.result;
 }
 
@@ -296,6 +380,28 @@ int devfs_execute_event_handler(mcu_event_handler_t * handler, u32 o_events, voi
 	return ret;
 }
 
+/*
+ * The handler runs privileged in the interrupt. Root tasks are already
+ * privileged so they can install any handler. Other tasks can only use the
+ * kernel's callbacks on a context in their own memory.
+ *
+ */
+int devfs_validate_event_handler(const mcu_event_handler_t * handler){
+	if( (handler->callback == NULL) || task_root_asserted(task_get_current()) ){
+		return 0;
+	}
+
+	if( handler->callback == devfs_semaphore_callback ){
+		return task_validate_memory(handler->context, sizeof(sem_t));
+	}
+
+	if( handler->callback == devfs_signal_callback ){
+		return task_validate_memory(handler->context, sizeof(devfs_signal_callback_t));
+	}
+
+	return -1;
+}
+
 void devfs_execute_cancel_handler(
 		devfs_transfer_handler_t * transfer_handler,
 		void * data,
@@ -306,6 +412,37 @@ void devfs_execute_cancel_handler(
 	devfs_execute_write_handler(transfer_handler, data, nbyte, o_flags | MCU_EVENT_FLAG_CANCELED);
 }
 
+int devfs_poll_transfer_handler(
+		devfs_transfer_handler_t * transfer_handler,
+		devfs_poll_t * request,
+		u32 o_ready_events
+		){
+	devfs_async_t * async = request->async;
+
+	request->o_events &= (MCU_EVENT_FLAG_DATA_READY | MCU_EVENT_FLAG_WRITE_COMPLETE);
+
+	if( async ){
+		//remove the request if a previous call left it in place
+		if( transfer_handler->read == async ){ transfer_handler->read = 0; }
+		if( transfer_handler->write == async ){ transfer_handler->write = 0; }
+
+		if( (request->o_events != 0) && ((request->o_events & o_ready_events) == 0) ){
+			if( ((request->o_events & MCU_EVENT_FLAG_DATA_READY) && transfer_handler->read) ||
+				 ((request->o_events & MCU_EVENT_FLAG_WRITE_COMPLETE) && transfer_handler->write) ){
+				//another operation is waiting on the device
+				return SYSFS_SET_RETURN(EBUSY);
+			}
+
+			async->nbyte = 0;
+			if( request->o_events & MCU_EVENT_FLAG_DATA_READY ){ transfer_handler->read = async; }
+			if( request->o_events & MCU_EVENT_FLAG_WRITE_COMPLETE ){ transfer_handler->write = async; }
+		}
+	}
+
+	request->o_events &= o_ready_events;
+	return 0;
+}
+
 //this should be called when a read completes
 int devfs_execute_read_handler(
 		devfs_transfer_handler_t * transfer_handler,
@@ -17,6 +17,7 @@
 
 
 int devfs_data_transfer(const void * config, const devfs_device_t * device, int flags, int loc, void * buf, int nbyte, int is_read);
+int devfs_data_transfer_vector(const void * config, const devfs_device_t * device, int flags, int loc, const struct iovec * iov, int iovcnt, int is_read);
 int devfs_aio_data_transfer(const devfs_device_t * device, struct aiocb * aiocbp);
 
 #endif /* SYSFS_DEVFS_LOCAL_H_ */
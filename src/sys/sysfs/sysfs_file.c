@@ -19,6 +19,7 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include "mcu/debug.h"
 #include "sos/fs/sysfs.h"
 
@@ -74,6 +75,59 @@ int sysfs_file_write(sysfs_file_t * file, const void * buf, int nbyte){
     return bytes;
 }
 
+int sysfs_file_readv(sysfs_file_t * file, const struct iovec * iov, int iovcnt){
+    const sysfs_t * fs = file->fs;
+    int bytes;
+    int total;
+    int i;
+
+    if( fs->readv ){
+        bytes = fs->readv(fs->config, file->handle, file->flags, file->loc, iov, iovcnt);
+        SYSFS_PROCESS_RETURN(bytes);
+        update_loc(file, bytes);
+        return bytes;
+    }
+
+    total = 0;
+    for(i=0; i < iovcnt; i++){
+        if( iov[i].iov_len == 0 ){ continue; }
+        bytes = sysfs_file_read(file, iov[i].iov_base, iov[i].iov_len);
+        if( bytes < 0 ){
+            //report the error only if nothing was transferred
+            return total ? total : bytes;
+        }
+        total += bytes;
+        if( bytes < (int)iov[i].iov_len ){ break; }
+    }
+    return total;
+}
+
+int sysfs_file_writev(sysfs_file_t * file, const struct iovec * iov, int iovcnt){
+    const sysfs_t * fs = file->fs;
+    int bytes;
+    int total;
+    int i;
+
+    if( fs->writev ){
+        bytes = fs->writev(fs->config, file->handle, file->flags, file->loc, iov, iovcnt);
+        SYSFS_PROCESS_RETURN(bytes);
+        update_loc(file, bytes);
+        return bytes;
+    }
+
+    total = 0;
+    for(i=0; i < iovcnt; i++){
+        if( iov[i].iov_len == 0 ){ continue; }
+        bytes = sysfs_file_write(file, iov[i].iov_base, iov[i].iov_len);
+        if( bytes < 0 ){
+            return total ? total : bytes;
+        }
+        total += bytes;
+        if( bytes < (int)iov[i].iov_len ){ break; }
+    }
+    return total;
+}
+
 int sysfs_file_aio(sysfs_file_t * file, void * aiocbp){
     const sysfs_t * fs = file->fs;
     int ret =  fs->aio(fs->config, file->handle, aiocbp);
@@ -35,6 +35,9 @@ typedef struct {
 
 static trace_list_t * trace_first = 0;
 
+#define TRACE_POOL_GROW_COUNT 2
+static sos_pool_t trace_pool = SOS_POOL_INITIALIZER(sizeof(trace_list_t));
+
 
 static void trace_cleanup(){
 	trace_list_t * entry;
@@ -63,7 +66,7 @@ static trace_id_handle_t * trace_find_free(){
 	}
 
 	//no free message queues
-	new_entry = _malloc_r(sos_task_table[0].global_reent, sizeof(trace_list_t));
+	new_entry = sos_pool_alloc_kernel(&trace_pool, TRACE_POOL_GROW_COUNT);
 	if( new_entry == 0 ){
 		return 0;
 	}
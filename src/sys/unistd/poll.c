@@ -0,0 +1,351 @@
+/* Copyright 2011-2018 Tyler Gilbert; 
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*! \addtogroup unistd
+ * @{
+ */
+
+/*! \file */
+
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "sys/socket.h"
+#include "cortexm/cortexm.h"
+#include "sos/sos.h"
+#include "sos/fs/devfs.h"
+#include "../scheduler/scheduler_local.h"
+#include "unistd_local.h"
+
+/*! \cond */
+#define POLL_READ_EVENTS (POLLIN | POLLRDNORM)
+#define POLL_WRITE_EVENTS (POLLOUT)
+
+typedef struct {
+	struct pollfd * fds;
+	nfds_t nfds;
+	const devfs_device_t * device[OPEN_MAX];
+	devfs_async_t async;
+	struct mcu_timeval abs_timeout;
+	int is_block;
+	int count;
+} svcall_poll_t;
+
+static void svcall_poll_wait(void * args) MCU_ROOT_EXEC_CODE;
+static void svcall_poll_cancel(void * args) MCU_ROOT_EXEC_CODE;
+static int root_poll_devices(svcall_poll_t * p, devfs_async_t * async) MCU_ROOT_CODE;
+static int root_poll_callback(void * context, const mcu_event_t * event) MCU_ROOT_CODE;
+static int is_fd_set(const fd_set * set, int fd);
+static void set_fd(fd_set * set, int fd);
+/*! \endcond */
+
+/*! \details This function waits for one of the file descriptors in \a fds
+ * to become ready for the events in \a events.
+ *
+ * Devices that are built on the fifo drivers (fifo, ffifo, uartfifo, usbfifo and
+ * stream_ffifo) report when they are readable (POLLIN) and writable (POLLOUT).
+ * Regular files and devices that don't support polling are always ready.
+ * Sockets are not supported and are reported with POLLNVAL.
+ *
+ * \param fds The file descriptors and events to check
+ * \param nfds The number of entries in \a fds
+ * \param timeout The maximum number of milliseconds to wait (-1 to wait forever, 0 to not wait)
+ *
+ * \return The number of entries in \a fds with non-zero \a revents (0 if \a timeout expired)
+ * or -1 with errno (see \ref errno) set to:
+ * - EINVAL: \a nfds is greater than OPEN_MAX
+ * - EINTR: a signal was received while waiting
+ *
+ */
+int poll(struct pollfd fds[], nfds_t nfds, int timeout){
+	svcall_poll_t args;
+	struct timespec abs_timeout;
+	const sysfs_t * fs;
+	int fildes;
+	nfds_t i;
+
+	if( nfds > OPEN_MAX ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	args.fds = fds;
+	args.nfds = nfds;
+	for(i=0; i < nfds; i++){
+		args.device[i] = 0;
+		fds[i].revents = 0;
+		if( fds[i].fd < 0 ){
+			continue;
+		}
+
+		if( FILDES_IS_SOCKET(fds[i].fd) ){
+			fds[i].revents = POLLNVAL;
+			continue;
+		}
+
+		fildes = u_fildes_is_bad(fds[i].fd);
+		if( fildes < 0 ){
+			fds[i].revents = POLLNVAL;
+			continue;
+		}
+
+		fs = get_fs(fildes);
+		if( fs->ioctl == devfs_ioctl ){
+			//the handle of a devfs file is the device
+			args.device[i] = get_handle(fildes);
+		} else {
+			//regular files never block
+			fds[i].revents = fds[i].events & (POLL_READ_EVENTS | POLL_WRITE_EVENTS);
+		}
+	}
+
+	if( timeout < 0 ){
+		scheduler_timing_convert_timespec(&args.abs_timeout, NULL);
+	} else {
+		clock_gettime(CLOCK_REALTIME, &abs_timeout);
+		abs_timeout.tv_sec += timeout / 1000;
+		abs_timeout.tv_nsec += (timeout % 1000) * 1000000UL;
+		if( abs_timeout.tv_nsec >= 1000000000UL ){
+			abs_timeout.tv_sec++;
+			abs_timeout.tv_nsec -= 1000000000UL;
+		}
+		scheduler_timing_convert_timespec(&args.abs_timeout, &abs_timeout);
+	}
+
+	args.async.tid = task_get_current();
+	args.async.flags = 0;
+	args.async.loc = 0;
+	args.async.buf = 0;
+	args.async.nbyte = 0;
+	args.async.handler.callback = root_poll_callback;
+	args.async.handler.context = &args;
+
+	do {
+		args.is_block = (timeout != 0);
+		cortexm_svcall(svcall_poll_wait, &args);
+
+		//remove the async from the devices and update revents
+		cortexm_svcall(svcall_poll_cancel, &args);
+		if( (args.count > 0) || (args.is_block == 0) ){
+			return args.count;
+		}
+
+		if ( scheduler_unblock_type( task_get_current() ) == SCHEDULER_UNBLOCK_SLEEP ){
+			//timeout
+			return 0;
+		} else if ( scheduler_unblock_type( task_get_current() ) == SCHEDULER_UNBLOCK_SIGNAL ){
+			errno = EINTR;
+			return -1;
+		}
+
+		//the device was woken (flushed or canceled) without an event -- wait again
+	} while( 1 );
+}
+
+/*! \details This function waits for one of the file descriptors in \a readset
+ * to be readable or one in \a writeset to be writable. It is built on poll() so
+ * it supports the same files and devices.
+ *
+ * If the sets have a descriptor that isn't an open file, the sets are
+ * assumed to hold sockets and the call is passed to the board's socket API.
+ *
+ * \param maxfdp1 One more than the highest descriptor in the sets
+ * \param readset Descriptors to check for reading (null to skip)
+ * \param writeset Descriptors to check for writing (null to skip)
+ * \param exceptset Descriptors to check for exceptions (files and devices don't have any)
+ * \param timeout The maximum time to wait (null to wait forever)
+ *
+ * \return The number of bits set in the sets (0 if \a timeout expired)
+ * or -1 with errno (see \ref errno) set to:
+ * - EINVAL: \a maxfdp1 is negative or larger than the sets
+ * - EBADF: a descriptor in the sets is not open
+ * - EINTR: a signal was received while waiting
+ *
+ */
+int select(int maxfdp1, fd_set * readset, fd_set * writeset, fd_set * exceptset, struct timeval * timeout){
+	struct pollfd fds[OPEN_MAX];
+	nfds_t nfds;
+	int timeout_ms;
+	int result;
+	int fd;
+	nfds_t i;
+
+	if( (maxfdp1 < 0) || (maxfdp1 > (int)sizeof(fd_set)*8) ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	nfds = 0;
+	for(fd=0; fd < maxfdp1; fd++){
+		short events = 0;
+		if( is_fd_set(readset, fd) ){ events |= POLL_READ_EVENTS; }
+		if( is_fd_set(writeset, fd) ){ events |= POLL_WRITE_EVENTS; }
+		if( is_fd_set(exceptset, fd) ){ events |= POLLPRI; }
+		if( events == 0 ){
+			continue;
+		}
+
+		if( (fd >= OPEN_MAX) || (u_fildes_is_bad(fd) < 0) ){
+			if( sos_board_config.socket_api != 0 ){
+				return sos_board_config.socket_api->select(maxfdp1, readset, writeset, exceptset, timeout);
+			}
+			errno = EBADF;
+			return -1;
+		}
+
+		fds[nfds].fd = fd;
+		fds[nfds].events = events;
+		nfds++;
+	}
+
+	if( timeout == 0 ){
+		timeout_ms = -1;
+	} else {
+		//round up so a short timeout still waits
+		timeout_ms = timeout->tv_sec*1000 + (timeout->tv_usec + 999) / 1000;
+	}
+
+	if( poll(fds, nfds, timeout_ms) < 0 ){
+		return -1;
+	}
+
+	if( readset ){ memset(readset, 0, sizeof(fd_set)); }
+	if( writeset ){ memset(writeset, 0, sizeof(fd_set)); }
+	if( exceptset ){ memset(exceptset, 0, sizeof(fd_set)); }
+
+	//an error makes the descriptor ready (read() or write() reports it)
+	result = 0;
+	for(i=0; i < nfds; i++){
+		if( (fds[i].events & POLL_READ_EVENTS) && (fds[i].revents & (POLL_READ_EVENTS | POLLERR | POLLHUP)) ){
+			set_fd(readset, fds[i].fd);
+			result++;
+		}
+		if( (fds[i].events & POLL_WRITE_EVENTS) && (fds[i].revents & (POLL_WRITE_EVENTS | POLLERR | POLLHUP)) ){
+			set_fd(writeset, fds[i].fd);
+			result++;
+		}
+	}
+
+	return result;
+}
+
+/*! \cond */
+//fd_set is a bitmask (LSB first) in both the bootstrap and the lwIP socket headers
+int is_fd_set(const fd_set * set, int fd){
+	if( set == 0 ){
+		return 0;
+	}
+	return (((const u8*)set)[fd/8] & (1<<(fd%8))) != 0;
+}
+
+void set_fd(fd_set * set, int fd){
+	((u8*)set)[fd/8] |= (1<<(fd%8));
+}
+
+int root_poll_devices(svcall_poll_t * p, devfs_async_t * async){
+	devfs_poll_t request;
+	const devfs_device_t * device;
+	u32 o_events;
+	int count = 0;
+	nfds_t i;
+
+	for(i=0; i < p->nfds; i++){
+		device = p->device[i];
+		if( device ){
+			o_events = 0;
+			if( p->fds[i].events & POLL_READ_EVENTS ){ o_events |= MCU_EVENT_FLAG_DATA_READY; }
+			if( p->fds[i].events & POLL_WRITE_EVENTS ){ o_events |= MCU_EVENT_FLAG_WRITE_COMPLETE; }
+
+			request.o_events = o_events;
+			request.resd = 0;
+			request.async = async;
+			if( device->driver.ioctl(&device->handle, I_DEVFS_POLL, &request) < 0 ){
+				//devices that can't be polled (or are busy) are ready -- read() or write() will report the error
+				request.o_events = o_events;
+			}
+
+			p->fds[i].revents = 0;
+			if( request.o_events & MCU_EVENT_FLAG_DATA_READY ){
+				p->fds[i].revents |= p->fds[i].events & POLL_READ_EVENTS;
+			}
+			if( request.o_events & MCU_EVENT_FLAG_WRITE_COMPLETE ){
+				p->fds[i].revents |= p->fds[i].events & POLL_WRITE_EVENTS;
+			}
+		}
+
+		if( p->fds[i].revents ){
+			count++;
+		}
+	}
+
+	return count;
+}
+
+void svcall_poll_wait(void * args){
+	CORTEXM_SVCALL_ENTER();
+	svcall_poll_t * p = args;
+
+	//no switching until the task is blocked (or an event would be missed)
+	cortexm_disable_interrupts();
+	p->count = root_poll_devices(p, p->is_block ? &p->async : 0);
+	if( (p->count == 0) && p->is_block ){
+		scheduler_timing_root_timedblock(args, &p->abs_timeout);
+	} else {
+		p->is_block = 0;
+	}
+	cortexm_enable_interrupts();
+}
+
+void svcall_poll_cancel(void * args){
+	CORTEXM_SVCALL_ENTER();
+	svcall_poll_t * p = args;
+	devfs_poll_t request;
+	const devfs_device_t * device;
+	nfds_t i;
+
+	//devices that were not ready may still have the async even if the task didn't block
+	cortexm_disable_interrupts();
+	for(i=0; i < p->nfds; i++){
+		device = p->device[i];
+		if( device ){
+			request.o_events = 0;
+			request.resd = 0;
+			request.async = &p->async;
+			device->driver.ioctl(&device->handle, I_DEVFS_POLL, &request);
+		}
+	}
+	p->count = root_poll_devices(p, 0);
+	cortexm_enable_interrupts();
+}
+
+int root_poll_callback(void * context, const mcu_event_t * event){
+	svcall_poll_t * p = context;
+	int tid = p->async.tid;
+
+	//the async is shared by all the devices -- only wake the task once
+	if( (sos_sched_table[tid].block_object == p) && !task_active_asserted(tid) ){
+		scheduler_root_assert_active(tid, SCHEDULER_UNBLOCK_TRANSFER);
+		scheduler_root_update_on_wake(tid, task_get_priority(tid));
+	}
+	return 0;
+}
+/*! \endcond */
+
+/*! @} */
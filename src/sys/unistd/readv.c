@@ -0,0 +1,93 @@
+/* Copyright 2011-2018 Tyler Gilbert; 
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * 
+ */
+
+/*! \addtogroup unistd
+ * @{
+ */
+
+/*! \file */
+
+#include <sys/uio.h>
+#include "unistd_local.h"
+#include "unistd_fs.h"
+#include "sos/sos.h"
+
+/*! \details This function reads from \a fildes into the \a iovcnt
+ * buffers described by \a iov. Each buffer is filled completely before
+ * moving on to the next one.
+ *
+ * Device transfers that complete without blocking are all started with a
+ * single privileged call, so reading several small buffers costs about
+ * the same as reading one.
+ *
+ * \param fildes The file descriptor returned by \ref open()
+ * \param iov The buffers to read to
+ * \param iovcnt The number of entries in \a iov
+ *
+ * \return The number of bytes actually read or -1 with errno (see \ref errno) set to:
+ * - EBADF:  \a fildes is bad
+ * - EACCES:  \a fildes is in O_WRONLY mode
+ * - EINVAL: \a iovcnt is less than zero
+ * - EIO:  IO error
+ * - EAGAIN:  O_NONBLOCK is set for \a fildes and no new data is available
+ *
+ */
+ssize_t readv(int fildes, const struct iovec * iov, int iovcnt){
+	int bytes;
+	int total;
+	int i;
+
+	if( iovcnt < 0 ){
+		errno = EINVAL;
+		return -1;
+	}
+
+	if( FILDES_IS_SOCKET(fildes) ){
+		if( sos_board_config.socket_api != 0 ){
+			//the socket API doesn't have readv()
+			total = 0;
+			for(i=0; i < iovcnt; i++){
+				bytes = sos_board_config.socket_api->read(fildes & ~FILDES_SOCKET_FLAG, iov[i].iov_base, iov[i].iov_len);
+				if( bytes < 0 ){
+					return total ? total : bytes;
+				}
+				total += bytes;
+				if( bytes < (int)iov[i].iov_len ){ break; }
+			}
+			return total;
+		}
+		errno = EBADF;
+		return -1;
+	}
+
+	fildes = u_fildes_is_bad(fildes);
+	if ( fildes < 0 ){
+		errno = EBADF;
+		return -1;
+	}
+
+	if ( (get_flags(fildes) & O_ACCMODE) == O_WRONLY ){
+		errno = EACCES;
+		return -1;
+	}
+
+	return sysfs_file_readv(get_open_file(fildes), iov, iovcnt);
+}
+
+/*! @} */
@@ -0,0 +1,413 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Host test and benchmark for the ready lists (task_ready.c).
+ *
+ * Random ready, not ready, priority and deadline changes plus context
+ * switches are checked against a model that keeps each list as an array
+ * in execution order. The round robin rotation, deadline preemption and
+ * tickless checks are tested on their own.
+ *
+ */
+
+#include "host.h"
+#include "sos/sos.h"
+#include "sos/dev/sys.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "cortexm/task_local.h"
+
+#define TASK_TOTAL 32
+#define PRIORITY_RANGE 6
+
+volatile task_t sos_task_table[TASK_TOTAL];
+volatile int m_task_current;
+
+//task_ready_is_tickless() reads the flags so they are writable here
+const sos_board_config_t sos_board_config __attribute__((section(".data"))) = {
+	.task_total = TASK_TOTAL,
+	.o_sys_flags = SYS_FLAG_IS_WDT_DISABLED
+};
+
+static int m_model[TASK_PRIORITY_TOTAL][TASK_TOTAL];
+static int m_model_count[TASK_PRIORITY_TOTAL];
+static unsigned int m_lcg = 1;
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+
+static int random_value(int range){
+	m_lcg = m_lcg*1103515245u + 12345u;
+	return (m_lcg >> 8) % range;
+}
+
+static void set_sys_flags(int o_flags){
+	((sos_board_config_t*)&sos_board_config)->o_sys_flags = o_flags;
+}
+
+static void reset(){
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset(m_model_count, 0, sizeof(m_model_count));
+	m_task_current = 0;
+	m_task_rr_reload = SYSTICK_MIN_CYCLES*10;
+	task_ready_init();
+}
+
+static void start_task(int id, int priority){
+	sos_task_table[id].priority = priority;
+	task_assert_used(id);
+	task_assert_active(id);
+}
+
+//the head of the list for priority (with task 0 current, task_ready_get_next() doesn't rotate)
+static int get_head(int priority){
+	int current = m_task_current;
+	int current_priority = task_get_current_priority();
+	int head;
+	m_task_current = 0;
+	task_root_set_current_priority(priority);
+	head = task_ready_get_next();
+	m_task_current = current;
+	task_root_set_current_priority(current_priority);
+	return head;
+}
+
+static int model_find(int list, int id){
+	int i;
+	for(i=0; i < m_model_count[list]; i++){
+		if( m_model[list][i] == id ){
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int model_list(int id){
+	int list;
+	for(list=0; list < TASK_PRIORITY_TOTAL; list++){
+		if( model_find(list, id) >= 0 ){
+			return list;
+		}
+	}
+	return -1;
+}
+
+static void model_remove(int id){
+	int list = model_list(id);
+	int i;
+	if( list < 0 ){
+		return;
+	}
+	for(i = model_find(list, id); i < m_model_count[list] - 1; i++){
+		m_model[list][i] = m_model[list][i+1];
+	}
+	m_model_count[list]--;
+}
+
+//deadline tasks go after the ones due first (or at the same time), the others go to the tail
+static void model_insert(int id){
+	int list = task_get_priority(id);
+	int position = m_model_count[list];
+	int next;
+	int i;
+
+	if( task_deadline_asserted(id) ){
+		for(position=0; position < m_model_count[list]; position++){
+			next = m_model[list][position];
+			if( !task_deadline_asserted(next) ||
+				 ((s32)(sos_task_table[next].deadline - sos_task_table[id].deadline) > 0) ){
+				break;
+			}
+		}
+	}
+
+	for(i = m_model_count[list]; i > position; i--){
+		m_model[list][i] = m_model[list][i-1];
+	}
+	m_model[list][position] = id;
+	m_model_count[list]++;
+}
+
+static void model_update(int id){
+	int list = model_list(id);
+	if( task_enabled_active_not_stopped(id) ){
+		if( list != task_get_priority(id) ){
+			model_remove(id);
+			model_insert(id);
+		}
+	} else {
+		model_remove(id);
+	}
+}
+
+static void check_lists(){
+	int highest = 0;
+	int list;
+	int id;
+	int i;
+
+	for(list=0; list < TASK_PRIORITY_TOTAL; list++){
+		id = get_head(list);
+		if( m_model_count[list] == 0 ){
+			HOST_CHECK(id == 0);
+			continue;
+		}
+		highest = list;
+		for(i=0; i < m_model_count[list]; i++){
+			HOST_CHECK(id == m_model[list][i]);
+			HOST_CHECK(sos_task_table[id].ready_list == list);
+			HOST_CHECK(sos_task_table[sos_task_table[id].ready_next].ready_prev == id);
+			id = sos_task_table[id].ready_next;
+		}
+		HOST_CHECK(id == m_model[list][0]);
+	}
+	HOST_CHECK(task_root_get_highest_ready_priority() == highest);
+
+	for(id=1; id < TASK_TOTAL; id++){
+		HOST_CHECK((sos_task_table[id].ready_next != 0) == (model_list(id) >= 0));
+	}
+}
+
+static void test_random(){
+	int operation;
+	int count;
+	int list;
+	int next;
+	int id;
+
+	reset();
+	for(count=0; count < 200000; count++){
+		id = random_value(TASK_TOTAL - 1) + 1;
+		operation = random_value(100);
+
+		if( operation < 25 ){
+			start_task(id, random_value(PRIORITY_RANGE));
+		} else if( operation < 40 ){
+			task_deassert_active(id);
+		} else if( operation < 45 ){
+			task_assert_stopped(id);
+		} else if( operation < 50 ){
+			task_deassert_stopped(id);
+		} else if( operation < 65 ){
+			task_set_priority(id, random_value(PRIORITY_RANGE));
+		} else if( operation < 80 ){
+			//about half the tasks are ordered by deadline
+			if( random_value(2) ){
+				task_ready_set_deadline(id, random_value(64), 1000);
+			} else {
+				task_ready_set_deadline(id, 0, 0);
+			}
+			if( model_list(id) >= 0 ){
+				model_remove(id);
+				model_insert(id);
+			}
+		} else {
+			//switch from the head of a list
+			list = random_value(PRIORITY_RANGE);
+			m_task_current = get_head(list);
+			task_root_set_current_priority(list);
+			next = task_ready_get_next();
+			if( m_task_current != 0 ){
+				model_remove(m_task_current);
+				model_insert(m_task_current);
+			}
+			HOST_CHECK((next == 0) || (next == m_model[list][0]));
+			m_task_current = 0;
+		}
+		model_update(id);
+		check_lists();
+	}
+}
+
+static void test_round_robin(){
+	int round;
+	int id;
+
+	reset();
+	for(id=1; id <= 4; id++){
+		start_task(id, 3);
+	}
+	start_task(5, 2);
+	task_root_set_current_priority(3);
+	HOST_CHECK(task_get_exec_count() == 4);
+	HOST_CHECK(task_exec_asserted(4) && !task_exec_asserted(5));
+
+	//each task at the current priority gets a turn and then task 0
+	for(round=0; round < 3; round++){
+		for(id=1; id <= 4; id++){
+			m_task_current = task_ready_get_next();
+			HOST_CHECK(m_task_current == id);
+		}
+		m_task_current = task_ready_get_next();
+		HOST_CHECK(m_task_current == 0);
+	}
+
+	//a task that blocks counts as its turn
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 1);
+	task_deassert_active(1);
+	HOST_CHECK(task_ready_get_next() == 2);
+	m_task_current = 2;
+	HOST_CHECK(task_ready_get_next() == 3);
+	m_task_current = 3;
+	HOST_CHECK(task_ready_get_next() == 4);
+	m_task_current = 4;
+	HOST_CHECK(task_ready_get_next() == 0);
+}
+
+static void test_deadline(){
+	reset();
+	start_task(1, 3);
+	start_task(2, 3);
+	task_root_set_current_priority(3);
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 1);
+	HOST_CHECK(task_ready_is_deadline_preempted() == 0);
+
+	//a deadline task goes ahead of the others and preempts them
+	task_ready_set_deadline(3, 200, 5000);
+	start_task(3, 3);
+	HOST_CHECK(task_ready_get_slice(3) == 5000);
+	HOST_CHECK(task_ready_is_deadline_preempted());
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 3);
+
+	//a later deadline doesn't preempt an earlier one (even across the 32-bit wrap)
+	task_ready_set_deadline(4, 100 + 0x80000000, 5000);
+	start_task(4, 3);
+	HOST_CHECK(task_ready_is_deadline_preempted() == 0);
+	task_ready_set_deadline(4, 100, 5000);
+	HOST_CHECK(task_ready_is_deadline_preempted());
+
+	//deadline tasks keep running in deadline order
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 4);
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 4);
+
+	//back to round robin
+	task_ready_set_deadline(4, 0, 0);
+	HOST_CHECK(task_ready_get_slice(4) == (u32)m_task_rr_reload);
+	HOST_CHECK(get_head(3) == 3);
+}
+
+static void test_tickless(){
+	reset();
+	set_sys_flags(SYS_FLAG_IS_WDT_DISABLED);
+
+	//task 0 sleeps when nothing is ready
+	HOST_CHECK(task_ready_is_tickless());
+	start_task(1, 3);
+	HOST_CHECK(task_ready_is_tickless() == 0);
+
+	//a task that is alone in its list doesn't need the SysTick
+	task_root_set_current_priority(3);
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 1);
+	HOST_CHECK(task_ready_is_tickless());
+
+	start_task(2, 3);
+	HOST_CHECK(task_ready_is_tickless() == 0);
+	task_deassert_active(2);
+	HOST_CHECK(task_ready_is_tickless());
+
+	//the SysTick enforces the budget
+	task_ready_set_deadline(1, 100, 5000);
+	HOST_CHECK(task_ready_is_tickless() == 0);
+	task_ready_set_deadline(1, 0, 0);
+
+	//task 0 resets the watchdog (even when nothing is ready)
+	set_sys_flags(0);
+	HOST_CHECK(task_ready_is_tickless() == 0);
+	task_deassert_active(1);
+	m_task_current = 0;
+	HOST_CHECK(task_ready_is_tickless() == 0);
+	set_sys_flags(SYS_FLAG_IS_WDT_DISABLED);
+	HOST_CHECK(task_ready_is_tickless());
+}
+
+static void test_tickless_time(){
+	u64 start;
+
+	reset();
+	set_sys_flags(SYS_FLAG_IS_WDT_DISABLED);
+	start_task(1, 3);
+	task_root_set_current_priority(3);
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 1);
+
+	//the part of the slice used before the tick stops is charged right away
+	start = sos_task_table[1].timer.t;
+	sos_task_table[1].rr_time = m_task_rr_reload - 1000;
+	task_ready_start_tickless(1);
+	HOST_CHECK(sos_task_table[1].timer.t == start + 1000);
+	HOST_CHECK(sos_task_table[1].rr_time == (u32)m_task_rr_reload);
+
+	//the SysTick value saved while tickless is ignored -- the measured cycles are charged
+	sos_task_table[1].rr_time = 5;
+	task_ready_stop_tickless(1, 100ULL*m_task_rr_reload);
+	HOST_CHECK(sos_task_table[1].timer.t == start + 1000 + 100ULL*m_task_rr_reload);
+	HOST_CHECK(sos_task_table[1].rr_time == (u32)m_task_rr_reload);
+
+	//a fresh slice so the next rotation charges nothing extra
+	start_task(2, 3);
+	m_task_current = task_ready_get_next();
+	HOST_CHECK(m_task_current == 2);
+	HOST_CHECK(sos_task_table[1].timer.t == start + 1000 + 100ULL*m_task_rr_reload);
+	HOST_CHECK(sos_task_table[1].rr_time == (u32)m_task_rr_reload);
+}
+
+static void bench(){
+	unsigned long long start;
+	const long count = 10000000;
+	char name[64];
+	int tasks;
+	int id;
+	long i;
+
+	for(tasks = 2; tasks < TASK_TOTAL; tasks *= 4){
+		reset();
+		for(id=1; id <= tasks; id++){
+			start_task(id, 3);
+		}
+		task_root_set_current_priority(3);
+
+		start = host_now_ns();
+		for(i=0; i < count; i++){
+			m_task_current = task_ready_get_next();
+		}
+		snprintf(name, sizeof(name), "ready get next %d tasks", tasks);
+		host_report(name, host_now_ns() - start, count);
+	}
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_round_robin();
+	test_deadline();
+	test_tickless();
+	test_tickless_time();
+	test_random();
+	return 0;
+}
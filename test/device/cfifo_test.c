@@ -0,0 +1,228 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+/*
+ * Host test for the cfifo ready channels.
+ *
+ * Channels are written through cfifo_write() and also the way a kernel
+ * driver fills a channel (fifo_write_buffer() then fifo_data_received())
+ * to check that both keep the ready bitmask and wake a read that waits on
+ * CFIFO_LOC_READY.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include "host.h"
+#include "device/cfifo.h"
+
+#define CHANNEL_COUNT 4
+#define FIFO_SIZE 16
+
+static char m_buffer[CHANNEL_COUNT][FIFO_SIZE];
+static const fifo_config_t m_fifo_config[CHANNEL_COUNT] = {
+	{ .size = FIFO_SIZE, .buffer = m_buffer[0] },
+	{ .size = FIFO_SIZE, .buffer = m_buffer[1] },
+	{ .size = FIFO_SIZE, .buffer = m_buffer[2] },
+	{ .size = FIFO_SIZE, .buffer = m_buffer[3] }
+};
+static fifo_state_t m_fifo_state[CHANNEL_COUNT];
+static u32 m_owner[CHANNEL_COUNT];
+static cfifo_state_t m_state = { .owner_array = m_owner, .fifo_state_array = m_fifo_state };
+static const cfifo_config_t m_config = { .count = CHANNEL_COUNT, .size = FIFO_SIZE, .fifo_config_array = m_fifo_config };
+static const devfs_handle_t m_handle = { .config = &m_config, .state = &m_state };
+
+static int m_complete_count;
+static u32 m_complete_events;
+static int m_complete_nbyte;
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+
+int devfs_execute_event_handler(mcu_event_handler_t * handler, u32 o_events, void * data){
+	mcu_event_t event;
+	if( handler->callback ){
+		event.o_events = o_events;
+		event.data = data;
+		return handler->callback(handler->context, &event);
+	}
+	return 0;
+}
+
+int devfs_execute_read_handler(devfs_transfer_handler_t * transfer_handler, void * data, int nbyte, u32 o_flags){
+	if( transfer_handler->read ){
+		devfs_async_t * async = transfer_handler->read;
+		transfer_handler->read = 0;
+		if( nbyte ){ async->nbyte = nbyte; }
+		return devfs_execute_event_handler(&async->handler, o_flags, data);
+	}
+	return 0;
+}
+
+int devfs_execute_write_handler(devfs_transfer_handler_t * transfer_handler, void * data, int nbyte, u32 o_flags){
+	if( transfer_handler->write ){
+		devfs_async_t * async = transfer_handler->write;
+		transfer_handler->write = 0;
+		if( nbyte ){ async->nbyte = nbyte; }
+		return devfs_execute_event_handler(&async->handler, o_flags, data);
+	}
+	return 0;
+}
+
+int devfs_poll_transfer_handler(devfs_transfer_handler_t * transfer_handler, devfs_poll_t * request, u32 o_ready_events){ return 0; }
+
+static int handle_complete(void * context, const mcu_event_t * event){
+	devfs_async_t * async = context;
+	m_complete_count++;
+	m_complete_events = event->o_events;
+	m_complete_nbyte = async->nbyte;
+	return 0;
+}
+
+static void init_async(devfs_async_t * async, int loc, void * buf, int nbyte, int flags){
+	memset(async, 0, sizeof(devfs_async_t));
+	async->loc = loc;
+	async->buf = buf;
+	async->nbyte = nbyte;
+	async->flags = O_RDWR | flags;
+	async->handler.callback = handle_complete;
+	async->handler.context = async;
+}
+
+static u32 get_ready(){
+	cfifo_info_t info;
+	HOST_CHECK(cfifo_ioctl(&m_handle, I_CFIFO_GETINFO, &info) == 0);
+	return info.o_ready;
+}
+
+static int write_channel(int channel, const char * data){
+	devfs_async_t async;
+	init_async(&async, channel, (void*)data, strlen(data), O_NONBLOCK);
+	return cfifo_write(&m_handle, &async);
+}
+
+static int read_channel(int channel, char * data, int nbyte){
+	devfs_async_t async;
+	init_async(&async, channel, data, nbyte, O_NONBLOCK);
+	return cfifo_read(&m_handle, &async);
+}
+
+//the same as a kernel driver that fills a channel from its interrupt
+static void fill_channel(int channel, const char * data){
+	HOST_CHECK(fifo_write_buffer(m_fifo_config + channel, m_fifo_state + channel, data, strlen(data), 1) == (int)strlen(data));
+	fifo_data_received(m_fifo_config + channel, m_fifo_state + channel);
+}
+
+static void test_ready_mask(){
+	cfifo_fiforequest_t request;
+	char data[FIFO_SIZE];
+
+	//a channel filled before the cfifo is opened is found when it opens
+	HOST_CHECK(fifo_write_buffer(m_fifo_config + 3, m_fifo_state + 3, "x", 1, 1) == 1);
+	HOST_CHECK(cfifo_open(&m_handle) == 0);
+	HOST_CHECK(get_ready() == (1<<3));
+	HOST_CHECK(read_channel(3, data, sizeof(data)) == 1);
+	HOST_CHECK(get_ready() == 0);
+
+	HOST_CHECK(write_channel(1, "abc") == 3);
+	HOST_CHECK(get_ready() == (1<<1));
+
+	fill_channel(2, "de");
+	HOST_CHECK(get_ready() == ((1<<1)|(1<<2)));
+
+	//a partial read leaves the channel ready
+	HOST_CHECK(read_channel(1, data, 2) == 2);
+	HOST_CHECK(get_ready() == ((1<<1)|(1<<2)));
+	HOST_CHECK(read_channel(1, data, sizeof(data)) == 1);
+	HOST_CHECK(data[0] == 'c');
+	HOST_CHECK(get_ready() == (1<<2));
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(read_channel(1, data, sizeof(data))) == EAGAIN);
+
+	request.channel = 2;
+	HOST_CHECK(cfifo_ioctl(&m_handle, I_CFIFO_FIFOFLUSH, &request) == 0);
+	HOST_CHECK(get_ready() == 0);
+
+	request.channel = CHANNEL_COUNT;
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(cfifo_ioctl(&m_handle, I_CFIFO_FIFOFLUSH, &request)) == EINVAL);
+	printf("ready mask: ok\n");
+}
+
+static void test_wait(){
+	devfs_async_t async;
+	devfs_async_t channel_async;
+	mcu_action_t action;
+	u32 o_ready;
+	char data[FIFO_SIZE];
+
+	//data that is already there is returned right away
+	fill_channel(0, "a");
+	o_ready = 0;
+	init_async(&async, CFIFO_LOC_READY, &o_ready, sizeof(o_ready), 0);
+	HOST_CHECK(cfifo_read(&m_handle, &async) == sizeof(u32));
+	HOST_CHECK(o_ready == (1<<0));
+
+	//only the selected channels complete the wait
+	o_ready = (1<<2)|(1<<3);
+	async.flags = O_RDWR | O_NONBLOCK;
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(cfifo_read(&m_handle, &async)) == EAGAIN);
+	async.flags = O_RDWR;
+	m_complete_count = 0;
+	o_ready = (1<<2)|(1<<3);
+	HOST_CHECK(cfifo_read(&m_handle, &async) == 0);
+	HOST_CHECK(write_channel(1, "b") == 1);
+	HOST_CHECK(m_complete_count == 0);
+
+	//a driver that fills the channel directly wakes the wait
+	fill_channel(3, "c");
+	HOST_CHECK(m_complete_count == 1);
+	HOST_CHECK(m_complete_events & MCU_EVENT_FLAG_DATA_READY);
+	HOST_CHECK(m_complete_nbyte == sizeof(u32));
+	HOST_CHECK(o_ready == (1<<3));
+
+	//a read that is blocked on the channel gets the data first so the channel never looks ready
+	HOST_CHECK(read_channel(0, data, sizeof(data)) == 1);
+	HOST_CHECK(read_channel(1, data, sizeof(data)) == 1);
+	HOST_CHECK(read_channel(3, data, sizeof(data)) == 1);
+	HOST_CHECK(get_ready() == 0);
+	init_async(&channel_async, 2, data, sizeof(data), 0);
+	HOST_CHECK(cfifo_read(&m_handle, &channel_async) == 0);
+	o_ready = 0;
+	m_complete_count = 0;
+	HOST_CHECK(cfifo_read(&m_handle, &async) == 0);
+	fill_channel(2, "de");
+	HOST_CHECK(m_complete_count == 1);
+	HOST_CHECK(channel_async.nbyte == 2);
+	HOST_CHECK(memcmp(data, "de", 2) == 0);
+	HOST_CHECK(get_ready() == 0);
+
+	//the wait is still pending and can be canceled
+	memset(&action, 0, sizeof(action));
+	action.channel = CFIFO_CHANNEL_READY;
+	HOST_CHECK(cfifo_ioctl(&m_handle, I_MCU_SETACTION, &action) == 0);
+	HOST_CHECK(m_complete_count == 2);
+	HOST_CHECK(m_complete_events & MCU_EVENT_FLAG_CANCELED);
+	HOST_CHECK(m_state.transfer_handler.read == 0);
+	printf("wait: ok\n");
+}
+
+int main(int argc, char * argv[]){
+	test_ready_mask();
+	test_wait();
+	return 0;
+}
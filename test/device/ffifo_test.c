@@ -0,0 +1,320 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <stdarg.h>
+/*
+ * Host test and benchmark for ffifo frame lending.
+ *
+ */
+
+#include "host.h"
+#include "device/ffifo.h"
+
+#define FRAME_SIZE 4
+#define FRAME_COUNT 5
+
+static char m_buffer[FRAME_SIZE*FRAME_COUNT];
+static ffifo_state_t m_state;
+static const ffifo_config_t m_config = { FFIFO_DEFINE_CONFIG(FRAME_COUNT, FRAME_SIZE, m_buffer) };
+
+int devfs_execute_read_handler(devfs_transfer_handler_t * transfer_handler, void * args, int nbyte, u32 o_flags){ return 0; }
+int devfs_execute_write_handler(devfs_transfer_handler_t * transfer_handler, void * args, int nbyte, u32 o_flags){ return 0; }
+int devfs_execute_event_handler(mcu_event_handler_t * handler, u32 o_events, void * data){ return 0; }
+int devfs_poll_transfer_handler(devfs_transfer_handler_t * transfer_handler, devfs_poll_t * request, u32 o_ready_events){ return 0; }
+
+static int m_watermark_calls;
+static u32 m_watermark_frames;
+static int m_watermark_keep;
+
+static int watermark_callback(void * context, const mcu_event_t * event){
+	HOST_CHECK(context == &m_watermark_calls);
+	m_watermark_calls++;
+	m_watermark_frames = (u32)(size_t)event->data;
+	return m_watermark_keep;
+}
+
+static int rejected_callback(void * context, const mcu_event_t * event){
+	HOST_CHECK(0);
+	return 0;
+}
+
+//the kernel version (devfs_data_transfer.c) is tested with readv
+int devfs_validate_event_handler(const mcu_event_handler_t * handler){
+	return handler->callback == rejected_callback ? -1 : 0;
+}
+
+static int get_errno(int result){
+	return SYSFS_GET_RETURN_ERRNO(result);
+}
+
+static void test_errors(){
+	ffifo_lend_t lend;
+	ffifo_lend_t other;
+	char frame[FRAME_SIZE*FRAME_COUNT];
+
+	ffifo_flush(&m_state);
+	ffifo_set_writeblock(&m_state, 1);
+
+	lend.frame_count = 0;
+	HOST_CHECK(get_errno(ffifo_acquire_read(&m_config, &m_state, &lend)) == EAGAIN);
+	HOST_CHECK(get_errno(ffifo_release_read(&m_config, &m_state, &lend)) == EINVAL);
+	HOST_CHECK(get_errno(ffifo_release_write(&m_config, &m_state, &lend)) == EINVAL);
+
+	//only one write lend at a time
+	lend.frame_count = 2;
+	HOST_CHECK(ffifo_acquire_write(&m_config, &m_state, &lend) == 2);
+	HOST_CHECK(lend.frame == m_buffer);
+	HOST_CHECK(lend.frame_size == FRAME_SIZE);
+	other.frame_count = 1;
+	HOST_CHECK(get_errno(ffifo_acquire_write(&m_config, &m_state, &other)) == EBUSY);
+
+	//a release must name the lent frames
+	other = lend;
+	other.frame = m_buffer + FRAME_SIZE;
+	HOST_CHECK(get_errno(ffifo_release_write(&m_config, &m_state, &other)) == EINVAL);
+	HOST_CHECK(ffifo_release_write(&m_config, &m_state, &lend) == 0);
+	HOST_CHECK(ffifo_get_frame_count_ready(&m_config, &m_state) == 2);
+
+	//fill the buffer and lend all of it
+	HOST_CHECK(ffifo_write_buffer(&m_config, &m_state, frame, FRAME_SIZE*3) == FRAME_SIZE*3);
+	lend.frame_count = 0;
+	HOST_CHECK(ffifo_acquire_read(&m_config, &m_state, &lend) == FRAME_COUNT);
+	HOST_CHECK(get_errno(ffifo_acquire_read(&m_config, &m_state, &other)) == EBUSY);
+
+	//writeblock keeps the lent frames intact
+	HOST_CHECK(ffifo_write_buffer(&m_config, &m_state, frame, FRAME_SIZE) == 0);
+	HOST_CHECK(ffifo_release_read(&m_config, &m_state, &lend) == 0);
+	HOST_CHECK(ffifo_get_frame_count_ready(&m_config, &m_state) == 0);
+
+	//without writeblock an overwrite of lent frames is reported on release
+	HOST_CHECK(ffifo_write_buffer(&m_config, &m_state, frame, FRAME_SIZE*FRAME_COUNT) == FRAME_SIZE*FRAME_COUNT);
+	lend.frame_count = 0;
+	HOST_CHECK(ffifo_acquire_read(&m_config, &m_state, &lend) > 0);
+	ffifo_set_writeblock(&m_state, 0);
+	HOST_CHECK(ffifo_write_buffer(&m_config, &m_state, frame, FRAME_SIZE) == FRAME_SIZE);
+	HOST_CHECK(get_errno(ffifo_release_read(&m_config, &m_state, &lend)) == EIO);
+	HOST_CHECK(ffifo_get_frame_count_ready(&m_config, &m_state) == FRAME_COUNT);
+	HOST_CHECK(m_state.overflow_count == 1);
+	printf("errors: ok\n");
+}
+
+static void set_watermark(u32 o_events, u16 frame_count, mcu_callback_t callback, int expected_errno){
+	ffifo_watermark_t watermark;
+	int result;
+	memset(&watermark, 0, sizeof(watermark));
+	watermark.o_events = o_events;
+	watermark.frame_count = frame_count;
+	watermark.handler.callback = callback;
+	watermark.handler.context = &m_watermark_calls;
+	result = ffifo_ioctl_local(&m_config, &m_state, I_FFIFO_SETWATERMARK, &watermark);
+	if( expected_errno ){
+		HOST_CHECK(get_errno(result) == expected_errno);
+	} else {
+		HOST_CHECK(result == 0);
+	}
+}
+
+static void test_watermark(){
+	ffifo_lend_t lend;
+	char frame[FRAME_SIZE*FRAME_COUNT];
+
+	HOST_CHECK(ffifo_ioctl_local(&m_config, &m_state, I_FFIFO_INIT, 0) == 0);
+	ffifo_set_writeblock(&m_state, 1);
+	m_watermark_calls = 0;
+	m_watermark_keep = 1;
+
+	set_watermark(MCU_EVENT_FLAG_DATA_READY, FRAME_COUNT+1, watermark_callback, EINVAL);
+	set_watermark(MCU_EVENT_FLAG_CANCELED, 1, watermark_callback, EINVAL);
+	set_watermark(MCU_EVENT_FLAG_DATA_READY, 1, rejected_callback, EPERM);
+	HOST_CHECK(m_state.watermark.handler.callback == NULL);
+
+	//the read watermark fires once enough frames are ready
+	set_watermark(MCU_EVENT_FLAG_DATA_READY, 2, watermark_callback, 0);
+	HOST_CHECK(ffifo_write_buffer(&m_config, &m_state, frame, FRAME_SIZE) == FRAME_SIZE);
+	ffifo_data_received(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 0);
+	HOST_CHECK(ffifo_write_buffer(&m_config, &m_state, frame, FRAME_SIZE*2) == FRAME_SIZE*2);
+	ffifo_data_received(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 1);
+	HOST_CHECK(m_watermark_frames == 3);
+
+	//it doesn't fire when frames are removed
+	ffifo_data_transmitted(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 1);
+
+	//releasing lent frames fires it like a write
+	lend.frame_count = 1;
+	HOST_CHECK(ffifo_ioctl_local(&m_config, &m_state, I_FFIFO_ACQUIRE_WRITE, &lend) == 1);
+	HOST_CHECK(ffifo_ioctl_local(&m_config, &m_state, I_FFIFO_RELEASE_WRITE, &lend) == 0);
+	HOST_CHECK(m_watermark_calls == 2);
+	HOST_CHECK(m_watermark_frames == 4);
+
+	//a handler that returns zero is removed
+	m_watermark_keep = 0;
+	ffifo_data_received(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 3);
+	HOST_CHECK(m_state.watermark.handler.callback == NULL);
+	ffifo_data_received(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 3);
+
+	//the write watermark counts free frames
+	m_watermark_keep = 1;
+	set_watermark(MCU_EVENT_FLAG_WRITE_COMPLETE, 3, watermark_callback, 0);
+	HOST_CHECK(ffifo_read_buffer(&m_config, &m_state, frame, FRAME_SIZE) == FRAME_SIZE);
+	ffifo_data_transmitted(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 3);
+	HOST_CHECK(ffifo_read_buffer(&m_config, &m_state, frame, FRAME_SIZE) == FRAME_SIZE);
+	ffifo_data_transmitted(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 4);
+	HOST_CHECK(m_watermark_frames == 3);
+	ffifo_data_received(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 4);
+
+	//a null callback and I_FFIFO_INIT remove it
+	set_watermark(MCU_EVENT_FLAG_WRITE_COMPLETE, 0, NULL, 0);
+	ffifo_data_transmitted(&m_config, &m_state);
+	HOST_CHECK(m_watermark_calls == 4);
+	set_watermark(MCU_EVENT_FLAG_WRITE_COMPLETE, 0, watermark_callback, 0);
+	HOST_CHECK(ffifo_ioctl_local(&m_config, &m_state, I_FFIFO_INIT, 0) == 0);
+	HOST_CHECK(m_state.watermark.handler.callback == NULL);
+	printf("watermark: ok\n");
+}
+
+static void test_sequence(){
+	ffifo_lend_t lend;
+	unsigned char write_sequence;
+	unsigned char read_sequence;
+	char frames[FRAME_SIZE*3];
+	long total;
+	int iteration;
+	int result;
+	int used;
+	int i;
+
+	ffifo_flush(&m_state);
+	ffifo_set_writeblock(&m_state, 1);
+	write_sequence = 0;
+	read_sequence = 0;
+	total = 0;
+
+	//lent and copied frames are mixed so the positions wrap at every offset
+	for(iteration=0; iteration < 100000; iteration++){
+		lend.frame_count = iteration % 4;
+		result = ffifo_acquire_write(&m_config, &m_state, &lend);
+		if( result > 0 ){
+			used = (iteration % 3 == 0) ? result : (result + 1) / 2;
+			for(i=0; i < used*FRAME_SIZE; i++){
+				((char*)lend.frame)[i] = write_sequence++;
+			}
+			lend.frame_count = used;
+			HOST_CHECK(ffifo_release_write(&m_config, &m_state, &lend) == 0);
+		}
+
+		lend.frame_count = (iteration * 7) % 3;
+		result = ffifo_acquire_read(&m_config, &m_state, &lend);
+		if( result > 0 ){
+			used = (iteration % 5 == 0) ? 1 : result;
+			for(i=0; i < used*FRAME_SIZE; i++){
+				HOST_CHECK((unsigned char)((char*)lend.frame)[i] == read_sequence);
+				read_sequence++;
+				total++;
+			}
+			lend.frame_count = used;
+			HOST_CHECK(ffifo_release_read(&m_config, &m_state, &lend) == 0);
+		}
+
+		if( iteration % 11 == 0 ){
+			for(i=0; i < FRAME_SIZE*2; i++){
+				frames[i] = write_sequence + i;
+			}
+			write_sequence += ffifo_write_buffer(&m_config, &m_state, frames, FRAME_SIZE*2);
+		}
+
+		if( iteration % 13 == 0 ){
+			result = ffifo_read_buffer(&m_config, &m_state, frames, FRAME_SIZE*3);
+			for(i=0; i < result; i++){
+				HOST_CHECK((unsigned char)frames[i] == read_sequence);
+				read_sequence++;
+				total++;
+			}
+		}
+	}
+	printf("sequence: %ld bytes\n", total);
+}
+
+#define BENCH_BUFFER_SIZE (1024*32)
+#define BENCH_ITERATIONS 500000
+
+static char m_bench_buffer[BENCH_BUFFER_SIZE];
+
+static void bench_frame_size(u16 frame_size){
+	ffifo_config_t config = { FFIFO_DEFINE_CONFIG(BENCH_BUFFER_SIZE / frame_size, frame_size, m_bench_buffer) };
+	char frame[1024];
+	char name[64];
+	ffifo_lend_t lend;
+	unsigned long long start;
+	volatile u32 sum;
+	long i;
+	int j;
+
+	//the producer fills a frame and the consumer sums it -- once through a copy and once in place
+	ffifo_flush(&m_state);
+	sum = 0;
+	start = host_now_ns();
+	for(i=0; i < BENCH_ITERATIONS; i++){
+		memset(frame, i, frame_size);
+		ffifo_write_buffer(&config, &m_state, frame, frame_size);
+		ffifo_read_buffer(&config, &m_state, frame, frame_size);
+		for(j=0; j < frame_size; j++){ sum += frame[j]; }
+	}
+	snprintf(name, sizeof(name), "ffifo copy %d byte frames", frame_size);
+	host_report(name, host_now_ns() - start, i);
+
+	ffifo_flush(&m_state);
+	start = host_now_ns();
+	for(i=0; i < BENCH_ITERATIONS; i++){
+		lend.frame_count = 1;
+		ffifo_acquire_write(&config, &m_state, &lend);
+		memset(lend.frame, i, frame_size);
+		ffifo_release_write(&config, &m_state, &lend);
+		lend.frame_count = 1;
+		ffifo_acquire_read(&config, &m_state, &lend);
+		for(j=0; j < frame_size; j++){ sum += ((char*)lend.frame)[j]; }
+		ffifo_release_read(&config, &m_state, &lend);
+	}
+	snprintf(name, sizeof(name), "ffifo lend %d byte frames", frame_size);
+	host_report(name, host_now_ns() - start, i);
+}
+
+static void bench(){
+	bench_frame_size(64);
+	bench_frame_size(1024);
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_errors();
+	test_watermark();
+	test_sequence();
+	return 0;
+}
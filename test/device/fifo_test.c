@@ -0,0 +1,197 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <stdarg.h>
+/*
+ * Host test and benchmark for the fifo bulk copy.
+ *
+ * A SIGALRM handler stands in for the interrupt that writes the fifo while
+ * the main loop reads it, so the reader is interrupted in the middle of
+ * its copies.
+ *
+ */
+
+#include <signal.h>
+#include <sys/time.h>
+
+#include "host.h"
+#include "device/fifo.h"
+
+#define FIFO_SIZE 257
+
+static char m_buffer[FIFO_SIZE];
+static fifo_state_t m_state;
+static const fifo_config_t m_config = { .size = FIFO_SIZE, .buffer = m_buffer };
+
+static volatile unsigned long m_produced;
+static volatile unsigned long m_dropped;
+static unsigned char m_write_sequence;
+
+int devfs_execute_read_handler(devfs_transfer_handler_t * transfer_handler, void * args, int nbyte, u32 o_flags){ return 0; }
+int devfs_execute_write_handler(devfs_transfer_handler_t * transfer_handler, void * args, int nbyte, u32 o_flags){ return 0; }
+int devfs_execute_event_handler(mcu_event_handler_t * handler, u32 o_events, void * data){ return 0; }
+static u32 m_poll_requested_events;
+static u32 m_poll_ready_events;
+
+int devfs_poll_transfer_handler(devfs_transfer_handler_t * transfer_handler, devfs_poll_t * request, u32 o_ready_events){
+	m_poll_requested_events = request->o_events;
+	m_poll_ready_events = o_ready_events;
+	return 0;
+}
+
+static void write_interrupt(int signal){
+	char chunk[400];
+	static unsigned int lcg = 1;
+	int nbyte;
+	int result;
+	int i;
+
+	lcg = lcg*1103515245u + 12345u;
+	nbyte = (lcg >> 16) % 400 + 1;
+	for(i=0; i < nbyte; i++){
+		chunk[i] = m_write_sequence + i;
+	}
+
+	result = fifo_write_buffer(&m_config, &m_state, chunk, nbyte, 0);
+	m_write_sequence += result;
+	m_produced += result;
+	m_dropped += nbyte - result;
+}
+
+static void test_wrap(){
+	char in[FIFO_SIZE*2];
+	char out[FIFO_SIZE*2];
+	int offset;
+	int nbyte;
+	int i;
+
+	for(i=0; i < FIFO_SIZE*2; i++){
+		in[i] = i*7;
+	}
+
+	//every combination of start offset and length crosses the end of the buffer
+	for(offset=0; offset < FIFO_SIZE; offset++){
+		for(nbyte=1; nbyte < FIFO_SIZE; nbyte += 13){
+			fifo_flush(&m_state);
+			m_state.atomic_position.access.head = offset;
+			m_state.atomic_position.access.tail = offset;
+			HOST_CHECK(fifo_write_buffer(&m_config, &m_state, in, nbyte, 0) == nbyte);
+			memset(out, 0, sizeof(out));
+			HOST_CHECK(fifo_read_buffer(&m_config, &m_state, out, FIFO_SIZE) == nbyte);
+			HOST_CHECK(memcmp(in, out, nbyte) == 0);
+		}
+	}
+
+	//without writeblock a full fifo overwrites the oldest data
+	fifo_flush(&m_state);
+	HOST_CHECK(fifo_write_buffer(&m_config, &m_state, in, FIFO_SIZE + 10, 0) == FIFO_SIZE + 10);
+	HOST_CHECK(fifo_is_overflow(&m_state));
+	fifo_flush(&m_state);
+	printf("wrap: ok\n");
+}
+
+static void test_ready_events(){
+	devfs_poll_t request;
+	char in[FIFO_SIZE];
+
+	fifo_flush(&m_state);
+	fifo_set_writeblock(&m_state, 1);
+	HOST_CHECK(fifo_get_ready_events(m_state.atomic_position.atomic_access, FIFO_SIZE, 1) == MCU_EVENT_FLAG_WRITE_COMPLETE);
+
+	HOST_CHECK(fifo_write_buffer(&m_config, &m_state, in, 1, 0) == 1);
+	HOST_CHECK(fifo_get_ready_events(m_state.atomic_position.atomic_access, FIFO_SIZE, 1) == (MCU_EVENT_FLAG_DATA_READY | MCU_EVENT_FLAG_WRITE_COMPLETE));
+
+	//a full fifo is only writable without writeblock
+	HOST_CHECK(fifo_write_buffer(&m_config, &m_state, in, FIFO_SIZE, 0) == FIFO_SIZE - 1);
+	HOST_CHECK(fifo_get_ready_events(m_state.atomic_position.atomic_access, FIFO_SIZE, 1) == MCU_EVENT_FLAG_DATA_READY);
+	HOST_CHECK(fifo_get_ready_events(m_state.atomic_position.atomic_access, FIFO_SIZE, 0) == (MCU_EVENT_FLAG_DATA_READY | MCU_EVENT_FLAG_WRITE_COMPLETE));
+
+	//drivers that write to the hardware only poll the fifo for reads
+	request.o_events = MCU_EVENT_FLAG_DATA_READY | MCU_EVENT_FLAG_WRITE_COMPLETE;
+	HOST_CHECK(fifo_poll_read(&m_config, &m_state, &request) == 0);
+	HOST_CHECK(m_poll_requested_events == MCU_EVENT_FLAG_DATA_READY);
+	HOST_CHECK(m_poll_ready_events == MCU_EVENT_FLAG_DATA_READY);
+	HOST_CHECK(request.o_events & MCU_EVENT_FLAG_WRITE_COMPLETE);
+
+	fifo_set_writeblock(&m_state, 0);
+	fifo_flush(&m_state);
+	printf("ready events: ok\n");
+}
+
+static void test_interrupted(){
+	struct itimerval timer = { {0, 20}, {0, 20} };
+	struct itimerval stop = { {0, 0}, {0, 0} };
+	unsigned char read_sequence;
+	unsigned long consumed;
+	char buf[300];
+	int nbyte;
+	int i;
+
+	fifo_flush(&m_state);
+	fifo_set_writeblock(&m_state, 1);
+	signal(SIGALRM, write_interrupt);
+	setitimer(ITIMER_REAL, &timer, 0);
+
+	read_sequence = 0;
+	consumed = 0;
+	while( consumed < 200000 ){
+		nbyte = fifo_read_buffer(&m_config, &m_state, buf, rand() % 300 + 1);
+		for(i=0; i < nbyte; i++){
+			HOST_CHECK((unsigned char)buf[i] == read_sequence);
+			read_sequence++;
+		}
+		consumed += nbyte;
+	}
+
+	setitimer(ITIMER_REAL, &stop, 0);
+	printf("interrupted: consumed %lu dropped %lu\n", consumed, m_dropped);
+}
+
+static void bench(){
+	char in[256];
+	char out[256];
+	unsigned long long start;
+	long total;
+	long i;
+	int nbyte;
+
+	fifo_flush(&m_state);
+	memset(in, 0x55, sizeof(in));
+	total = 0;
+	start = host_now_ns();
+	for(i=0; i < 2000000; i++){
+		nbyte = 1 + i % 128;
+		total += fifo_write_buffer(&m_config, &m_state, in, nbyte, 0);
+		fifo_read_buffer(&m_config, &m_state, out, nbyte);
+	}
+	host_report("fifo write+read 1..128 bytes", host_now_ns() - start, i);
+	printf("%.1f MB/s\n", total * 1000.0 / (host_now_ns() - start));
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_wrap();
+	test_ready_events();
+	test_interrupted();
+	return 0;
+}
@@ -0,0 +1,499 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+/*
+ * Host test for switchboard fan-out outputs and packet transforms.
+ *
+ * The devices on the switchboard are fakes that keep the pending
+ * asynchronous read or write. The test completes them in whatever order
+ * it wants by calling the handler the same way a driver's interrupt does.
+ *
+ */
+
+#include <errno.h>
+
+#include "host.h"
+#include "mcu/mcu.h"
+#include "sos/fs/sysfs.h"
+#include "device/switchboard.h"
+
+#define CONNECTION_COUNT 4
+#define BUFFER_SIZE 16
+#define PACKET_SIZE 8
+#define LOG_SIZE 1024
+#define DEVICE_COUNT 4
+
+typedef struct {
+	devfs_async_t * async; //pending operation
+	int is_synchronous; //writes complete before the driver returns
+	int is_open;
+	int error; //errno to return from the next operation
+	u8 log[LOG_SIZE]; //bytes written to the device
+	int log_size;
+} fake_state_t;
+
+enum {
+	INPUT, OUTPUT0, OUTPUT1, OUTPUT2
+};
+
+static int fake_open(const devfs_handle_t * handle);
+static int fake_ioctl(const devfs_handle_t * handle, int request, void * ctl);
+static int fake_read(const devfs_handle_t * handle, devfs_async_t * async);
+static int fake_write(const devfs_handle_t * handle, devfs_async_t * async);
+static int fake_close(const devfs_handle_t * handle);
+
+#define FAKE_DEVICE(device_name, index) { .name = device_name, \
+	.driver = { fake_open, fake_ioctl, fake_read, fake_write, fake_close }, \
+	.handle = { .port = index, .state = m_fake + index } }
+
+static fake_state_t m_fake[DEVICE_COUNT];
+
+static const devfs_device_t m_devices[] = {
+	FAKE_DEVICE("in0", INPUT),
+	FAKE_DEVICE("out0", OUTPUT0),
+	FAKE_DEVICE("out1", OUTPUT1),
+	FAKE_DEVICE("out2", OUTPUT2),
+	{ 0 }
+};
+
+static char m_buffer[CONNECTION_COUNT*BUFFER_SIZE*2];
+static switchboard_state_t m_state[CONNECTION_COUNT];
+static const switchboard_config_t m_config = {
+	.devfs_list = m_devices,
+	.connection_count = CONNECTION_COUNT,
+	.connection_buffer_size = BUFFER_SIZE,
+	.transaction_limit = 100,
+	.buffer = m_buffer
+};
+static const devfs_handle_t m_handle = { .config = &m_config, .state = m_state };
+
+static u8 m_sequence;
+static u32 m_stop_events[CONNECTION_COUNT];
+
+volatile int m_task_current;
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+
+int mcu_execute_event_handler(mcu_event_handler_t * handler, u32 o_events, void * data){
+	int ret = 0;
+	mcu_event_t event;
+	mcu_callback_t callback;
+	if( handler->callback ){
+		event.o_events = o_events;
+		event.data = data;
+		callback = handler->callback;
+		handler->callback = 0;
+		ret = callback(handler->context, &event);
+		if( ret != 0 ){
+			handler->callback = callback;
+		}
+	}
+	return ret;
+}
+
+const devfs_device_t * devfs_lookup_device(const devfs_device_t * list, const char * device_name){
+	int i;
+	for(i=0; list[i].driver.open != 0; i++){
+		if( strncmp(device_name, list[i].name, NAME_MAX) == 0 ){
+			return list + i;
+		}
+	}
+	return 0;
+}
+
+int devfs_lookup_name(const devfs_device_t * list, const devfs_device_t * device, char name[NAME_MAX]){
+	strncpy(name, device->name, NAME_MAX);
+	return 0;
+}
+
+int fake_open(const devfs_handle_t * handle){
+	fake_state_t * state = handle->state;
+	state->is_open++;
+	return 0;
+}
+
+int fake_ioctl(const devfs_handle_t * handle, int request, void * ctl){
+	return 0;
+}
+
+int fake_read(const devfs_handle_t * handle, devfs_async_t * async){
+	fake_state_t * state = handle->state;
+	HOST_CHECK(state->async == 0);
+	if( state->error ){
+		return SYSFS_SET_RETURN(state->error);
+	}
+	state->async = async;
+	return 0;
+}
+
+static void log_write(fake_state_t * state, devfs_async_t * async){
+	HOST_CHECK(state->log_size + async->nbyte <= LOG_SIZE);
+	memcpy(state->log + state->log_size, async->buf, async->nbyte);
+	state->log_size += async->nbyte;
+}
+
+int fake_write(const devfs_handle_t * handle, devfs_async_t * async){
+	fake_state_t * state = handle->state;
+	HOST_CHECK(state->async == 0);
+	if( state->error ){
+		return SYSFS_SET_RETURN(state->error);
+	}
+	if( state->is_synchronous ){
+		log_write(state, async);
+		return async->nbyte;
+	}
+	state->async = async;
+	return 0;
+}
+
+int fake_close(const devfs_handle_t * handle){
+	fake_state_t * state = handle->state;
+	state->is_open--;
+	return 0;
+}
+
+static int stop_handler(void * context, const mcu_event_t * event){
+	m_stop_events[(int)(long)context] = event->o_events;
+	return 0;
+}
+
+//completes the pending read with the next packet -- returns zero if no read was pending
+static int deliver_packet(){
+	fake_state_t * state = m_fake + INPUT;
+	devfs_async_t * async = state->async;
+	mcu_event_t event;
+	int i;
+
+	if( async == 0 ){
+		return 0;
+	}
+
+	state->async = 0;
+	for(i=0; i < async->nbyte; i++){
+		((u8*)async->buf)[i] = m_sequence++;
+	}
+	event.o_events = MCU_EVENT_FLAG_DATA_READY;
+	event.data = 0;
+	async->handler.callback(async->handler.context, &event);
+	return 1;
+}
+
+//completes the pending write on an output -- returns zero if no write was pending
+static int complete_write(int device){
+	fake_state_t * state = m_fake + device;
+	devfs_async_t * async = state->async;
+	mcu_event_t event;
+
+	if( async == 0 ){
+		return 0;
+	}
+
+	state->async = 0;
+	log_write(state, async);
+	event.o_events = MCU_EVENT_FLAG_WRITE_COMPLETE;
+	event.data = 0;
+	async->handler.callback(async->handler.context, &event);
+	return 1;
+}
+
+static int connect(u16 id, const char * input, const char * output, u32 o_flags){
+	switchboard_attr_t attr;
+	mcu_action_t action;
+	int result;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.id = id;
+	attr.o_flags = SWITCHBOARD_FLAG_CONNECT | SWITCHBOARD_FLAG_IS_PERSISTENT | o_flags;
+	attr.nbyte = PACKET_SIZE;
+	strcpy(attr.input.name, input);
+	strcpy(attr.output.name, output);
+	result = switchboard_ioctl(&m_handle, I_SWITCHBOARD_SETATTR, &attr);
+	if( result < 0 ){
+		return result;
+	}
+
+	//the connection clears the action so it is set afterwards
+	memset(&action, 0, sizeof(action));
+	action.channel = id;
+	action.handler.callback = stop_handler;
+	action.handler.context = (void*)(long)id;
+	m_stop_events[id] = 0;
+	HOST_CHECK(switchboard_ioctl(&m_handle, I_SWITCHBOARD_SETACTION, &action) == 0);
+	return 0;
+}
+
+static int disconnect(u16 id){
+	switchboard_attr_t attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.id = id;
+	attr.o_flags = SWITCHBOARD_FLAG_DISCONNECT;
+	return switchboard_ioctl(&m_handle, I_SWITCHBOARD_SETATTR, &attr);
+}
+
+static s32 get_status(u16 id, u32 * o_flags){
+	switchboard_connection_t status;
+	devfs_async_t async;
+	memset(&async, 0, sizeof(async));
+	async.loc = id*sizeof(switchboard_connection_t);
+	async.buf = &status;
+	async.nbyte = sizeof(status);
+	HOST_CHECK(switchboard_read(&m_handle, &async) == sizeof(status));
+	if( o_flags ){
+		*o_flags = status.o_flags;
+	}
+	return status.nbyte;
+}
+
+//checks that the device got consecutive packets starting with first
+static void check_log(int device, u8 first, int count){
+	fake_state_t * state = m_fake + device;
+	int i;
+	HOST_CHECK(state->log_size == count*PACKET_SIZE);
+	for(i=0; i < state->log_size; i++){
+		HOST_CHECK(state->log[i] == (u8)(first + i));
+	}
+}
+
+static void reset(){
+	int i;
+	memset(m_state, 0, sizeof(m_state));
+	memset(m_fake, 0, sizeof(m_fake));
+	m_sequence = 0;
+	for(i=0; i < CONNECTION_COUNT; i++){
+		m_stop_events[i] = 0;
+	}
+}
+
+static void test_fan_out(){
+	int i;
+
+	reset();
+
+	//a fan-out output needs an active source
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(connect(1, "in0", "out1", SWITCHBOARD_FLAG_IS_FAN_OUT)) == ENOENT);
+
+	HOST_CHECK(connect(0, "in0", "out0", 0) == 0);
+	HOST_CHECK(m_fake[INPUT].async != 0);
+
+	//the input can only be read by one connection
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(connect(1, "in0", "out1", 0)) == EBUSY);
+	//an output can't be shared
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(connect(1, "in0", "out0", SWITCHBOARD_FLAG_IS_FAN_OUT)) == EBUSY);
+
+	HOST_CHECK(connect(1, "in0", "out1", SWITCHBOARD_FLAG_IS_FAN_OUT) == 0);
+	HOST_CHECK(connect(2, "in0", "out2", SWITCHBOARD_FLAG_IS_FAN_OUT) == 0);
+	HOST_CHECK(m_fake[OUTPUT1].is_open == 1);
+	HOST_CHECK(m_fake[OUTPUT2].is_open == 1);
+
+	//outputs complete in a different order each time
+	for(i=0; i < 20; i++){
+		HOST_CHECK(deliver_packet());
+		switch(i % 3){
+			case 0:
+				HOST_CHECK(complete_write(OUTPUT0));
+				HOST_CHECK(complete_write(OUTPUT1));
+				HOST_CHECK(complete_write(OUTPUT2));
+				break;
+			case 1:
+				HOST_CHECK(complete_write(OUTPUT2));
+				HOST_CHECK(complete_write(OUTPUT0));
+				HOST_CHECK(complete_write(OUTPUT1));
+				break;
+			case 2:
+				HOST_CHECK(complete_write(OUTPUT1));
+				HOST_CHECK(complete_write(OUTPUT2));
+				HOST_CHECK(complete_write(OUTPUT0));
+				break;
+		}
+	}
+
+	check_log(OUTPUT0, 0, 20);
+	check_log(OUTPUT1, 0, 20);
+	check_log(OUTPUT2, 0, 20);
+
+	//the status of the fan-out output names the source input
+	HOST_CHECK(get_status(1, 0) == PACKET_SIZE);
+
+	//when the source is disconnected, every output stops
+	HOST_CHECK(disconnect(0) == 0);
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(m_stop_events[0] & MCU_EVENT_FLAG_STOP);
+	HOST_CHECK(m_stop_events[1] & MCU_EVENT_FLAG_STOP);
+	HOST_CHECK(m_stop_events[2] & MCU_EVENT_FLAG_STOP);
+	for(i=0; i < DEVICE_COUNT; i++){
+		HOST_CHECK(m_fake[i].is_open == 0);
+	}
+	HOST_CHECK(m_state[0].o_flags == 0);
+
+	printf("fan out: ok\n");
+}
+
+static void test_reference_count(){
+	int i;
+
+	reset();
+	HOST_CHECK(connect(0, "in0", "out0", 0) == 0);
+	HOST_CHECK(connect(1, "in0", "out1", SWITCHBOARD_FLAG_IS_FAN_OUT) == 0);
+	m_fake[OUTPUT0].is_synchronous = 1;
+
+	//out1 holds the first buffer so the source reads the second buffer and stops
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(m_state[0].reference_count[0] == 1);
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(m_state[0].reference_count[1] == 1);
+	HOST_CHECK(m_fake[INPUT].async == 0);
+	HOST_CHECK(deliver_packet() == 0);
+	check_log(OUTPUT0, 0, 2);
+
+	//once out1 writes the first buffer, the source reads it again
+	HOST_CHECK(complete_write(OUTPUT1));
+	HOST_CHECK(m_state[0].reference_count[0] == 0);
+	HOST_CHECK(m_fake[INPUT].async != 0);
+	HOST_CHECK(complete_write(OUTPUT1));
+	HOST_CHECK(m_state[0].reference_count[1] == 0);
+
+	for(i=0; i < 10; i++){
+		HOST_CHECK(deliver_packet());
+		HOST_CHECK(complete_write(OUTPUT1));
+	}
+	check_log(OUTPUT0, 0, 12);
+	check_log(OUTPUT1, 0, 12);
+
+	//a fan-out output that is disconnected drops its references and the source keeps going
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(m_state[0].reference_count[0] + m_state[0].reference_count[1] == 1);
+	HOST_CHECK(disconnect(1) == 0);
+	HOST_CHECK(complete_write(OUTPUT1));
+	HOST_CHECK(m_stop_events[1] & MCU_EVENT_FLAG_STOP);
+	HOST_CHECK(m_fake[OUTPUT1].is_open == 0);
+	HOST_CHECK(m_state[1].o_flags == 0);
+	HOST_CHECK(m_state[0].fan_out == 0);
+	HOST_CHECK(m_state[0].reference_count[0] == 0);
+	HOST_CHECK(m_state[0].reference_count[1] == 0);
+
+	for(i=0; i < 10; i++){
+		HOST_CHECK(deliver_packet());
+	}
+	check_log(OUTPUT0, 0, 23);
+	HOST_CHECK(m_stop_events[0] == 0);
+
+	//an output that fails stops by itself
+	HOST_CHECK(connect(1, "in0", "out1", SWITCHBOARD_FLAG_IS_FAN_OUT) == 0);
+	m_fake[OUTPUT1].error = EIO;
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(m_stop_events[1] & MCU_EVENT_FLAG_STOP);
+	HOST_CHECK(m_stop_events[0] == 0);
+	HOST_CHECK(m_state[0].fan_out == 0);
+	HOST_CHECK(m_state[0].reference_count[0] == 0);
+	HOST_CHECK(m_state[0].reference_count[1] == 0);
+	HOST_CHECK(deliver_packet());
+	check_log(OUTPUT0, 0, 26);
+
+	HOST_CHECK(disconnect(0) == 0);
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(m_fake[INPUT].is_open == 0);
+	HOST_CHECK(m_fake[OUTPUT0].is_open == 0);
+
+	printf("reference count: ok\n");
+}
+
+//keeps every other byte and drops packets that start with a multiple of 32
+static int decimate(void * context, void * buf, int nbyte, int size){
+	u8 * data = buf;
+	int * count = context;
+	int i;
+
+	(*count)++;
+	if( data[0] % 32 == 0 ){
+		return 0;
+	}
+
+	if( *count == 10 ){
+		return -1;
+	}
+
+	for(i=0; i < nbyte/2; i++){
+		data[i] = data[i*2];
+	}
+	return nbyte/2;
+}
+
+static void test_transform(){
+	switchboard_transform_t transform;
+	fake_state_t * output = m_fake + OUTPUT0;
+	int count;
+	int i;
+	u32 o_flags;
+
+	reset();
+	count = 0;
+	memset(&transform, 0, sizeof(transform));
+	transform.id = 0;
+	transform.callback = decimate;
+	transform.context = &count;
+
+	//the transform is set before connecting
+	HOST_CHECK(switchboard_ioctl(&m_handle, I_SWITCHBOARD_SETTRANSFORM, &transform) == 0);
+	HOST_CHECK(connect(0, "in0", "out0", 0) == 0);
+	HOST_CHECK(connect(1, "in0", "out1", SWITCHBOARD_FLAG_IS_FAN_OUT) == 0);
+	m_fake[OUTPUT0].is_synchronous = 1;
+	m_fake[OUTPUT1].is_synchronous = 1;
+
+	//fan-out outputs get the source's transformed packets
+	transform.id = 1;
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(switchboard_ioctl(&m_handle, I_SWITCHBOARD_SETTRANSFORM, &transform)) == EINVAL);
+
+	for(i=0; i < 9; i++){
+		HOST_CHECK(deliver_packet());
+	}
+
+	//packets 0, 4 and 8 are dropped, the rest are decimated
+	HOST_CHECK(output->log_size == 6*PACKET_SIZE/2);
+	HOST_CHECK(memcmp(output->log, m_fake[OUTPUT1].log, output->log_size) == 0);
+	for(i=0; i < output->log_size; i++){
+		int packet = i / (PACKET_SIZE/2);
+		packet += 1 + packet/3;
+		HOST_CHECK(output->log[i] == packet*PACKET_SIZE + (i % (PACKET_SIZE/2))*2);
+	}
+
+	//the transform stops the connection
+	HOST_CHECK(deliver_packet());
+	HOST_CHECK(count == 10);
+	HOST_CHECK(output->log_size == 6*PACKET_SIZE/2);
+	HOST_CHECK(m_stop_events[0] & MCU_EVENT_FLAG_STOP);
+	HOST_CHECK(m_stop_events[1] & MCU_EVENT_FLAG_STOP);
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(get_status(0, &o_flags)) == ECANCELED);
+	HOST_CHECK((o_flags & SWITCHBOARD_FLAG_IS_CONNECTED) == 0);
+	HOST_CHECK(m_fake[INPUT].is_open == 0);
+
+	//a stopped connection clears when it is disconnected and keeps no transform
+	HOST_CHECK(disconnect(0) == 0);
+	HOST_CHECK(m_state[0].o_flags == 0);
+	HOST_CHECK(m_state[0].transform.callback == 0);
+
+	printf("transform: ok\n");
+}
+
+int main(int argc, char * argv[]){
+	test_fan_out();
+	test_reference_count();
+	test_transform();
+	return 0;
+}
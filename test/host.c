@@ -0,0 +1,72 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <stdarg.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "host.h"
+
+void * host_alloc_low(size_t size){
+	void * result;
+	result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	HOST_CHECK(result != MAP_FAILED);
+	return result;
+}
+
+unsigned long long host_now_ns(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int host_is_mode(int argc, char * argv[], const char * name){
+	return (argc > 1) && (strcmp(argv[1], name) == 0);
+}
+
+void host_report(const char * name, unsigned long long ns, long operations){
+	printf("%-32s %10ld ops %10.1f ns/op\n", name, operations, (double)ns / operations);
+}
+
+//debug output from the kernel sources under test
+void mcu_debug_log_info(int o_flags, const char * format, ...){}
+
+void mcu_debug_log_warning(int o_flags, const char * format, ...){
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "warning: ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+void mcu_debug_log_error(int o_flags, const char * format, ...){
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "error: ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+	exit(1);
+}
+
+int mcu_debug_printf(const char * format, ...){ return 0; }
+
+void sos_trace_stack(unsigned int count){}
+void sos_trace_event(int event, const void * data, size_t data_len){}
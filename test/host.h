@@ -0,0 +1,55 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*! \details Checks \a x and exits with a failure if it is false.
+ *
+ */
+#define HOST_CHECK(x) do { \
+	if( !(x) ){ \
+	fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+	exit(1); \
+	} \
+	} while(0)
+
+/*! \details Returns memory for kernel data structures that the kernel code
+ * addresses with 32-bit integers. The memory is mapped in the low 2GB of
+ * the address space so those casts do not lose bits.
+ *
+ */
+void * host_alloc_low(size_t size);
+
+/*! \details Returns a monotonic time stamp in nanoseconds. */
+unsigned long long host_now_ns();
+
+/*! \details Returns non-zero if the test was run with \a name
+ * as its first argument.
+ */
+int host_is_mode(int argc, char * argv[], const char * name);
+
+/*! \details Prints one benchmark result line. */
+void host_report(const char * name, unsigned long long ns, long operations);
+
+#endif /* HOST_H_ */
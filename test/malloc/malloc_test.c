@@ -0,0 +1,359 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#include <stdarg.h>
+/*
+ * Host test and benchmark for the chunk allocator.
+ *
+ * The test is built once with the first-fit heap walk and once with
+ * MALLOC_USE_FREE_LIST_BINS so both modes are checked and can be compared
+ * with "bench".
+ *
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <reent.h>
+
+#include "host.h"
+#include "sos/sos.h"
+#include "cortexm/task_table.h"
+#include "cortexm/cortexm.h"
+#include "sys/malloc/malloc_local.h"
+
+#define HEAP_SIZE (8*1024*1024)
+#define LIVE_TOTAL 2000
+
+static struct _reent m_reent;
+struct _reent * _impure_ptr = &m_reent;
+
+volatile task_t sos_task_table[8];
+volatile int m_task_current;
+
+void cortexm_assign_zero_sum32(void * data, int size){
+	u32 * d = data;
+	u32 sum = 0;
+	int i;
+	for(i=0; i < size-1; i++){ sum += d[i]; }
+	d[size-1] = (u32)(0 - sum);
+}
+
+int cortexm_verify_zero_sum32(void * data, int size){
+	u32 * d = data;
+	u32 sum = 0;
+	int i;
+	for(i=0; i < size; i++){ sum += d[i]; }
+	return sum == 0;
+}
+
+void mcu_board_execute_event_handler(int event, void * args){
+	fprintf(stderr, "fatal board event %d\n", event);
+	exit(1);
+}
+
+void __malloc_lock(struct _reent * reent_ptr){}
+void __malloc_unlock(struct _reent * reent_ptr){}
+
+void * _sbrk_r(struct _reent * reent_ptr, ptrdiff_t incr){
+	int size = reent_ptr->procmem_base->size;
+	if( size + incr > HEAP_SIZE - 256 ){
+		return NULL;
+	}
+	reent_ptr->procmem_base->size += incr;
+	return (char*)&(reent_ptr->procmem_base->base) + size;
+}
+
+static void init_heap(){
+	char * arena;
+	arena = host_alloc_low(HEAP_SIZE + 64);
+	//the heap base is aligned like the process memory on the target
+	m_reent.procmem_base = (proc_mem_t*)(arena + 64 - offsetof(proc_mem_t, base));
+	m_reent.procmem_base->size = 0;
+	m_task_current = 3;
+}
+
+static int random_size(){
+	return rand() % (rand() % 4 == 0 ? 4000 : 200) + 1;
+}
+
+static void fill(char * p, int size, int key){
+	memset(p, key, size);
+}
+
+static void check_fill(const char * p, int size, int key){
+	int i;
+	for(i=0; i < size; i++){
+		HOST_CHECK(p[i] == (char)key);
+	}
+}
+
+static void test_random(long iterations){
+	static char * p[LIVE_TOTAL];
+	static int size[LIVE_TOTAL];
+	long i;
+	int k;
+
+	srand(1);
+	for(i=0; i < iterations; i++){
+		k = rand() % LIVE_TOTAL;
+		if( p[k] ){
+			check_fill(p[k], size[k], k);
+			_free_r(&m_reent, p[k]);
+			p[k] = 0;
+		} else {
+			size[k] = random_size();
+			p[k] = _malloc_r(&m_reent, size[k]);
+			HOST_CHECK(p[k] != 0);
+			HOST_CHECK(((uintptr_t)p[k] & 3) == 0);
+			fill(p[k], size[k], k);
+		}
+	}
+
+	for(k=0; k < LIVE_TOTAL; k++){
+		if( p[k] ){
+			check_fill(p[k], size[k], k);
+			_free_r(&m_reent, p[k]);
+			p[k] = 0;
+		}
+	}
+	printf("random: %ld iterations heap size %d\n", iterations, m_reent.procmem_base->size);
+}
+
+static void test_realloc_random(long iterations){
+	static char * p[LIVE_TOTAL];
+	static int size[LIVE_TOTAL];
+	char * q;
+	long i;
+	int k;
+	int new_size;
+
+	srand(3);
+	for(i=0; i < iterations; i++){
+		k = rand() % LIVE_TOTAL;
+		if( p[k] == 0 ){
+			size[k] = random_size();
+			p[k] = _malloc_r(&m_reent, size[k]);
+			HOST_CHECK(p[k] != 0);
+			fill(p[k], size[k], k);
+		} else if( rand() % 3 == 0 ){
+			check_fill(p[k], size[k], k);
+			_free_r(&m_reent, p[k]);
+			p[k] = 0;
+		} else {
+			//realloc() must keep the smaller of the old and new sizes
+			new_size = random_size();
+			q = _realloc_r(&m_reent, p[k], new_size);
+			HOST_CHECK(q != 0);
+			check_fill(q, new_size < size[k] ? new_size : size[k], k);
+			fill(q, new_size, k);
+			p[k] = q;
+			size[k] = new_size;
+		}
+	}
+
+	for(k=0; k < LIVE_TOTAL; k++){
+		if( p[k] ){
+			_free_r(&m_reent, p[k]);
+			p[k] = 0;
+		}
+	}
+	printf("realloc: %ld iterations heap size %d\n", iterations, m_reent.procmem_base->size);
+}
+
+//grows interleaved buffers a little at a time and returns the number of moves
+static int grow_buffers(int rounds, int is_checked){
+	char * buffer[4] = {0};
+	int length[4] = {0};
+	char * q;
+	int moves;
+	int round;
+	int i;
+	int j;
+	int k;
+
+	moves = 0;
+	for(round=0; round < rounds; round++){
+		for(i=0; i < 400; i++){
+			k = i & 3;
+			q = _realloc_r(&m_reent, buffer[k], length[k] + 17);
+			HOST_CHECK(q != 0);
+			for(j=0; is_checked && (j < length[k]); j++){
+				HOST_CHECK(q[j] == (char)(j+k));
+			}
+			for(j=length[k]; j < length[k] + 17; j++){
+				q[j] = (char)(j+k);
+			}
+			if( buffer[k] && (q != buffer[k]) ){
+				moves++;
+			}
+			buffer[k] = q;
+			length[k] += 17;
+		}
+
+		//shrinking in place must keep the data
+		for(k=0; k < 4; k++){
+			q = _realloc_r(&m_reent, buffer[k], 10);
+			HOST_CHECK(q == buffer[k]);
+			for(j=0; j < 10; j++){
+				HOST_CHECK(q[j] == (char)(j+k));
+			}
+			length[k] = 10;
+		}
+	}
+
+	for(k=0; k < 4; k++){
+		_free_r(&m_reent, buffer[k]);
+	}
+	return moves;
+}
+
+static void test_realloc_grow(){
+	int moves;
+	moves = grow_buffers(200, 1);
+	printf("grow: %d moves in %d reallocs\n", moves, 200*400);
+	//a neighbor that is free (or the top of the heap) is used before moving the data
+	HOST_CHECK(moves < 200*4);
+}
+
+static void test_heap_info(){
+	sys_heapinfo_t info;
+	malloc_chunk_t * chunk;
+	char * p[100];
+	u32 used_size;
+	int heap_size;
+	u16 num_chunks;
+	int i;
+
+	used_size = 0;
+	for(i=0; i < 100; i++){
+		p[i] = _malloc_r(&m_reent, 10 + i*30);
+		HOST_CHECK(p[i] != 0);
+		if( i & 1 ){
+			used_size += 10 + i*30;
+		}
+	}
+
+	for(i=0; i < 100; i += 2){
+		_free_r(&m_reent, p[i]);
+	}
+
+	heap_size = m_reent.procmem_base->size;
+	info.tid = 0;
+	HOST_CHECK(malloc_get_heap_info(&m_reent, &info) == 0);
+	HOST_CHECK(info.used_count == 50);
+	HOST_CHECK(info.used_size == used_size);
+	HOST_CHECK(info.free_count > 0);
+	HOST_CHECK(info.largest_free_size <= info.free_size);
+	HOST_CHECK(info.size <= (u32)heap_size);
+
+	//a heap that is shorter than its chunks say (e.g. read while another task grows it)
+	m_reent.procmem_base->size = heap_size / 2;
+	info.tid = 0;
+	if( malloc_get_heap_info(&m_reent, &info) == 0 ){
+		HOST_CHECK(info.size <= (u32)heap_size / 2);
+	} else {
+		HOST_CHECK(errno == EAGAIN);
+	}
+	m_reent.procmem_base->size = heap_size;
+
+	//a chunk that claims to run past the end of the heap
+	chunk = (malloc_chunk_t*)(p[1] - offsetof(malloc_chunk_t, memory));
+	num_chunks = chunk->header.num_chunks;
+	chunk->header.num_chunks = 0x7FFF;
+	cortexm_assign_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t));
+	info.tid = 0;
+	errno = 0;
+	HOST_CHECK(malloc_get_heap_info(&m_reent, &info) < 0);
+	HOST_CHECK(errno == EAGAIN);
+	chunk->header.num_chunks = num_chunks;
+	cortexm_assign_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t));
+
+	info.tid = 0;
+	HOST_CHECK(malloc_get_heap_info(&m_reent, &info) == 0);
+	HOST_CHECK(info.used_count == 50);
+	printf("heap info: size %u used %u/%u free %u/%u fragmentation %u\n",
+			 info.size, info.used_size, info.used_count,
+			 info.free_size, info.free_count, info.fragmentation);
+}
+
+static void bench(){
+	static char * p[LIVE_TOTAL];
+	static int size[1024];
+	unsigned long long start;
+	long operations;
+	long i;
+	int k;
+
+	srand(2);
+	for(k=0; k < 1024; k++){
+		size[k] = random_size();
+	}
+
+	//keep half the slots live so the heap is fragmented like a long running process
+	for(k=0; k < LIVE_TOTAL; k += 2){
+		p[k] = _malloc_r(&m_reent, size[k & 1023]);
+	}
+
+	operations = 0;
+	start = host_now_ns();
+	for(i=0; i < 400000; i++){
+		k = (i * 7919) % LIVE_TOTAL;
+		if( p[k] ){
+			_free_r(&m_reent, p[k]);
+			p[k] = 0;
+		} else {
+			p[k] = _malloc_r(&m_reent, size[i & 1023]);
+			HOST_CHECK(p[k] != 0);
+		}
+		operations++;
+	}
+
+	host_report(MALLOC_USE_FREE_LIST_BINS ? "malloc/free (bins)" : "malloc/free (first fit)",
+					host_now_ns() - start, operations);
+	printf("heap size %d\n", m_reent.procmem_base->size);
+
+	start = host_now_ns();
+	k = grow_buffers(50, 0);
+	host_report("realloc grow by 17 bytes", host_now_ns() - start, 50*400);
+	printf("realloc moves %d\n", k);
+}
+
+int main(int argc, char * argv[]){
+	init_heap();
+
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	if( host_is_mode(argc, argv, "heapinfo") ){
+		test_heap_info();
+		return 0;
+	}
+
+	if( host_is_mode(argc, argv, "realloc") ){
+		test_realloc_random(200000);
+		test_realloc_grow();
+		return 0;
+	}
+
+	test_random(200000);
+	return 0;
+}
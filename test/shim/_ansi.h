@@ -0,0 +1 @@
+//newlib compiler portability macros -- nothing is needed on the host
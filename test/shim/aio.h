@@ -0,0 +1,2 @@
+//the aio types (with the kernel members) live with the posix headers
+#include "posix/aio.h"
@@ -0,0 +1,2 @@
+//the message queue types live with the posix headers
+#include "posix/mqueue.h"
@@ -0,0 +1,119 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Stands in for the newlib pthread.h of the arm toolchain in the host tests
+ * that build the kernel's pthread and scheduler code. The kernel reads the
+ * fields of these types directly so the host (glibc) types can't be used.
+ * glibc already declares the pthread types in sys/types.h so the newlib
+ * types are declared under other names. The same goes for timer_t which is
+ * a pointer in glibc (the kernel keeps the task ID and the timer offset in
+ * the newlib integer).
+ */
+
+#ifndef SOS_HOST_NEWLIB_PTHREAD_H_
+#define SOS_HOST_NEWLIB_PTHREAD_H_
+
+#include <sched.h>
+#include <time.h>
+
+#define pthread_attr_t sos_host_pthread_attr_t
+#define pthread_mutex_t sos_host_pthread_mutex_t
+#define pthread_mutexattr_t sos_host_pthread_mutexattr_t
+#define pthread_cond_t sos_host_pthread_cond_t
+#define pthread_condattr_t sos_host_pthread_condattr_t
+#define timer_t sos_host_timer_t
+
+typedef unsigned long timer_t;
+
+typedef struct {
+	unsigned int o_flags;
+	void * stackaddr;
+	int stacksize;
+	struct sched_param schedparam;
+} pthread_attr_t;
+
+#define PTHREAD_ATTR_FIELD_GET(attr, shift, mask) (((attr)->o_flags >> (shift)) & (mask))
+#define PTHREAD_ATTR_FIELD_SET(attr, shift, mask, value) \
+	((attr)->o_flags = ((attr)->o_flags & ~((mask) << (shift))) | (((value) & (mask)) << (shift)))
+
+#define PTHREAD_ATTR_GET_IS_INITIALIZED(attr) PTHREAD_ATTR_FIELD_GET(attr, 0, 1)
+#define PTHREAD_ATTR_SET_IS_INITIALIZED(attr, value) PTHREAD_ATTR_FIELD_SET(attr, 0, 1, value)
+#define PTHREAD_ATTR_GET_CONTENTION_SCOPE(attr) PTHREAD_ATTR_FIELD_GET(attr, 1, 1)
+#define PTHREAD_ATTR_SET_CONTENTION_SCOPE(attr, value) PTHREAD_ATTR_FIELD_SET(attr, 1, 1, value)
+#define PTHREAD_ATTR_GET_INHERIT_SCHED(attr) PTHREAD_ATTR_FIELD_GET(attr, 2, 1)
+#define PTHREAD_ATTR_SET_INHERIT_SCHED(attr, value) PTHREAD_ATTR_FIELD_SET(attr, 2, 1, value)
+#define PTHREAD_ATTR_GET_DETACH_STATE(attr) PTHREAD_ATTR_FIELD_GET(attr, 3, 1)
+#define PTHREAD_ATTR_SET_DETACH_STATE(attr, value) PTHREAD_ATTR_FIELD_SET(attr, 3, 1, value)
+#define PTHREAD_ATTR_GET_SCHED_POLICY(attr) PTHREAD_ATTR_FIELD_GET(attr, 4, 0x07)
+#define PTHREAD_ATTR_SET_SCHED_POLICY(attr, value) PTHREAD_ATTR_FIELD_SET(attr, 4, 0x07, value)
+#define PTHREAD_ATTR_GET_GUARDSIZE(attr) PTHREAD_ATTR_FIELD_GET(attr, 8, 0xFF)
+#define PTHREAD_ATTR_SET_GUARDSIZE(attr, value) PTHREAD_ATTR_FIELD_SET(attr, 8, 0xFF, value)
+
+typedef struct {
+	int flags;
+	int prio_ceiling;
+	int pthread;
+	int pid;
+	int lock;
+} pthread_mutex_t;
+
+#define PTHREAD_MUTEX_FLAGS_INITIALIZED (1<<0)
+#define PTHREAD_MUTEX_FLAGS_PSHARED (1<<1)
+#define PTHREAD_MUTEX_FLAGS_RECURSIVE (1<<2)
+#define PTHREAD_MAX_LOCKS 1024
+
+typedef struct {
+	int is_initialized;
+	int process_shared;
+	int prio_ceiling;
+	int protocol;
+	int recursive;
+	int type;
+} pthread_mutexattr_t;
+
+#define PTHREAD_PRIO_NONE 0
+#define PTHREAD_PRIO_INHERIT 1
+#define PTHREAD_PRIO_PROTECT 2
+
+#define PTHREAD_MUTEX_NORMAL 0
+#define PTHREAD_MUTEX_RECURSIVE 1
+#define PTHREAD_MUTEX_ERRORCHECK 2
+
+typedef int pthread_cond_t;
+
+typedef struct {
+	int is_initialized;
+	int process_shared;
+} pthread_condattr_t;
+
+int pthread_mutex_init(pthread_mutex_t * mutex, const pthread_mutexattr_t * attr);
+int pthread_mutex_lock(pthread_mutex_t * mutex);
+int pthread_mutex_trylock(pthread_mutex_t * mutex);
+int pthread_mutex_timedlock(pthread_mutex_t * mutex, const struct timespec * abs_timeout);
+int pthread_mutex_unlock(pthread_mutex_t * mutex);
+int pthread_mutex_destroy(pthread_mutex_t * mutex);
+int pthread_mutex_force_unlock(pthread_mutex_t * mutex);
+
+int pthread_mutexattr_init(pthread_mutexattr_t * attr);
+int pthread_mutexattr_setprioceiling(pthread_mutexattr_t * attr, int prio_ceiling);
+int pthread_mutexattr_setpshared(pthread_mutexattr_t * attr, int pshared);
+int pthread_mutexattr_settype(pthread_mutexattr_t * attr, int type);
+
+#endif /* SOS_HOST_NEWLIB_PTHREAD_H_ */
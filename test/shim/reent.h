@@ -0,0 +1,31 @@
+#ifndef SOS_HOST_REENT_H_
+#define SOS_HOST_REENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//only the members used by the kernel sources under test
+typedef struct {
+	int size;
+	int flags;
+	open_file_t * open_file; //an array of OPEN_MAX in newlib
+	int base;
+} proc_mem_t;
+
+struct _reent {
+	int _errno;
+	proc_mem_t * procmem_base;
+};
+
+extern struct _reent * _impure_ptr;
+extern struct _reent * _global_impure_ptr;
+
+#define _REENT _impure_ptr
+#define _GLOBAL_REENT _impure_ptr
+
+void * _sbrk_r(struct _reent *, ptrdiff_t);
+void * _malloc_r(struct _reent *, size_t);
+void _free_r(struct _reent *, void*);
+void * _realloc_r(struct _reent *, void *, size_t);
+
+#endif /* SOS_HOST_REENT_H_ */
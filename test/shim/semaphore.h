@@ -0,0 +1,4 @@
+//the semaphore type (with the kernel members) lives with the posix headers
+#include <limits.h>
+#undef SEM_VALUE_MAX
+#include "posix/semaphore.h"
@@ -0,0 +1,66 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * This header is included ahead of every kernel source that is built
+ * for the host tests. It fills in the newlib definitions that the kernel
+ * expects from the arm toolchain.
+ */
+
+#ifndef SOS_HOST_H_
+#define SOS_HOST_H_
+
+#include <limits.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <fcntl.h>
+
+//glibc limits.h and pthread.h have these but the kernel defines its own (config.h and mqueue.h)
+#undef PTHREAD_STACK_MIN
+#undef MQ_PRIO_MAX
+
+//same as mcu/arch.h (glibc uses 255 which doesn't fit in an sffs block)
+#undef NAME_MAX
+#define NAME_MAX 24
+
+//the arm newlib marks character device descriptors with this open flag (glibc doesn't use this bit)
+#ifndef O_CHAR
+#define O_CHAR 0x20000000
+#endif
+
+typedef struct {
+	const void * fs;
+	void * handle;
+	int flags;
+	int loc;
+} open_file_t;
+
+typedef struct sos_socket_api_host sos_socket_api_t;
+
+//newlib declares the reentrant allocators in stdlib.h
+struct _reent;
+void * _malloc_r(struct _reent *, size_t);
+void * _calloc_r(struct _reent *, size_t, size_t);
+void _free_r(struct _reent *, void *);
+
+//newlib's stdlib.h also brings in the reent structure (the kernel uses _global_impure_ptr)
+#include "reent.h"
+
+#endif /* SOS_HOST_H_ */
@@ -0,0 +1,2 @@
+//newlib keeps the dirent types in sys/dirent.h
+#include <dirent.h>
@@ -0,0 +1,10 @@
+#ifndef SOS_HOST_SYS_LOCK_H_
+#define SOS_HOST_SYS_LOCK_H_
+
+#include <pthread.h>
+
+//the host tests are single threaded so the newlib locks are plain integers
+typedef int _LOCK_T;
+typedef int _LOCK_RECURSIVE_T;
+
+#endif /* SOS_HOST_SYS_LOCK_H_ */
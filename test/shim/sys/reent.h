@@ -0,0 +1,6 @@
+#ifndef SOS_HOST_SYS_REENT_H_
+#define SOS_HOST_SYS_REENT_H_
+
+#include <reent.h>
+
+#endif /* SOS_HOST_SYS_REENT_H_ */
@@ -0,0 +1,2 @@
+//glibc keeps the limits in limits.h
+#include <limits.h>
@@ -0,0 +1,2 @@
+//the kernel trace types live with the posix headers
+#include "posix/trace.h"
@@ -0,0 +1,422 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+/*
+ * Host test for asynchronous IO (aio.c and devfs_aio.c).
+ *
+ * The operations are started on a fake device that finishes them when
+ * the test calls complete() (the device's interrupt). When a thread
+ * blocks, the simulated scheduler runs one action (which should finish
+ * an operation and wake the thread) and switches back. If the thread is
+ * still blocked afterwards, it is woken as if the timeout expired.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+
+#include "host.h"
+#include "aio.h"
+#include "sos/sos.h"
+#include "sos/fs/sysfs.h"
+#include "sos/fs/devfs.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "sys/scheduler/scheduler_local.h"
+#include "sys/scheduler/scheduler_root.h"
+#include "sys/scheduler/scheduler_flags.h"
+#include "sys/sysfs/devfs_local.h"
+
+#define TASK_TOTAL 4
+#define OPEN_FILE_TOTAL 4
+#define FD_DEVICE 1
+#define PENDING_MAX 16
+
+volatile task_t sos_task_table[TASK_TOTAL];
+volatile sched_task_t sos_sched_table[TASK_TOTAL];
+volatile int m_task_current;
+cortexm_svcall_t cortexm_svcall_validation;
+
+static int fake_read(const devfs_handle_t * handle, devfs_async_t * async);
+static int fake_write(const devfs_handle_t * handle, devfs_async_t * async);
+static int fake_open(const devfs_handle_t * handle){ return 0; }
+static int fake_ioctl(const devfs_handle_t * handle, int request, void * ctl){ return 0; }
+static int fake_close(const devfs_handle_t * handle){ return 0; }
+
+static const devfs_device_t m_device = {
+	.name = "fake",
+	.mode = 0666 | S_IFCHR,
+	.driver = { fake_open, fake_ioctl, fake_read, fake_write, fake_close }
+};
+
+static sysfs_t m_devfs;
+static open_file_t m_open_file[OPEN_FILE_TOTAL];
+static proc_mem_t m_proc_mem;
+static struct _reent m_reent;
+struct _reent * _impure_ptr = &m_reent;
+struct _reent * _global_impure_ptr = &m_reent;
+
+static devfs_async_t * m_pending[PENDING_MAX];
+static int m_pending_count;
+static int m_device_error; //errno the device reports when a transfer starts
+static char m_invalid[256]; //task_validate_memory() rejects this memory
+static int m_interrupts_disabled;
+static void (*m_block_action)();
+static int m_block_count;
+static int m_wake_count;
+
+//the device's interrupt finishes the oldest pending operation
+static void complete(int nbyte){
+	devfs_async_t * async;
+	mcu_event_t event;
+	HOST_CHECK(m_pending_count > 0);
+	async = m_pending[0];
+	m_pending_count--;
+	memmove(m_pending, m_pending + 1, m_pending_count * sizeof(devfs_async_t*));
+	async->nbyte = nbyte;
+	event.o_events = MCU_EVENT_FLAG_DATA_READY;
+	event.data = 0;
+	async->handler.callback(async->handler.context, &event);
+}
+
+static int fake_transfer(devfs_async_t * async){
+	if( m_device_error ){
+		return SYSFS_SET_RETURN(m_device_error);
+	}
+	HOST_CHECK(m_pending_count < PENDING_MAX);
+	m_pending[m_pending_count++] = async;
+	return 0;
+}
+
+int fake_read(const devfs_handle_t * handle, devfs_async_t * async){ return fake_transfer(async); }
+int fake_write(const devfs_handle_t * handle, devfs_async_t * async){ return fake_transfer(async); }
+
+void cortexm_svcall(cortexm_svcall_t call, void * args){
+	call(args);
+}
+
+void cortexm_disable_interrupts(){ m_interrupts_disabled = 1; }
+void cortexm_enable_interrupts(){ m_interrupts_disabled = 0; }
+
+int task_validate_memory(void * target, int size){
+	char * start = target;
+	if( (start < m_invalid + sizeof(m_invalid)) && (start + size > m_invalid) ){
+		return -1;
+	}
+	return 0;
+}
+
+u8 task_get_total(){ return TASK_TOTAL; }
+
+int u_fildes_is_bad(int fildes){
+	if( (fildes < 0) || (fildes >= OPEN_FILE_TOTAL) || (m_open_file[fildes].fs == 0) ){
+		return -1;
+	}
+	return fildes;
+}
+
+int devfs_aio(const void * config, void * handle, struct aiocb * aio){
+	return devfs_aio_data_transfer(handle, aio);
+}
+
+int sysfs_file_aio(sysfs_file_t * file, void * aiocbp){
+	const sysfs_t * fs = file->fs;
+	int result = fs->aio(fs->config, file->handle, aiocbp);
+	SYSFS_PROCESS_RETURN(result);
+	return result;
+}
+
+int ioctl(int fd, unsigned long request, ...){ return 0; }
+
+int signal_root_send(int send_tid, int tid, int si_signo, int si_sigcode, int sig_value, int forward){ return 0; }
+
+void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts){
+	tv->tv_sec = ts ? 1 : SCHEDULER_TIMEVAL_SEC_INVALID;
+	tv->tv_usec = 0;
+}
+
+void scheduler_root_assert(int id, int flag){ sos_sched_table[id].flags |= (1<<flag); }
+void scheduler_root_deassert(int id, int flag){ sos_sched_table[id].flags &= ~(1<<flag); }
+
+void scheduler_root_assert_active(int id, int unblock_type){
+	scheduler_root_set_unblock_type(id, unblock_type);
+	scheduler_root_deassert_aiosuspend(id);
+	sos_sched_table[id].block_object = NULL;
+}
+
+void scheduler_root_update_on_wake(int id, int new_priority){
+	m_wake_count++;
+}
+
+void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * abs_time){
+	int id = task_get_current();
+	HOST_CHECK(m_interrupts_disabled);
+	m_block_count++;
+	sos_sched_table[id].block_object = block_object;
+
+	//other threads and interrupts run while this one is blocked
+	m_interrupts_disabled = 0;
+	if( m_block_action ){
+		m_block_action();
+	}
+	m_interrupts_disabled = 1;
+
+	if( sos_sched_table[id].block_object != NULL ){
+		//nothing woke the thread
+		scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_SLEEP);
+	}
+}
+
+static void init_task(){
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	sos_task_table[1].flags = TASK_FLAGS_USED | TASK_FLAGS_ACTIVE;
+	sos_sched_table[1].flags = (1<<SCHEDULER_TASK_FLAG_INUSE);
+	m_task_current = 1;
+
+	memset(&m_devfs, 0, sizeof(m_devfs));
+	m_devfs.aio = devfs_aio;
+	memset(m_open_file, 0, sizeof(m_open_file));
+	m_open_file[FD_DEVICE].fs = &m_devfs;
+	m_open_file[FD_DEVICE].handle = (void*)&m_device;
+	m_proc_mem.open_file = m_open_file;
+	m_reent.procmem_base = &m_proc_mem;
+}
+
+static void reset(){
+	m_pending_count = 0;
+	m_device_error = 0;
+	m_block_action = 0;
+	m_block_count = 0;
+	m_wake_count = 0;
+}
+
+static void init_aiocb(struct aiocb * aiocbp, char * buf, int nbyte){
+	memset(aiocbp, 0, sizeof(struct aiocb));
+	aiocbp->aio_fildes = FD_DEVICE;
+	aiocbp->aio_buf = buf;
+	aiocbp->aio_nbytes = nbyte;
+	aiocbp->aio_lio_opcode = LIO_READ;
+	aiocbp->aio_sigevent.sigev_notify = SIGEV_NONE;
+}
+
+static void complete_first(){ complete(4); }
+
+static void test_queue(){
+	struct aiocb aiocb[4];
+	struct aiocb * list[4];
+	struct aiocb * entry[3];
+	aio_queue_t queue;
+	char buf[4][8];
+	int i;
+
+	reset();
+	HOST_CHECK(aio_queue_init(&queue, entry, 1) < 0);
+	HOST_CHECK(errno == EINVAL);
+	HOST_CHECK(aio_queue_init(&queue, entry, 3) == 0);
+
+	for(i=0; i < 4; i++){
+		init_aiocb(aiocb + i, buf[i], 8);
+		list[i] = aiocb + i;
+	}
+	HOST_CHECK(aio_queue_submit(&queue, list, 4) == 0);
+	HOST_CHECK(m_pending_count == 4);
+	HOST_CHECK(aio_error(aiocb) == EINPROGRESS);
+
+	//the operations are queued in the order they finish (the ring holds two)
+	complete(8);
+	complete(5);
+	HOST_CHECK(queue.overflow_count == 0);
+	complete(SYSFS_SET_RETURN(EIO));
+	HOST_CHECK(queue.overflow_count == 1);
+	HOST_CHECK(aio_error(aiocb + 2) == EIO);
+	HOST_CHECK(aio_return(aiocb + 1) == 5);
+
+	HOST_CHECK(aio_queue_get(&queue, 0) == aiocb);
+	HOST_CHECK(aio_queue_get(&queue, 0) == aiocb + 1);
+
+	//an empty queue blocks until the next operation finishes
+	m_block_action = complete_first;
+	HOST_CHECK(aio_queue_get(&queue, 0) == aiocb + 3);
+	HOST_CHECK(m_block_count == 1);
+	HOST_CHECK(m_wake_count == 1);
+	HOST_CHECK(queue.tid == -1);
+
+	//a timeout
+	m_block_action = 0;
+	struct timespec timeout = { 0, 0 };
+	HOST_CHECK(aio_queue_get(&queue, &timeout) == 0);
+	HOST_CHECK(errno == EAGAIN);
+	HOST_CHECK(queue.tid == -1);
+}
+
+static void complete_all(){
+	while( m_pending_count ){
+		complete(4);
+	}
+}
+
+//the completions come from interrupts that nest in the order they finish
+static void test_queue_nested(){
+	struct aiocb aiocb[6];
+	struct aiocb * list[6];
+	struct aiocb * entry[8];
+	aio_queue_t queue;
+	char buf[6][8];
+	int i;
+
+	reset();
+	HOST_CHECK(aio_queue_init(&queue, entry, 8) == 0);
+	for(i=0; i < 6; i++){
+		init_aiocb(aiocb + i, buf[i], 8);
+		list[i] = aiocb + i;
+	}
+	HOST_CHECK(aio_queue_submit(&queue, list, 6) == 0);
+
+	//the thread is woken once even though every completion could wake it
+	m_block_action = complete_all;
+	HOST_CHECK(aio_queue_get(&queue, 0) == aiocb);
+	HOST_CHECK(m_wake_count == 1);
+	HOST_CHECK(m_interrupts_disabled == 0);
+	for(i=1; i < 6; i++){
+		HOST_CHECK(aio_queue_get(&queue, 0) == aiocb + i);
+	}
+	HOST_CHECK(queue.head == queue.tail);
+}
+
+static void test_queue_invalid(){
+	struct aiocb aiocb[2];
+	struct aiocb * list[2];
+	struct aiocb * entry[3];
+	aio_queue_t * invalid_queue = (aio_queue_t*)m_invalid;
+	aio_queue_t queue;
+	char buf[2][8];
+
+	reset();
+	init_aiocb(aiocb, buf[0], 8);
+	init_aiocb(aiocb + 1, buf[1], 8);
+	list[0] = aiocb;
+	list[1] = aiocb + 1;
+
+	//the queue doesn't belong to the caller
+	HOST_CHECK(aio_queue_init(invalid_queue, entry, 3) == 0);
+	HOST_CHECK(aio_queue_submit(invalid_queue, list, 2) < 0);
+	HOST_CHECK(errno == EIO);
+	HOST_CHECK(m_pending_count == 0);
+	HOST_CHECK(aio_error(aiocb) == EPERM);
+	HOST_CHECK(aio_error(aiocb + 1) == EPERM);
+	HOST_CHECK(invalid_queue->head == 0);
+
+	//the ring doesn't belong to the caller
+	HOST_CHECK(aio_queue_init(&queue, (struct aiocb**)(m_invalid + sizeof(m_invalid) - sizeof(void*)), 3) == 0);
+	HOST_CHECK(aio_queue_submit(&queue, list, 2) < 0);
+	HOST_CHECK(m_pending_count == 0);
+	HOST_CHECK(aio_error(aiocb) == EPERM);
+
+	//the size was changed after the queue was initialized
+	HOST_CHECK(aio_queue_init(&queue, entry, 3) == 0);
+	queue.size = 1;
+	HOST_CHECK(aio_queue_submit(&queue, list, 2) < 0);
+	HOST_CHECK(aio_error(aiocb) == EPERM);
+
+	//the indexes are changed while the operations are in progress
+	HOST_CHECK(aio_queue_init(&queue, entry, 3) == 0);
+	HOST_CHECK(aio_queue_submit(&queue, list, 2) == 0);
+	queue.head = 100;
+	complete(8);
+	HOST_CHECK(queue.overflow_count == 1);
+	HOST_CHECK(queue.head == 100);
+	queue.head = 0;
+	complete(8);
+	HOST_CHECK(queue.head == 1);
+	HOST_CHECK(entry[0] == aiocb + 1);
+
+	//a device error
+	m_device_error = EIO;
+	HOST_CHECK(aio_queue_init(&queue, entry, 3) == 0);
+	HOST_CHECK(aio_queue_submit(&queue, list, 2) < 0);
+	HOST_CHECK(aio_error(aiocb) == EIO);
+	HOST_CHECK(queue.head == queue.tail);
+}
+
+static void test_suspend(){
+	struct aiocb aiocb[3];
+	struct aiocb * list[3];
+	char buf[3][8];
+	int other_waiter;
+	int i;
+
+	reset();
+	for(i=0; i < 3; i++){
+		init_aiocb(aiocb + i, buf[i], 8);
+		list[i] = aiocb + i;
+		HOST_CHECK(aio_read(aiocb + i) == 0);
+	}
+	HOST_CHECK(m_pending_count == 3);
+
+	//blocks until one operation finishes
+	m_block_action = complete_first;
+	HOST_CHECK(aio_suspend(list, 3, 0) == 0);
+	HOST_CHECK(m_block_count == 1);
+	HOST_CHECK(aio_return(aiocb) == 4);
+	HOST_CHECK(aiocb[1].suspend == 0);
+	HOST_CHECK(aiocb[2].suspend == 0);
+
+	//already finished
+	HOST_CHECK(aio_suspend(list, 3, 0) == 0);
+	HOST_CHECK(m_block_count == 1);
+
+	//another thread waits on the operations that are in progress
+	aiocb[1].suspend = &other_waiter;
+	HOST_CHECK(aio_suspend(list + 1, 2, 0) < 0);
+	HOST_CHECK(errno == EBUSY);
+	//but one in the list has already finished
+	HOST_CHECK(aio_suspend(list, 3, 0) == 0);
+	HOST_CHECK(m_block_count == 1);
+	aiocb[1].suspend = 0;
+
+	//timeout
+	m_block_action = 0;
+	struct timespec timeout = { 0, 0 };
+	HOST_CHECK(aio_suspend(list + 1, 2, &timeout) < 0);
+	HOST_CHECK(errno == EAGAIN);
+	HOST_CHECK(aiocb[1].suspend == 0);
+
+	//lio_listio() waits for all of them
+	complete_all();
+	for(i=0; i < 3; i++){
+		init_aiocb(aiocb + i, buf[i], 8);
+	}
+	m_block_action = complete_all;
+	m_block_count = 0;
+	HOST_CHECK(lio_listio(LIO_WAIT, list, 3, 0) == 0);
+	HOST_CHECK(m_block_count == 1);
+	for(i=0; i < 3; i++){
+		HOST_CHECK(aio_return(aiocb + i) == 4);
+	}
+}
+
+int main(int argc, char * argv[]){
+	init_task();
+	test_queue();
+	test_queue_nested();
+	test_queue_invalid();
+	test_suspend();
+	return 0;
+}
@@ -0,0 +1,384 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Host simulator for SCHED_DEADLINE (scheduler_deadline.c).
+ *
+ * The deadline code runs with the real ready lists (task_ready.c) and wake
+ * queue (scheduler_timing_queue.c). The test stands in for the SysTick,
+ * the microsecond timer and the context switcher (task.c) and steps the
+ * simulated clock one microsecond (one core clock cycle) at a time.
+ *
+ * Each deadline thread executes a fixed amount of work per job and then
+ * calls sched_yield(). While the simulation runs, the test checks that a
+ * ready deadline task never waits behind a task with a later deadline (or
+ * a round robin task or task 0) and that no job executes longer than its
+ * runtime. Task sets that pass admission control must not miss a deadline.
+ * A task that overruns is throttled without making the others miss.
+ *
+ */
+
+#include "config.h"
+#include "host.h"
+#include "sos/sos.h"
+#include "sos/dev/sys.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "cortexm/task_local.h"
+#include "sys/scheduler/scheduler_local.h"
+#include "sys/scheduler/scheduler_root.h"
+
+#define TASK_TOTAL 16
+#define PRIORITY 3
+#define BACKGROUND_TASK 1
+
+SOS_DECLARE_TASK_TABLE(TASK_TOTAL);
+volatile int m_task_current;
+
+const sos_board_config_t sos_board_config = {
+	.task_total = TASK_TOTAL,
+	.o_sys_flags = SYS_FLAG_IS_WDT_DISABLED
+};
+
+//one clock cycle per microsecond so the budgets are in microseconds
+const mcu_board_config_t mcu_board_config = {
+	.core_cpu_freq = 1000000
+};
+
+static struct mcu_timeval m_now;
+static int m_is_switch_requested;
+static u32 m_work[TASK_TOTAL] /*! Work per job (microseconds) */;
+static u32 m_work_left[TASK_TOTAL];
+static u32 m_executed[TASK_TOTAL] /*! Time executed with the current budget */;
+static u32 m_total_executed[TASK_TOTAL];
+static long m_switch_count;
+static unsigned int m_lcg = 1;
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+u8 task_get_total(){ return TASK_TOTAL; }
+
+struct mcu_timeval scheduler_timing_add_mcu_timeval(const struct mcu_timeval * a, const struct mcu_timeval * b){
+	struct mcu_timeval result;
+	result.tv_sec = a->tv_sec + b->tv_sec;
+	result.tv_usec = a->tv_usec + b->tv_usec;
+	if( result.tv_usec > SOS_USECOND_PERIOD ){
+		result.tv_sec++;
+		result.tv_usec -= SOS_USECOND_PERIOD;
+	}
+	return result;
+}
+
+void scheduler_timing_root_get_realtime(struct mcu_timeval * tv){
+	*tv = m_now;
+}
+
+//task.c
+void task_root_set_deadline(int id, u32 deadline, u32 budget){
+	task_ready_set_deadline(id, deadline, budget);
+	m_executed[id] = 0;
+}
+
+void task_root_switch_context(){
+	m_is_switch_requested = 1;
+}
+
+static int is_after_now(const struct mcu_timeval * abs_time){
+	return (abs_time->tv_sec > m_now.tv_sec) ||
+			((abs_time->tv_sec == m_now.tv_sec) && (abs_time->tv_usec > m_now.tv_usec));
+}
+
+static void queue_wake(int id, const struct mcu_timeval * abs_time){
+	sos_sched_table[id].wake.tv_sec = abs_time->tv_sec;
+	sos_sched_table[id].wake.tv_usec = abs_time->tv_usec;
+	scheduler_timing_root_wake_queue_insert(id);
+	task_deassert_active(id);
+}
+
+//scheduler_timing.c
+void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * abs_time){
+	int id = task_get_current();
+	sos_sched_table[id].block_object = block_object;
+	if( is_after_now(abs_time) ){
+		//scheduler_root_update_on_sleep()
+		queue_wake(id, abs_time);
+		task_root_set_current_priority( task_root_get_highest_ready_priority() );
+		task_root_switch_context();
+	}
+}
+
+int scheduler_timing_root_throttle(int id, struct mcu_timeval * abs_time){
+	sos_sched_table[id].block_object = NULL;
+	if( is_after_now(abs_time) ){
+		queue_wake(id, abs_time);
+		return 1;
+	}
+	return 0;
+}
+
+static int random_value(int range){
+	m_lcg = m_lcg*1103515245u + 12345u;
+	return (m_lcg >> 8) % range;
+}
+
+static void switch_contexts(){
+	int previous = m_task_current;
+	m_task_current = task_ready_get_next();
+	if( m_task_current != previous ){
+		m_switch_count++;
+	}
+}
+
+//PendSV (task.c check_switch_request())
+static void check_switch_request(){
+	int current = task_get_current();
+	if( (current == 0) ||
+		 (task_exec_asserted(current) == 0) ||
+		 task_yield_asserted(current) ||
+		 task_ready_is_deadline_preempted() ){
+		task_deassert_yield(current);
+		switch_contexts();
+	}
+}
+
+//usecond timer output compare (scheduler_timing.c root_handle_usecond_match_event())
+static void wake_tasks(){
+	int is_woken = 0;
+	int id;
+	while( (id = scheduler_timing_root_get_wake_queue_head()) != 0 ){
+		if( is_after_now((struct mcu_timeval*)&sos_sched_table[id].wake) ){
+			break;
+		}
+		scheduler_timing_root_dequeue_wake(id);
+		task_assert_active(id);
+		is_woken = 1;
+	}
+
+	if( is_woken ){
+		//scheduler_root_update_on_wake()
+		task_root_elevate_current_priority(PRIORITY);
+		task_root_switch_context();
+	}
+}
+
+static void check_edf(){
+	int current = task_get_current();
+	int id;
+
+	for(id=1; id < TASK_TOTAL; id++){
+		if( (id == current) || !task_deadline_asserted(id) || (sos_task_table[id].ready_next == 0) ){
+			continue;
+		}
+		//a ready deadline task only waits for a deadline task that is due first (or at the same time)
+		HOST_CHECK(current != 0);
+		HOST_CHECK(task_deadline_asserted(current));
+		HOST_CHECK((s32)(sos_task_table[id].deadline - sos_task_table[current].deadline) >= 0);
+	}
+}
+
+//execute the current task for one microsecond
+static void execute(){
+	int id = task_get_current();
+
+	m_total_executed[id]++;
+	if( sos_task_table[id].rr_time > 0 ){
+		sos_task_table[id].rr_time--;
+	}
+
+	if( task_deadline_asserted(id) ){
+		m_executed[id]++;
+		HOST_CHECK(m_executed[id] <= sos_sched_table[id].deadline.runtime);
+		if( --m_work_left[id] == 0 ){
+			//the job is done -- sched_yield()
+			m_work_left[id] = m_work[id];
+			scheduler_root_complete_deadline_job();
+			return;
+		}
+	}
+
+	if( sos_task_table[id].rr_time == 0 ){
+		//SysTick (task.c task_check_count_flag())
+		if( task_deadline_asserted(id) ){
+			task_budget_event_handler(id);
+		}
+		switch_contexts();
+	}
+}
+
+static void reset(){
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	memset(m_work, 0, sizeof(m_work));
+	memset(m_total_executed, 0, sizeof(m_total_executed));
+	memset(&m_now, 0, sizeof(m_now));
+	m_task_current = 0;
+	m_task_rr_reload = SYSTICK_MIN_CYCLES;
+	m_is_switch_requested = 0;
+	m_switch_count = 0;
+	task_ready_init();
+	scheduler_timing_root_queue_init();
+	task_root_set_current_priority(PRIORITY);
+
+	//a round robin thread that always has something to do
+	task_set_priority(BACKGROUND_TASK, PRIORITY);
+	task_assert_used(BACKGROUND_TASK);
+	task_assert_active(BACKGROUND_TASK);
+}
+
+static int start_deadline_task(int id, u32 runtime, u32 period, u32 deadline, u32 work){
+	sos_sched_deadline_t attr;
+	int result;
+
+	sos_task_table[id].priority = PRIORITY;
+	task_assert_used(id);
+	task_assert_active(id);
+
+	attr.param.sched_priority = PRIORITY;
+	attr.runtime = runtime;
+	attr.period = period;
+	attr.deadline = deadline;
+	m_work[id] = work;
+	m_work_left[id] = work;
+	result = scheduler_root_set_deadline(id, &attr);
+	if( result < 0 ){
+		task_deassert_used(id);
+	}
+	//scheduler_root_update_on_wake()
+	task_root_switch_context();
+	return result;
+}
+
+static void run(u32 useconds){
+	u32 i;
+	for(i=0; i < useconds; i++){
+		wake_tasks();
+		if( m_is_switch_requested ){
+			m_is_switch_requested = 0;
+			check_switch_request();
+		}
+		check_edf();
+		execute();
+		if( m_is_switch_requested ){
+			m_is_switch_requested = 0;
+			check_switch_request();
+		}
+		m_now.tv_usec++;
+	}
+}
+
+static void test_admission(){
+	reset();
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(start_deadline_task(2, 0, 1000, 0, 1)) == EINVAL);
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(start_deadline_task(2, 2000, 1000, 0, 1)) == EINVAL);
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(start_deadline_task(2, 500, 1000, 2000, 1)) == EINVAL);
+	HOST_CHECK(start_deadline_task(2, 500, 1000, 0, 1) == 0);
+	HOST_CHECK(start_deadline_task(3, 300, 1000, 0, 1) == 0);
+	//the third would take the total to 100%
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(start_deadline_task(4, 200, 1000, 0, 1)) == EBUSY);
+	//the density uses the (shorter) deadline
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(start_deadline_task(4, 100, 10000, 500, 1)) == EBUSY);
+	HOST_CHECK(start_deadline_task(4, 100, 10000, 1000, 1) == 0);
+	HOST_CHECK(scheduler_policy(4) == SCHED_DEADLINE);
+	scheduler_root_clear_deadline(4);
+	HOST_CHECK(scheduler_policy(4) != SCHED_DEADLINE);
+}
+
+static void test_random_sets(){
+	u32 density;
+	u32 runtime;
+	u32 period;
+	u32 deadline;
+	int count;
+	int set;
+	int id;
+
+	for(set=0; set < 40; set++){
+		reset();
+		density = 0;
+		count = random_value(6) + 1;
+		for(id=2; id < count + 2; id++){
+			period = (random_value(20) + 1)*500;
+			deadline = random_value(2) ? period : period - random_value(period/2);
+			runtime = random_value(deadline/count) + 1;
+			if( density + (u64)runtime*1000000/deadline > SOS_SCHED_DEADLINE_DENSITY_MAX ){
+				break;
+			}
+			density += (u64)runtime*1000000/deadline;
+			//each job does up to its runtime
+			HOST_CHECK(start_deadline_task(id, runtime, period, deadline, runtime - random_value(runtime)) == 0);
+		}
+
+		run(1000000);
+
+		for(id=2; id < TASK_TOTAL; id++){
+			HOST_CHECK(sos_sched_table[id].deadline.miss_count == 0);
+			HOST_CHECK(sos_sched_table[id].deadline.overrun_count == 0);
+		}
+		HOST_CHECK(m_total_executed[BACKGROUND_TASK] > 0);
+	}
+}
+
+static void test_overrun(){
+	reset();
+	HOST_CHECK(start_deadline_task(2, 300, 1000, 0, 300) == 0);
+	HOST_CHECK(start_deadline_task(3, 200, 2000, 0, 200) == 0);
+	//needs 1000us for each job but only has 250us each period
+	HOST_CHECK(start_deadline_task(4, 250, 1000, 0, 1000) == 0);
+
+	run(1000000);
+
+	HOST_CHECK(sos_sched_table[2].deadline.miss_count == 0);
+	HOST_CHECK(sos_sched_table[3].deadline.miss_count == 0);
+	//each job takes four periods so the budget runs out in three of them
+	HOST_CHECK(sos_sched_table[4].deadline.overrun_count >= 740);
+	HOST_CHECK(sos_sched_table[4].deadline.overrun_count <= 750);
+	HOST_CHECK(sos_sched_table[4].deadline.miss_count >= sos_sched_table[4].deadline.overrun_count);
+
+	//task 4 is held to its runtime each period (check_edf() and execute() check each job)
+	HOST_CHECK(m_total_executed[4] <= 250*1000 + 250);
+	HOST_CHECK(m_total_executed[BACKGROUND_TASK] > 0);
+}
+
+static void bench(){
+	unsigned long long start;
+	const u32 useconds = 10000000;
+
+	reset();
+	start_deadline_task(2, 300, 1000, 0, 250);
+	start_deadline_task(3, 1000, 5000, 0, 800);
+	start_deadline_task(4, 500, 2000, 1500, 500);
+
+	start = host_now_ns();
+	run(useconds);
+	host_report("deadline simulated us", host_now_ns() - start, useconds);
+	printf("%ld context switches, background thread executed %u of %u us\n",
+			 m_switch_count, m_total_executed[BACKGROUND_TASK], useconds);
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_admission();
+	test_overrun();
+	test_random_sets();
+	return 0;
+}
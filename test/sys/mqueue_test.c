@@ -0,0 +1,588 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+
+/*
+ * Host test and benchmark for the message queues.
+ *
+ * mqueue.c is built with the real pthread mutex and the scheduler replaced
+ * by a simulation. cortexm_svcall() calls the kernel function directly and
+ * counts the calls. When a thread blocks on a queue, the simulated
+ * scheduler runs one action as another thread (which should wake it)
+ * and switches back. The bench compares the copy (send/receive) and the
+ * zero-copy (reserve/commit and borrow/release) paths.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "mqueue.h"
+#include "sos/sos.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "sys/scheduler/scheduler_local.h"
+#include "sys/scheduler/scheduler_root.h"
+
+#define TASK_TOTAL 8
+#define MSG_SIZE 32
+#define MSG_COUNT 8
+#define BENCH_MSG_SIZE_MAX 1024
+
+volatile task_t sos_task_table[TASK_TOTAL];
+volatile sched_task_t sos_sched_table[TASK_TOTAL];
+volatile int m_task_current;
+cortexm_svcall_t cortexm_svcall_validation;
+
+static int m_svcall_count;
+static void * m_blocked_object[TASK_TOTAL];
+static int m_block_count;
+static int m_block_switch_id;
+static void (*m_block_action)(mqd_t mqdes);
+static mqd_t m_block_mqdes;
+static unsigned int m_lcg = 1;
+
+void cortexm_svcall(cortexm_svcall_t call, void * args){
+	m_svcall_count++;
+	call(args);
+}
+
+static int m_heap_count;
+
+void * _malloc_r(struct _reent * reent, size_t size){
+	//mqdes is the address of the queue as an int
+	m_heap_count++;
+	return host_alloc_low(size);
+}
+
+void _free_r(struct _reent * reent, void * ptr){
+	if( ptr ){
+		m_heap_count--;
+	}
+}
+
+pid_t getpid(){ return task_get_pid(task_get_current()); }
+s8 task_get_current_priority(){ return task_get_priority(task_get_current()); }
+void task_root_set_current_priority(s8 value){ task_set_priority(task_get_current(), value); }
+void task_root_update_ready(int id){}
+void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts){
+	memset(tv, 0, sizeof(struct mcu_timeval));
+}
+void scheduler_root_update_on_wake(int id, int new_priority){}
+void scheduler_root_update_on_stopped(){}
+
+void scheduler_root_assert_active(int id, int unblock_type){
+	m_blocked_object[id] = 0;
+	scheduler_root_set_unblock_type(id, unblock_type);
+}
+
+static int get_blocked(volatile void * block_object){
+	int i;
+	int id = -1;
+	for(i=1; i < TASK_TOTAL; i++){
+		if( m_blocked_object[i] == block_object ){
+			if( (id == -1) || (task_get_priority(i) > task_get_priority(id)) ){
+				id = i;
+			}
+		}
+	}
+	return id;
+}
+
+int scheduler_root_get_highest_priority_blocked(void * block_object){
+	return get_blocked(block_object);
+}
+
+int scheduler_wait_queue_head(volatile void * block_object){
+	int id = get_blocked(block_object);
+	return id == -1 ? 0 : id;
+}
+
+void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * abs_time){
+	int current = task_get_current();
+	void (*action)(mqd_t mqdes) = m_block_action;
+
+	m_blocked_object[current] = block_object;
+	m_block_count++;
+	HOST_CHECK(action != 0);
+
+	//run the other thread until the blocked thread is woken
+	m_block_action = 0;
+	m_task_current = m_block_switch_id;
+	action(m_block_mqdes);
+	m_task_current = current;
+	HOST_CHECK(m_blocked_object[current] == 0);
+	HOST_CHECK(scheduler_unblock_type(current) == SCHEDULER_UNBLOCK_MQ);
+}
+
+static int random_value(int range){
+	m_lcg = m_lcg*1103515245u + 12345u;
+	return (m_lcg >> 8) % range;
+}
+
+static void init_tasks(){
+	int i;
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	memset(m_blocked_object, 0, sizeof(m_blocked_object));
+	for(i=1; i < TASK_TOTAL; i++){
+		sos_task_table[i].pid = 1;
+		sos_task_table[i].priority = i;
+		sos_sched_table[i].attr.schedparam.sched_priority = i;
+	}
+	m_task_current = 1;
+}
+
+static mqd_t open_queue_size(const char * name, int oflag, int size){
+	struct mq_attr attr;
+	mqd_t mqdes;
+	memset(&attr, 0, sizeof(attr));
+	attr.mq_maxmsg = MSG_COUNT;
+	attr.mq_msgsize = size;
+	mqdes = mq_open(name, O_CREAT|O_EXCL|O_RDWR|oflag, 0666, &attr);
+	HOST_CHECK(mqdes != (mqd_t)-1);
+	return mqdes;
+}
+
+static mqd_t open_queue(const char * name, int oflag){
+	return open_queue_size(name, oflag, MSG_SIZE);
+}
+
+static void close_queue(const char * name, mqd_t mqdes){
+	HOST_CHECK(mq_close(mqdes) == 0);
+	HOST_CHECK(mq_unlink(name) == 0);
+}
+
+static int get_curmsgs(mqd_t mqdes){
+	struct mq_attr attr;
+	HOST_CHECK(mq_getattr(mqdes, &attr) == 0);
+	return attr.mq_curmsgs;
+}
+
+static void fill_message(char * buffer, int value, int size){
+	int i;
+	for(i=0; i < size; i++){
+		buffer[i] = value + i;
+	}
+}
+
+static void test_invalid_send(){
+	mqd_t mqdes;
+	char buffer[MSG_SIZE+1];
+	int i;
+
+	init_tasks();
+	mqdes = open_queue("/invalid", O_NONBLOCK);
+	memset(buffer, 0, sizeof(buffer));
+
+	//none of these take a message from the queue
+	for(i=0; i < MSG_COUNT*2; i++){
+		errno = 0;
+		HOST_CHECK(mq_send(mqdes, buffer, 0, 0) < 0 && errno == EINVAL);
+		HOST_CHECK(mq_send(mqdes, buffer, 1, MQ_PRIO_MAX) < 0 && errno == EINVAL);
+		HOST_CHECK(mq_send(mqdes, buffer, MSG_SIZE+1, 0) < 0 && errno == EMSGSIZE);
+	}
+	HOST_CHECK(get_curmsgs(mqdes) == 0);
+
+	for(i=0; i < MSG_COUNT; i++){
+		HOST_CHECK(mq_send(mqdes, buffer, 1, 0) == 1);
+	}
+	HOST_CHECK(mq_send(mqdes, buffer, 1, 0) < 0 && errno == EAGAIN);
+
+	//a full queue still rejects an empty message before anything else
+	HOST_CHECK(mq_send(mqdes, buffer, 0, 0) < 0 && errno == EINVAL);
+	close_queue("/invalid", mqdes);
+}
+
+typedef struct {
+	int prio;
+	int size;
+	int value;
+} model_message_t;
+
+static void test_reuse(){
+	mqd_t first;
+	mqd_t mqdes;
+	int heap_count;
+	int i;
+
+	init_tasks();
+
+	//the message table goes back to the heap and the queue goes back to the queue pool
+	first = open_queue("reuse", 0);
+	close_queue("reuse", first);
+	heap_count = m_heap_count;
+	for(i=0; i < 100; i++){
+		mqdes = open_queue("reuse", 0);
+		HOST_CHECK(mqdes == first);
+		HOST_CHECK(m_heap_count == heap_count + 1);
+		close_queue("reuse", mqdes);
+		HOST_CHECK(m_heap_count == heap_count);
+	}
+
+	//a closed descriptor is rejected
+	HOST_CHECK(mq_close(first) < 0);
+	HOST_CHECK(errno == EBADF);
+}
+
+static void test_random(){
+	mqd_t mqdes;
+	model_message_t model[MSG_COUNT];
+	char buffer[MSG_SIZE];
+	char expected[MSG_SIZE];
+	unsigned prio;
+	int count;
+	int value;
+	int i;
+	int j;
+	int next;
+
+	init_tasks();
+	mqdes = open_queue("/random", O_NONBLOCK);
+
+	//the model keeps the messages in the order they were sent
+	count = 0;
+	value = 0;
+	for(i=0; i < 100000; i++){
+		if( random_value(2) ){
+			model_message_t msg;
+			msg.prio = random_value(4) * 8 + random_value(2);
+			msg.size = random_value(MSG_SIZE) + 1;
+			msg.value = value++;
+			fill_message(buffer, msg.value, msg.size);
+			if( count == MSG_COUNT ){
+				HOST_CHECK(mq_send(mqdes, buffer, msg.size, msg.prio) < 0 && errno == EAGAIN);
+			} else {
+				HOST_CHECK(mq_send(mqdes, buffer, msg.size, msg.prio) == msg.size);
+				model[count++] = msg;
+			}
+		} else {
+			if( count == 0 ){
+				HOST_CHECK(mq_receive(mqdes, buffer, MSG_SIZE, &prio) < 0 && errno == EAGAIN);
+			} else {
+				//the oldest message with the highest priority
+				next = 0;
+				for(j=1; j < count; j++){
+					if( model[j].prio > model[next].prio ){
+						next = j;
+					}
+				}
+				HOST_CHECK(mq_receive(mqdes, buffer, MSG_SIZE, &prio) == model[next].size);
+				HOST_CHECK(prio == model[next].prio);
+				fill_message(expected, model[next].value, model[next].size);
+				HOST_CHECK(memcmp(buffer, expected, model[next].size) == 0);
+				count--;
+				memmove(model + next, model + next + 1, (count - next)*sizeof(model_message_t));
+			}
+		}
+		HOST_CHECK(get_curmsgs(mqdes) == count);
+	}
+
+	close_queue("/random", mqdes);
+}
+
+static void send_action(mqd_t mqdes){
+	char buffer[4];
+	fill_message(buffer, 10, sizeof(buffer));
+	HOST_CHECK(mq_send(mqdes, buffer, sizeof(buffer), 3) == sizeof(buffer));
+}
+
+static void receive_action(mqd_t mqdes){
+	char buffer[MSG_SIZE];
+	HOST_CHECK(mq_receive(mqdes, buffer, MSG_SIZE, 0) > 0);
+}
+
+static void test_blocking(){
+	mqd_t mqdes;
+	char buffer[MSG_SIZE];
+	char expected[4];
+	unsigned prio;
+	int i;
+
+	init_tasks();
+	mqdes = open_queue("/blocking", 0);
+
+	//2 blocks on the empty queue until 1 sends a message
+	m_task_current = 2;
+	m_block_count = 0;
+	m_block_switch_id = 1;
+	m_block_action = send_action;
+	m_block_mqdes = mqdes;
+	HOST_CHECK(mq_receive(mqdes, buffer, MSG_SIZE, &prio) == 4);
+	HOST_CHECK(m_block_count == 1);
+	HOST_CHECK(prio == 3);
+	fill_message(expected, 10, sizeof(expected));
+	HOST_CHECK(memcmp(buffer, expected, sizeof(expected)) == 0);
+
+	//1 blocks on the full queue until 2 receives a message
+	m_task_current = 1;
+	for(i=0; i < MSG_COUNT; i++){
+		HOST_CHECK(mq_send(mqdes, buffer, 1, 0) == 1);
+	}
+	m_block_count = 0;
+	m_block_switch_id = 2;
+	m_block_action = receive_action;
+	HOST_CHECK(mq_send(mqdes, buffer, 1, 0) == 1);
+	HOST_CHECK(m_block_count == 1);
+	HOST_CHECK(get_curmsgs(mqdes) == MSG_COUNT);
+
+	//a zero timeout doesn't block
+	m_block_action = 0;
+	HOST_CHECK(mq_trysend(mqdes, buffer, 1, 0) < 0 && errno == EAGAIN);
+
+	close_queue("/blocking", mqdes);
+}
+
+static void test_zero_copy(){
+	mqd_t mqdes;
+	char buffer[MSG_SIZE];
+	char expected[MSG_SIZE];
+	void * reserved[MSG_COUNT];
+	char * msg;
+	size_t msg_len;
+	unsigned prio;
+	int i;
+
+	init_tasks();
+	mqdes = open_queue("/zero_copy", O_NONBLOCK);
+
+	//a reserved message is written in place and received with a copy
+	for(i=0; i < MSG_COUNT; i++){
+		reserved[i] = mq_reserve(mqdes);
+		HOST_CHECK(reserved[i] != 0);
+	}
+	HOST_CHECK(mq_reserve(mqdes) == 0 && errno == EAGAIN);
+	HOST_CHECK(get_curmsgs(mqdes) == 0);
+	for(i=0; i < MSG_COUNT; i++){
+		fill_message(reserved[i], i, i+1);
+		HOST_CHECK(mq_commit(mqdes, reserved[i], i+1, i) == 0);
+	}
+	HOST_CHECK(mq_commit(mqdes, reserved[0], 1, 0) < 0 && errno == EINVAL);
+	HOST_CHECK(get_curmsgs(mqdes) == MSG_COUNT);
+	for(i=MSG_COUNT-1; i >= 0; i--){
+		HOST_CHECK(mq_receive(mqdes, buffer, MSG_SIZE, &prio) == i+1);
+		HOST_CHECK(prio == i);
+		fill_message(expected, i, i+1);
+		HOST_CHECK(memcmp(buffer, expected, i+1) == 0);
+	}
+
+	//committing zero bytes gives the message back
+	msg = mq_reserve(mqdes);
+	HOST_CHECK(msg != 0);
+	HOST_CHECK(mq_commit(mqdes, msg, MSG_SIZE+1, 0) < 0 && errno == EMSGSIZE);
+	HOST_CHECK(mq_commit(mqdes, msg, 1, MQ_PRIO_MAX) < 0 && errno == EINVAL);
+	HOST_CHECK(mq_commit(mqdes, msg + 1, 1, 0) < 0 && errno == EINVAL);
+	HOST_CHECK(mq_commit(mqdes, msg, 0, 0) == 0);
+	HOST_CHECK(get_curmsgs(mqdes) == 0);
+
+	//a sent message is read in place
+	HOST_CHECK(mq_borrow(mqdes, &msg_len, &prio) == 0 && errno == EAGAIN);
+	fill_message(buffer, 20, 5);
+	HOST_CHECK(mq_send(mqdes, buffer, 5, 7) == 5);
+	msg = mq_borrow(mqdes, &msg_len, &prio);
+	HOST_CHECK(msg != 0);
+	HOST_CHECK(msg_len == 5);
+	HOST_CHECK(prio == 7);
+	HOST_CHECK(memcmp(msg, buffer, 5) == 0);
+	HOST_CHECK(get_curmsgs(mqdes) == 0);
+
+	//the borrowed message isn't free until it is released
+	for(i=0; i < MSG_COUNT-1; i++){
+		HOST_CHECK(mq_send(mqdes, buffer, 1, 0) == 1);
+	}
+	HOST_CHECK(mq_send(mqdes, buffer, 1, 0) < 0 && errno == EAGAIN);
+	HOST_CHECK(mq_release(mqdes, msg + 1) < 0 && errno == EINVAL);
+	HOST_CHECK(mq_release(mqdes, msg) == 0);
+	HOST_CHECK(mq_release(mqdes, msg) < 0 && errno == EINVAL);
+	HOST_CHECK(mq_send(mqdes, buffer, 1, 0) == 1);
+
+	//the size and priority are optional
+	for(i=0; i < MSG_COUNT; i++){
+		msg = mq_borrow(mqdes, 0, 0);
+		HOST_CHECK(msg != 0);
+		HOST_CHECK(mq_release(mqdes, msg) == 0);
+	}
+	HOST_CHECK(get_curmsgs(mqdes) == 0);
+
+	//a message can't be released to a queue it didn't come from
+	msg = mq_reserve(mqdes);
+	HOST_CHECK(mq_release(mqdes, msg) < 0 && errno == EINVAL);
+	HOST_CHECK(mq_commit(mqdes, msg, 0, 0) == 0);
+
+	//lending a message takes one svcall -- the same as locking and unlocking for a copy
+	m_svcall_count = 0;
+	HOST_CHECK(mq_send(mqdes, buffer, 1, 0) == 1);
+	HOST_CHECK(mq_receive(mqdes, buffer, MSG_SIZE, 0) == 1);
+	HOST_CHECK(m_svcall_count == 4);
+	m_svcall_count = 0;
+	msg = mq_reserve(mqdes);
+	HOST_CHECK(mq_commit(mqdes, msg, 1, 0) == 0);
+	msg = mq_borrow(mqdes, 0, 0);
+	HOST_CHECK(mq_release(mqdes, msg) == 0);
+	HOST_CHECK(m_svcall_count == 4);
+
+	close_queue("/zero_copy", mqdes);
+}
+
+static void * m_reserved[MSG_COUNT];
+
+static void commit_action(mqd_t mqdes){
+	//a sent message wakes the receiver even though the sender has a higher priority
+	HOST_CHECK(mq_commit(mqdes, m_reserved[0], 4, 0) == 0);
+	HOST_CHECK(m_blocked_object[2] == 0);
+	HOST_CHECK(m_blocked_object[3] != 0);
+
+	//a cancelled message wakes the sender
+	HOST_CHECK(mq_commit(mqdes, m_reserved[1], 0, 0) == 0);
+	HOST_CHECK(m_blocked_object[3] == 0);
+}
+
+static void reserve_action(mqd_t mqdes){
+	void * msg;
+	m_block_switch_id = 1;
+	m_block_action = commit_action;
+	msg = mq_reserve(mqdes);
+	HOST_CHECK(msg == m_reserved[1]);
+	HOST_CHECK(mq_commit(mqdes, msg, 0, 0) == 0);
+}
+
+static void test_send_receive_wake(){
+	mqd_t mqdes;
+	size_t msg_len;
+	char * msg;
+	int i;
+
+	init_tasks();
+	mqdes = open_queue("/wake", 0);
+
+	//every message is reserved so the queue is empty and has no free messages
+	for(i=0; i < MSG_COUNT; i++){
+		m_reserved[i] = mq_reserve(mqdes);
+		HOST_CHECK(m_reserved[i] != 0);
+	}
+
+	//2 blocks receiving, then 3 blocks sending, then 1 sends one message and cancels another
+	m_task_current = 2;
+	m_block_count = 0;
+	m_block_switch_id = 3;
+	m_block_action = reserve_action;
+	m_block_mqdes = mqdes;
+	msg = mq_borrow(mqdes, &msg_len, 0);
+	HOST_CHECK(msg == m_reserved[0]);
+	HOST_CHECK(msg_len == 4);
+	HOST_CHECK(m_block_count == 2);
+	HOST_CHECK(mq_release(mqdes, msg) == 0);
+
+	m_task_current = 1;
+	for(i=2; i < MSG_COUNT; i++){
+		HOST_CHECK(mq_commit(mqdes, m_reserved[i], 0, 0) == 0);
+	}
+	HOST_CHECK(get_curmsgs(mqdes) == 0);
+	close_queue("/wake", mqdes);
+}
+
+static void bench_size(int size){
+	mqd_t mqdes;
+	char buffer[BENCH_MSG_SIZE_MAX];
+	char name[32];
+	unsigned long long start;
+	const long count = 2000000;
+	void * msg;
+	long i;
+
+	sprintf(name, "/bench%d", size);
+	mqdes = open_queue_size(name, O_NONBLOCK, size);
+	memset(buffer, 0, sizeof(buffer));
+
+	m_svcall_count = 0;
+	start = host_now_ns();
+	for(i=0; i < count; i++){
+		mq_send(mqdes, buffer, size, 0);
+		mq_receive(mqdes, buffer, size, 0);
+	}
+	sprintf(name, "mq send/receive %d bytes", size);
+	host_report(name, host_now_ns() - start, count);
+	printf("  svcalls %d (the queue mutex has a priority ceiling)\n", m_svcall_count);
+
+	//the same messages written and read in place
+	m_svcall_count = 0;
+	start = host_now_ns();
+	for(i=0; i < count; i++){
+		msg = mq_reserve(mqdes);
+		memcpy(msg, buffer, size);
+		mq_commit(mqdes, msg, size, 0);
+		msg = mq_borrow(mqdes, 0, 0);
+		buffer[0] = *(char*)msg;
+		mq_release(mqdes, msg);
+	}
+	sprintf(name, "mq reserve..release %d bytes", size);
+	host_report(name, host_now_ns() - start, count);
+	printf("  svcalls %d\n", m_svcall_count);
+
+	sprintf(name, "/bench%d", size);
+	close_queue(name, mqdes);
+}
+
+static void bench(){
+	mqd_t mqdes;
+	char buffer[MSG_SIZE];
+	unsigned long long start;
+	const long count = 2000000;
+	long i;
+	int j;
+
+	init_tasks();
+
+	//zero-copy saves a copy each way and takes the same number of svcalls -- a svcall
+	//is a direct call on the host so compare the svcall counts for the target
+	bench_size(MSG_SIZE);
+	bench_size(BENCH_MSG_SIZE_MAX);
+
+	//fill and drain the queue with mixed priorities
+	mqdes = open_queue("/bench", O_NONBLOCK);
+	memset(buffer, 0, sizeof(buffer));
+	start = host_now_ns();
+	for(i=0; i < count / MSG_COUNT; i++){
+		for(j=0; j < MSG_COUNT; j++){
+			mq_send(mqdes, buffer, MSG_SIZE, j*3);
+		}
+		for(j=0; j < MSG_COUNT; j++){
+			mq_receive(mqdes, buffer, MSG_SIZE, 0);
+		}
+	}
+	host_report("mq send/receive 32 bytes, queue full", host_now_ns() - start, (count / MSG_COUNT) * MSG_COUNT);
+	close_queue("/bench", mqdes);
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_invalid_send();
+	test_reuse();
+	test_random();
+	test_blocking();
+	test_zero_copy();
+	test_send_receive_wake();
+	return 0;
+}
@@ -0,0 +1,288 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Host test and benchmark for the pthread mutex fast path.
+ *
+ * pthread_mutex.c is built with the scheduler replaced by a simulation.
+ * cortexm_svcall() calls the kernel function directly and counts the
+ * calls. When a thread blocks, the simulated scheduler switches to the
+ * thread set up by the test (usually the owner), runs one action as that
+ * thread and switches back.
+ *
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "sos/sos.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "sys/scheduler/scheduler_local.h"
+#include "sys/scheduler/scheduler_root.h"
+#include "sys/pthread/pthread_local.h"
+
+#define TASK_TOTAL 8
+
+volatile task_t sos_task_table[TASK_TOTAL];
+volatile sched_task_t sos_sched_table[TASK_TOTAL];
+volatile int m_task_current;
+cortexm_svcall_t cortexm_svcall_validation;
+
+static int m_svcall_count;
+static int m_is_blocked[TASK_TOTAL];
+static int m_block_count;
+static int m_block_switch_id;
+static void (*m_block_action)(pthread_mutex_t * mutex);
+static pthread_mutex_t * m_block_mutex;
+
+void cortexm_svcall(cortexm_svcall_t call, void * args){
+	m_svcall_count++;
+	call(args);
+}
+
+pid_t getpid(){ return task_get_pid(task_get_current()); }
+s8 task_get_current_priority(){ return task_get_priority(task_get_current()); }
+void task_root_set_current_priority(s8 value){ task_set_priority(task_get_current(), value); }
+void task_root_update_ready(int id){}
+void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts){
+	memset(tv, 0, sizeof(struct mcu_timeval));
+}
+void scheduler_root_update_on_wake(int id, int new_priority){}
+void scheduler_root_update_on_stopped(){}
+
+void scheduler_root_assert_active(int id, int unblock_type){
+	m_is_blocked[id] = 0;
+	scheduler_root_set_unblock_type(id, unblock_type);
+}
+
+int scheduler_root_get_highest_priority_blocked(void * block_object){
+	int i;
+	int id = -1;
+	for(i=1; i < TASK_TOTAL; i++){
+		if( m_is_blocked[i] && (sos_sched_table[i].block_object == block_object) ){
+			if( (id == -1) || (task_get_priority(i) > task_get_priority(id)) ){
+				id = i;
+			}
+		}
+	}
+	return id;
+}
+
+void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * abs_time){
+	int current = task_get_current();
+	void (*action)(pthread_mutex_t * mutex) = m_block_action;
+
+	m_is_blocked[current] = 1;
+	m_block_count++;
+	HOST_CHECK(action != 0);
+
+	//run the other thread until the blocked thread is woken
+	m_block_action = 0;
+	m_task_current = m_block_switch_id;
+	action(m_block_mutex);
+	m_task_current = current;
+	HOST_CHECK(m_is_blocked[current] == 0);
+}
+
+static void set_current(int id){
+	m_task_current = id;
+}
+
+static void unlock_action(pthread_mutex_t * mutex){
+	HOST_CHECK(pthread_mutex_unlock(mutex) == 0);
+}
+
+static void init_tasks(){
+	int i;
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	memset(m_is_blocked, 0, sizeof(m_is_blocked));
+	for(i=1; i < TASK_TOTAL; i++){
+		sos_task_table[i].pid = 1;
+		sos_task_table[i].priority = i;
+		sos_sched_table[i].attr.schedparam.sched_priority = i;
+	}
+	set_current(1);
+}
+
+static void test_uncontended(){
+	pthread_mutex_t mutex;
+	int i;
+
+	init_tasks();
+	HOST_CHECK(pthread_mutex_init(&mutex, 0) == 0);
+
+	m_svcall_count = 0;
+	for(i=0; i < 10; i++){
+		HOST_CHECK(pthread_mutex_lock(&mutex) == 0);
+		HOST_CHECK(mutex.pthread == 1);
+		HOST_CHECK(mutex.lock == 1);
+		HOST_CHECK(pthread_mutex_lock(&mutex) < 0 && errno == EDEADLK);
+		HOST_CHECK(pthread_mutex_unlock(&mutex) == 0);
+		HOST_CHECK(mutex.pthread == -1);
+		HOST_CHECK(mutex.lock == 0);
+	}
+	HOST_CHECK(pthread_mutex_unlock(&mutex) < 0 && errno == EACCES);
+
+	//another thread can't take or release it
+	HOST_CHECK(pthread_mutex_trylock(&mutex) == 0);
+	set_current(2);
+	HOST_CHECK(pthread_mutex_trylock(&mutex) < 0 && errno == EBUSY);
+	HOST_CHECK(pthread_mutex_unlock(&mutex) < 0 && errno == EACCES);
+	set_current(1);
+	HOST_CHECK(pthread_mutex_unlock(&mutex) == 0);
+
+	HOST_CHECK(m_svcall_count == 0);
+}
+
+static void test_recursive(){
+	pthread_mutex_t mutex;
+	pthread_mutexattr_t attr;
+	int i;
+
+	init_tasks();
+	memset(&attr, 0, sizeof(attr));
+	attr.recursive = 1;
+	HOST_CHECK(pthread_mutex_init(&mutex, &attr) == 0);
+
+	m_svcall_count = 0;
+	for(i=0; i < 5; i++){
+		HOST_CHECK(pthread_mutex_lock(&mutex) == 0);
+		HOST_CHECK(mutex.lock == i+1);
+	}
+	for(i=0; i < 5; i++){
+		HOST_CHECK(mutex.pthread == 1);
+		HOST_CHECK(pthread_mutex_unlock(&mutex) == 0);
+	}
+	HOST_CHECK(mutex.pthread == -1);
+	HOST_CHECK(m_svcall_count == 0);
+}
+
+static void test_handoff(){
+	pthread_mutex_t mutex;
+	int i;
+
+	init_tasks();
+	HOST_CHECK(pthread_mutex_init(&mutex, 0) == 0);
+
+	for(i=0; i < 3; i++){
+		//1 owns the mutex while 2 blocks on it and 1 unlocks
+		set_current(1);
+		HOST_CHECK(pthread_mutex_lock(&mutex) == 0);
+
+		set_current(2);
+		m_svcall_count = 0;
+		m_block_count = 0;
+		m_block_switch_id = 1;
+		m_block_action = unlock_action;
+		m_block_mutex = &mutex;
+		HOST_CHECK(pthread_mutex_lock(&mutex) == 0);
+
+		//2 blocked once and 1 had to unlock in the kernel to hand over
+		HOST_CHECK(m_block_count == 1);
+		HOST_CHECK(m_svcall_count == 2);
+		HOST_CHECK(pthread_mutex_get_owner(&mutex) == 2);
+		HOST_CHECK(mutex.pthread & PTHREAD_MUTEX_PTHREAD_WAITING);
+		HOST_CHECK(mutex.lock == 1);
+
+		//the waiting bit sends this unlock to the kernel which frees the mutex
+		m_svcall_count = 0;
+		HOST_CHECK(pthread_mutex_unlock(&mutex) == 0);
+		HOST_CHECK(m_svcall_count == 1);
+		HOST_CHECK(mutex.pthread == -1);
+
+		//and the fast path is back
+		HOST_CHECK(pthread_mutex_lock(&mutex) == 0);
+		HOST_CHECK(pthread_mutex_unlock(&mutex) == 0);
+		HOST_CHECK(m_svcall_count == 1);
+	}
+}
+
+static void test_ceiling(){
+	pthread_mutex_t mutex;
+
+	init_tasks();
+	HOST_CHECK(pthread_mutex_init(&mutex, 0) == 0);
+	mutex.prio_ceiling = 5;
+
+	//locking raises the priority so it goes through the kernel
+	set_current(2);
+	m_svcall_count = 0;
+	HOST_CHECK(pthread_mutex_lock(&mutex) == 0);
+	HOST_CHECK(m_svcall_count == 1);
+	HOST_CHECK(task_get_priority(2) == 5);
+
+	//unlocking restores the priority in the kernel too
+	HOST_CHECK(pthread_mutex_unlock(&mutex) == 0);
+	HOST_CHECK(m_svcall_count == 2);
+	HOST_CHECK(task_get_priority(2) == 2);
+	HOST_CHECK(mutex.pthread == -1);
+
+	//a thread at or above the ceiling uses the fast path
+	set_current(6);
+	m_svcall_count = 0;
+	HOST_CHECK(pthread_mutex_lock(&mutex) == 0);
+	HOST_CHECK(pthread_mutex_unlock(&mutex) == 0);
+	HOST_CHECK(m_svcall_count == 0);
+}
+
+static void bench(){
+	pthread_mutex_t mutex;
+	unsigned long long start;
+	const long count = 10000000;
+	long i;
+
+	init_tasks();
+	HOST_CHECK(pthread_mutex_init(&mutex, 0) == 0);
+
+	m_svcall_count = 0;
+	start = host_now_ns();
+	for(i=0; i < count; i++){
+		pthread_mutex_lock(&mutex);
+		pthread_mutex_unlock(&mutex);
+	}
+	host_report("mutex lock/unlock fast path", host_now_ns() - start, count);
+	printf("  svcalls %d\n", m_svcall_count);
+
+	//the priority ceiling forces both calls through the kernel
+	mutex.prio_ceiling = 5;
+	m_svcall_count = 0;
+	start = host_now_ns();
+	for(i=0; i < count; i++){
+		pthread_mutex_lock(&mutex);
+		pthread_mutex_unlock(&mutex);
+	}
+	host_report("mutex lock/unlock svcall path", host_now_ns() - start, count);
+	printf("  svcalls %d (a direct call on the host)\n", m_svcall_count);
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_uncontended();
+	test_recursive();
+	test_handoff();
+	test_ceiling();
+	return 0;
+}
@@ -0,0 +1,239 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+/*
+ * Host test for sos_pool_t.
+ *
+ * The kernel heap (_malloc_r() and _free_r()) is counted so the test can
+ * check that kernel pools return their memory. The stress test has threads
+ * pass objects to each other to check that an object is never handed out
+ * twice.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+
+#include "host.h"
+#include "sos/sos.h"
+#include "cortexm/task_table.h"
+
+#define OBJECT_COUNT 16
+#define STRESS_THREADS 4
+#define STRESS_COUNT 200000
+
+typedef struct {
+	void * next; //used by the pool while the object is free
+	u32 owner;
+	u32 value;
+} object_t;
+
+typedef struct {
+	sos_pool_t * pool;
+	u32 id;
+} stress_t;
+
+volatile task_t sos_task_table[1];
+
+static int m_malloc_count;
+static int m_free_count;
+
+void * _malloc_r(struct _reent * reent, size_t size){
+	m_malloc_count++;
+	return malloc(size);
+}
+
+void _free_r(struct _reent * reent, void * ptr){
+	if( ptr ){
+		m_free_count++;
+	}
+	free(ptr);
+}
+
+static void test_alloc_free(){
+	sos_pool_t pool;
+	u32 memory[SOS_POOL_SIZE(sizeof(object_t), OBJECT_COUNT)/sizeof(u32)];
+	object_t * object[OBJECT_COUNT];
+	int i;
+
+	HOST_CHECK(SOS_POOL_OBJECT_SIZE(1) == sizeof(void*));
+	HOST_CHECK(SOS_POOL_OBJECT_SIZE(sizeof(void*)+1) == sizeof(void*)+4);
+
+	HOST_CHECK(sos_pool_init(&pool, memory, sizeof(memory), sizeof(object_t)) == OBJECT_COUNT);
+	HOST_CHECK(pool.memory == 0);
+
+	//objects are handed out in address order
+	for(i=0; i < OBJECT_COUNT; i++){
+		object[i] = sos_pool_alloc(&pool);
+		HOST_CHECK(object[i] == (object_t*)((char*)memory + i*pool.object_size));
+	}
+
+	//exhausted
+	HOST_CHECK(sos_pool_alloc(&pool) == 0);
+
+	//the last object freed is the next one allocated
+	sos_pool_free(&pool, object[3]);
+	sos_pool_free(&pool, object[7]);
+	HOST_CHECK(sos_pool_alloc(&pool) == object[7]);
+	HOST_CHECK(sos_pool_alloc(&pool) == object[3]);
+	HOST_CHECK(sos_pool_alloc(&pool) == 0);
+}
+
+static void test_extend(){
+	sos_pool_t pool;
+	u32 first[SOS_POOL_SIZE(sizeof(object_t), 2)/sizeof(u32)];
+	u32 second[SOS_POOL_SIZE(sizeof(object_t), 3)/sizeof(u32) + 1];
+	int i;
+
+	HOST_CHECK(sos_pool_init(&pool, first, sizeof(first), sizeof(object_t)) == 2);
+
+	//misaligned memory and memory too small for one object are rejected
+	errno = 0;
+	HOST_CHECK(sos_pool_extend(&pool, (char*)second + 1, sizeof(second) - 1) < 0);
+	HOST_CHECK(errno == EINVAL);
+	errno = 0;
+	HOST_CHECK(sos_pool_extend(&pool, second, pool.object_size - 1) < 0);
+	HOST_CHECK(errno == EINVAL);
+
+	//a partial object at the end is not used
+	HOST_CHECK(sos_pool_extend(&pool, second, sizeof(second)) == 3);
+	for(i=0; i < 5; i++){
+		HOST_CHECK(sos_pool_alloc(&pool) != 0);
+	}
+	HOST_CHECK(sos_pool_alloc(&pool) == 0);
+
+	//an uninitialized pool has no object size
+	memset(&pool, 0, sizeof(pool));
+	errno = 0;
+	HOST_CHECK(sos_pool_extend(&pool, first, sizeof(first)) < 0);
+	HOST_CHECK(errno == EINVAL);
+}
+
+static void test_create(){
+	sos_pool_t pool;
+	int i;
+
+	HOST_CHECK(sos_pool_create(&pool, sizeof(object_t), OBJECT_COUNT) == 0);
+	HOST_CHECK(pool.memory != 0);
+	for(i=0; i < OBJECT_COUNT; i++){
+		HOST_CHECK(sos_pool_alloc(&pool) != 0);
+	}
+	HOST_CHECK(sos_pool_alloc(&pool) == 0);
+	sos_pool_destroy(&pool);
+	HOST_CHECK(pool.memory == 0);
+	HOST_CHECK(sos_pool_alloc(&pool) == 0);
+
+	//kernel pools come from (and go back to) the kernel heap
+	m_malloc_count = m_free_count = 0;
+	HOST_CHECK(sos_pool_create_kernel(&pool, sizeof(object_t), OBJECT_COUNT) == 0);
+	HOST_CHECK(m_malloc_count == 1);
+	for(i=0; i < OBJECT_COUNT; i++){
+		HOST_CHECK(sos_pool_alloc(&pool) != 0);
+	}
+	HOST_CHECK(sos_pool_alloc(&pool) == 0);
+	sos_pool_destroy_kernel(&pool);
+	HOST_CHECK(m_free_count == 1);
+	HOST_CHECK(pool.memory == 0);
+	sos_pool_destroy_kernel(&pool);
+	HOST_CHECK(m_free_count == 1);
+}
+
+static void test_alloc_kernel(){
+	sos_pool_t pool = SOS_POOL_INITIALIZER(sizeof(object_t));
+	object_t * object[OBJECT_COUNT];
+	int i;
+
+	//the pool grows by four objects when it is empty
+	m_malloc_count = 0;
+	for(i=0; i < OBJECT_COUNT; i++){
+		object[i] = sos_pool_alloc_kernel(&pool, 4);
+		HOST_CHECK(object[i] != 0);
+		HOST_CHECK(m_malloc_count == i/4 + 1);
+	}
+
+	//freed objects are reused before the pool grows again
+	for(i=0; i < OBJECT_COUNT; i++){
+		sos_pool_free(&pool, object[i]);
+	}
+	for(i=0; i < OBJECT_COUNT; i++){
+		HOST_CHECK(sos_pool_alloc_kernel(&pool, 4) != 0);
+	}
+	HOST_CHECK(m_malloc_count == OBJECT_COUNT/4);
+	HOST_CHECK(sos_pool_alloc_kernel(&pool, 4) != 0);
+	HOST_CHECK(m_malloc_count == OBJECT_COUNT/4 + 1);
+}
+
+static void * stress(void * args){
+	stress_t * s = args;
+	object_t * object;
+	int i;
+
+	for(i=0; i < STRESS_COUNT; i++){
+		object = sos_pool_alloc(s->pool);
+		if( object == 0 ){
+			continue;
+		}
+		//if another thread has the same object, one of the checks fails
+		HOST_CHECK(object->owner == 0);
+		object->owner = s->id;
+		object->value = i;
+		HOST_CHECK(object->owner == s->id);
+		HOST_CHECK(object->value == (u32)i);
+		object->owner = 0;
+		sos_pool_free(s->pool, object);
+	}
+	return 0;
+}
+
+static void test_stress(){
+	static u32 memory[SOS_POOL_SIZE(sizeof(object_t), STRESS_THREADS-1)/sizeof(u32)];
+	sos_pool_t pool;
+	pthread_t thread[STRESS_THREADS];
+	stress_t args[STRESS_THREADS];
+	object_t * object;
+	int count;
+	int i;
+
+	//fewer objects than threads so the pool is empty some of the time
+	HOST_CHECK(sos_pool_init(&pool, memory, sizeof(memory), sizeof(object_t)) == STRESS_THREADS-1);
+
+	for(i=0; i < STRESS_THREADS; i++){
+		args[i].pool = &pool;
+		args[i].id = i+1;
+		HOST_CHECK(pthread_create(thread + i, 0, stress, args + i) == 0);
+	}
+	for(i=0; i < STRESS_THREADS; i++){
+		HOST_CHECK(pthread_join(thread[i], 0) == 0);
+	}
+
+	//every object is back on the free list
+	count = 0;
+	while( (object = sos_pool_alloc(&pool)) != 0 ){
+		count++;
+	}
+	HOST_CHECK(count == STRESS_THREADS-1);
+}
+
+int main(int argc, char * argv[]){
+	test_alloc_free();
+	test_extend();
+	test_create();
+	test_alloc_kernel();
+	test_stress();
+	return 0;
+}
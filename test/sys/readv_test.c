@@ -0,0 +1,421 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+/*
+ * Host test for vectored transfers (readv() and writev()).
+ *
+ * devfs_data_transfer_vector() runs against a fake device that completes
+ * each segment either right away or after the task blocks (the fake
+ * scheduler completes the pending transfer the way the driver's
+ * interrupt would). sysfs_file_readv() and sysfs_file_writev() are
+ * checked on a filesystem without the vector hooks (the per-segment
+ * fallback). devfs_validate_event_handler() is checked here too because it
+ * lives in the same file.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+#include "host.h"
+#include "sos/sos.h"
+#include "sos/fs/sysfs.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "sys/scheduler/scheduler_local.h"
+#include "sys/scheduler/scheduler_root.h"
+#include "sys/sysfs/devfs_local.h"
+#include "semaphore.h"
+
+#define TASK_TOTAL 4
+#define DEVICE_SIZE 64
+
+typedef struct {
+	u8 data[DEVICE_SIZE];
+	int available; //bytes a read can return
+	int max_transfer; //most bytes one read or write transfers
+	int is_async; //segments complete after the task blocks
+	int error; //errno to return from the next transfer
+	devfs_async_t * pending;
+	int transfer_count;
+	int locs[16];
+} fake_device_state_t;
+
+volatile task_t sos_task_table[TASK_TOTAL];
+volatile sched_task_t sos_sched_table[TASK_TOTAL];
+volatile int m_task_current;
+cortexm_svcall_t cortexm_svcall_validation;
+
+static fake_device_state_t m_fake;
+static char m_invalid[64]; //task_validate_memory() rejects this memory
+static int m_svcall_count;
+static int m_sleep_count;
+
+static int fake_open(const devfs_handle_t * handle){ return 0; }
+static int fake_ioctl(const devfs_handle_t * handle, int request, void * ctl){ return 0; }
+static int fake_close(const devfs_handle_t * handle){ return 0; }
+
+static int fake_transfer(devfs_async_t * async, int is_read){
+	int nbyte = async->nbyte;
+
+	if( m_fake.error ){
+		return SYSFS_SET_RETURN(m_fake.error);
+	}
+
+	if( m_fake.transfer_count < 16 ){
+		m_fake.locs[m_fake.transfer_count] = async->loc;
+	}
+	m_fake.transfer_count++;
+
+	if( nbyte > m_fake.max_transfer ){
+		nbyte = m_fake.max_transfer;
+	}
+
+	if( is_read ){
+		if( nbyte > m_fake.available ){
+			nbyte = m_fake.available;
+		}
+		if( nbyte == 0 ){
+			return SYSFS_SET_RETURN(EAGAIN);
+		}
+		memcpy(async->buf, m_fake.data + (DEVICE_SIZE - m_fake.available), nbyte);
+		m_fake.available -= nbyte;
+	} else {
+		memcpy(m_fake.data + m_fake.available, async->buf_const, nbyte);
+		m_fake.available += nbyte;
+	}
+
+	if( m_fake.is_async ){
+		//the interrupt reports the number of bytes later
+		async->nbyte = nbyte;
+		m_fake.pending = async;
+		return 0;
+	}
+	return nbyte;
+}
+
+static int fake_read(const devfs_handle_t * handle, devfs_async_t * async){
+	return fake_transfer(async, 1);
+}
+
+static int fake_write(const devfs_handle_t * handle, devfs_async_t * async){
+	return fake_transfer(async, 0);
+}
+
+static const devfs_device_t m_device = {
+	.name = "fake",
+	.mode = 0666 | S_IFCHR,
+	.driver = { fake_open, fake_ioctl, fake_read, fake_write, fake_close }
+};
+
+void cortexm_svcall(cortexm_svcall_t call, void * args){
+	m_svcall_count++;
+	call(args);
+}
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+
+int task_validate_memory(void * target, int size){
+	char * start = target;
+	if( (start < m_invalid + sizeof(m_invalid)) && (start + size > m_invalid) ){
+		return -1;
+	}
+	return 0;
+}
+
+int sysfs_is_r_ok(int file_mode, int file_uid, int file_gid){ return 1; }
+int sysfs_is_w_ok(int file_mode, int file_uid, int file_gid){ return 1; }
+int sysfs_access(int file_mode, int file_uid, int file_gid, int amode){ return 0; }
+int devfs_open(const void * cfg, void ** handle, const char * path, int flags, int mode){ return 0; }
+int devfs_ioctl(const void * cfg, void * handle, int request, void * ctl){ return 0; }
+
+void scheduler_root_assert_active(int id, int unblock_type){
+	sos_sched_table[id].block_object = 0;
+	scheduler_root_set_unblock_type(id, unblock_type);
+}
+
+u8 task_get_total(){ return TASK_TOTAL; }
+
+int devfs_signal_callback(void * context, const mcu_event_t * data){ return 0; }
+int devfs_semaphore_callback(void * context, const mcu_event_t * data){ return 0; }
+static int other_callback(void * context, const mcu_event_t * data){ return 0; }
+
+void scheduler_root_update_on_wake(int id, int new_priority){}
+
+//the task blocks until the device's interrupt completes the transfer
+void scheduler_root_update_on_sleep(){
+	devfs_async_t * async = m_fake.pending;
+	mcu_event_t event;
+
+	m_sleep_count++;
+	HOST_CHECK(async != 0);
+	m_fake.pending = 0;
+	event.o_events = MCU_EVENT_FLAG_DATA_READY;
+	event.data = 0;
+	async->handler.callback(async->handler.context, &event);
+}
+
+static void init_task(){
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	sos_task_table[1].pid = 1;
+	sos_sched_table[1].flags = (1<<SCHEDULER_TASK_FLAG_INUSE);
+	m_task_current = 1;
+}
+
+static void reset_device(int available, int max_transfer, int is_async){
+	int i;
+	memset(&m_fake, 0, sizeof(m_fake));
+	for(i=0; i < DEVICE_SIZE; i++){
+		m_fake.data[i] = i;
+	}
+	m_fake.available = available;
+	m_fake.max_transfer = max_transfer;
+	m_fake.is_async = is_async;
+	m_svcall_count = 0;
+	m_sleep_count = 0;
+}
+
+static int transfer(int flags, int loc, const struct iovec * iov, int iovcnt, int is_read){
+	return devfs_data_transfer_vector(0, &m_device, flags, loc, iov, iovcnt, is_read);
+}
+
+static void test_read(int is_async){
+	char a[8];
+	char b[4];
+	char c[16];
+	struct iovec iov[4];
+	int i;
+
+	//all segments complete (zero length entries are skipped)
+	reset_device(DEVICE_SIZE, DEVICE_SIZE, is_async);
+	iov[0].iov_base = a; iov[0].iov_len = sizeof(a);
+	iov[1].iov_base = 0; iov[1].iov_len = 0;
+	iov[2].iov_base = b; iov[2].iov_len = sizeof(b);
+	iov[3].iov_base = c; iov[3].iov_len = sizeof(c);
+	HOST_CHECK(transfer(0, 0, iov, 4, 1) == 28);
+	for(i=0; i < 8; i++){ HOST_CHECK(a[i] == i); }
+	for(i=0; i < 4; i++){ HOST_CHECK(b[i] == 8 + i); }
+	for(i=0; i < 16; i++){ HOST_CHECK(c[i] == 12 + i); }
+	HOST_CHECK(m_fake.transfer_count == 3);
+	if( is_async ){
+		//each segment blocks
+		HOST_CHECK(m_sleep_count == 3);
+		HOST_CHECK(m_svcall_count == 3);
+	} else {
+		//one svcall for every segment
+		HOST_CHECK(m_sleep_count == 0);
+		HOST_CHECK(m_svcall_count == 1);
+	}
+
+	//block devices advance the location for each segment (character devices don't)
+	reset_device(DEVICE_SIZE, DEVICE_SIZE, is_async);
+	HOST_CHECK(transfer(0, 100, iov, 4, 1) == 28);
+	HOST_CHECK(m_fake.locs[0] == 100);
+	HOST_CHECK(m_fake.locs[1] == 108);
+	HOST_CHECK(m_fake.locs[2] == 112);
+	reset_device(DEVICE_SIZE, DEVICE_SIZE, is_async);
+	HOST_CHECK(transfer(O_CHAR, 100, iov, 4, 1) == 28);
+	HOST_CHECK(m_fake.locs[2] == 100);
+
+	//a short segment ends the transfer
+	reset_device(10, DEVICE_SIZE, is_async);
+	HOST_CHECK(transfer(0, 0, iov, 4, 1) == 10);
+	HOST_CHECK(m_fake.transfer_count == 2);
+	reset_device(DEVICE_SIZE, 6, is_async);
+	HOST_CHECK(transfer(0, 0, iov, 4, 1) == 6);
+	HOST_CHECK(m_fake.transfer_count == 1);
+
+	//an error after the first segment returns the bytes that were transferred
+	reset_device(8, DEVICE_SIZE, is_async);
+	HOST_CHECK(transfer(0, 0, iov, 4, 1) == 8);
+	reset_device(0, DEVICE_SIZE, is_async);
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(transfer(0, 0, iov, 4, 1)) == EAGAIN);
+	reset_device(DEVICE_SIZE, DEVICE_SIZE, is_async);
+	m_fake.error = EIO;
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(transfer(0, 0, iov, 4, 1)) == EIO);
+
+	//only empty segments
+	reset_device(DEVICE_SIZE, DEVICE_SIZE, is_async);
+	iov[0].iov_len = 0; iov[2].iov_len = 0; iov[3].iov_len = 0;
+	HOST_CHECK(transfer(0, 0, iov, 4, 1) == 0);
+	HOST_CHECK(transfer(0, 0, iov, 0, 1) == 0);
+	HOST_CHECK(m_fake.transfer_count == 0);
+}
+
+static void test_write(int is_async){
+	char a[8];
+	char b[4];
+	struct iovec iov[3];
+	int i;
+
+	for(i=0; i < 8; i++){ a[i] = 100 + i; }
+	for(i=0; i < 4; i++){ b[i] = 108 + i; }
+
+	reset_device(0, DEVICE_SIZE, is_async);
+	iov[0].iov_base = a; iov[0].iov_len = sizeof(a);
+	iov[1].iov_base = m_invalid; iov[1].iov_len = 0;
+	iov[2].iov_base = b; iov[2].iov_len = sizeof(b);
+	HOST_CHECK(transfer(O_CHAR, 0, iov, 3, 0) == 12);
+	HOST_CHECK(m_fake.available == 12);
+	for(i=0; i < 12; i++){ HOST_CHECK(m_fake.data[i] == 100 + i); }
+
+	//the device takes fewer bytes than the first segment
+	reset_device(0, 5, is_async);
+	HOST_CHECK(transfer(O_CHAR, 0, iov, 3, 0) == 5);
+	HOST_CHECK(m_fake.transfer_count == 1);
+}
+
+static void test_invalid(){
+	char a[8];
+	struct iovec iov[3];
+	struct iovec * invalid_iov = (struct iovec*)m_invalid;
+
+	//the iov array itself must belong to the caller
+	reset_device(DEVICE_SIZE, DEVICE_SIZE, 0);
+	invalid_iov[0].iov_base = a;
+	invalid_iov[0].iov_len = sizeof(a);
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(transfer(0, 0, invalid_iov, 1, 1)) == EPERM);
+	HOST_CHECK(m_fake.transfer_count == 0);
+
+	//a count that overflows the size of the array
+	iov[0].iov_base = a; iov[0].iov_len = sizeof(a);
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(transfer(0, 0, iov, 0x7fffffff, 1)) == EPERM);
+	HOST_CHECK(m_fake.transfer_count == 0);
+
+	//a segment buffer that doesn't belong to the caller
+	iov[0].iov_base = m_invalid; iov[0].iov_len = sizeof(a);
+	HOST_CHECK(SYSFS_GET_RETURN_ERRNO(transfer(0, 0, iov, 1, 1)) == EPERM);
+	HOST_CHECK(m_fake.transfer_count == 0);
+
+	//the segments before the invalid one are still transferred
+	iov[0].iov_base = a; iov[0].iov_len = sizeof(a);
+	iov[1].iov_base = m_invalid + 60; iov[1].iov_len = 8;
+	iov[2].iov_base = a; iov[2].iov_len = sizeof(a);
+	HOST_CHECK(transfer(0, 0, iov, 3, 1) == 8);
+	HOST_CHECK(m_fake.transfer_count == 1);
+}
+
+//a filesystem without readv/writev hooks
+static int m_file_available;
+static int m_file_read_count;
+
+static int file_read(const void * cfg, void * handle, int flags, int loc, void * buf, int nbyte){
+	m_file_read_count++;
+	if( m_file_available < 0 ){
+		return SYSFS_SET_RETURN(EIO);
+	}
+	if( nbyte > m_file_available ){
+		nbyte = m_file_available;
+	}
+	memset(buf, loc, nbyte);
+	m_file_available -= nbyte;
+	return nbyte;
+}
+
+static int file_write(const void * cfg, void * handle, int flags, int loc, const void * buf, int nbyte){
+	return nbyte;
+}
+
+static void test_fallback(){
+	sysfs_t fs;
+	sysfs_file_t file;
+	char a[8];
+	char b[8];
+	struct iovec iov[3];
+
+	memset(&fs, 0, sizeof(fs));
+	fs.read = file_read;
+	fs.write = file_write;
+	memset(&file, 0, sizeof(file));
+	file.fs = &fs;
+
+	iov[0].iov_base = a; iov[0].iov_len = sizeof(a);
+	iov[1].iov_base = 0; iov[1].iov_len = 0;
+	iov[2].iov_base = b; iov[2].iov_len = sizeof(b);
+
+	//the location advances with each segment
+	m_file_available = 100;
+	m_file_read_count = 0;
+	HOST_CHECK(sysfs_file_readv(&file, iov, 3) == 16);
+	HOST_CHECK(m_file_read_count == 2);
+	HOST_CHECK(a[0] == 0);
+	HOST_CHECK(b[0] == 8);
+	HOST_CHECK(file.loc == 16);
+
+	//a short read ends the transfer
+	m_file_available = 4;
+	m_file_read_count = 0;
+	HOST_CHECK(sysfs_file_readv(&file, iov, 3) == 4);
+	HOST_CHECK(m_file_read_count == 1);
+	HOST_CHECK(file.loc == 20);
+
+	//an error is only reported if nothing was read
+	m_file_available = -1;
+	errno = 0;
+	HOST_CHECK(sysfs_file_readv(&file, iov, 3) < 0);
+	HOST_CHECK(errno == EIO);
+	HOST_CHECK(file.loc == 20);
+
+	HOST_CHECK(sysfs_file_writev(&file, iov, 3) == 16);
+	HOST_CHECK(file.loc == 36);
+	HOST_CHECK(sysfs_file_writev(&file, iov, 0) == 0);
+}
+
+static void test_event_handler(){
+	mcu_event_handler_t handler;
+	sem_t sem;
+
+	//removing a handler is always allowed
+	handler.callback = 0;
+	handler.context = m_invalid;
+	HOST_CHECK(devfs_validate_event_handler(&handler) == 0);
+
+	//other tasks can only use the kernel callbacks on their own memory
+	handler.callback = devfs_semaphore_callback;
+	handler.context = &sem;
+	HOST_CHECK(devfs_validate_event_handler(&handler) == 0);
+	handler.callback = devfs_signal_callback;
+	HOST_CHECK(devfs_validate_event_handler(&handler) == 0);
+	handler.context = m_invalid;
+	HOST_CHECK(devfs_validate_event_handler(&handler) < 0);
+	handler.callback = devfs_semaphore_callback;
+	HOST_CHECK(devfs_validate_event_handler(&handler) < 0);
+	handler.callback = other_callback;
+	handler.context = &sem;
+	HOST_CHECK(devfs_validate_event_handler(&handler) < 0);
+
+	//root tasks are already privileged
+	task_assert_root(1);
+	HOST_CHECK(devfs_validate_event_handler(&handler) == 0);
+	task_deassert_root(1);
+}
+
+int main(int argc, char * argv[]){
+	init_task();
+	test_read(0);
+	test_read(1);
+	test_write(0);
+	test_write(1);
+	test_invalid();
+	test_fallback();
+	test_event_handler();
+	return 0;
+}
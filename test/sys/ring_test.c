@@ -0,0 +1,225 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Host test and benchmark for sos_ring_t.
+ *
+ * sos_futex_wait() and sos_futex_wake() are implemented with Linux futexes
+ * so producer and consumer threads block the same way they do on the
+ * kernel. The consumer checks that the items from each producer arrive
+ * in order.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "host.h"
+#include "sos/sos.h"
+
+#define MAX_PRODUCERS 8
+
+typedef struct {
+	u32 producer;
+	u32 sequence;
+	u32 payload[2];
+} item_t;
+
+typedef struct {
+	sos_ring_t * ring;
+	u32 producer;
+	u32 count;
+} producer_t;
+
+static unsigned long m_futex_wait_count;
+static unsigned long m_futex_wake_count;
+
+int sos_futex_wait(volatile u32 * addr, u32 value, const struct timespec * abs_timeout){
+	__atomic_add_fetch(&m_futex_wait_count, 1, __ATOMIC_RELAXED);
+	if( syscall(SYS_futex, (u32*)addr,
+					FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+					value, abs_timeout, 0, FUTEX_BITSET_MATCH_ANY) < 0 ){
+		//EAGAIN means the value changed before blocking
+		if( errno != EAGAIN ){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void sos_futex_wake(volatile u32 * addr){
+	__atomic_add_fetch(&m_futex_wake_count, 1, __ATOMIC_RELAXED);
+	syscall(SYS_futex, (u32*)addr, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+}
+
+static void * produce(void * args){
+	producer_t * p = args;
+	item_t item;
+	u32 i;
+
+	memset(&item, 0, sizeof(item));
+	item.producer = p->producer;
+	for(i=0; i < p->count; i++){
+		item.sequence = i;
+		HOST_CHECK(sos_ring_write(p->ring, &item, 0) == 0);
+	}
+	return 0;
+}
+
+static void run(int producers, int slots, u32 count, const char * name){
+	sos_ring_t ring;
+	pthread_t thread[MAX_PRODUCERS];
+	producer_t producer[MAX_PRODUCERS];
+	u32 next[MAX_PRODUCERS];
+	u32 size = SOS_RING_SIZE(sizeof(item_t), slots);
+	void * buffer = malloc(size);
+	unsigned long long start;
+	item_t item;
+	long total;
+	long i;
+
+	HOST_CHECK(sos_ring_init(&ring, buffer, size, sizeof(item_t),
+									 producers > 1 ? SOS_RING_FLAG_IS_MULTI_PRODUCER : 0) == slots);
+
+	memset(next, 0, sizeof(next));
+	start = host_now_ns();
+	for(i=0; i < producers; i++){
+		producer[i].ring = &ring;
+		producer[i].producer = i;
+		producer[i].count = count;
+		HOST_CHECK(pthread_create(thread + i, 0, produce, producer + i) == 0);
+	}
+
+	total = (long)count * producers;
+	for(i=0; i < total; i++){
+		HOST_CHECK(sos_ring_read(&ring, &item, 0) == 0);
+		HOST_CHECK(item.producer < (u32)producers);
+		HOST_CHECK(item.sequence == next[item.producer]);
+		next[item.producer]++;
+	}
+
+	for(i=0; i < producers; i++){
+		pthread_join(thread[i], 0);
+	}
+
+	if( name ){
+		host_report(name, host_now_ns() - start, total);
+	}
+
+	HOST_CHECK(sos_ring_tryread(&ring, &item) < 0);
+	free(buffer);
+}
+
+static void test_nonblocking(){
+	sos_ring_t ring;
+	u32 buffer[SOS_RING_SIZE(sizeof(item_t), 8)/sizeof(u32) + 1];
+	item_t item;
+	u32 lap;
+	u32 i;
+
+	//not aligned, zero item size and too small
+	HOST_CHECK(sos_ring_init(&ring, (char*)buffer + 1, sizeof(buffer) - 4, sizeof(item_t), 0) < 0 && errno == EINVAL);
+	HOST_CHECK(sos_ring_init(&ring, buffer, sizeof(buffer), 0, 0) < 0 && errno == EINVAL);
+	HOST_CHECK(sos_ring_init(&ring, buffer, SOS_RING_SLOT_SIZE(sizeof(item_t)) - 1, sizeof(item_t), 0) < 0 && errno == EINVAL);
+
+	//one slot more than 8 still gives 8 slots
+	HOST_CHECK(sos_ring_init(&ring, buffer, sizeof(buffer), sizeof(item_t), 0) == 8);
+
+	memset(&item, 0, sizeof(item));
+	for(lap=0; lap < 3; lap++){
+		HOST_CHECK(sos_ring_tryread(&ring, &item) < 0 && errno == EAGAIN);
+		for(i=0; i < 8; i++){
+			item.sequence = lap*8 + i;
+			HOST_CHECK(sos_ring_trywrite(&ring, &item) == 0);
+		}
+		HOST_CHECK(sos_ring_trywrite(&ring, &item) < 0 && errno == EAGAIN);
+		for(i=0; i < 8; i++){
+			HOST_CHECK(sos_ring_tryread(&ring, &item) == 0);
+			HOST_CHECK(item.sequence == lap*8 + i);
+		}
+	}
+
+	//neither side enters the kernel if nobody waits
+	HOST_CHECK(m_futex_wait_count == 0);
+	HOST_CHECK(m_futex_wake_count == 0);
+}
+
+static void test_timeout(){
+	sos_ring_t ring;
+	u32 buffer[SOS_RING_SIZE(sizeof(item_t), 2)/sizeof(u32)];
+	struct timespec abs_timeout;
+	item_t item;
+
+	HOST_CHECK(sos_ring_init(&ring, buffer, sizeof(buffer), sizeof(item_t), 0) == 2);
+
+	clock_gettime(CLOCK_REALTIME, &abs_timeout);
+	abs_timeout.tv_nsec += 10*1000*1000;
+	if( abs_timeout.tv_nsec >= 1000*1000*1000 ){
+		abs_timeout.tv_nsec -= 1000*1000*1000;
+		abs_timeout.tv_sec++;
+	}
+	HOST_CHECK(sos_ring_read(&ring, &item, &abs_timeout) < 0 && errno == ETIMEDOUT);
+	HOST_CHECK(ring.read_waiters == 0);
+
+	memset(&item, 0, sizeof(item));
+	HOST_CHECK(sos_ring_write(&ring, &item, 0) == 0);
+	HOST_CHECK(sos_ring_write(&ring, &item, 0) == 0);
+	HOST_CHECK(sos_ring_write(&ring, &item, &abs_timeout) < 0 && errno == ETIMEDOUT);
+	HOST_CHECK(ring.write_waiters == 0);
+}
+
+static void test_threads(){
+	int producers;
+	int slots;
+
+	for(producers=1; producers <= MAX_PRODUCERS; producers *= 2){
+		for(slots=2; slots <= 64; slots *= 4){
+			run(producers, slots, 20000, 0);
+		}
+	}
+}
+
+static void bench(){
+	char name[64];
+	int producers;
+
+	for(producers=1; producers <= 4; producers *= 2){
+		m_futex_wait_count = 0;
+		m_futex_wake_count = 0;
+		snprintf(name, sizeof(name), "ring %d producer(s) 256 slots", producers);
+		run(producers, 256, 1000000, name);
+		printf("  futex wait %lu wake %lu\n", m_futex_wait_count, m_futex_wake_count);
+	}
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_nonblocking();
+	test_timeout();
+	test_threads();
+	return 0;
+}
@@ -0,0 +1,303 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Host test and benchmark for the semaphore post fast path.
+ *
+ * sem.c is built with the scheduler replaced by a simulation.
+ * cortexm_svcall() calls the kernel function directly and counts the
+ * calls. When a thread blocks, the simulated scheduler switches to the
+ * thread set up by the test, runs one action as that thread and switches
+ * back. Threads that the test marks blocked stay blocked until a post
+ * wakes them.
+ *
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "sos/sos.h"
+#include "sos/fs/devfs.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "sys/scheduler/scheduler_local.h"
+#include "sys/scheduler/scheduler_root.h"
+#include "semaphore.h"
+
+#define TASK_TOTAL 8
+
+volatile task_t sos_task_table[TASK_TOTAL];
+volatile sched_task_t sos_sched_table[TASK_TOTAL];
+volatile int m_task_current;
+cortexm_svcall_t cortexm_svcall_validation;
+
+static int m_svcall_count;
+static int m_is_blocked[TASK_TOTAL];
+static int m_block_count;
+static int m_block_switch_id;
+static void (*m_block_action)(sem_t * sem);
+static sem_t * m_block_sem;
+
+void cortexm_svcall(cortexm_svcall_t call, void * args){
+	m_svcall_count++;
+	call(args);
+}
+
+//named semaphores come from the pool (not used here)
+void * _malloc_r(struct _reent * reent, size_t size){ return host_alloc_low(size); }
+void _free_r(struct _reent * reent, void * ptr){}
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+
+pid_t getpid(){ return task_get_pid(task_get_current()); }
+void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts){
+	memset(tv, 0, sizeof(struct mcu_timeval));
+}
+void scheduler_root_update_on_wake(int id, int new_priority){}
+
+void scheduler_root_assert_active(int id, int unblock_type){
+	m_is_blocked[id] = 0;
+	scheduler_root_set_unblock_type(id, unblock_type);
+}
+
+int scheduler_root_get_highest_priority_blocked(void * block_object){
+	int i;
+	int id = -1;
+	for(i=1; i < TASK_TOTAL; i++){
+		if( m_is_blocked[i] && (sos_sched_table[i].block_object == block_object) ){
+			if( (id == -1) || (task_get_priority(i) > task_get_priority(id)) ){
+				id = i;
+			}
+		}
+	}
+	return id;
+}
+
+static void block_current(){
+	int current = task_get_current();
+	void (*action)(sem_t * sem) = m_block_action;
+
+	m_is_blocked[current] = 1;
+	m_block_count++;
+	HOST_CHECK(action != 0);
+
+	//run the other thread until the blocked thread is woken
+	m_block_action = 0;
+	m_task_current = m_block_switch_id;
+	action(m_block_sem);
+	m_task_current = current;
+	HOST_CHECK(m_is_blocked[current] == 0);
+}
+
+void scheduler_root_update_on_sleep(){
+	block_current();
+}
+
+void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * abs_time){
+	block_current();
+}
+
+static void set_current(int id){
+	m_task_current = id;
+}
+
+static void set_blocked(int id, sem_t * sem){
+	sos_sched_table[id].block_object = sem;
+	m_is_blocked[id] = 1;
+}
+
+static void post_action(sem_t * sem){
+	HOST_CHECK(sem_post(sem) == 0);
+}
+
+static void post_twice_action(sem_t * sem){
+	HOST_CHECK(sem_post(sem) == 0);
+	HOST_CHECK(sem_post(sem) == 0);
+}
+
+static void callback_action(sem_t * sem){
+	mcu_event_t event;
+	memset(&event, 0, sizeof(event));
+	HOST_CHECK(devfs_semaphore_callback(sem, &event) != 0);
+}
+
+static void init_tasks(){
+	int i;
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	memset(m_is_blocked, 0, sizeof(m_is_blocked));
+	for(i=1; i < TASK_TOTAL; i++){
+		sos_task_table[i].pid = 1;
+		sos_task_table[i].priority = i;
+		sos_sched_table[i].attr.schedparam.sched_priority = i;
+	}
+	set_current(1);
+}
+
+static void wait_blocked(sem_t * sem, int switch_id, void (*action)(sem_t * sem)){
+	m_block_count = 0;
+	m_block_switch_id = switch_id;
+	m_block_action = action;
+	m_block_sem = sem;
+	HOST_CHECK(sem_wait(sem) == 0);
+	HOST_CHECK(m_block_count == 1);
+}
+
+static void test_uncontended(){
+	sem_t sem;
+	int value;
+	int i;
+
+	init_tasks();
+	HOST_CHECK(sem_init(&sem, 0, 0) == 0);
+
+	//posts without waiters stay in user space
+	m_svcall_count = 0;
+	for(i=0; i < 10; i++){
+		HOST_CHECK(sem_post(&sem) == 0);
+	}
+	HOST_CHECK(m_svcall_count == 0);
+	HOST_CHECK(sem_getvalue(&sem, &value) == 0);
+	HOST_CHECK(value == 10);
+
+	for(i=0; i < 10; i++){
+		HOST_CHECK(sem_trywait(&sem) == 0);
+	}
+	HOST_CHECK(sem_trywait(&sem) < 0 && errno == EAGAIN);
+	HOST_CHECK(sem.value == 0);
+
+	//another process can't post a private semaphore
+	sos_task_table[2].pid = 2;
+	set_current(2);
+	HOST_CHECK(sem_post(&sem) < 0 && errno == EACCES);
+	set_current(1);
+	HOST_CHECK(sem.value == 0);
+}
+
+static void test_waiter(){
+	sem_t sem;
+	int value;
+	int i;
+
+	init_tasks();
+	HOST_CHECK(sem_init(&sem, 0, 0) == 0);
+
+	for(i=0; i < 3; i++){
+		//2 blocks which sends 1's post to the kernel to wake it
+		set_current(2);
+		m_svcall_count = 0;
+		wait_blocked(&sem, 1, post_action);
+		HOST_CHECK(m_svcall_count == 3);
+		HOST_CHECK(sem.value == 0);
+
+		//the fast path is back once nothing waits
+		set_current(1);
+		m_svcall_count = 0;
+		HOST_CHECK(sem_post(&sem) == 0);
+		HOST_CHECK(m_svcall_count == 0);
+		HOST_CHECK(sem_trywait(&sem) == 0);
+	}
+
+	//the interrupt callback wakes the waiter the same way
+	set_current(2);
+	wait_blocked(&sem, 1, callback_action);
+	HOST_CHECK(sem.value == 0);
+
+	//a blocked thread shows as zero
+	set_blocked(3, &sem);
+	sem.value = -1;
+	HOST_CHECK(sem_getvalue(&sem, &value) == 0);
+	HOST_CHECK(value == 0);
+}
+
+static void test_multiple_waiters(){
+	sem_t sem;
+
+	init_tasks();
+	HOST_CHECK(sem_init(&sem, 0, 0) == 0);
+
+	//2 is already waiting when 3 blocks -- the first post wakes 3 in the kernel
+	//and the second one is a fast post because 3 hasn't taken its unit yet
+	set_blocked(2, &sem);
+	set_current(3);
+	m_svcall_count = 0;
+	wait_blocked(&sem, 1, post_twice_action);
+	HOST_CHECK(m_svcall_count == 3);
+
+	//3 saw the extra unit and woke 2
+	HOST_CHECK(m_is_blocked[2] == 0);
+	HOST_CHECK(sem.value == 1);
+	set_current(2);
+	HOST_CHECK(sem_trywait(&sem) == 0);
+	HOST_CHECK(sem.value == 0);
+
+	//4 takes the unit posted for 2 while 3 is still waiting
+	set_blocked(2, &sem);
+	set_blocked(3, &sem);
+	sem.value = -1;
+	set_current(1);
+	HOST_CHECK(sem_post(&sem) == 0);
+	HOST_CHECK(m_is_blocked[3] == 0);
+	HOST_CHECK(m_is_blocked[2] == 1);
+	set_current(4);
+	HOST_CHECK(sem_trywait(&sem) == 0);
+
+	//then 3 retries and has to wait again so posts go to the kernel
+	set_current(3);
+	HOST_CHECK(sem_trywait(&sem) < 0);
+	HOST_CHECK(sem.value == -1);
+	set_current(1);
+	m_svcall_count = 0;
+	HOST_CHECK(sem_post(&sem) == 0);
+	HOST_CHECK(m_svcall_count == 1);
+	HOST_CHECK(m_is_blocked[2] == 0);
+	HOST_CHECK(sem.value == 1);
+}
+
+static void bench(){
+	sem_t sem;
+	unsigned long long start;
+	const long count = 10000000;
+	long i;
+
+	init_tasks();
+	HOST_CHECK(sem_init(&sem, 0, 0) == 0);
+
+	m_svcall_count = 0;
+	start = host_now_ns();
+	for(i=0; i < count; i++){
+		sem_post(&sem);
+	}
+	host_report("sem_post fast path", host_now_ns() - start, count);
+	printf("  svcalls %d\n", m_svcall_count);
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_uncontended();
+	test_waiter();
+	test_multiple_waiters();
+	return 0;
+}
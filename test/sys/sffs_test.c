@@ -0,0 +1,365 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+
+/*
+ * Host test for sffs append-only log files (SFFS_MODE_LOG).
+ *
+ * sffs is built on a RAM drive (in place of sffs_dev.c) that behaves like
+ * NOR flash: a write can only clear bits and an erase sets them. The drive
+ * can lose power after a given number of programmed bytes -- the write in
+ * progress is cut short and the test jumps back to remount the drive, which
+ * runs the log recovery.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "host.h"
+#include "sos/fs/sffs.h"
+#include "sos/fs/sysfs.h"
+#include "cortexm/cortexm.h"
+#include "sys/sffs/sffs_local.h"
+
+#define DRIVE_SIZE (256*1024)
+#define ERASE_SIZE 4096
+#define RECORD_MAX 300
+
+const sysfs_t sysfs_list[] = { SYSFS_TERMINATOR };
+cortexm_svcall_t cortexm_svcall_validation;
+
+static unsigned char m_drive[DRIVE_SIZE];
+static sffs_state_t m_state;
+static sffs_config_t m_config = {
+	.drive = { .state = (sysfs_shared_state_t*)&m_state }
+};
+
+static long m_write_budget = -1; //bytes programmed before power is lost
+static jmp_buf m_power_loss;
+static unsigned int m_lcg = 1;
+
+void cortexm_svcall(cortexm_svcall_t call, void * args){ call(args); }
+
+int pthread_mutexattr_init(pthread_mutexattr_t * attr){ return 0; }
+int pthread_mutexattr_setpshared(pthread_mutexattr_t * attr, int pshared){ return 0; }
+int pthread_mutexattr_setprioceiling(pthread_mutexattr_t * attr, int prio_ceiling){ return 0; }
+int pthread_mutexattr_settype(pthread_mutexattr_t * attr, int type){ return 0; }
+int pthread_mutex_init(pthread_mutex_t * mutex, const pthread_mutexattr_t * attr){ return 0; }
+int pthread_mutex_lock(pthread_mutex_t * mutex){ return 0; }
+int pthread_mutex_unlock(pthread_mutex_t * mutex){ return 0; }
+int pthread_mutex_force_unlock(pthread_mutex_t * mutex){ return 0; }
+
+int sffs_dev_getlist_block(const void * cfg){ return SFFS_STATE(cfg)->list_block; }
+void sffs_dev_setlist_block(const void * cfg, int list_block){ SFFS_STATE(cfg)->list_block = list_block; }
+int sffs_dev_getserialno(const void * cfg){ return SFFS_STATE(cfg)->serialno; }
+void sffs_dev_setserialno(const void * cfg, int serialno){ SFFS_STATE(cfg)->serialno = serialno; }
+void sffs_dev_setdelay_mutex(pthread_mutex_t * mutex){}
+int sffs_dev_close(const void * cfg){ return 0; }
+
+int sffs_dev_open(const void * cfg){
+	drive_info_t * info = &(SFFS_STATE(cfg)->dattr);
+	memset(info, 0, sizeof(drive_info_t));
+	info->addressable_size = 1;
+	info->write_block_size = 1;
+	info->num_write_blocks = DRIVE_SIZE;
+	info->erase_block_size = ERASE_SIZE;
+	info->page_program_size = 256;
+	return 0;
+}
+
+int sffs_dev_write(const void * cfg, int loc, const void * buf, int nbyte){
+	const unsigned char * src = buf;
+	int count = nbyte;
+	int i;
+
+	HOST_CHECK(loc >= 0 && loc + nbyte <= DRIVE_SIZE);
+	if( (m_write_budget >= 0) && (count > m_write_budget) ){
+		count = m_write_budget;
+	}
+
+	for(i=0; i < count; i++){
+		//flash can only clear bits
+		HOST_CHECK((m_drive[loc+i] & src[i]) == src[i]);
+		m_drive[loc+i] = src[i];
+	}
+
+	if( m_write_budget >= 0 ){
+		m_write_budget -= count;
+		if( count < nbyte ){
+			longjmp(m_power_loss, 1);
+		}
+	}
+	return nbyte;
+}
+
+int sffs_dev_read(const void * cfg, int loc, void * buf, int nbyte){
+	HOST_CHECK(loc >= 0 && loc + nbyte <= DRIVE_SIZE);
+	memcpy(buf, m_drive + loc, nbyte);
+	return nbyte;
+}
+
+int sffs_dev_erase(const void * cfg){
+	memset(m_drive, 0xFF, DRIVE_SIZE);
+	return 0;
+}
+
+int sffs_dev_erasesection(const void * cfg, int loc){
+	memset(m_drive + (loc & ~(ERASE_SIZE-1)), 0xFF, ERASE_SIZE);
+	return 0;
+}
+
+static int random_value(int range){
+	m_lcg = m_lcg*1103515245u + 12345u;
+	return (m_lcg >> 8) % range;
+}
+
+//each byte of the log is a function of its offset so any part can be checked
+static unsigned char log_byte(int offset){
+	return (offset * 7 + (offset >> 8)) & 0xFF;
+}
+
+static void fill_record(unsigned char * buffer, int offset, int nbyte){
+	int i;
+	for(i=0; i < nbyte; i++){
+		buffer[i] = log_byte(offset + i);
+	}
+}
+
+static void mount(){
+	//the RAM state is lost with the power
+	memset(&m_state, 0, sizeof(m_state));
+	HOST_CHECK(sffs_init(&m_config) == 0);
+}
+
+static void format(){
+	memset(&m_state, 0, sizeof(m_state));
+	HOST_CHECK(sffs_dev_open(&m_config) == 0);
+	HOST_CHECK(sffs_mkfs(&m_config) == 0);
+	mount();
+}
+
+static void * open_log(int flags){
+	void * handle = 0;
+	HOST_CHECK(sffs_open(&m_config, &handle, "log", flags, 0666 | SFFS_MODE_LOG) == 0);
+	HOST_CHECK(handle != 0);
+	return handle;
+}
+
+static int append(void * handle, int offset, int nbyte){
+	unsigned char buffer[RECORD_MAX];
+	fill_record(buffer, offset, nbyte);
+	//the location is ignored for log files
+	return sffs_write(&m_config, handle, O_RDWR, 0, buffer, nbyte);
+}
+
+static int get_size(void * handle){
+	struct stat st;
+	HOST_CHECK(sffs_fstat(&m_config, handle, &st) == 0);
+	return st.st_size;
+}
+
+//check whether the file holds the log from \a first to first + size
+static int is_log(int first, int size){
+	unsigned char buffer[RECORD_MAX];
+	void * handle;
+	int result;
+	int loc;
+	int nbyte;
+	int i;
+
+	handle = open_log(O_RDONLY);
+	result = (get_size(handle) == size);
+	for(loc=0; result && (loc < size); loc += nbyte){
+		nbyte = size - loc;
+		if( nbyte > RECORD_MAX ){
+			nbyte = RECORD_MAX;
+		}
+		HOST_CHECK(sffs_read(&m_config, handle, O_RDONLY, loc, buffer, nbyte) == nbyte);
+		for(i=0; i < nbyte; i++){
+			if( buffer[i] != log_byte(first + loc + i) ){
+				result = 0;
+				break;
+			}
+		}
+	}
+	HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+	return result;
+}
+
+static void check_log(int first, int size){
+	HOST_CHECK(is_log(first, size));
+}
+
+static void test_append(){
+	void * handle;
+	int size;
+	int nbyte;
+	int i;
+
+	format();
+	handle = open_log(O_CREAT | O_RDWR);
+	HOST_CHECK(get_size(handle) == 0);
+
+	//enough small appends to fill the trailer area of several headers
+	size = 0;
+	for(i=0; i < 400; i++){
+		nbyte = random_value(RECORD_MAX) + 1;
+		HOST_CHECK(append(handle, size, nbyte) == nbyte);
+		size += nbyte;
+		HOST_CHECK(get_size(handle) == size);
+
+		if( i % 50 == 49 ){
+			HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+			check_log(0, size);
+			handle = open_log(O_RDWR);
+		}
+	}
+	HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+	check_log(0, size);
+
+	//and the log is still there after a remount
+	mount();
+	check_log(0, size);
+}
+
+static void test_ring(){
+	void * handle;
+	int size;
+	int nbyte;
+	int first;
+	int i;
+
+	//the head is dropped a whole segment at a time
+	m_config.log_max_size = 2000;
+	format();
+	handle = open_log(O_CREAT | O_RDWR);
+	size = 0;
+	for(i=0; i < 300; i++){
+		nbyte = random_value(RECORD_MAX) + 1;
+		HOST_CHECK(append(handle, size, nbyte) == nbyte);
+		size += nbyte;
+		if( i == 0 ){
+			continue;
+		}
+		HOST_CHECK(get_size(handle) <= size);
+		HOST_CHECK(get_size(handle) >= 2000 - RECORD_MAX || get_size(handle) == size);
+	}
+
+	//the dropped bytes are a whole number of segments
+	first = size - get_size(handle);
+	HOST_CHECK(first > 0);
+	HOST_CHECK(first % BLOCK_DATA_SIZE == 0);
+	HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+	check_log(first, size - first);
+
+	mount();
+	check_log(first, size - first);
+	m_config.log_max_size = 0;
+}
+
+static void test_power_loss(int log_max_size){
+	void * handle;
+	volatile int committed;
+	volatile int pending;
+	int completed;
+	int size;
+	int cut;
+	int nbyte;
+	int rolled_back;
+	int rolled_forward;
+	int i;
+
+	rolled_back = 0;
+	rolled_forward = 0;
+	m_config.log_max_size = log_max_size;
+
+	//cut the power after every possible number of programmed bytes
+	completed = 0;
+	for(cut = 0; completed == 0; cut++){
+		m_lcg = 1;
+		format();
+		//a new file doesn't exist until it is closed
+		handle = open_log(O_CREAT | O_RDWR);
+		HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+		handle = open_log(O_RDWR);
+		committed = 0;
+		pending = 0;
+
+		if( setjmp(m_power_loss) == 0 ){
+			m_write_budget = cut;
+			for(i=0; i < 60; i++){
+				nbyte = random_value(RECORD_MAX) + 1;
+				pending = nbyte;
+				HOST_CHECK(append(handle, committed, nbyte) == nbyte);
+				committed += nbyte;
+				pending = 0;
+			}
+			m_write_budget = -1;
+			HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+			//the budget was enough for every write
+			completed = 1;
+		} else {
+			//the handle was lost with the power
+			free(handle);
+		}
+		m_write_budget = -1;
+
+		//the head of a ring log is dropped a whole segment at a time
+		mount();
+		handle = open_log(O_RDONLY);
+		size = get_size(handle);
+		HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+		if( (committed - size) % BLOCK_DATA_SIZE == 0 && is_log(committed - size, size) ){
+			//the trailer of the interrupted append was not complete
+			rolled_back++;
+		} else {
+			//the trailer was written but the power was lost before write() returned
+			HOST_CHECK(pending > 0);
+			committed += pending;
+			HOST_CHECK((committed - size) % BLOCK_DATA_SIZE == 0);
+			check_log(committed - size, size);
+			rolled_forward++;
+		}
+		HOST_CHECK(log_max_size || (size == committed));
+
+		//the recovered log can be appended
+		handle = open_log(O_RDWR);
+		HOST_CHECK(append(handle, committed, 100) == 100);
+		HOST_CHECK(get_size(handle) <= size + 100);
+		size = get_size(handle);
+		HOST_CHECK(sffs_close(&m_config, &handle) == 0);
+		check_log(committed + 100 - size, size);
+	}
+
+	HOST_CHECK(rolled_back > 0);
+	HOST_CHECK(rolled_forward > 0);
+	m_config.log_max_size = 0;
+}
+
+int main(int argc, char * argv[]){
+	test_append();
+	test_ring();
+	test_power_loss(0);
+	test_power_loss(2000);
+	return 0;
+}
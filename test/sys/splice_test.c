@@ -0,0 +1,329 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+/*
+ * Host test for sos_splice.
+ *
+ * sos_splice.c runs in a real thread with read(), write(), ioctl() and
+ * poll() replaced by an ffifo (ffifo.c) and two memory files. The ffifo
+ * is the device: it produces (or consumes) frames when the worker polls
+ * and while the worker is writing (or reading) the file, the way DMA
+ * would. The test checks the data and the number of calls the worker
+ * makes for each chunk.
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "host.h"
+#include "sos/sos.h"
+#include "device/ffifo.h"
+
+#define FRAME_SIZE 16
+#define FRAME_COUNT 8
+#define FILE_SIZE (1024*24)
+
+#define FD_FFIFO 3
+#define FD_FILE_IN 4
+#define FD_FILE_OUT 5
+
+typedef struct {
+	unsigned char data[FILE_SIZE];
+	int size;
+	int loc;
+	int limit; //most bytes the file can hold
+} memory_file_t;
+
+static char m_buffer[FRAME_SIZE*FRAME_COUNT];
+static ffifo_state_t m_state;
+static const ffifo_config_t m_config = { FFIFO_DEFINE_CONFIG(FRAME_COUNT, FRAME_SIZE, m_buffer) };
+
+static memory_file_t m_file_in;
+static memory_file_t m_file_out;
+static sos_splice_t * m_splice;
+static int m_source_frames; //frames the device has left to produce
+static unsigned char m_source_sequence;
+static unsigned char m_sink[FILE_SIZE];
+static int m_sink_size;
+static int m_is_stop_after_exchange;
+static int m_ioctl_count;
+static int m_poll_count;
+static int m_read_count;
+static int m_write_count;
+
+int devfs_execute_read_handler(devfs_transfer_handler_t * transfer_handler, void * args, int nbyte, u32 o_flags){ return 0; }
+int devfs_execute_write_handler(devfs_transfer_handler_t * transfer_handler, void * args, int nbyte, u32 o_flags){ return 0; }
+int devfs_execute_event_handler(mcu_event_handler_t * handler, u32 o_events, void * data){ return 0; }
+int devfs_poll_transfer_handler(devfs_transfer_handler_t * transfer_handler, devfs_poll_t * request, u32 o_ready_events){ return 0; }
+int devfs_validate_event_handler(const mcu_event_handler_t * handler){ return 0; }
+
+//the device fills frames (input)
+static void device_produce(int frame_count){
+	char frame[FRAME_SIZE];
+	int i;
+	while( (frame_count > 0) && (m_source_frames > 0) ){
+		for(i=0; i < FRAME_SIZE; i++){
+			frame[i] = m_source_sequence + i;
+		}
+		if( ffifo_write_buffer(&m_config, &m_state, frame, FRAME_SIZE) != FRAME_SIZE ){
+			return;
+		}
+		m_source_sequence += FRAME_SIZE;
+		m_source_frames--;
+		frame_count--;
+	}
+}
+
+//the device empties frames (output)
+static void device_consume(){
+	int result;
+	do {
+		result = ffifo_read_buffer(&m_config, &m_state, (char*)m_sink + m_sink_size, FRAME_SIZE);
+		if( result > 0 ){
+			m_sink_size += result;
+		}
+	} while( result > 0 );
+}
+
+int ioctl(int fd, unsigned long request, ...){
+	va_list ap;
+	void * ctl;
+	int result;
+
+	va_start(ap, request);
+	ctl = va_arg(ap, void*);
+	va_end(ap);
+
+	m_ioctl_count++;
+	HOST_CHECK(fd == FD_FFIFO);
+	result = ffifo_ioctl_local(&m_config, &m_state, request, ctl);
+	if( result < 0 ){
+		errno = SYSFS_GET_RETURN_ERRNO(result);
+		return -1;
+	}
+
+	if( m_is_stop_after_exchange && ((int)request == (int)I_FFIFO_EXCHANGE_READ) && (result > 0) ){
+		m_splice->o_flags |= SOS_SPLICE_FLAG_IS_STOP;
+	}
+	return result;
+}
+
+int poll(struct pollfd * fds, nfds_t nfds, int timeout){
+	m_poll_count++;
+	HOST_CHECK(nfds == 1);
+	if( fds->fd == FD_FFIFO ){
+		if( fds->events & POLLIN ){
+			device_produce(FRAME_COUNT/2);
+			if( ffifo_get_frame_count_ready(&m_config, &m_state) ){
+				return 1;
+			}
+		} else {
+			device_consume();
+			return 1;
+		}
+	} else {
+		//a file is always ready (read() returns zero at the end)
+		return 1;
+	}
+
+	//timeout
+	usleep(1000);
+	return 0;
+}
+
+ssize_t read(int fd, void * buf, size_t nbyte){
+	int bytes;
+	m_read_count++;
+	HOST_CHECK(fd == FD_FILE_IN);
+	//the device sends the frames that are ready while the file is read
+	device_consume();
+	bytes = m_file_in.size - m_file_in.loc;
+	if( (int)nbyte < bytes ){
+		bytes = nbyte;
+	}
+	memcpy(buf, m_file_in.data + m_file_in.loc, bytes);
+	m_file_in.loc += bytes;
+	return bytes;
+}
+
+ssize_t write(int fd, const void * buf, size_t nbyte){
+	int bytes;
+	m_write_count++;
+	HOST_CHECK(fd == FD_FILE_OUT);
+	//the device receives more frames while the file is written
+	device_produce(FRAME_COUNT/2);
+	bytes = m_file_out.limit - m_file_out.size;
+	if( (int)nbyte < bytes ){
+		bytes = nbyte;
+	}
+	if( bytes == 0 ){
+		errno = ENOSPC;
+		return -1;
+	}
+	memcpy(m_file_out.data + m_file_out.size, buf, bytes);
+	m_file_out.size += bytes;
+	return bytes;
+}
+
+static void reset(){
+	ffifo_flush(&m_state);
+	ffifo_set_writeblock(&m_state, 1);
+	memset(&m_file_in, 0, sizeof(m_file_in));
+	memset(&m_file_out, 0, sizeof(m_file_out));
+	m_file_out.limit = FILE_SIZE;
+	m_source_frames = 0;
+	m_source_sequence = 0;
+	m_sink_size = 0;
+	m_is_stop_after_exchange = 0;
+	m_ioctl_count = 0;
+	m_poll_count = 0;
+	m_read_count = 0;
+	m_write_count = 0;
+}
+
+static int run(sos_splice_t * splice, int fd_in, int fd_out, u32 nbyte, u32 o_flags){
+	m_splice = splice;
+	HOST_CHECK(sos_splice_start(splice, fd_in, fd_out, nbyte, o_flags) == 0);
+	while( (splice->o_flags & SOS_SPLICE_FLAG_IS_DONE) == 0 ){
+		usleep(100);
+	}
+	return sos_splice_stop(splice);
+}
+
+static void check_sequence(const unsigned char * data, int size){
+	int i;
+	for(i=0; i < size; i++){
+		HOST_CHECK(data[i] == (unsigned char)i);
+	}
+}
+
+static void test_from_ffifo(){
+	sos_splice_t splice;
+	const int frame_total = 100;
+
+	reset();
+	m_source_frames = frame_total;
+	HOST_CHECK(run(&splice, FD_FFIFO, FD_FILE_OUT, frame_total*FRAME_SIZE, SOS_SPLICE_FLAG_IS_INPUT_FFIFO) == frame_total*FRAME_SIZE);
+	HOST_CHECK(m_file_out.size == frame_total*FRAME_SIZE);
+	check_sequence(m_file_out.data, m_file_out.size);
+	HOST_CHECK((m_state.o_flags & FIFO_FLAG_IS_READ_LENT) == 0);
+
+	//the device keeps up so the worker only polls before the first frames arrive
+	HOST_CHECK(m_poll_count == 1);
+	//one request per chunk plus the two acquires before the first chunk (the first finds the ffifo empty)
+	HOST_CHECK(m_ioctl_count == m_write_count + 2);
+	printf("from ffifo: %d writes, %d ioctls, %d polls\n", m_write_count, m_ioctl_count, m_poll_count);
+
+	//the output runs out of space
+	reset();
+	m_source_frames = frame_total;
+	m_file_out.limit = FRAME_SIZE*10 + 4;
+	HOST_CHECK(run(&splice, FD_FFIFO, FD_FILE_OUT, 0, SOS_SPLICE_FLAG_IS_INPUT_FFIFO) < 0);
+	HOST_CHECK(errno == ENOSPC);
+	HOST_CHECK(splice.bytes_transferred == FRAME_SIZE*10 + 4);
+	check_sequence(m_file_out.data, m_file_out.size);
+	HOST_CHECK((m_state.o_flags & FIFO_FLAG_IS_READ_LENT) == 0);
+
+	//stopped after an exchange borrowed more frames
+	reset();
+	m_source_frames = frame_total;
+	m_is_stop_after_exchange = 1;
+	HOST_CHECK(run(&splice, FD_FFIFO, FD_FILE_OUT, 0, SOS_SPLICE_FLAG_IS_INPUT_FFIFO) == m_file_out.size);
+	HOST_CHECK(m_file_out.size > 0);
+	check_sequence(m_file_out.data, m_file_out.size);
+	HOST_CHECK((m_state.o_flags & FIFO_FLAG_IS_READ_LENT) == 0);
+	//the frames that weren't written are still in the ffifo
+	HOST_CHECK(ffifo_get_frame_count_ready(&m_config, &m_state) > 0);
+}
+
+static void test_to_ffifo(){
+	sos_splice_t splice;
+	const int size = FRAME_SIZE*100 + 5;
+	int i;
+
+	reset();
+	m_file_in.size = size;
+	for(i=0; i < size; i++){
+		m_file_in.data[i] = i;
+	}
+
+	//zero transfers to the end of the input (the last frame is padded)
+	HOST_CHECK(run(&splice, FD_FILE_IN, FD_FFIFO, 0, SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO) == size);
+	HOST_CHECK((m_state.o_flags & FIFO_FLAG_IS_WRITE_LENT) == 0);
+	device_consume();
+	HOST_CHECK(m_sink_size == FRAME_SIZE*101);
+	check_sequence(m_sink, size);
+	for(i=size; i < m_sink_size; i++){
+		HOST_CHECK(m_sink[i] == 0);
+	}
+
+	//each chunk is read into frames that were borrowed when the previous ones were returned
+	//the worker fills the ffifo faster than the device empties it so it waits each time the ffifo is full
+	//but a poll() is always followed by an acquire that succeeds
+	//the worker fills the ffifo faster than the device empties it so it waits each time the ffifo is full
+	//but a poll() is always followed by an acquire that succeeds (plus the first acquire and the one after the short read at the end)
+	HOST_CHECK(m_ioctl_count == m_read_count + m_poll_count + 2);
+	printf("to ffifo: %d reads, %d ioctls, %d polls\n", m_read_count, m_ioctl_count, m_poll_count);
+
+	//nbyte stops the transfer before the end of the input
+	reset();
+	m_file_in.size = size;
+	for(i=0; i < size; i++){
+		m_file_in.data[i] = i;
+	}
+	HOST_CHECK(run(&splice, FD_FILE_IN, FD_FFIFO, FRAME_SIZE*20, SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO) == FRAME_SIZE*20);
+	HOST_CHECK(m_file_in.loc == FRAME_SIZE*20);
+	HOST_CHECK((m_state.o_flags & FIFO_FLAG_IS_WRITE_LENT) == 0);
+	device_consume();
+	HOST_CHECK(m_sink_size == FRAME_SIZE*20);
+	check_sequence(m_sink, m_sink_size);
+}
+
+static void test_with_buffer(){
+	sos_splice_t splice;
+	const int size = BUFSIZ*2 + 100;
+	int i;
+
+	reset();
+	m_file_in.size = size;
+	for(i=0; i < size; i++){
+		m_file_in.data[i] = i;
+	}
+
+	HOST_CHECK(run(&splice, FD_FILE_IN, FD_FILE_OUT, 0, 0) == size);
+	HOST_CHECK(m_file_out.size == size);
+	check_sequence(m_file_out.data, size);
+	HOST_CHECK(m_read_count == 4);
+	HOST_CHECK(m_write_count == 3);
+	//poll() is only used before the first read and after a short read
+	HOST_CHECK(m_poll_count == 2);
+
+	HOST_CHECK(sos_splice_start(&splice, FD_FFIFO, FD_FFIFO, 0, SOS_SPLICE_FLAG_IS_INPUT_FFIFO|SOS_SPLICE_FLAG_IS_OUTPUT_FFIFO) < 0);
+	HOST_CHECK(errno == EINVAL);
+}
+
+int main(int argc, char * argv[]){
+	test_from_ffifo();
+	test_to_ffifo();
+	test_with_buffer();
+	return 0;
+}
@@ -0,0 +1,288 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Host test and benchmark for the sorted sleep and process timer queues
+ * (scheduler_timing_queue.c).
+ *
+ * Random inserts, removals and expirations are checked against the set of
+ * tasks (or timers) that should be queued. Each queue must hold exactly
+ * that set in order of expiration, with entries that expire at the same
+ * time in the order they were queued.
+ *
+ */
+
+#include "host.h"
+#include "sos/sos.h"
+#include "cortexm/cortexm.h"
+#include "sys/scheduler/scheduler_local.h"
+
+#define TASK_TOTAL 64
+#define ENTRY_TOTAL (TASK_TOTAL*SOS_PROCESS_TIMER_COUNT)
+
+SOS_DECLARE_TASK_TABLE(TASK_TOTAL);
+
+static int m_is_sleeping[TASK_TOTAL];
+static u32 m_wake_sequence[TASK_TOTAL];
+static int m_is_timer_queued[ENTRY_TOTAL+1];
+static u32 m_timer_sequence[ENTRY_TOTAL+1];
+static u32 m_next_sequence;
+static unsigned int m_lcg = 1;
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+
+static int random_value(int range){
+	m_lcg = m_lcg*1103515245u + 12345u;
+	return (m_lcg >> 8) % range;
+}
+
+//few distinct times so that many entries expire together
+static void random_time(volatile struct mcu_timeval * value){
+	value->tv_sec = random_value(3);
+	value->tv_usec = random_value(8);
+}
+
+static void reset(){
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	memset(m_is_sleeping, 0, sizeof(m_is_sleeping));
+	memset(m_is_timer_queued, 0, sizeof(m_is_timer_queued));
+	m_next_sequence = 0;
+	scheduler_timing_root_queue_init();
+}
+
+static int is_in_order(volatile const struct mcu_timeval * a, u32 a_sequence,
+							  volatile const struct mcu_timeval * b, u32 b_sequence){
+	if( a->tv_sec != b->tv_sec ){
+		return a->tv_sec < b->tv_sec;
+	}
+	if( a->tv_usec != b->tv_usec ){
+		return a->tv_usec < b->tv_usec;
+	}
+	return a_sequence < b_sequence;
+}
+
+static void check_wake_queue(){
+	int count = 0;
+	int prev = 0;
+	int id;
+
+	for(id = scheduler_timing_root_get_wake_queue_head(); id != 0; id = sos_sched_table[id].wake_next){
+		HOST_CHECK(m_is_sleeping[id]);
+		HOST_CHECK(sos_sched_table[id].wake_prev == prev);
+		if( prev ){
+			HOST_CHECK(is_in_order(&sos_sched_table[prev].wake, m_wake_sequence[prev],
+										  &sos_sched_table[id].wake, m_wake_sequence[id]));
+		}
+		prev = id;
+		count++;
+		HOST_CHECK(count < TASK_TOTAL);
+	}
+
+	for(id=1; id < TASK_TOTAL; id++){
+		count -= m_is_sleeping[id];
+		if( m_is_sleeping[id] == 0 ){
+			HOST_CHECK(sos_sched_table[id].wake_next == 0);
+			HOST_CHECK(sos_sched_table[id].wake_prev == 0);
+		}
+	}
+	HOST_CHECK(count == 0);
+}
+
+static void check_timer_queue(){
+	volatile sos_process_timer_t * timer;
+	volatile sos_process_timer_t * prev_timer;
+	int count = 0;
+	u16 prev = 0;
+	u16 entry;
+	u16 next;
+
+	for(entry = scheduler_timing_root_get_timer_queue_head(); entry != 0; entry = next){
+		timer = scheduler_timing_timer_entry_timer(entry);
+		HOST_CHECK(m_is_timer_queued[entry]);
+		HOST_CHECK(timer->value.tv_sec != SCHEDULER_TIMEVAL_SEC_INVALID);
+		HOST_CHECK(sos_sched_table[scheduler_timing_timer_entry_task_id(entry)].timer_prev[(entry-1) % SOS_PROCESS_TIMER_COUNT] == prev);
+		if( prev ){
+			prev_timer = scheduler_timing_timer_entry_timer(prev);
+			HOST_CHECK(is_in_order(&prev_timer->value, m_timer_sequence[prev], &timer->value, m_timer_sequence[entry]));
+		}
+		prev = entry;
+		next = sos_sched_table[scheduler_timing_timer_entry_task_id(entry)].timer_next[(entry-1) % SOS_PROCESS_TIMER_COUNT];
+		count++;
+		HOST_CHECK(count <= ENTRY_TOTAL);
+	}
+
+	for(entry=1; entry <= ENTRY_TOTAL; entry++){
+		count -= m_is_timer_queued[entry];
+	}
+	HOST_CHECK(count == 0);
+}
+
+static void test_entries(){
+	timer_t timer_id;
+	u16 entry;
+	int id;
+	int offset;
+
+	//entries are numbered from one (zero is the end of the queue)
+	for(id=0; id < TASK_TOTAL; id++){
+		for(offset=0; offset < SOS_PROCESS_TIMER_COUNT; offset++){
+			timer_id = SCHEDULER_TIMING_PROCESS_TIMER(id, offset);
+			entry = scheduler_timing_timer_entry(timer_id);
+			HOST_CHECK(entry == id*SOS_PROCESS_TIMER_COUNT + offset + 1);
+			HOST_CHECK(scheduler_timing_timer_entry_task_id(entry) == id);
+			HOST_CHECK(scheduler_timing_timer_entry_timer(entry) == sos_sched_table[id].timer + offset);
+		}
+	}
+}
+
+static void wake_queue_insert(int id){
+	random_time(&sos_sched_table[id].wake);
+	scheduler_timing_root_wake_queue_insert(id);
+	m_wake_sequence[id] = m_next_sequence++;
+	m_is_sleeping[id] = 1;
+}
+
+static void test_wake_queue(){
+	int operation;
+	int count;
+	int id;
+
+	reset();
+	for(count=0; count < 200000; count++){
+		id = random_value(TASK_TOTAL - 1) + 1;
+		operation = random_value(100);
+
+		if( operation < 50 ){
+			if( m_is_sleeping[id] == 0 ){
+				wake_queue_insert(id);
+			}
+		} else if( operation < 70 ){
+			//removing a task that isn't queued does nothing
+			scheduler_timing_root_dequeue_wake(id);
+			m_is_sleeping[id] = 0;
+		} else {
+			//the match handler wakes the task at the head
+			id = scheduler_timing_root_get_wake_queue_head();
+			if( id ){
+				scheduler_timing_root_dequeue_wake(id);
+				m_is_sleeping[id] = 0;
+			}
+		}
+		check_wake_queue();
+	}
+}
+
+static void test_timer_queue(){
+	volatile sos_process_timer_t * timer;
+	int operation;
+	int count;
+	u16 entry;
+	int id;
+	int i;
+
+	reset();
+	for(count=0; count < 200000; count++){
+		entry = random_value(ENTRY_TOTAL) + 1;
+		timer = scheduler_timing_timer_entry_timer(entry);
+		operation = random_value(100);
+
+		if( operation < 45 ){
+			//setting a timer moves it to its new place (or out of the queue)
+			if( random_value(8) == 0 ){
+				timer->value.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
+			} else {
+				random_time(&timer->value);
+			}
+			scheduler_timing_root_timer_queue_update(entry);
+			m_is_timer_queued[entry] = (timer->value.tv_sec != SCHEDULER_TIMEVAL_SEC_INVALID);
+			m_timer_sequence[entry] = m_next_sequence++;
+		} else if( operation < 60 ){
+			scheduler_timing_root_timer_queue_remove(entry);
+			m_is_timer_queued[entry] = 0;
+		} else if( operation < 63 ){
+			//a task that is deleted leaves both queues
+			id = scheduler_timing_timer_entry_task_id(entry);
+			if( id && (m_is_sleeping[id] == 0) && random_value(2) ){
+				wake_queue_insert(id);
+			}
+			scheduler_timing_root_dequeue_task(id);
+			for(i=0; i < SOS_PROCESS_TIMER_COUNT; i++){
+				m_is_timer_queued[id*SOS_PROCESS_TIMER_COUNT + i + 1] = 0;
+			}
+			m_is_sleeping[id] = 0;
+			check_wake_queue();
+		} else {
+			//the match handler fires the timer at the head and reloads periodic timers
+			entry = scheduler_timing_root_get_timer_queue_head();
+			if( entry ){
+				timer = scheduler_timing_timer_entry_timer(entry);
+				scheduler_timing_root_timer_queue_remove(entry);
+				m_is_timer_queued[entry] = 0;
+				if( random_value(2) ){
+					timer->value.tv_sec += 1;
+					scheduler_timing_root_timer_queue_update(entry);
+					m_is_timer_queued[entry] = 1;
+					m_timer_sequence[entry] = m_next_sequence++;
+				}
+			}
+		}
+		check_timer_queue();
+	}
+}
+
+static void bench(){
+	unsigned long long start;
+	const long count = 2000000;
+	char name[64];
+	int sleepers;
+	int id;
+	long i;
+
+	//each task that wakes sleeps again for a random time
+	for(sleepers = 4; sleepers < TASK_TOTAL; sleepers *= 4){
+		reset();
+		for(id=1; id <= sleepers; id++){
+			wake_queue_insert(id);
+		}
+
+		start = host_now_ns();
+		for(i=0; i < count; i++){
+			id = scheduler_timing_root_get_wake_queue_head();
+			scheduler_timing_root_dequeue_wake(id);
+			sos_sched_table[id].wake.tv_sec++;
+			sos_sched_table[id].wake.tv_usec = random_value(1000000);
+			scheduler_timing_root_wake_queue_insert(id);
+		}
+		snprintf(name, sizeof(name), "wake queue %d sleepers", sleepers);
+		host_report(name, host_now_ns() - start, count);
+	}
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_entries();
+	test_wake_queue();
+	test_timer_queue();
+	return 0;
+}
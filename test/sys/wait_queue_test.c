@@ -0,0 +1,302 @@
+/* Copyright 2011-2018 Tyler Gilbert;
+ * This file is part of Stratify OS.
+ *
+ * Stratify OS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stratify OS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stratify OS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+/*
+ * Host test and benchmark for the scheduler wait queues.
+ *
+ * scheduler_root.c is built with a full (255 task) table. Random block,
+ * wake, wake-all, stop and delete operations are checked against a scan
+ * of the whole table, which is how the kernel found blocked threads
+ * before the wait queues. The blocked time statistics (opt-in with
+ * SYS_FLAG_IS_TASK_STATS) are tested on their own.
+ *
+ */
+
+#include "config.h"
+#include "host.h"
+#include "sos/sos.h"
+#include "sos/dev/sys.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task_table.h"
+#include "sys/scheduler/scheduler_local.h"
+#include "sys/scheduler/scheduler_root.h"
+
+#define TASK_TOTAL 255
+#define OBJECT_COUNT 64
+
+SOS_DECLARE_TASK_TABLE(TASK_TOTAL);
+volatile int m_task_current;
+cortexm_svcall_t cortexm_svcall_validation;
+
+static u32 m_block_sequence[TASK_TOTAL];
+static u32 m_sequence;
+static u32 m_objects[OBJECT_COUNT];
+static unsigned int m_lcg = 1;
+static u32 m_now;
+static int m_clock_count;
+
+//the blocked time statistics read the flags so they are writable here
+const sos_board_config_t sos_board_config __attribute__((section(".data"))) = {
+	.task_total = TASK_TOTAL
+};
+
+void cortexm_disable_interrupts(){}
+void cortexm_enable_interrupts(){}
+void task_root_update_ready(int id){}
+void scheduler_timing_root_dequeue_wake(int id){}
+void scheduler_timing_root_get_realtime(struct mcu_timeval * tv){
+	m_clock_count++;
+	tv->tv_sec = 0;
+	tv->tv_usec = m_now;
+}
+
+static void set_sys_flags(int o_flags){
+	((sos_board_config_t*)&sos_board_config)->o_sys_flags = o_flags;
+}
+
+static int random_value(int range){
+	m_lcg = m_lcg*1103515245u + 12345u;
+	return (m_lcg >> 8) % range;
+}
+
+static int is_waiting(int id, void * block_object){
+	return task_enabled(id) &&
+			(sos_sched_table[id].block_object == block_object) &&
+			!task_active_asserted(id);
+}
+
+//the highest priority thread that has waited the longest
+static int scan_highest_priority_blocked(void * block_object){
+	int i;
+	int id = -1;
+	for(i=1; i < TASK_TOTAL; i++){
+		if( is_waiting(i, block_object) && !task_stopped_asserted(i) ){
+			if( (id == -1) ||
+				 (sos_sched_table[i].attr.schedparam.sched_priority > sos_sched_table[id].attr.schedparam.sched_priority) ||
+				 ((sos_sched_table[i].attr.schedparam.sched_priority == sos_sched_table[id].attr.schedparam.sched_priority) &&
+				  (m_block_sequence[i] < m_block_sequence[id])) ){
+				id = i;
+			}
+		}
+	}
+	return id;
+}
+
+static void start_task(int id){
+	//a new thread in a slot unlinks the old one (scheduler_thread.c)
+	scheduler_root_wait_queue_remove(id);
+	memset((void*)(sos_sched_table + id), 0, sizeof(sched_task_t));
+	sos_sched_table[id].attr.schedparam.sched_priority = random_value(8);
+	sos_task_table[id].flags = 0;
+	task_assert_used(id);
+	task_assert_active(id);
+}
+
+static void block_task(int id, void * block_object){
+	sos_sched_table[id].block_object = block_object;
+	m_block_sequence[id] = m_sequence++;
+	scheduler_root_deassert_active(id);
+}
+
+static void check_queues(){
+	int queue;
+	int count = 0;
+	int prev;
+	int i;
+
+	//each blocked thread is linked once and every queue is in priority order
+	for(queue=0; queue < SCHEDULER_WAIT_QUEUE_COUNT; queue++){
+		prev = 0;
+		for(i = scheduler_wait_queue[queue]; i != 0; i = sos_sched_table[i].wait_next){
+			HOST_CHECK(sos_sched_table[i].wait_queue == queue + 1);
+			HOST_CHECK(sos_sched_table[i].wait_prev == prev);
+			if( prev ){
+				HOST_CHECK(sos_sched_table[prev].attr.schedparam.sched_priority >=
+							  sos_sched_table[i].attr.schedparam.sched_priority);
+			}
+			prev = i;
+			count++;
+			HOST_CHECK(count < TASK_TOTAL);
+		}
+	}
+
+	for(i=1; i < TASK_TOTAL; i++){
+		if( task_enabled(i) && !task_active_asserted(i) ){
+			HOST_CHECK(sos_sched_table[i].wait_queue != 0);
+		}
+	}
+}
+
+static void test_random(){
+	int operation;
+	int expected;
+	int priority;
+	int result;
+	int count;
+	void * block_object;
+	int id;
+	int i;
+
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	memset((void*)scheduler_wait_queue, 0, SCHEDULER_WAIT_QUEUE_COUNT);
+	for(i=1; i < TASK_TOTAL; i++){
+		start_task(i);
+	}
+
+	for(count=0; count < 500000; count++){
+		id = random_value(TASK_TOTAL - 1) + 1;
+		block_object = m_objects + random_value(OBJECT_COUNT);
+		operation = random_value(100);
+
+		if( operation < 45 ){
+			if( task_enabled(id) && task_active_asserted(id) ){
+				block_task(id, block_object);
+			}
+		} else if( operation < 85 ){
+			expected = scan_highest_priority_blocked(block_object);
+			result = scheduler_root_get_highest_priority_blocked(block_object);
+			HOST_CHECK(result == expected);
+			if( result != -1 ){
+				scheduler_root_assert_active(result, SCHEDULER_UNBLOCK_SEMAPHORE);
+				HOST_CHECK(sos_sched_table[result].wait_queue == 0);
+			}
+		} else if( operation < 88 ){
+			priority = SCHED_LOWEST_PRIORITY - 1;
+			for(i=1; i < TASK_TOTAL; i++){
+				if( is_waiting(i, block_object) && !task_stopped_asserted(i) &&
+					 (sos_sched_table[i].attr.schedparam.sched_priority > priority) ){
+					priority = sos_sched_table[i].attr.schedparam.sched_priority;
+				}
+			}
+			HOST_CHECK(scheduler_root_unblock_all(block_object, SCHEDULER_UNBLOCK_COND) == priority);
+			for(i=1; i < TASK_TOTAL; i++){
+				HOST_CHECK(is_waiting(i, block_object) == 0);
+			}
+		} else if( operation < 92 ){
+			//stopped threads stay in the queue but aren't woken
+			if( task_stopped_asserted(id) ){
+				task_deassert_stopped(id);
+			} else {
+				task_assert_stopped(id);
+			}
+		} else if( operation < 96 ){
+			//a deleted thread stays in its queue
+			task_deassert_used(id);
+		} else if( task_enabled(id) == 0 ){
+			start_task(id);
+		}
+
+		if( (count % 1000) == 0 ){
+			check_queues();
+		}
+	}
+	check_queues();
+}
+
+static void test_block_time(){
+	int i;
+
+	memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+	memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+	memset((void*)scheduler_wait_queue, 0, SCHEDULER_WAIT_QUEUE_COUNT);
+	for(i=1; i < TASK_TOTAL; i++){
+		start_task(i);
+	}
+
+	//without the flag, blocking and waking don't read the clock
+	set_sys_flags(0);
+	m_clock_count = 0;
+	block_task(1, m_objects);
+	scheduler_root_assert_active(1, SCHEDULER_UNBLOCK_SEMAPHORE);
+	HOST_CHECK(m_clock_count == 0);
+	for(i=0; i < SYS_TASK_BLOCK_TOTAL; i++){
+		HOST_CHECK(sos_sched_table[1].block_time[i] == 0);
+	}
+
+	//with the flag, the time is grouped by what woke the task
+	set_sys_flags(SYS_FLAG_IS_TASK_STATS);
+	m_now = 1000;
+	block_task(1, m_objects);
+	m_now = 1250;
+	scheduler_root_assert_active(1, SCHEDULER_UNBLOCK_SEMAPHORE);
+	m_now = 2000;
+	block_task(1, m_objects + 1);
+	m_now = 2100;
+	scheduler_root_assert_active(1, SCHEDULER_UNBLOCK_MUTEX);
+	HOST_CHECK(m_clock_count == 4);
+	HOST_CHECK(sos_sched_table[1].block_time[SYS_TASK_BLOCK_SEMAPHORE] == 250);
+	HOST_CHECK(sos_sched_table[1].block_time[SYS_TASK_BLOCK_MUTEX] == 100);
+
+	//waking a task that isn't blocked charges nothing
+	scheduler_root_assert_active(1, SCHEDULER_UNBLOCK_SLEEP);
+	HOST_CHECK(sos_sched_table[1].block_time[SYS_TASK_BLOCK_SLEEP] == 0);
+	HOST_CHECK(m_clock_count == 4);
+	set_sys_flags(0);
+}
+
+static void bench(){
+	unsigned long long start;
+	const long count = 1000000;
+	int waiters;
+	char name[64];
+	int id;
+	long i;
+
+	for(waiters = 4; waiters <= 64; waiters *= 4){
+		memset((void*)sos_task_table, 0, sizeof(sos_task_table));
+		memset((void*)sos_sched_table, 0, sizeof(sos_sched_table));
+		memset((void*)scheduler_wait_queue, 0, SCHEDULER_WAIT_QUEUE_COUNT);
+		for(i=1; i < TASK_TOTAL; i++){
+			start_task(i);
+		}
+
+		//each waiter blocks on its own object
+		for(i=1; i <= waiters; i++){
+			block_task(i, m_objects + i - 1);
+		}
+
+		start = host_now_ns();
+		for(i=0; i < count; i++){
+			id = scheduler_root_get_highest_priority_blocked(m_objects + (i % waiters));
+			HOST_CHECK(id != -1);
+		}
+		snprintf(name, sizeof(name), "wait queue find %d waiters", waiters);
+		host_report(name, host_now_ns() - start, count);
+
+		start = host_now_ns();
+		for(i=0; i < count; i++){
+			id = scan_highest_priority_blocked(m_objects + (i % waiters));
+			HOST_CHECK(id != -1);
+		}
+		snprintf(name, sizeof(name), "table scan find %d waiters", waiters);
+		host_report(name, host_now_ns() - start, count);
+	}
+}
+
+int main(int argc, char * argv[]){
+	if( host_is_mode(argc, argv, "bench") ){
+		bench();
+		return 0;
+	}
+
+	test_random();
+	test_block_time();
+	return 0;
+}